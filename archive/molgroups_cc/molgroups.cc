@@ -11,1032 +11,2597 @@
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include "ctype.h"
 #include "math.h"
+#include "unistd.h"
 #include "molgroups.h"
 #include "iostream"
+#include "new"
+#include "algorithm"
+#ifdef MOLGROUPS_THREADS
+#include "thread"
+#include "vector"
+#include "mutex"
+#include "condition_variable"
+#endif
+#ifdef MOLGROUPS_ZLIB
+#include "zlib.h"
+#endif
+#ifdef MOLGROUPS_DISTRIBUTED
+#include "vector"
+#include "fcntl.h"
+#include "poll.h"
+#include "netdb.h"
+#include "sys/types.h"
+#include "sys/socket.h"
+#include "sys/stat.h"
+#include "sys/wait.h"
+#include "dirent.h"
+#include "time.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "arpa/inet.h"
+#endif
+
+#ifdef MOLGROUPS_NAMESPACE
+namespace MOLGROUPS_NAMESPACE {
+#endif
 
 
 //------------------------------------------------------------------------------------------------------
-//Parent Object Implementation
+//Rasterization Cache
 
-nSLDObj::nSLDObj()
+Raster::Raster()
 {
-    bWrapping=true;
-    bConvolution=false;
-    bProtonExchange=false;
-    dSigmaConvolution=1;
-    iNumberOfConvPoints=7;
-    absorb=0;
+    iSize=0; iCapacity=0; iDimension=0;
+    dStepsize=0;
+    iFirstBin=0; iLastBin=-1;
+    bValid=false; bAbsorb=false; bBulk=false; bMonotonic=true;
+    iKey=0; iLastUsed=0;
+    dBulk=0;
+    aBin=NULL; aArea=NULL; anSLD=NULL; aAbsorb=NULL; anSLDBulk=NULL;
 };
 
-nSLDObj::~nSLDObj(){};
+Raster::~Raster()
+{
+    delete [] aBin; delete [] aArea; delete [] anSLD; delete [] aAbsorb; delete [] anSLDBulk;
+};
 
-double nSLDObj::fnGetAbsorb(double z){return absorb;};
+void Raster::fnGrow(int iNewCapacity)
+{
+    int *iBin;
+    mgreal *dArea, *dnSLD, *dAbsorb, *dnSLDBulk;
+    int i;
+    
+    iBin=new int[iNewCapacity];
+    dArea=new mgreal[iNewCapacity];
+    dnSLD=new mgreal[iNewCapacity];
+    dAbsorb=new mgreal[iNewCapacity];
+    dnSLDBulk=new mgreal[iNewCapacity];
+    for (i=0; i<iSize; i++) {
+        iBin[i]=aBin[i]; dArea[i]=aArea[i]; dnSLD[i]=anSLD[i]; dAbsorb[i]=aAbsorb[i]; dnSLDBulk[i]=anSLDBulk[i];
+    }
+    delete [] aBin; delete [] aArea; delete [] anSLD; delete [] aAbsorb; delete [] anSLDBulk;
+    aBin=iBin; aArea=dArea; anSLD=dnSLD; aAbsorb=dAbsorb; anSLDBulk=dnSLDBulk;
+    iCapacity=iNewCapacity;
+}
 
-// returns a n-point gaussian interpolation of the area within 4 sigma
-// all area calculatioins are routed through this function, whether they use convolution or not
-// convolution works only for objects with fixed nSLD. Broadening an nSLD profile is not as direct as
-// broadening a nSL profile. For reason, however, objects report a nSLD(z) and not a nSL(z)
-// if it becomes necessary to broaden profiles with variable nSLD, structural changes to the code
-// have to be implemented.
+//------------------------------------------------------------------------------------------------------
+//Canvas
+
+Canvas::Canvas()
+{
+    dimension=0; iPaddedDimension=0;
+    stepsize=0;
+    bAbsorb=false; bBulk=false;
+    dMaxArea=0;
+    aArea=NULL; anSL=NULL; aAbsorb=NULL; anSLBulk=NULL;
+    pBlock=NULL;
+    iAllocatedElements=0;
+    bIncremental=false;
+    aWritten=NULL;
+    iSlabKey=0;
+};
+
+Canvas::Canvas(int _dimension, double _stepsize, bool _bAbsorb, bool _bBulk)
+{
+    dimension=0; iPaddedDimension=0;
+    stepsize=0;
+    bAbsorb=_bAbsorb; bBulk=_bBulk;
+    dMaxArea=0;
+    aArea=NULL; anSL=NULL; aAbsorb=NULL; anSLBulk=NULL;
+    pBlock=NULL;
+    iAllocatedElements=0;
+    bIncremental=false;
+    aWritten=NULL;
+    iSlabKey=0;
+    fnResize(_dimension, _stepsize);
+};
+
+Canvas::~Canvas()
+{
+    delete [] pBlock;
+    delete [] aWritten;
+};
+
+//four channels are always allocated, switching channels on or off never reallocates
+void Canvas::fnAllocate()
+{
+    int i, iPerAlignment, iElements;
+    size_t iAddress;
+    mgreal *p;
+    
+    iPerAlignment=MOLGROUPS_ALIGNMENT/sizeof(mgreal);
+    if (iPerAlignment<1) {iPerAlignment=1;}
+    iPaddedDimension=((dimension+iPerAlignment-1)/iPerAlignment)*iPerAlignment;
+    iElements=4*iPaddedDimension;
+    
+    if (iElements>iAllocatedElements) {
+        delete [] pBlock;
+        pBlock=new char[iElements*sizeof(mgreal)+MOLGROUPS_ALIGNMENT];
+        delete [] aWritten;
+        aWritten=new double[iElements];
+        iAllocatedElements=iElements;
+    }
+    iSlabKey=0;
+    
+    iAddress=(size_t) pBlock;
+    iAddress=((iAddress+MOLGROUPS_ALIGNMENT-1)/MOLGROUPS_ALIGNMENT)*MOLGROUPS_ALIGNMENT;
+    p=(mgreal *) iAddress;
+    for (i=0; i<iElements; i++) {new (p+i) mgreal(0);}
+    
+    aArea=p;
+    anSL=p+iPaddedDimension;
+    aAbsorb=p+2*iPaddedDimension;
+    anSLBulk=p+3*iPaddedDimension;
+    dMaxArea=0;
+}
+
+void Canvas::fnResize(int _dimension, double _stepsize)
+{
+    stepsize=_stepsize;
+    if ((_dimension!=dimension) || (pBlock==NULL)) {
+        dimension=_dimension;
+        fnAllocate();
+    }
+}
+
+void Canvas::fnSetChannels(bool _bAbsorb, bool _bBulk)
+{
+    bAbsorb=_bAbsorb;
+    bBulk=_bBulk;
+}
 
-double nSLDObj::fnGetConvolutedArea(double dz)
+//clears all channels including the padding and returns the new maximum area
+mgreal Canvas::fnClear()
 {
     int i;
-    double dgauss, dnormsum, dsum, dd;
     
-    if (bConvolution==true) {
-        
-        dnormsum=0; dsum=0;
-        for (i=0; i<iNumberOfConvPoints; i++) {
-            dd=8/(double)iNumberOfConvPoints*(double)i-4;
-            dgauss=exp((-0.5)*dd*dd);       //(sigma_convolution)^2/(sigma_convolution)^2 cancels
-            dnormsum+=dgauss;
-            dsum+=fnGetArea(dz+dd*dSigmaConvolution)*dgauss;
-        }
-        
-        if (dnormsum!=0) {
-            return dsum/dnormsum;
+    for (i=0; i<iPaddedDimension; i++) {
+        aArea[i]=0; anSL[i]=0; aAbsorb[i]=0; anSLBulk[i]=0;
+    }
+    dMaxArea=0;
+    return dMaxArea;
+}
+
+//records the destinations and bulk values of a slab write, returns true if they differ from the last write.
+//Non-incremental writes leave aWritten as it is, so they clear the key and the next incremental write is full
+bool Canvas::fnSetSlabKey(unsigned long long iKey)
+{
+    bool bChanged;
+    
+    if (bIncremental==false) {iSlabKey=0; return true;}
+    if (iKey==0) {iKey=1;}
+    bChanged=(iKey!=iSlabKey);
+    iSlabKey=iKey;
+    return bChanged;
+}
+
+//slab coefficients of the bins iStart..iEnd-1 in double precision, with the division by normarea*stepsize
+//hoisted out of the loops. For a bulk with rho_b and mu_b, a bin has
+//  rho=anSLr+aVoidBulk*rho_b  and  mu=aAbsorbr+aVoid*mu_b
+//returns false if bIncremental is set and the coefficients equal those of the last write
+bool Canvas::fnSlabBlock(int iStart, int iEnd, mgreal normarea, double anSLr[], double aAbsorbr[], double aVoid[], double aVoidBulk[])
+{
+    double dscale, dinvnorm;
+    double *w;
+    bool bChanged;
+    int j, k;
+    
+    if (dMaxArea!=0) {
+        dscale=1/fnValue(normarea*stepsize);
+        dinvnorm=1/fnValue(normarea);
+        for (j=iStart, k=0; j<iEnd; j++, k++) {
+            anSLr[k]=fnValue(anSL[j])*dscale;
+            aAbsorbr[k]=fnValue(aAbsorb[j])*dscale;
+            aVoid[k]=1-fnValue(aArea[j])*dinvnorm;
+            aVoidBulk[k]=aVoid[k]+fnValue(anSLBulk[j])*dscale;
         }
-        else return 0;
     }
-    
     else {
-        return fnGetArea(dz);
+        for (k=0; k<iEnd-iStart; k++) {anSLr[k]=0; aAbsorbr[k]=0; aVoid[k]=1; aVoidBulk[k]=1;}
+    }
+    
+    if (bIncremental==false) {return true;}
+    
+    bChanged=false;
+    for (j=iStart, k=0; j<iEnd; j++, k++) {
+        w=aWritten+4*j;
+        if ((w[0]!=anSLr[k]) || (w[1]!=aAbsorbr[k]) || (w[2]!=aVoid[k]) || (w[3]!=aVoidBulk[k])) {
+            w[0]=anSLr[k]; w[1]=aAbsorbr[k]; w[2]=aVoid[k]; w[3]=aVoidBulk[k];
+            bChanged=true;
+        }
     }
+    return bChanged;
 }
 
-void nSLDObj::fnSetConvolution(double _sigma_convolution, int _iNumberOfConvPoints)
+//------------------------------------------------------------------------------------------------------
+//Thread pool
+//workers sleep on a condition variable until fnParallelFor publishes a job, then all threads, including
+//the caller, draw indices from a shared counter until the range is exhausted
+
+#ifdef MOLGROUPS_THREADS
+class ThreadPoolState
 {
-    bConvolution=true;
-    dSigmaConvolution=_sigma_convolution;
-    iNumberOfConvPoints=_iNumberOfConvPoints;
-}
+public:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    void (*fnTask)(int i, void *pData);
+    void *pData;
+    int  inext, iend, iactive;
+    unsigned long iJob;
+    bool bStop;
+    
+    void fnRun();
+    void fnWorker();
+};
 
+//draws indices until the job is exhausted, called with the mutex unlocked
+void ThreadPoolState::fnRun()
+{
+    int i;
+    
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (inext>=iend) {return;}
+            i=inext++;
+        }
+        fnTask(i, pData);
+    }
+}
 
-void nSLDObj::fnWriteData2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void ThreadPoolState::fnWorker()
 {
-    double dLowerLimit, dUpperLimit, d, dmirror, dAreaInc, dnSLDInc;
-	int i;
+    unsigned long iSeen=0;
     
-    fprintf(fp, "z%s a%s nsl%s \n",cName, cName, cName);
-	
-	dLowerLimit=fnGetLowerLimit();
-	dUpperLimit=fnGetUpperLimit();
-	d=floor(dLowerLimit/stepsize+0.5)*stepsize;
-	
-	for (i=0; i<dimension; i++)
-	{
-        d=double(i)*stepsize;
-        dmirror=d-float(2*i)*stepsize;
-        if ((bWrapping==true) && (dmirror>=dLowerLimit))
+    while (true) {
         {
-            dAreaInc=fnGetConvolutedArea(d)+fnGetConvolutedArea(dmirror);
-            dnSLDInc=(fnGetnSLD(d)*fnGetConvolutedArea(d)+fnGetnSLD(dmirror)*fnGetConvolutedArea(dmirror))/(fnGetConvolutedArea(d)+fnGetConvolutedArea(dmirror));
-            //printf("Bin %i Area %f nSLD %e nSL %e \n", i, dAreaInc, fnGetnSLD(d), fnGetnSLD(d)*dAreaInc*stepsize);
+            std::unique_lock<std::mutex> lock(mutex);
+            while ((bStop==false) && (iJob==iSeen)) {wake.wait(lock);}
+            if (bStop) {return;}
+            iSeen=iJob;
+            iactive++;
         }
-        else
+        fnRun();
         {
-            dAreaInc=fnGetConvolutedArea(d);
-            dnSLDInc=fnGetnSLD(d);
-            //printf("Bin %i z %g Area %f nSLD %e nSL %e \n", i, d, dAreaInc, fnGetnSLD(d), fnGetnSLD(d)*dAreaInc*stepsize);
+            std::lock_guard<std::mutex> lock(mutex);
+            iactive--;
+            if (iactive==0) {done.notify_all();}
         }
-        fprintf(fp, "%lf %lf %e \n", d, dAreaInc, dnSLDInc*dAreaInc*stepsize);
-	};
-    fprintf(fp, "\n");
+    }
 }
+#else
+class ThreadPoolState
+{
+};
+#endif
 
+ThreadPool::ThreadPool(int _nthreads)
+{
+    nthreads=1;
+    pState=NULL;
+#ifdef MOLGROUPS_THREADS
+    int i;
+    
+    nthreads=_nthreads;
+    if (nthreads<=0) {nthreads=int(std::thread::hardware_concurrency());}
+    if (nthreads<=0) {nthreads=1;}
+    pState=new ThreadPoolState;
+    pState->fnTask=NULL; pState->pData=NULL;
+    pState->inext=0; pState->iend=0; pState->iactive=0;
+    pState->iJob=0;
+    pState->bStop=false;
+    for (i=1; i<nthreads; i++) {pState->workers.push_back(std::thread(&ThreadPoolState::fnWorker, pState));}
+#endif
+}
 
+ThreadPool::~ThreadPool()
+{
+#ifdef MOLGROUPS_THREADS
+    size_t i;
+    
+    {
+        std::lock_guard<std::mutex> lock(pState->mutex);
+        pState->bStop=true;
+    }
+    pState->wake.notify_all();
+    for (i=0; i<pState->workers.size(); i++) {pState->workers[i].join();}
+#endif
+    delete pState;
+}
 
-//does a Catmull-Rom Interpolation on an equal distance grid
-// 0<t<=1 is the relative position on the interval between p0 and p1
-// p-1 and p2 are needed for derivative calculation
-double nSLDObj::CatmullInterpolate(double t, double pm1, double p0, double p1, double p2){
+void ThreadPool::fnParallelFor(int istart, int iend, void (*fnTask)(int i, void *pData), void *pData)
+{
+    int i;
     
-    double m0, m1, t_2, t_3, h00, h10, h01, h11;
-        
-    m0=(p1-pm1)/2;
-    m1=(p2-p0) /2;
-            
-    t_2=t*t;
-    t_3=t_2*t;
-    h00=   2*t_3-3*t_2+1;
-    h10=     t_3-2*t_2+t;
-    h01=(-2)*t_3+3*t_2;
-    h11=     t_3-t_2;
+    if ((nthreads<=1) || (iend-istart<=1)) {
+        for (i=istart; i<iend; i++) {fnTask(i, pData);}
+        return;
+    }
+#ifdef MOLGROUPS_THREADS
+    {
+        std::lock_guard<std::mutex> lock(pState->mutex);
+        pState->fnTask=fnTask; pState->pData=pData;
+        pState->inext=istart; pState->iend=iend;
+        pState->iJob++;
+    }
+    pState->wake.notify_all();
+    pState->fnRun();
+    {
+        std::unique_lock<std::mutex> lock(pState->mutex);
+        while (pState->iactive>0) {pState->done.wait(lock);}
+    }
+#endif
+}
+
+//------------------------------------------------------------------------------------------------------
+//Binary molgroups file
+
+MolDump::MolDump()
+{
+    fp=NULL;
+    bCompress=false;
+}
+
+MolDump::~MolDump()
+{
+    fnClose();
+}
+
+FILE* MolDump::fnOpen(const char *cFileName, bool _bCompress)
+{
+    FILE *_fp;
     
-    return h00*p0+h10*m0+h01*p1+h11*m1;
+    fnClose();
+    _fp=fopen(cFileName, "wb");
+    if (_fp==NULL) {return NULL;}
+    return fnOpen(_fp, _bCompress);
+}
+
+FILE* MolDump::fnOpen(FILE *_fp, bool _bCompress)
+{
+    int iTest=1;
     
-};
+    fnClose();
+    fp=_fp;
+#ifdef MOLGROUPS_ZLIB
+    bCompress=_bCompress;
+#else
+    bCompress=false;
+#endif
+    fprintf(fp, "MOLGROUPS-BINARY 1 %s\n", (*((char *) &iTest)==1) ? "little" : "big");
+    return fp;
+}
 
-double nSLDObj::fnTriCubicCatmullInterpolate(double p[4][4][4],double t[3]){
-    double dFirstStage[4][4];
-    double dSecondStage[4];
-    int i,j;
+void MolDump::fnClose()
+{
+    if (fp==NULL) {return;}
+    fclose(fp);
+    fp=NULL;
+}
+
+void MolDump::fnWriteBlock(const char *cName, int n, const double aZ[], const double aArea[], const double anSL[])
+{
+    fnWriteColumns("#BLOCK", cName, n, aZ, aArea, anSL);
+}
+
+void MolDump::fnWriteProfile(int n, const double aZ[], const double arho[], const double amu[])
+{
+    fnWriteColumns("#PROFILE", "profile", n, aZ, arho, amu);
+}
+
+void MolDump::fnWriteColumns(const char *cTag, const char *cName, int n, const double a1[], const double a2[], const double a3[])
+{
+    size_t nbytes;
+    char *pRaw;
     
-    for (i=0; i<4; i++){
-        for (j=0; j<4; j++){
-            dFirstStage[i][j]=CatmullInterpolate(t[0],p[0][i][j],p[1][i][j],p[2][i][j],p[3][i][j]);
+    if (n<0) {n=0;}
+    nbytes=3*size_t(n)*sizeof(double);
+    pRaw=(char *) malloc(nbytes+1);
+    if (n>0) {
+        memcpy(pRaw, a1, n*sizeof(double));
+        memcpy(pRaw+n*sizeof(double), a2, n*sizeof(double));
+        memcpy(pRaw+2*n*sizeof(double), a3, n*sizeof(double));
+    }
+    
+#ifdef MOLGROUPS_ZLIB
+    if (bCompress && (nbytes>0)) {
+        //byte-shuffled: all first bytes of the 3n doubles, then all second bytes, ...
+        size_t i, j, nvalues=3*size_t(n);
+        uLongf ncompressed=compressBound(nbytes);
+        char *pShuffled=(char *) malloc(nbytes);
+        Bytef *pCompressed=(Bytef *) malloc(ncompressed);
+        
+        for (i=0; i<nvalues; i++) {
+            for (j=0; j<sizeof(double); j++) {pShuffled[j*nvalues+i]=pRaw[i*sizeof(double)+j];}
+        }
+        if (compress2(pCompressed, &ncompressed, (const Bytef *) pShuffled, nbytes, Z_BEST_SPEED)==Z_OK) {
+            fprintf(fp, "%s %s %i 1 %lu\n", cTag, cName, n, (unsigned long) ncompressed);
+            fwrite(pCompressed, 1, ncompressed, fp);
+            free(pCompressed); free(pShuffled); free(pRaw);
+            return;
         }
+        free(pCompressed); free(pShuffled);
     }
+#endif
+    fprintf(fp, "%s %s %i 0 %lu\n", cTag, cName, n, (unsigned long) nbytes);
+    fwrite(pRaw, 1, nbytes, fp);
+    free(pRaw);
+}
+
+//------------------------------------------------------------------------------------------------------
+//Statistical results reader
+
+StatReader::StatReader()
+{
+    fp=NULL;
+    aiColumn=NULL; aRow=NULL;
+    cLine=NULL; iLineLength=0;
+    nparameters=0; ncolumns=0;
+    bChisq=false;
+    cMissing[0]=0;
+}
+
+StatReader::~StatReader()
+{
+    fnClose();
+    free(cLine);
+}
+
+//reads one line of any length into cLine, false at the end of the file
+bool StatReader::fnReadLine()
+{
+    int n=0;
     
-    for (i=0; i<4; i++){
-        dSecondStage[i]=CatmullInterpolate(t[1],dFirstStage[0][i],dFirstStage[1][i],dFirstStage[2][i],dFirstStage[3][i]);
+    if (cLine==NULL) {iLineLength=4096; cLine=(char *) malloc(iLineLength);}
+    cLine[0]=0;
+    while (fgets(cLine+n, iLineLength-n, fp)!=NULL) {
+        n+=strlen(cLine+n);
+        if ((n>0) && (cLine[n-1]=='\n')) {return true;}
+        if (n<iLineLength-1) {return true;}
+        iLineLength*=2;
+        cLine=(char *) realloc(cLine, iLineLength);
     }
+    return (n>0);
+}
+
+//false if the file cannot be read or a name is not among its columns (see cMissing)
+bool StatReader::fnOpen(const char *cFileName, const char *acNames[], int _nparameters)
+{
+    char *cToken, *cNext;
+    int i, j;
     
-    return CatmullInterpolate(t[2],dSecondStage[0],dSecondStage[1],dSecondStage[2],dSecondStage[3]);        
+    fnClose();
+    fp=fopen(cFileName, "r");
+    if (fp==NULL) {return false;}
+    if (fnReadLine()==false) {fnClose(); return false;}
+    
+    nparameters=_nparameters;
+    aiColumn=new int[nparameters+1];
+    for (i=0; i<=nparameters; i++) {aiColumn[i]=-1;}
+    ncolumns=0;
+    cToken=cLine;
+    while (true) {
+        while ((*cToken!=0) && isspace((unsigned char) *cToken)) {cToken++;}
+        if (*cToken==0) {break;}
+        for (cNext=cToken; (*cNext!=0) && (isspace((unsigned char) *cNext)==0); cNext++) {}
+        if (*cNext!=0) {*cNext=0; cNext++;}
+        for (j=0; j<nparameters; j++) {
+            if ((aiColumn[j]<0) && (strcmp(cToken, acNames[j])==0)) {aiColumn[j]=ncolumns; break;}
+        }
+        if (strcmp(cToken, "Chisq")==0) {aiColumn[nparameters]=ncolumns;}
+        ncolumns++;
+        cToken=cNext;
+    }
+    bChisq=(aiColumn[nparameters]>=0);
+    aRow=new double[ncolumns+1];
+    
+    for (j=0; j<nparameters; j++) {
+        if (aiColumn[j]<0) {
+            strncpy(cMissing, acNames[j], MOLGROUPS_NAMELENGTH-1);
+            cMissing[MOLGROUPS_NAMELENGTH-1]=0;
+            fnClose();
+            return false;
+        }
+    }
+    return true;
+}
 
-};
+//reads up to nrows samples, aParameters laid out [row][parameter], aChisq may be NULL
+//rows with too few columns are skipped, returns the number of rows read
+int StatReader::fnRead(double aParameters[], double aChisq[], int nrows)
+{
+    char *cPos, *cEnd;
+    int i, j, n=0;
+    
+    if (fp==NULL) {return 0;}
+    while ((n<nrows) && fnReadLine()) {
+        cPos=cLine;
+        for (i=0; i<ncolumns; i++) {
+            aRow[i]=strtod(cPos, &cEnd);
+            if (cEnd==cPos) {break;}
+            cPos=cEnd;
+        }
+        if (i<ncolumns) {continue;}
+        for (j=0; j<nparameters; j++) {aParameters[n*nparameters+j]=aRow[aiColumn[j]];}
+        if (aChisq!=NULL) {aChisq[n]=(bChisq) ? aRow[aiColumn[nparameters]] : 0;}
+        n++;
+    }
+    return n;
+}
 
-double nSLDObj::fnQuadCubicCatmullInterpolate(double p[4][4][4][4],double t[4]){
-    double dFirstStage[4][4][4];
-    double dSecondStage[4][4];
-    double dThirdStage[4];
+void StatReader::fnClose()
+{
+    if (fp!=NULL) {fclose(fp);}
+    fp=NULL;
+    delete [] aiColumn; aiColumn=NULL;
+    delete [] aRow; aRow=NULL;
+}
 
-    int i,j,k;
+//------------------------------------------------------------------------------------------------------
+//Profile envelopes
+
+const double aEnvelopeQuantiles[MOLGROUPS_QUANTILES]={0.023, 0.159, 0.5, 0.841, 0.977};
+
+//the five P2 markers of quantile p sit at the minimum, p/2, p, (1+p)/2 and the maximum
+double fnP2Desired(int iMarker, double dFraction, int n)
+{
+    double f[5]={0, dFraction/2, dFraction, (1+dFraction)/2, 1};
     
-    for (i=0; i<4; i++){
-        for (j=0; j<4; j++){
-            for (k=0; k<4; k++){
-                dFirstStage[i][j][k]=CatmullInterpolate(t[0],p[0][i][j][k],p[1][i][j][k],p[2][i][j][k],p[3][i][j][k]);
+    return 1+double(n-1)*f[iMarker];
+}
+
+Envelope::Envelope(int _dimension, double _stepsize, int _nmaxsamples)
+{
+    dimension=_dimension;
+    stepsize=_stepsize;
+    nmaxsamples=_nmaxsamples;
+    if (nmaxsamples<5) {nmaxsamples=5;}     //P2 starts from at least five samples
+    nsamples=0;
+    bStreaming=false;
+    aSamples=new double[size_t(dimension)*nmaxsamples+1];
+    aHeights=NULL; aPositions=NULL;
+    aRow=new double[dimension+1];
+    aProfile=NULL; iProfileLength=0;
+    pScratch=NULL;
+}
+
+Envelope::~Envelope()
+{
+    delete [] aSamples;
+    delete [] aHeights;
+    delete [] aPositions;
+    delete [] aRow;
+    delete [] aProfile;
+    delete pScratch;
+}
+
+void Envelope::fnAdd(const double aValues[], int n)
+{
+    double x;
+    int i, j;
+    
+    if (n<1) {return;}
+    if ((bStreaming==false) && (nsamples==nmaxsamples)) {fnStartStreaming();}
+    nsamples++;
+    for (i=0; i<dimension; i++) {
+        x=(i<n) ? aValues[i] : aValues[n-1];
+        if (bStreaming) {
+            for (j=0; j<MOLGROUPS_QUANTILES; j++) {
+                fnStream(aHeights+(i*MOLGROUPS_QUANTILES+j)*5, aPositions+(i*MOLGROUPS_QUANTILES+j)*5, aEnvelopeQuantiles[j], x);
             }
         }
+        else {
+            aSamples[size_t(i)*nmaxsamples+nsamples-1]=x;
+        }
     }
+}
+
+void Envelope::fnAddArea(Canvas &canvas)
+{
+    int i, n;
     
-    for (i=0; i<4; i++){
-        for (j=0; j<4; j++){
-            dSecondStage[i][j]=CatmullInterpolate(t[1],dFirstStage[0][i][j],dFirstStage[1][i][j],dFirstStage[2][i][j],dFirstStage[3][i][j]);
+    n=(canvas.dimension<dimension) ? canvas.dimension : dimension;
+    for (i=0; i<n; i++) {aRow[i]=fnValue(canvas.aArea[i]);}
+    fnAdd(aRow, n);
+}
+
+//aProfile stays allocated, fnWriteCanvas2Buffer then only rewrites the blocks that changed
+void Envelope::fnAddProfile(Canvas &canvas, double bulkrho, mgreal normarea)
+{
+    if (canvas.dimension>iProfileLength) {
+        delete [] aProfile;
+        iProfileLength=canvas.dimension;
+        aProfile=new double[iProfileLength+1];
+        canvas.fnSetSlabKey(0);
+    }
+    fnWriteCanvas2Buffer(canvas, &bulkrho, &bulkrho, 1, normarea, aProfile, NULL);
+    fnAdd(aProfile, (canvas.dimension<dimension) ? canvas.dimension : dimension);
+}
+
+//the area of one group, or of several, on the grid of the envelope
+void Envelope::fnAddGroup(nSLDObj &group)
+{
+    if (pScratch==NULL) {pScratch=new Canvas(dimension, stepsize);}
+    fnClearCanvas(*pScratch);
+    group.fnWriteCanvas(*pScratch);
+    fnAddArea(*pScratch);
+}
+
+//initializes the markers of every bin from the stored samples and releases them
+void Envelope::fnStartStreaming()
+{
+    double *column, *q, *pos;
+    int i, j, k, iPos;
+    
+    aHeights=new double[size_t(dimension)*MOLGROUPS_QUANTILES*5];
+    aPositions=new double[size_t(dimension)*MOLGROUPS_QUANTILES*5];
+    for (i=0; i<dimension; i++) {
+        column=aSamples+size_t(i)*nmaxsamples;
+        std::sort(column, column+nsamples);
+        for (j=0; j<MOLGROUPS_QUANTILES; j++) {
+            q=aHeights+(i*MOLGROUPS_QUANTILES+j)*5;
+            pos=aPositions+(i*MOLGROUPS_QUANTILES+j)*5;
+            for (k=0; k<5; k++) {
+                iPos=int(floor(fnP2Desired(k, aEnvelopeQuantiles[j], nsamples)+0.5));
+                if ((k>0) && (iPos<=int(pos[k-1]))) {iPos=int(pos[k-1])+1;}
+                if (iPos>nsamples-4+k) {iPos=nsamples-4+k;}
+                pos[k]=iPos;
+                q[k]=column[iPos-1];
+            }
         }
     }
+    delete [] aSamples;
+    aSamples=NULL;
+    bStreaming=true;
+}
+
+//P2 update of the markers q (heights) and pos (positions) of one quantile with the value x
+void Envelope::fnStream(double q[], double pos[], double dFraction, double x)
+{
+    double d, s, qp;
+    int i, k;
     
-    for (i=0; i<4; i++){
-        dThirdStage[i]=CatmullInterpolate(t[2],dSecondStage[0][i],dSecondStage[1][i],dSecondStage[2][i],dSecondStage[3][i]);
+    if (x<q[0]) {q[0]=x; k=0;}
+    else if (x>=q[4]) {q[4]=x; k=3;}
+    else {
+        for (k=0; k<3; k++) {
+            if (x<q[k+1]) {break;}
+        }
+    }
+    for (i=k+1; i<5; i++) {pos[i]+=1;}
+    
+    for (i=1; i<4; i++) {
+        d=fnP2Desired(i, dFraction, nsamples)-pos[i];
+        if (((d>=1) && (pos[i+1]-pos[i]>1)) || ((d<=-1) && (pos[i-1]-pos[i]<-1))) {
+            s=(d>0) ? 1 : -1;
+            qp=q[i]+s/(pos[i+1]-pos[i-1])*((pos[i]-pos[i-1]+s)*(q[i+1]-q[i])/(pos[i+1]-pos[i])+(pos[i+1]-pos[i]-s)*(q[i]-q[i-1])/(pos[i]-pos[i-1]));
+            if ((q[i-1]<qp) && (qp<q[i+1])) {q[i]=qp;}
+            else {q[i]=q[i]+s*(q[i+int(s)]-q[i])/(pos[i+int(s)]-pos[i]);}
+            pos[i]+=s;
+        }
     }
+}
+
+double Envelope::fnGetQuantile(int iBin, double dFraction)
+{
+    double *column, dIndex, dLower, dUpper;
+    int j, iLower;
     
-    return CatmullInterpolate(t[3],dThirdStage[0],dThirdStage[1],dThirdStage[2],dThirdStage[3]);
+    if ((nsamples==0) || (iBin<0) || (iBin>=dimension)) {return 0;}
+    if (bStreaming) {
+        for (j=0; j<MOLGROUPS_QUANTILES; j++) {
+            if (fabs(aEnvelopeQuantiles[j]-dFraction)<1e-9) {return aHeights[(iBin*MOLGROUPS_QUANTILES+j)*5+2];}
+        }
+        return NAN;                                 //not tracked
+    }
     
-};
-
-//Philosophy for this first method: You simply add more and more volume and nSLD to the
-//volume and nSLD array. After all objects have filled up those arrays the maximal area is
-//determined which is the area per molecule and unfilled volume is filled with bulk solvent.
-//Hopefully the fit algorithm finds a physically meaningful solution. There has to be a global
-//hydration paramter for the bilayer.
-//Returns maximum area
-
+    //partial sort of the column, the stored order does not matter
+    column=aSamples+size_t(iBin)*nmaxsamples;
+    if (dFraction<0) {dFraction=0;}
+    if (dFraction>1) {dFraction=1;}
+    dIndex=dFraction*double(nsamples-1);
+    iLower=int(floor(dIndex));
+    std::nth_element(column, column+iLower, column+nsamples);
+    dLower=column[iLower];
+    if (iLower+1>=nsamples) {return dLower;}
+    dUpper=*std::min_element(column+iLower+1, column+nsamples);
+    return dLower+(dUpper-dLower)*(dIndex-double(iLower));
+}
 
-double nSLDObj::fnWriteProfile(double aArea[], double anSL[], int dimension, double stepsize, double dMaxArea)
+void Envelope::fnGetBands(double aBands[])
 {
-    double dLowerLimit, dUpperLimit, d, dAreaInc, dprefactor;
-	int i;
+    int i, j;
     
-	dLowerLimit=fnGetLowerLimit();
-	dUpperLimit=fnGetUpperLimit();
-    if (dUpperLimit==0)
-    {
-        dUpperLimit=double(dimension)*stepsize;
+    for (j=0; j<MOLGROUPS_QUANTILES; j++) {
+        for (i=0; i<dimension; i++) {aBands[j*dimension+i]=fnGetQuantile(i, aEnvelopeQuantiles[j]);}
     }
-	d=floor(dLowerLimit/stepsize+0.5)*stepsize;
-	
-    
-	while (d<=dUpperLimit)
-	{
-	    i=int(d/stepsize);
-		dprefactor=1;
-		if ((i<0) && (bWrapping==true)) {i=-1*i;};
-		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
-		if ((i>=0) && (i<dimension))
-		{
-		    dAreaInc=fnGetConvolutedArea(d);
-		    aArea[i]=aArea[i]+dAreaInc*dprefactor;
-			if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
-			anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-			//printf("Bin %i AreaInc %g total %g MaxArea %g nSL %f total %f \n", i, dAreaInc, aArea[i], dMaxArea, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-		}
-		d=d+stepsize;  
-	};
-	
-	return dMaxArea;
-    
-};
-double nSLDObj::fnWriteProfile(double aArea[], double anSL[], double aAbsorb[], int dimension, double stepsize, double dMaxArea)
-{
-    double dLowerLimit, dUpperLimit, d, dAreaInc, dprefactor;
-	int i;
-	
-	dLowerLimit=fnGetLowerLimit();
-	dUpperLimit=fnGetUpperLimit();
-    if (dUpperLimit==0)
-    {
-        dUpperLimit=double(dimension)*stepsize;
-    }
-	d=floor(dLowerLimit/stepsize+0.5)*stepsize;
-	
-	while (d<=dUpperLimit)
-	{
-	    i=int(d/stepsize);
-		dprefactor=1;
-		//printf("Here we are %i, dimension %i \n", i, dimension);
-		if ((i<0) && (bWrapping==true)) {i=-1*i;};
-		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
-		if ((i>=0) && (i<dimension))
-		{
-            //printf("Bin %i Areainc %f area now %f nSLD %g Absorbinc %g Absorb now %g nSLinc %g nSL now %g \n", i, dAreaInc, aArea[i], fnGetnSLD(d), aAbsorb[i], fnGetAbsorb(d)*dAreaInc*stepsize, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-		    dAreaInc=fnGetConvolutedArea(d);
-		    aArea[i]=aArea[i]+dAreaInc*dprefactor;
-			if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
-			anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-            aAbsorb[i]=aAbsorb[i]+fnGetAbsorb(d)*dAreaInc*stepsize*dprefactor;
-			//printf("Bin %i Area %f total %f nSL %f total %f \n", i, dAreaInc, aArea[i], fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-		}
-		d=d+stepsize;  
-	};
-	
-	return dMaxArea;
-    
-};
-void nSLDObj::fnOverlayProfile(double aArea[], double anSL[], int dimension, double stepsize, double dMaxArea)
-{
-    double dLowerLimit, dUpperLimit, d, dAreaInc, dprefactor, temparea;
-	int i;
-	
-	dLowerLimit=fnGetLowerLimit();
-	dUpperLimit=fnGetUpperLimit();
-    if (dUpperLimit==0)
-    {
-        dUpperLimit=double(dimension)*stepsize;
-    }
-	d=floor(dLowerLimit/stepsize+0.5)*stepsize;
-	
-	while (d<=dUpperLimit)
-	{
-	    i=int(d/stepsize);
-		dprefactor=1;
-		if ((i<0) && (bWrapping==true)) {i=-1*i;};
-		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
-		if ((i>=0) && (i<dimension))
-		{
-		    dAreaInc=fnGetConvolutedArea(d);
-			temparea=dAreaInc*dprefactor+aArea[i];
-            if (temparea<=dMaxArea) {
-                aArea[i]=aArea[i]+dAreaInc*dprefactor;
-                anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-            }
-			else {
-                if ((temparea-dMaxArea)<=aArea[i])                                                   //overfill is not larger than existing area
-                {
-                    anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-                    anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-                    aArea[i]=dMaxArea;
-                    //printf("Replace: Bin %i temparea %g Areainc %g area now %g dMaxArea %g nSLD %g nSLinc %g nSL now %g \n", i, temparea, dAreaInc, aArea[i], dMaxArea, fnGetnSLD(d), fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-                }
-                else                                                                                //overfill is larger!!, this is non-physical
-                {
-                    anSL[i]=fnGetnSLD(d)*dMaxArea*stepsize;
-                    aArea[i]=dMaxArea;
-                    
-                };
-			}
-		}
-		d=d+stepsize;
-	}
-};
+}
 
-void nSLDObj::fnOverlayProfile(double aArea[], double anSL[], double aAbsorb[], int dimension, double stepsize, double dMaxArea)
+//writes the columns of rs.py's pulledmolgroupsstat.dat, mean holds the median
+bool Envelope::fnWrite(const char *cFileName)
 {
-    double dLowerLimit, dUpperLimit, d, dAreaInc, dprefactor, temparea;
-	int i;
-	
-	dLowerLimit=fnGetLowerLimit();
-	dUpperLimit=fnGetUpperLimit();
-    if (dUpperLimit==0)
-    {
-        dUpperLimit=double(dimension)*stepsize;
+    FILE *fp;
+    double *aBands;
+    int i, j;
+    
+    fp=fopen(cFileName, "w");
+    if (fp==NULL) {return false;}
+    aBands=new double[MOLGROUPS_QUANTILES*dimension];
+    fnGetBands(aBands);
+    fprintf(fp, "zaxis m2sigma msigma mean psigma p2sigma \n");
+    for (i=0; i<dimension; i++) {
+        fprintf(fp, "%lf ", double(i)*stepsize);
+        for (j=0; j<MOLGROUPS_QUANTILES; j++) {fprintf(fp, "%e ", aBands[j*dimension+i]);}
+        fprintf(fp, "\n");
     }
-	d=floor(dLowerLimit/stepsize+0.5)*stepsize;
-	
-	while (d<=dUpperLimit)
-	{
-	    i=int(d/stepsize);
-		dprefactor=1;
-		//printf("Here we are %i, dimension %i, maxarea %f \n", i, dimension, dMaxArea);
-		if ((i<0) && (bWrapping==true)) {i=-1*i;};
-		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
-		if ((i>=0) && (i<dimension))
-		{
-		    dAreaInc=fnGetConvolutedArea(d);
-			temparea=dAreaInc*dprefactor+aArea[i];
-			if (temparea>dMaxArea) {
-                //printf("Bin %i Areainc %f area now %f nSLD %g Absorbinc %g Absorb now %g nSLinc %g nSL now %g \n", i, dAreaInc, aArea[i], fnGetnSLD(d), aAbsorb[i], fnGetAbsorb(d)*dAreaInc*stepsize, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-                anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-                anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-                aAbsorb[i]=aAbsorb[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-                aAbsorb[i]=aAbsorb[i]+fnGetAbsorb(d)*dAreaInc*stepsize*dprefactor;
-                aArea[i]=dMaxArea;
-			}
-            else {
-                //printf("Bin %i Areainc %f area now %f nSLD %g Absorbinc %g Absorb now %g nSLinc %g nSL now %g \n", i, dAreaInc, aArea[i], fnGetnSLD(d), aAbsorb[i], fnGetAbsorb(d)*dAreaInc*stepsize, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
-                aArea[i]=aArea[i]+dAreaInc*dprefactor;
-                anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
-                aAbsorb[i]=aAbsorb[i]+fnGetAbsorb(d)*dAreaInc*stepsize*dprefactor;
-            }
-		}
-		d=d+stepsize;  
-	};
-};
+    delete [] aBands;
+    fclose(fp);
+    return true;
+}
 
 //------------------------------------------------------------------------------------------------------
-//Function Object Implementation
-//------------------------------------------------------------------------------------------------------
+//Property statistics
 
-BoxErr::BoxErr(double dz, double dsigma, double dlength, double dvolume, double dnSL, double dnumberfraction=1)
+PropertyStatistics::PropertyStatistics(int _nmaxsamples)
 {
-    z=dz; sigma=dsigma; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
-};
+    nproperties=0;
+    nsamples=0;
+    nmaxsamples=_nmaxsamples;
+    pEnvelope=NULL;
+}
 
-BoxErr::~BoxErr(){};
+PropertyStatistics::~PropertyStatistics()
+{
+    delete pEnvelope;
+}
 
-//Gaussian function definition, integral is volume, return value is area at position z
-double BoxErr::fnGetArea(double dz) {
+//returns the index of the property, -1 if the table is full or samples have been added
+int PropertyStatistics::fnAddProperty(const char *cName)
+{
+    int i;
     
-    return (vol/l)*0.5*(erf((dz-z+0.5*l)/sqrt(2)/sigma)-erf((dz-z-0.5*l)/sqrt(2)/sigma))*nf;
-};
-
-//constant nSLD
-double BoxErr::fnGetnSLD(double dz) {return nSL/vol;};
-
-//Gaussians are cut off below and above 3 sigma
-double BoxErr::fnGetLowerLimit() {return z-0.5*l-3*sigma;};
-double BoxErr::fnGetUpperLimit() {return z+0.5*l+3*sigma;};
+    i=fnFind(cName);
+    if (i>=0) {return i;}
+    if ((nproperties==MOLGROUPS_MAXPROPERTIES) || (nsamples>0)) {return -1;}
+    snprintf(acNames[nproperties], MOLGROUPS_NAMELENGTH, "%s", cName);
+    aMean[nproperties]=0; aM2[nproperties]=0;
+    return nproperties++;
+}
 
-void   BoxErr::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+//returns the index of name_COM, the other properties of the group follow in the order of the header
+int PropertyStatistics::fnAddGroup(const char *cName)
 {
-    fprintf(fp, "BoxErr %s z %lf sigma %lf l %lf vol %lf nSL %e nf %lf \n",cName, z, sigma, l, vol, nSL, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    const char *acSuffix[MOLGROUPS_GROUPPROPERTIES]={"_COM", "_INT", "_AVG", "_WIDTH", "_NSL"};
+    char cProperty[MOLGROUPS_NAMELENGTH];
+    int i, iFirst=-1, iProperty;
+    
+    if (nproperties+MOLGROUPS_GROUPPROPERTIES>MOLGROUPS_MAXPROPERTIES) {return -1;}
+    for (i=0; i<MOLGROUPS_GROUPPROPERTIES; i++) {
+        snprintf(cProperty, MOLGROUPS_NAMELENGTH, "%s%s", cName, acSuffix[i]);
+        iProperty=fnAddProperty(cProperty);
+        if (iProperty<0) {return -1;}
+        if (i==0) {iFirst=iProperty;}
+    }
+    return iFirst;
 }
 
-
-//------------------------------------------------------------------------------------------------------
-
-Box2Err::Box2Err(double dz, double dsigma1, double dsigma2, double dlength, double dvolume, double dnSL, double dnumberfraction=1)
+int PropertyStatistics::fnFind(const char *cName) const
 {
-    z=dz; sigma1=dsigma1; sigma2=dsigma2; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
-    nsldbulk_store=0;
-};
+    int i;
+    
+    for (i=0; i<nproperties; i++) {
+        if (strncmp(acNames[i], cName, MOLGROUPS_NAMELENGTH-1)==0) {return i;}
+    }
+    return -1;
+}
 
-Box2Err::~Box2Err(){};
+void PropertyStatistics::fnGroupValues(int iFirst, nSLDObj &group, int dimension, double stepsize, mgreal normarea, double aValues[]) const
+{
+    Moments moments;
+    
+    if ((iFirst<0) || (iFirst+MOLGROUPS_GROUPPROPERTIES>nproperties)) {return;}
+    group.fnGetMoments(dimension, stepsize, moments);
+    aValues[iFirst]=(moments.integral!=0) ? moments.com-moments.start : 1e5;
+    aValues[iFirst+1]=(fnValue(normarea)!=0) ? moments.integral/fnValue(normarea) : 0;
+    aValues[iFirst+2]=(dimension>0) ? moments.integral/(double(dimension)*stepsize) : 0;
+    aValues[iFirst+3]=sqrt(moments.variance);
+    aValues[iFirst+4]=(fnValue(normarea)!=0) ? moments.nsl/fnValue(normarea) : 0;
+}
 
-//Gaussian function definition, integral is volume, return value is area at position z
-double Box2Err::fnGetArea(double dz) {
+void PropertyStatistics::fnAdd(const double aValues[])
+{
+    double d;
+    int i;
     
-    if ((l!=0) && (sigma1!=0) && (sigma2!=0)) {
-        return (vol/l)*0.5*(erf((dz-z+0.5*l)/sqrt(2)/sigma1)-erf((dz-z-0.5*l)/sqrt(2)/sigma2))*nf;        
+    if (nproperties==0) {return;}
+    if (pEnvelope==NULL) {pEnvelope=new Envelope(nproperties, 1, nmaxsamples);}
+    nsamples++;
+    for (i=0; i<nproperties; i++) {
+        d=aValues[i]-aMean[i];
+        aMean[i]+=d/double(nsamples);
+        aM2[i]+=d*(aValues[i]-aMean[i]);
     }
-    else {
-        return 0;
-    }
-};
+    pEnvelope->fnAdd(aValues, nproperties);
+}
 
-double Box2Err::fnGetnSL(double bulknsld) {
-    if (bProtonExchange) {
-        if (vol!=0) {
-            return ((bulknsld+0.56e-6)*nSL2+(6.36e-6-bulknsld)*nSL)/(6.36e-6+0.56e-6);
-        }
-        else {
-            return 0;
-        }
-    }
-    else {
-        return nSL;
-    }
-};
+double PropertyStatistics::fnGetMean(int i)
+{
+    if ((i<0) || (i>=nproperties)) {return 0;}
+    return aMean[i];
+}
 
+double PropertyStatistics::fnGetSigma(int i)
+{
+    if ((i<0) || (i>=nproperties) || (nsamples<2)) {return 0;}
+    return sqrt(aM2[i]/double(nsamples-1));
+}
 
-//constant nSLD
-double Box2Err::fnGetnSLD(double dz) {
-    if (vol!=0) {
-        if (bProtonExchange) {
-            return ((nsldbulk_store+0.56e-6)*nSL2+(6.36e-6-nsldbulk_store)*nSL)/(6.36e-6+0.56e-6)/vol;
-        }
-        else {
-            return nSL/vol;
-        }
-    }
-    else {
-        return 0;
-    }
+double PropertyStatistics::fnGetQuantile(int i, double dFraction)
+{
+    if (pEnvelope==NULL) {return 0;}
+    return pEnvelope->fnGetQuantile(i, dFraction);
 }
 
-double Box2Err::fnGetnSLD(double dz, double bulknsld) {
-    if (bProtonExchange) {
-        if (vol!=0) {
-            nsldbulk_store=bulknsld;                     //store bulk solvent for later plotting purposes
-            return ((bulknsld+0.56e-6)*nSL2+(6.36e-6-bulknsld)*nSL)/(6.36e-6+0.56e-6)/vol;
-        }
-        else {
-            return 0;
-        }
-    }
-    else {
-        return fnGetnSLD(dz);
+bool PropertyStatistics::fnWrite(const char *cFileName)
+{
+    FILE *fp;
+    int i, j;
+    
+    fp=fopen(cFileName, "w");
+    if (fp==NULL) {return false;}
+    fprintf(fp, "name mean sigma m2sigma msigma median psigma p2sigma \n");
+    for (i=0; i<nproperties; i++) {
+        fprintf(fp, "%s %e %e ", acNames[i], fnGetMean(i), fnGetSigma(i));
+        for (j=0; j<MOLGROUPS_QUANTILES; j++) {fprintf(fp, "%e ", fnGetQuantile(i, aEnvelopeQuantiles[j]));}
+        fprintf(fp, "\n");
     }
-};
+    fclose(fp);
+    return true;
+}
 
-//Gaussians are cut off below and above 3 sigma
-double Box2Err::fnGetLowerLimit() {return z-0.5*l-3*sigma1;};
-double Box2Err::fnGetUpperLimit() {return z+0.5*l+3*sigma2;};
+//------------------------------------------------------------------------------------------------------
+//Contour histogram
 
-void Box2Err::fnSetnSL(double _nSL, double _nSL2)
+ContourHistogram::ContourHistogram(double _z0, double _dz, int _nz, double _y0, double _dy, int _ny, bool _bRasterize)
 {
-	nSL=_nSL;
-	nSL2=_nSL2;
-    bProtonExchange=true;
+    z0=_z0; dz=_dz; nz=(_nz>0) ? _nz : 1;
+    y0=_y0; dy=_dy; ny=(_ny>0) ? _ny : 1;
+    bRasterize=_bRasterize;
+    aCounts=new unsigned int[size_t(nz)*ny];
+    aProfile=NULL; iProfileLength=0;
+    fnClear();
 }
 
-void Box2Err::fnSetSigma(double sigma)
+ContourHistogram::~ContourHistogram()
 {
-	sigma1=sigma;
-	sigma2=sigma;
+    delete [] aCounts;
+    delete [] aProfile;
 }
-void Box2Err::fnSetSigma(double dsigma1, double dsigma2)
+
+void ContourHistogram::fnClear()
 {
-	sigma1=dsigma1;
-	sigma2=dsigma2;
+    memset(aCounts, 0, sizeof(unsigned int)*size_t(nz)*ny);
+    nprofiles=0;
 }
 
-void Box2Err::fnSetZ(double dz)
+void ContourHistogram::fnCount(int iz, int iy)
 {
-	z=dz;
-};
+    if ((iz>=0) && (iz<nz) && (iy>=0) && (iy<ny)) {aCounts[size_t(iy)*nz+iz]++;}
+}
 
-void   Box2Err::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+//cell of the grid coordinate u, -1 and n stand for everything below and above the grid
+int fnGridCell(double u, int n)
 {
-    fprintf(fp, "Box2Err %s z %lf sigma1 %lf sigma2 %lf l %lf vol %lf nSL %lf nSL2 %e nf %lf \n",cName, z, sigma1, sigma2, l, vol, nSL, nSL2, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    if (u<0) {return -1;}
+    if (u>=n) {return n;}
+    return int(floor(u));
 }
 
-//------------------------------------------------------------------------------------------------------
-
-BoxErrLinearSLD::BoxErrLinearSLD(double dz, double dsigma1, double dsigma2, double dlength, double dvolume, double dnSLD1, double dnSLD2, double dnumberfraction=1)
+//Liang-Barsky: the part t0..t1 of the segment (u1,v1)-(u2,v2) within [0,umax]x[0,vmax], false if none
+bool fnClipSegment(double u1, double v1, double u2, double v2, double umax, double vmax, double &t0, double &t1)
 {
-    z=dz; sigma1=dsigma1; sigma2=dsigma2; l=dlength, vol=dvolume, nSLD1=dnSLD1, nSLD2=dnSLD2, nf=dnumberfraction;
-};
-
-BoxErrLinearSLD::~BoxErrLinearSLD(){};
-
-//Gaussian function definition, integral is volume, return value is area at position z
-double BoxErrLinearSLD::fnGetArea(double dz) {
+    double p[4], q[4], t;
+    int i;
     
-    if ((l!=0) && (sigma1!=0) && (sigma2!=0)) {
-        return (vol/l)*0.5*(erf((dz-z+0.5*l)/sqrt(2)/sigma1)-erf((dz-z-0.5*l)/sqrt(2)/sigma2))*nf;        
-    }
-    else {
-        return 0;
-    }
-};
-
-//linear nSLD
-double BoxErrLinearSLD::fnGetnSLD(double dz) {
-    if (vol!=0) { 
-
-        if (dz < (z - 0.5*l)) {
-//	printf("Returning 0 because dz is %f and z ranges from %f to %f\n", dz, z-0.5*l, z+0.5*l);
-            return nSLD1;
+    p[0]=u1-u2; q[0]=u1;
+    p[1]=u2-u1; q[1]=umax-u1;
+    p[2]=v1-v2; q[2]=v1;
+    p[3]=v2-v1; q[3]=vmax-v1;
+    t0=0; t1=1;
+    for (i=0; i<4; i++) {
+        if (p[i]==0) {
+            if (q[i]<0) {return false;}
+            continue;
         }
-        else if (dz > (z + 0.5*l)) {
-            return nSLD2;
+        t=q[i]/p[i];
+        if (p[i]<0) {if (t>t0) {t0=t;}}
+        else if (t<t1) {t1=t;}
+    }
+    return (t0<=t1);
+}
+
+//a line from one point to the next counts the cells of its longer direction once each, the next line
+//starts with the cell this one ends in. Lines are clipped to the grid first, a point that is not finite
+//ends the line, the next finite point starts a new one
+void ContourHistogram::fnAdd(const double aZ[], const double aY[], int n)
+{
+    double u1=0, v1=0, u2, v2, t0, t1;
+    int i, j, iz1, iy1, iz2, iy2, nsteps, nend;
+    bool bLine=false;
+    
+    if (n<1) {return;}
+    nprofiles++;
+    for (i=0; i<n; i++) {
+        u2=(aZ[i]-z0)/dz;
+        v2=(aY[i]-y0)/dy;
+        if ((fabs(u2)<HUGE_VAL)==false || (fabs(v2)<HUGE_VAL)==false) {
+            if (bLine) {fnCount(fnGridCell(u1, nz), fnGridCell(v1, ny));}
+            bLine=false;
+            continue;
         }
-        else {
-            return (nSLD1 + (nSLD2-nSLD1)*(dz-(z-0.5*l))/l);
-        //printf("%f\n", (nSLD1 + (nSLD2-nSLD1)*(dz-(z-0.5*l))/l));
+        if (bLine) {
+            if (bRasterize) {
+                if (fnClipSegment(u1, v1, u2, v2, nz, ny, t0, t1)) {
+                    iz1=fnGridCell(u1+(u2-u1)*t0, nz); iy1=fnGridCell(v1+(v2-v1)*t0, ny);
+                    iz2=fnGridCell(u1+(u2-u1)*t1, nz); iy2=fnGridCell(v1+(v2-v1)*t1, ny);
+                    nsteps=abs(iz2-iz1);
+                    if (abs(iy2-iy1)>nsteps) {nsteps=abs(iy2-iy1);}
+                    nend=(t1<1) ? nsteps+1 : nsteps;                        //a line leaving the grid counts its last cell too
+                    for (j=0; j<nend; j++) {
+                        if (j==nsteps) {fnCount(iz2, iy2);}
+                        else {fnCount(iz1+int(floor(double((iz2-iz1)*j)/double(nsteps)+0.5)), iy1+int(floor(double((iy2-iy1)*j)/double(nsteps)+0.5)));}
+                    }
+                }
+            }
+            else {
+                iz1=fnGridCell(u1, nz); iy1=fnGridCell(v1, ny);
+                if ((fnGridCell(u2, nz)!=iz1) || (fnGridCell(v2, ny)!=iy1)) {fnCount(iz1, iy1);}
+            }
         }
+        u1=u2; v1=v2;
+        bLine=true;
     }
-    else {
-        return 0;
-    }
-};
-
-double BoxErrLinearSLD::fnGetnSL(double dz) {
+    if (bLine) {fnCount(fnGridCell(u1, nz), fnGridCell(v1, ny));}
+}
 
-    return fnGetnSLD(dz)*vol;
+void ContourHistogram::fnAdd(const double aY[], int n, double stepsize)
+{
+    double *aZ;
+    int i;
     
-};
-
-//Gaussians are cut off below and above 3 sigma
-double BoxErrLinearSLD::fnGetLowerLimit() {return z-0.5*l-3*sigma1;};
-double BoxErrLinearSLD::fnGetUpperLimit() {return z+0.5*l+3*sigma2;};
+    aZ=new double[n+1];
+    for (i=0; i<n; i++) {aZ[i]=double(i)*stepsize;}
+    fnAdd(aZ, aY, n);
+    delete [] aZ;
+}
 
-void BoxErrLinearSLD::fnSetSigma(double sigma)
+//aProfile stays allocated, see Envelope::fnAddProfile
+void ContourHistogram::fnAddProfile(Canvas &canvas, double bulkrho, mgreal normarea)
 {
-	sigma1=sigma;
-	sigma2=sigma;
+    if (canvas.dimension>iProfileLength) {
+        delete [] aProfile;
+        iProfileLength=canvas.dimension;
+        aProfile=new double[iProfileLength+1];
+        canvas.fnSetSlabKey(0);
+    }
+    fnWriteCanvas2Buffer(canvas, &bulkrho, &bulkrho, 1, normarea, aProfile, NULL);
+    fnAdd(aProfile, canvas.dimension, canvas.stepsize);
 }
-void BoxErrLinearSLD::fnSetSigma(double dsigma1, double dsigma2)
+
+void ContourHistogram::fnMerge(const ContourHistogram &o)
 {
-	sigma1=dsigma1;
-	sigma2=dsigma2;
+    size_t i;
+    
+    if ((o.nz!=nz) || (o.ny!=ny)) {return;}
+    for (i=0; i<size_t(nz)*ny; i++) {aCounts[i]+=o.aCounts[i];}
+    nprofiles+=o.nprofiles;
 }
 
-void BoxErrLinearSLD::fnSetnSLD(double nSLD)
+bool ContourHistogram::fnWrite(const char *cFileName)
 {
-	nSLD1=nSLD;
-	nSLD2=nSLD;
+    FILE *fp;
+    int iTest=1;
+    
+    fp=fopen(cFileName, "wb");
+    if (fp==NULL) {return false;}
+    fprintf(fp, "MOLGROUPS-CONTOUR 1 %s %i %i %.17g %.17g %.17g %.17g %i\n", (*((char *) &iTest)==1) ? "little" : "big", nz, ny, z0, dz, y0, dy, nprofiles);
+    fwrite(aCounts, sizeof(unsigned int), size_t(nz)*ny, fp);
+    fclose(fp);
+    return true;
 }
-void BoxErrLinearSLD::fnSetnSLD(double dnSLD1, double dnSLD2)
+
+//------------------------------------------------------------------------------------------------------
+//Parameter Registry
+
+//called by fnRegisterParameters after the base class registered, names the layout in checkpoints
+void ParameterRegistry::fnSetClass(const char *cName)
 {
-	nSLD1=dnSLD1;
-	nSLD2=dnSLD2;
+    snprintf(cClass, MOLGROUPS_NAMELENGTH, "%s", cName);
 }
 
-void BoxErrLinearSLD::fnSetZ(double dz)
+//registering a name again replaces the entry, derived classes use this for members they shadow
+//returns the index of the entry. A full registry aborts, a parameter vector that silently lacks the
+//last parameters would fit the wrong model; raise MOLGROUPS_MAXPARAMETERS instead
+int ParameterRegistry::fnAdd(nSLDObj *object, const char *cName, mgreal *pMember, double dLower, double dUpper, bool bDerived)
 {
-	z=dz;
-};
+    int i;
+    
+    i=fnFind(cName);
+    if (i<0) {
+        if (nparameters==MOLGROUPS_MAXPARAMETERS) {
+            fprintf(stderr, "ParameterRegistry: no room for %s, at most MOLGROUPS_MAXPARAMETERS=%i \n", cName, MOLGROUPS_MAXPARAMETERS);
+            abort();
+        }
+        i=nparameters;
+        nparameters++;
+        strncpy(aParameters[i].cName, cName, MOLGROUPS_NAMELENGTH-1);
+        aParameters[i].cName[MOLGROUPS_NAMELENGTH-1]=0;
+        aParameters[i].bFixed=false;
+    }
+    aParameters[i].iOffset=size_t((char *)pMember-(char *)object);
+    aParameters[i].dLower=dLower; aParameters[i].dUpper=dUpper;
+    aParameters[i].bDerived=bDerived;
+    fnCount();
+    return i;
+}
 
-void   BoxErrLinearSLD::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+int ParameterRegistry::fnFind(const char *cName) const
 {
-    fprintf(fp, "BoxErrLinearSLD %s z %lf sigma1 %lf sigma2 %lf l %lf vol %lf nSLD1 %1f nSLD2 %e nf %lf \n",cName, z, sigma1, sigma2, l, vol, nSLD1, nSLD2, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    int i;
+    
+    for (i=0; i<nparameters; i++) {
+        if (strncmp(aParameters[i].cName, cName, MOLGROUPS_NAMELENGTH-1)==0) {return i;}
+    }
+    return -1;
 }
 
-//------------------------------------------------------------------------------------------------------
-
-Gaussian::Gaussian(double dz, double dsigma, double dvolume, double dnSL, double dnumberfraction=1)
+int ParameterRegistry::fnSetFixed(const char *cName, bool bFixed)
 {
-    z=dz; sigma=dsigma; vol=dvolume, nSL=dnSL, nf=dnumberfraction;
-};
-
-Gaussian::~Gaussian(){};
-
-//Gaussian function definition, integral is volume, return value is area at position z
-double Gaussian::fnGetArea(double dz) {return (vol/sqrt(2*3.141592654)/sigma)*exp(-0.5*(z-dz)*(z-dz)/sigma/sigma)*nf;};
-
-//constant nSLD
-double Gaussian::fnGetnSLD(double dz) {return nSL/vol;};
+    int i;
+    
+    i=fnFind(cName);
+    if (i>=0) {aParameters[i].bFixed=bFixed; fnCount();}
+    return i;
+}
 
-//Gaussians are cut off below and above 3 sigma
-double Gaussian::fnGetLowerLimit() {return z-3*sigma;};
-double Gaussian::fnGetUpperLimit() {return z+3*sigma;};
+int ParameterRegistry::fnSetBounds(const char *cName, double dLower, double dUpper)
+{
+    int i;
+    
+    i=fnFind(cName);
+    if (i>=0) {aParameters[i].dLower=dLower; aParameters[i].dUpper=dUpper;}
+    return i;
+}
 
-void   Gaussian::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void ParameterRegistry::fnCount()
 {
-    fprintf(fp, "Gaussian %s z %lf sigma %lf vol %lf nSL %e nf %lf \n",cName, z, sigma, vol, nSL, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    int i;
+    
+    nfree=0;
+    for (i=0; i<nparameters; i++) {
+        if ((aParameters[i].bFixed==false) && (aParameters[i].bDerived==false)) {nfree++;}
+    }
 }
 
 //------------------------------------------------------------------------------------------------------
+//Parent Object Implementation
 
-Parabolic::Parabolic(double dC, double dH, double dn, double dnSLD, double dnumberfraction=1)
+nSLDObj::nSLDObj()
 {
-    C=dC; H=dH, n=dn, nSLD=dnSLD, nf=dnumberfraction;
-    bWrapping=false;
+    bWrapping=true;
+    bConvolution=false;
+    bProtonExchange=false;
+    dSigmaConvolution=1;
+    iNumberOfConvPoints=7;
+    absorb=0;
+    z=0; l=0; nf=0; nSL=0; nSL2=0; vol=0;
+    bDirty=true; iStateHash=0;
+    bCaching=false;
+    aRaster=NULL; pRaster=NULL;
+    pScratch=NULL;
+    iRasterClock=0;
 };
 
-Parabolic::~Parabolic(){};
-
-//Gaussian function definition, integral is volume, return value is area at position z
-double Parabolic::fnGetArea(double dz) {
-    if (dz<H) {return C*(1-pow(dz/H,n))*nf;}
-    else {return 0;}
+//copies share no rasterization cache, the copy starts out dirty
+nSLDObj::nSLDObj(const nSLDObj &o)
+{
+    aRaster=NULL; pRaster=NULL;
+    pScratch=NULL;
+    *this=o;
 };
 
-//constant nSLD
-double Parabolic::fnGetnSLD(double dz) {return nSLD;};
+nSLDObj& nSLDObj::operator=(const nSLDObj &o)
+{
+    if (this!=&o) {
+        iNumberOfConvPoints=o.iNumberOfConvPoints;
+        bWrapping=o.bWrapping; bConvolution=o.bConvolution; bProtonExchange=o.bProtonExchange;
+        absorb=o.absorb; z=o.z; l=o.l; nf=o.nf; nSL=o.nSL; nSL2=o.nSL2; vol=o.vol;
+        dSigmaConvolution=o.dSigmaConvolution;
+        bCaching=o.bCaching;
+        fnFreeCache();
+    }
+    return *this;
+};
 
-//Gaussians are cut off below and above 3 sigma
-double Parabolic::fnGetLowerLimit() {return 0;};
-double Parabolic::fnGetUpperLimit() {return 0;};
+nSLDObj::~nSLDObj()
+{
+    fnFreeCache();
+    delete pScratch;
+};
 
-void   Parabolic::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void nSLDObj::fnFreeCache()
 {
-    fprintf(fp, "Parabolic %s C %lf H %lf n %lf  nSLD %e nf %lf \n",cName, C, H, n, nSLD, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    delete [] aRaster;
+    aRaster=NULL; pRaster=NULL;
+    iRasterClock=0;
+    bDirty=true; iStateHash=0;
 }
-//------------------------------------------------------------------------------------------------------
 
-StretchGaussian::StretchGaussian(double dz, double dsigma, double dlength, double dvolume, double dnSL, double dnumberfraction=1)
+void nSLDObj::fnSetCaching(bool _bCaching)
 {
-    z=dz; sigma=dsigma; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
-};
-
-StretchGaussian::~StretchGaussian(){};
+    bCaching=_bCaching;
+    if (bCaching==false) {fnFreeCache();}
+    bDirty=true; iStateHash=0;
+}
 
-//Gaussian function definition, integral is volume, return value is area at position z
-double StretchGaussian::fnGetArea(double dz) {
-    
-    double returnvalue;
-    double temp, dvgauss;
-    
-    temp=sqrt(2*3.141592654)*sigma;
-    dvgauss=vol/(1+l/temp);
+//invalidates the current state and all cached rasterizations, required after changing members directly
+void nSLDObj::fnSetDirty()
+{
+    int i;
     
-    if (dz<(z-0.5*l))
-    {
-        returnvalue=dvgauss/temp*exp(-0.5*(z-dz-0.5*l)*(z-dz-0.5*l)/sigma*sigma)*nf;
-    }
-    else if ((dz>=(z-0.5*l)) && (dz<=(z+0.5*l)))
-    {
-        returnvalue=dvgauss/temp*nf;
+    bDirty=true; iStateHash=0;
+    if (aRaster!=NULL) {
+        for (i=0; i<MOLGROUPS_CACHESLOTS; i++) {aRaster[i].bValid=false;}
     }
-    else
-    {
-        returnvalue=dvgauss/temp*exp(-0.5*(dz-z-0.5*l)*(dz-z-0.5*l)/sigma*sigma)*nf;
+}
+
+//writes the free parameters of the registry from aValues into the object, recomputes the dependent
+//members if a value changed and keys the rasterization cache as fnSet does. Returns the number of
+//values read, so that the vector of a model with several objects can be passed on object by object:
+//  n=0; n+=a.fnSetParameters(ra, x+n, n); n+=b.fnSetParameters(rb, x+n, n);
+//With dual numbers, free parameter i is seeded as derivative iFirstDerivative+i, the position of its
+//value in the model's vector
+int nSLDObj::fnSetParameters(const ParameterRegistry &registry, const double aValues[], int iFirstDerivative)
+{
+    mgreal aState[MOLGROUPS_MAXPARAMETERS], dValue, *pMember;
+    int i, n, nstate;
+    
+    n=0; nstate=0;
+    for (i=0; i<registry.nparameters; i++) {
+        if (registry.aParameters[i].bDerived) {continue;}
+        pMember=(mgreal *)((char *)this+registry.aParameters[i].iOffset);
+        if (registry.aParameters[i].bFixed==false) {
+            dValue=aValues[n];
+#ifdef MOLGROUPS_DUAL
+            fnSeedDerivative(dValue, iFirstDerivative+n);
+#endif
+            if (*pMember!=dValue) {bDirty=true;}
+            *pMember=dValue;
+            n++;
+        }
+        aState[nstate]=*pMember;
+        nstate++;
     }
     
-    return returnvalue;
-};
-
-//constant nSLD
-double StretchGaussian::fnGetnSLD(double dz) {return nSL/vol;};
+    fnApplyState(aState, nstate);
+    return n;
+}
 
-//Gaussians are cut off below and above 3 sigma
-double StretchGaussian::fnGetLowerLimit() {return z-0.5*l-3*sigma;};
-double StretchGaussian::fnGetUpperLimit() {return z+0.5*l+3*sigma;};
+//reads the current values of the free parameters into aValues, returns their number
+int nSLDObj::fnGetParameters(const ParameterRegistry &registry, double aValues[])
+{
+    int i, n;
+    
+    n=0;
+    for (i=0; i<registry.nparameters; i++) {
+        if ((registry.aParameters[i].bFixed==false) && (registry.aParameters[i].bDerived==false)) {
+            aValues[n]=fnValue(*(mgreal *)((char *)this+registry.aParameters[i].iOffset));
+            n++;
+        }
+    }
+    return n;
+}
 
-void   StretchGaussian::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+//value of any registered parameter including fixed and derived ones, 0 for unknown names
+mgreal nSLDObj::fnGetParameter(const ParameterRegistry &registry, const char *cName)
 {
-    fprintf(fp, "Gaussian %s z %lf sigma %lf l %lf vol %lf nSL %e nf %lf \n",cName, z, sigma, l, vol, nSL, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    int i;
+    
+    i=registry.fnFind(cName);
+    if (i<0) {return 0;}
+    return *(mgreal *)((char *)this+registry.aParameters[i].iOffset);
 }
 
-//------------------------------------------------------------------------------------------------------
-// Combined Object Implementation
-//------------------------------------------------------------------------------------------------------
+//key of a state: FNV-1a over the fnSet parameters and the members without a setter that the class adds in
+//fnHashMembers. For dual numbers this includes the derivatives
+unsigned long long nSLDObj::fnHashParameters(const mgreal aParameters[], int iNumberOfParameters)
+{
+    unsigned long long iHash;
+    
+    iHash=fnHashMembers(fnHashBytes(aParameters, sizeof(mgreal)*iNumberOfParameters));
+    if (iHash==0) {iHash=1;}
+    return iHash;
+}
 
-PC::PC()
+//common end of the setters. Without caching, dependent members are always recomputed and no key is
+//kept. With caching, a state whose key differs from the current one is dirty even if no setter
+//argument changed
+void nSLDObj::fnApplyState(const mgreal aParameters[], int iNumberOfParameters)
 {
+    unsigned long long iHash;
     
-    cg = new Box2Err(0,0,0,0,0,0,1);
-    phosphate = new Box2Err(0,0,0,0,0,0,1);
-    choline = new Box2Err(0,0,0,0,0,0,1);
+    if (bCaching==false) {
+        fnAdjustParameters();
+        iStateHash=0;
+        return;
+    }
+    iHash=fnHashParameters(aParameters, iNumberOfParameters);
+    if (iHash!=iStateHash) {bDirty=true;}
+    if (bDirty==true) {fnAdjustParameters();}
+    iStateHash=iHash;
+}
+
+//evaluates the object on the same grid points and with the same wrapping as fnWriteProfile and stores
+//bin, area increment (including the mirror prefactor) and nSLD of every point that falls on the canvas
+//nothing is done if the object is clean and the grid is unchanged. A dirty object whose fnSet parameters
+//match a cached slot reuses that slot, otherwise the least recently used slot is overwritten
+//without caching, every call rasterizes the current state into the first slot, members may have been
+//changed directly since the last fnSet.
+//with bBulk, the nSLD is evaluated a second time at a shifted bulk nSLD. Areas do not depend on the
+//bulk and all nSLDs are linear in it, so the difference is the exact contrast dependence
+void nSLDObj::fnRasterize(int dimension, double stepsize, bool bAbsorb, bool bBulk)
+{
+    mgreal dLowerLimit, dUpperLimit, dAreaInc, dBulk;
+    double d, dprefactor;
+    int i, n;
+    bool bStoreDirty;
+    unsigned long long iStoreHash;
+    Raster *r;
+    
+    if (aRaster==NULL) {aRaster=new Raster[MOLGROUPS_CACHESLOTS]; pRaster=&aRaster[0];}
+    iRasterClock++;
+    if (bCaching==false) {bDirty=true;}
+    
+    if ((bDirty==false) && (pRaster->bValid) && (pRaster->iDimension==dimension) && (pRaster->dStepsize==stepsize) && ((bAbsorb==false) || (pRaster->bAbsorb==true)) && ((bBulk==false) || (pRaster->bBulk==true))) {
+        pRaster->iLastUsed=iRasterClock;
+        return;
+    }
     
-    cg->l=4.21; phosphate->l=3.86; choline->l=6.34;                             //from fit to Feller data
-    cg->sigma1=2.53; cg->sigma2=2.29;
-    phosphate->sigma1=2.29; phosphate->sigma2=2.02;
-    choline->sigma1=2.02; choline->sigma2=2.26;
-    //from fit to Feller data
-    l=9.575;                                                                    //group cg    phosphate choline
-    //z     15.00 18.44     19.30
-    //l      4.21  3.86      6.34
+    if ((bCaching==true) && (iStateHash!=0)) {
+        for (i=0; i<MOLGROUPS_CACHESLOTS; i++) {
+            r=&aRaster[i];
+            if ((r->bValid) && (r->iKey==iStateHash) && (r->iDimension==dimension) && (r->dStepsize==stepsize) && ((bAbsorb==false) || (r->bAbsorb==true)) && ((bBulk==false) || (r->bBulk==true))) {
+                pRaster=r;
+                pRaster->iLastUsed=iRasterClock;
+                bDirty=false;
+                return;
+            }
+        }
+        for (i=0; i<MOLGROUPS_CACHESLOTS; i++) {
+            if ((aRaster[i].bValid==false) || (aRaster[i].iLastUsed<pRaster->iLastUsed)) {pRaster=&aRaster[i];}
+            if (aRaster[i].bValid==false) {break;}
+        }
+    }
+    r=pRaster;
     
-    cg->vol=147; phosphate->vol=54; choline->vol=120;                           //nominal values
-    cg->nSL=3.7755e-4; phosphate->nSL=2.8350e-4; choline->nSL=-6.0930e-5;
-    cg->nf=1; phosphate->nf=1; choline->nf=1;
+	dLowerLimit=fnGetLowerLimit();
+	dUpperLimit=fnGetUpperLimit();
+    if (dUpperLimit==0)
+    {
+        dUpperLimit=double(dimension)*stepsize;
+    }
     
-    vol=cg->vol+phosphate->vol+choline->vol;
-    nSL=cg->nSL+phosphate->nSL+choline->nSL;
+    dBulk=fnGetBulknSLD();
+    if (bBulk) {
+        bStoreDirty=bDirty; iStoreHash=iStateHash;
+        fnSetBulknSLD(dBulk+1e-6);
+        n=0;
+        d=floor(fnValue(dLowerLimit)/stepsize+0.5)*stepsize;
+        while (d<=dUpperLimit)
+        {
+            i=int(d/stepsize);
+            if ((i<0) && (bWrapping==true)) {i=-1*i;};
+            if ((i>=0) && (i<dimension))
+            {
+                if (n==r->iCapacity) {r->iSize=n; r->fnGrow(2*r->iCapacity+dimension);}
+                r->anSLDBulk[n]=fnGetnSLD(d);
+                n++;
+            }
+            d=d+stepsize;
+        };
+        fnSetBulknSLD(dBulk);
+        bDirty=bStoreDirty; iStateHash=iStoreHash;
+    }
     
-    fnAdjustParameters();
+	d=floor(fnValue(dLowerLimit)/stepsize+0.5)*stepsize;
+    n=0;
+    r->iFirstBin=dimension; r->iLastBin=-1;
+    r->bMonotonic=true;
+	while (d<=dUpperLimit)
+	{
+	    i=int(d/stepsize);
+		dprefactor=1;
+		if ((i<0) && (bWrapping==true)) {i=-1*i;};
+		if ((i==0) && (bWrapping==true)) {dprefactor=2;}
+		if ((i>=0) && (i<dimension))
+		{
+            if (n==r->iCapacity) {r->iSize=n; r->fnGrow(2*r->iCapacity+dimension);}
+		    dAreaInc=fnGetConvolutedArea(d);
+            if ((n>0) && (i<=r->aBin[n-1])) {r->bMonotonic=false;}
+            if (i<r->iFirstBin) {r->iFirstBin=i;}
+            if (i>r->iLastBin) {r->iLastBin=i;}
+            r->aBin[n]=i;
+            r->aArea[n]=dAreaInc*dprefactor;
+            r->anSLD[n]=fnGetnSLD(d);
+            if (bAbsorb) {r->aAbsorb[n]=fnGetAbsorb(d);}
+            if (bBulk) {r->anSLDBulk[n]=(r->anSLDBulk[n]-r->anSLD[n])/1e-6;}
+            n++;
+		}
+		d=d+stepsize;
+	};
     
-};
-
-PC::~PC(){
-    delete cg;
-    delete phosphate;
-    delete choline;
-};
-
-void PC::fnAdjustParameters(){
-    cg->z=z-0.5*l+0.5*cg->l;
-    choline->z=z+0.5*l-0.5*choline->l;
-    phosphate->z=(cg->z+0.5*cg->l+choline->z-choline->l*0.5)/2;
+    r->iSize=n;
+    r->iDimension=dimension;
+    r->dStepsize=stepsize;
+    r->bAbsorb=bAbsorb;
+    r->bBulk=bBulk;
+    r->dBulk=dBulk;
+    r->bValid=true;
+    r->iKey=iStateHash;
+    r->iLastUsed=iRasterClock;
+    bDirty=false;
+}
 
-};
+//bins the current raster onto the scratch canvas, only the range covered by the raster is touched
+//the nSL channels hold the same increments that the scalar overlay adds per grid point
+void nSLDObj::fnRaster2Scratch(int dimension, double stepsize, bool bBulk)
+{
+    int i, n;
+    
+    if (pScratch==NULL) {pScratch=new Canvas(dimension, stepsize);}
+    else {pScratch->fnResize(dimension, stepsize);}
+    
+    for (i=pRaster->iFirstBin; i<=pRaster->iLastBin; i++) {
+        pScratch->aArea[i]=0; pScratch->anSL[i]=0; pScratch->aAbsorb[i]=0; pScratch->anSLBulk[i]=0;
+    }
+    for (n=0; n<pRaster->iSize; n++) {
+        i=pRaster->aBin[n];
+        pScratch->aArea[i]=pRaster->aArea[n];
+        if (bBulk) {
+            pScratch->anSL[i]=(pRaster->anSLD[n]-pRaster->dBulk*pRaster->anSLDBulk[n])*pRaster->aArea[n]*stepsize;
+            pScratch->anSLBulk[i]=pRaster->anSLDBulk[n]*pRaster->aArea[n]*stepsize;
+        }
+        else {
+            pScratch->anSL[i]=pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+        }
+        if (pRaster->bAbsorb) {pScratch->aAbsorb[i]=pRaster->aAbsorb[n]*pRaster->aArea[n]*stepsize;}
+    }
+}
 
-//Return value is area at position z
-double PC::fnGetArea(double dz) {
-    return (cg->fnGetArea(dz)+phosphate->fnGetArea(dz)+choline->fnGetArea(dz))*nf;
-};
+mgreal nSLDObj::fnGetAbsorb(mgreal z){return absorb;};
 
-double PC::fnGetTotalnSL(){
-    return cg->nSL+phosphate->nSL+choline->nSL;
-};
+// returns a n-point gaussian interpolation of the area within 4 sigma
+// all area calculatioins are routed through this function, whether they use convolution or not
+// convolution works only for objects with fixed nSLD. Broadening an nSLD profile is not as direct as
+// broadening a nSL profile. For reason, however, objects report a nSLD(z) and not a nSL(z)
+// if it becomes necessary to broaden profiles with variable nSLD, structural changes to the code
+// have to be implemented.
 
-//get nSLD from molecular subgroups
-double PC::fnGetnSLD(double dz) {
-    double cgarea, pharea, charea, sum;
+mgreal nSLDObj::fnGetConvolutedArea(mgreal dz)
+{
+    int i;
+    mgreal dgauss, dnormsum, dsum, dd;
     
-    cgarea=cg->fnGetArea(dz);
-    pharea=phosphate->fnGetArea(dz);
-    charea=choline->fnGetArea(dz);
-    sum=cgarea+pharea+charea;
+    if (bConvolution==true) {
+        
+        dnormsum=0; dsum=0;
+        for (i=0; i<iNumberOfConvPoints; i++) {
+            dd=8/(double)iNumberOfConvPoints*(double)i-4;
+            dgauss=exp((-0.5)*dd*dd);       //(sigma_convolution)^2/(sigma_convolution)^2 cancels
+            dnormsum+=dgauss;
+            dsum+=fnGetArea(dz+dd*dSigmaConvolution)*dgauss;
+        }
+        
+        if (dnormsum!=0) {
+            return dsum/dnormsum;
+        }
+        else return 0;
+    }
     
-    if (sum==0) {return 0;}
     else {
-        return (cg->fnGetnSLD(dz)*cgarea+
-                phosphate->fnGetnSLD(dz)*pharea+
-                choline->fnGetnSLD(dz)*charea)/sum;
+        return fnGetArea(dz);
     }
-};
-
-//Use limits of molecular subgroups
-double PC::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
-double PC::fnGetUpperLimit() {return choline->fnGetUpperLimit();};
+}
 
-void PC::fnSetSigma(double sigma)
+void nSLDObj::fnSetConvolution(mgreal _sigma_convolution, int _iNumberOfConvPoints)
 {
-    cg->sigma1=sigma;
-    cg->sigma2=sigma;
-    phosphate->sigma1=sigma;
-    phosphate->sigma2=sigma;
-    choline->sigma1=sigma;
-    choline->sigma2=sigma;
-};
-
+    bDirty=true; iStateHash=0;
+    bConvolution=true;
+    dSigmaConvolution=_sigma_convolution;
+    iNumberOfConvPoints=_iNumberOfConvPoints;
+}
 
-void PC::fnSetZ(double dz){
-    z=dz;
-    fnAdjustParameters();
-};
 
-void PC::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+//area and nSL of grid point i as written to mol.dat, wrapping groups add their mirror image below z=0
+void nSLDObj::fnGetBin(int i, double stepsize, mgreal dLowerLimit, mgreal &dArea, mgreal &dnSL)
 {
-    //char *str = new char[80];
-    
-    fprintf(fp, "PC %s z %lf l %lf vol %lf nf %lf \n",cName, z, l,cg->vol+phosphate->vol+choline->vol, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
-    //cg->fnWriteGroup2File(fp, "cg", dimension, stepsize);
-    //phosphate->fnWriteGroup2File(fp, "phosphate", dimension, stepsize);
-    //choline->fnWriteGroup2File(fp, "choline", dimension, stepsize);
-    
-    //delete []str;
+    mgreal dnSLDInc;
+    double d, dmirror;
     
+    d=double(i)*stepsize;
+    dmirror=d-float(2*i)*stepsize;
+    if ((bWrapping==true) && (dmirror>=dLowerLimit))
+    {
+        dArea=fnGetConvolutedArea(d)+fnGetConvolutedArea(dmirror);
+        dnSLDInc=(fnGetnSLD(d)*fnGetConvolutedArea(d)+fnGetnSLD(dmirror)*fnGetConvolutedArea(dmirror))/(fnGetConvolutedArea(d)+fnGetConvolutedArea(dmirror));
+        //printf("Bin %i Area %f nSLD %e nSL %e \n", i, dArea, fnGetnSLD(d), fnGetnSLD(d)*dArea*stepsize);
+    }
+    else
+    {
+        dArea=fnGetConvolutedArea(d);
+        dnSLDInc=fnGetnSLD(d);
+        //printf("Bin %i z %g Area %f nSLD %e nSL %e \n", i, d, dArea, fnGetnSLD(d), fnGetnSLD(d)*dArea*stepsize);
+    }
+    dnSL=dnSLDInc*dArea*stepsize;
 }
-//------------------------------------------------------------------------------------------------------
-PCm::PCm() 
+
+void nSLDObj::fnWriteData2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    cg->sigma2=2.53; cg->sigma1=2.29;										//from fit to Feller data
-    phosphate->sigma2=2.29; phosphate->sigma1=2.02;
-    choline->sigma2=2.02; choline->sigma1=2.26;
-    
-    fnAdjustParameters();
+    mgreal dLowerLimit, dAreaInc, dnSLInc;
+    double *aZ=NULL, *aArea=NULL, *anSL=NULL;
+	int i;
+    MolDump *pDump=fp.pDump;
     
-};
-
-PCm::~PCm() {};
-
-void PCm::fnAdjustParameters(){
-    cg->z=z+0.5*l-0.5*cg->l;
-    choline->z=z-0.5*l+0.5*choline->l;
-    phosphate->z=(cg->z-0.5*cg->l+choline->z+choline->l*0.5)/2;
-};
-
-//Use limits of molecular subgroups
-double PCm::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
-double PCm::fnGetUpperLimit() {return choline->fnGetUpperLimit();};
+    if (pDump!=NULL) {
+        aZ=new double[3*dimension+1];
+        aArea=aZ+dimension;
+        anSL=aArea+dimension;
+    }
+    else {
+        fprintf(fp, "z%s a%s nsl%s \n",cName, cName, cName);
+    }
+	
+	dLowerLimit=fnGetLowerLimit();
+	for (i=0; i<dimension; i++)
+	{
+        fnGetBin(i, stepsize, dLowerLimit, dAreaInc, dnSLInc);
+        if (pDump!=NULL) {
+            aZ[i]=double(i)*stepsize; aArea[i]=fnValue(dAreaInc); anSL[i]=fnValue(dnSLInc);
+        }
+        else {
+            fprintf(fp, "%lf %lf %e \n", double(i)*stepsize, fnValue(dAreaInc), fnValue(dnSLInc));
+        }
+	};
+    if (pDump!=NULL) {
+        pDump->fnWriteBlock(cName, dimension, aZ, aArea, anSL);
+        delete [] aZ;
+    }
+    else {
+        fprintf(fp, "\n");
+    }
+}
 
-void   PCm::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+//moments of the area on the grid of fnWriteData2File, as rs.py derives them from mol.dat
+void nSLDObj::fnGetMoments(int dimension, double stepsize, Moments &moments)
 {
-    //char *str = new char[80];
-    
-    fprintf(fp, "PCm %s z %lf l %lf vol %lf nf %lf \n",cName, z, l,cg->vol+phosphate->vol+choline->vol, nf);
-    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
-    //cg->fnWriteGroup2File(fp, "cg_m", dimension, stepsize);
-    //phosphate->fnWriteGroup2File(fp, "phosphate_m", dimension, stepsize);
-    //choline->fnWriteGroup2File(fp, "choline_m", dimension, stepsize);
-    
-    //delete []str;
+    mgreal dLowerLimit, dArea, dnSL;
+    double d, dSum=0, dSumZ=0, dSumZZ=0;
+	int i;
     
+    moments.nsl=0; moments.start=1e5;
+	dLowerLimit=fnGetLowerLimit();
+	for (i=0; i<dimension; i++)
+	{
+        d=double(i)*stepsize;
+        fnGetBin(i, stepsize, dLowerLimit, dArea, dnSL);
+        if ((fabs(fnValue(dArea))>=5e-7) && (moments.start==1e5)) {moments.start=d;}    //non-zero in mol.dat
+        dSum+=fnValue(dArea); dSumZ+=fnValue(dArea)*d; dSumZZ+=fnValue(dArea)*d*d;
+        moments.nsl+=fnValue(dnSL);
+	};
+    moments.integral=dSum*stepsize;
+    if (dSum!=0) {
+        moments.com=dSumZ/dSum;
+        moments.variance=dSumZZ/dSum-moments.com*moments.com;
+        if (moments.variance<0) {moments.variance=0;}
+    }
+    else {
+        moments.com=1e5;
+        moments.variance=0;
+    }
 }
-//---------------------------------------------------------------------------------------------------------------
-PS::PS()
-{
-    
-    cg = new Box2Err(0,0,0,0,0,0,1);
-    phosphate = new Box2Err(0,0,0,0,0,0,1);
-    serine = new Box2Err(0,0,0,0,0,0,1);
-    
-    cg->l=3.6; phosphate->l=2.0; serine->l=3.0;                             //from fit to Feller data
-    cg->sigma1=2.53; cg->sigma2=2.29;
-    phosphate->sigma1=2.29; phosphate->sigma2=2.02;
-    serine->sigma1=2.02; serine->sigma2=2.26;
-    //from fit to Feller data
-    l=8.6;                                                                    //group cg    phosphate choline
-    //z     15.00 18.44     19.30
-    //l      4.21  3.86      6.34
+
+
+
+//does a Catmull-Rom Interpolation on an equal distance grid
+// 0<t<=1 is the relative position on the interval between p0 and p1
+// p-1 and p2 are needed for derivative calculation
+mgreal nSLDObj::CatmullInterpolate(mgreal t, mgreal pm1, mgreal p0, mgreal p1, mgreal p2){
     
-    cg->vol=147; phosphate->vol=54; serine->vol=80;                           //nominal values
-    cg->nSL=3.7755e-4; phosphate->nSL=2.8350e-4; serine->nSL=1.8408E-04;
-    cg->nf=1; phosphate->nf=1; serine->nf=1;
+    mgreal m0, m1, t_2, t_3, h00, h10, h01, h11;
+        
+    m0=(p1-pm1)/2;
+    m1=(p2-p0) /2;
+            
+    t_2=t*t;
+    t_3=t_2*t;
+    h00=   2*t_3-3*t_2+1;
+    h10=     t_3-2*t_2+t;
+    h01=(-2)*t_3+3*t_2;
+    h11=     t_3-t_2;
     
-    fnAdjustParameters();
+    return h00*p0+h10*m0+h01*p1+h11*m1;
     
 };
 
-PS::~PS(){
-    delete cg;
-    delete phosphate;
-    delete serine;
-};
+mgreal nSLDObj::fnTriCubicCatmullInterpolate(mgreal p[4][4][4],mgreal t[3]){
+    mgreal dFirstStage[4][4];
+    mgreal dSecondStage[4];
+    int i,j;
+    
+    for (i=0; i<4; i++){
+        for (j=0; j<4; j++){
+            dFirstStage[i][j]=CatmullInterpolate(t[0],p[0][i][j],p[1][i][j],p[2][i][j],p[3][i][j]);
+        }
+    }
+    
+    for (i=0; i<4; i++){
+        dSecondStage[i]=CatmullInterpolate(t[1],dFirstStage[0][i],dFirstStage[1][i],dFirstStage[2][i],dFirstStage[3][i]);
+    }
+    
+    return CatmullInterpolate(t[2],dSecondStage[0],dSecondStage[1],dSecondStage[2],dSecondStage[3]);        
 
-void PS::fnAdjustParameters(){
-    cg->z=z-0.5*l+0.5*cg->l; phosphate->z=z-0.5*l+cg->l+0.5*phosphate->l;
-    serine->z=z+0.5*l-0.5*serine->l;                                           
 };
 
-//Return value is area at position z
-double PS::fnGetArea(double dz) {
-    return (cg->fnGetArea(dz)+phosphate->fnGetArea(dz)+serine->fnGetArea(dz))*nf;
-};
+mgreal nSLDObj::fnQuadCubicCatmullInterpolate(mgreal p[4][4][4][4],mgreal t[4]){
+    mgreal dFirstStage[4][4][4];
+    mgreal dSecondStage[4][4];
+    mgreal dThirdStage[4];
 
-//get nSLD from molecular subgroups
-double PS::fnGetnSLD(double dz) {
-    double cgarea, pharea, searea, sum;
+    int i,j,k;
     
-    cgarea=cg->fnGetArea(dz);
-    pharea=phosphate->fnGetArea(dz);
-    searea=serine->fnGetArea(dz);
-    sum=cgarea+pharea+searea;
+    for (i=0; i<4; i++){
+        for (j=0; j<4; j++){
+            for (k=0; k<4; k++){
+                dFirstStage[i][j][k]=CatmullInterpolate(t[0],p[0][i][j][k],p[1][i][j][k],p[2][i][j][k],p[3][i][j][k]);
+            }
+        }
+    }
     
-    if (sum==0) {return 0;}
-    else {
-        return (cg->fnGetnSLD(dz)*cgarea+
-                phosphate->fnGetnSLD(dz)*pharea+
-                serine->fnGetnSLD(dz)*searea)/sum;
+    for (i=0; i<4; i++){
+        for (j=0; j<4; j++){
+            dSecondStage[i][j]=CatmullInterpolate(t[1],dFirstStage[0][i][j],dFirstStage[1][i][j],dFirstStage[2][i][j],dFirstStage[3][i][j]);
+        }
+    }
+    
+    for (i=0; i<4; i++){
+        dThirdStage[i]=CatmullInterpolate(t[2],dSecondStage[0][i],dSecondStage[1][i],dSecondStage[2][i],dSecondStage[3][i]);
     }
+    
+    return CatmullInterpolate(t[3],dThirdStage[0],dThirdStage[1],dThirdStage[2],dThirdStage[3]);
+    
 };
 
-//Use limits of molecular subgroups
-double PS::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
-double PS::fnGetUpperLimit() {return serine->fnGetUpperLimit();};
+//Philosophy for this first method: You simply add more and more volume and nSLD to the
+//volume and nSLD array. After all objects have filled up those arrays the maximal area is
+//determined which is the area per molecule and unfilled volume is filled with bulk solvent.
+//Hopefully the fit algorithm finds a physically meaningful solution. There has to be a global
+//hydration paramter for the bilayer.
+//Returns maximum area
+
 
-void PS::fnSetSigma(double sigma)
+mgreal nSLDObj::fnWriteProfile(mgreal aArea[], mgreal anSL[], int dimension, double stepsize, mgreal dMaxArea)
 {
-    cg->sigma1=sigma;
-    cg->sigma2=sigma;
-    phosphate->sigma1=sigma;
-    phosphate->sigma2=sigma;
-    serine->sigma1=sigma;
-    serine->sigma2=sigma;
+    mgreal dLowerLimit, dUpperLimit, dAreaInc;
+    double d, dprefactor;
+	int i, n;
+    
+    if (bCaching) {
+        fnRasterize(dimension, stepsize, false);
+        for (n=0; n<pRaster->iSize; n++) {
+            i=pRaster->aBin[n];
+            aArea[i]=aArea[i]+pRaster->aArea[n];
+            if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+        }
+        return dMaxArea;
+    }
+    
+	dLowerLimit=fnGetLowerLimit();
+	dUpperLimit=fnGetUpperLimit();
+    if (dUpperLimit==0)
+    {
+        dUpperLimit=double(dimension)*stepsize;
+    }
+	d=floor(fnValue(dLowerLimit)/stepsize+0.5)*stepsize;
+	
+    
+	while (d<=dUpperLimit)
+	{
+	    i=int(d/stepsize);
+		dprefactor=1;
+		if ((i<0) && (bWrapping==true)) {i=-1*i;};
+		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
+		if ((i>=0) && (i<dimension))
+		{
+		    dAreaInc=fnGetConvolutedArea(d);
+		    aArea[i]=aArea[i]+dAreaInc*dprefactor;
+			if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
+			anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
+			//printf("Bin %i AreaInc %g total %g MaxArea %g nSL %f total %f \n", i, dAreaInc, aArea[i], dMaxArea, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
+		}
+		d=d+stepsize;  
+	};
+	
+	return dMaxArea;
+    
+};
+mgreal nSLDObj::fnWriteProfile(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    mgreal dLowerLimit, dUpperLimit, dAreaInc;
+    double d, dprefactor;
+	int i, n;
+	
+    if (bCaching) {
+        fnRasterize(dimension, stepsize, true);
+        for (n=0; n<pRaster->iSize; n++) {
+            i=pRaster->aBin[n];
+            aArea[i]=aArea[i]+pRaster->aArea[n];
+            if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+            aAbsorb[i]=aAbsorb[i]+pRaster->aAbsorb[n]*pRaster->aArea[n]*stepsize;
+        }
+        return dMaxArea;
+    }
+    
+	dLowerLimit=fnGetLowerLimit();
+	dUpperLimit=fnGetUpperLimit();
+    if (dUpperLimit==0)
+    {
+        dUpperLimit=double(dimension)*stepsize;
+    }
+	d=floor(fnValue(dLowerLimit)/stepsize+0.5)*stepsize;
+	
+	while (d<=dUpperLimit)
+	{
+	    i=int(d/stepsize);
+		dprefactor=1;
+		//printf("Here we are %i, dimension %i \n", i, dimension);
+		if ((i<0) && (bWrapping==true)) {i=-1*i;};
+		if ((i==0) && (bWrapping==true)) {dprefactor=2;}											//avoid too low filling when mirroring
+		if ((i>=0) && (i<dimension))
+		{
+            //printf("Bin %i Areainc %f area now %f nSLD %g Absorbinc %g Absorb now %g nSLinc %g nSL now %g \n", i, dAreaInc, aArea[i], fnGetnSLD(d), aAbsorb[i], fnGetAbsorb(d)*dAreaInc*stepsize, fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
+		    dAreaInc=fnGetConvolutedArea(d);
+		    aArea[i]=aArea[i]+dAreaInc*dprefactor;
+			if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
+			anSL[i]=anSL[i]+fnGetnSLD(d)*dAreaInc*stepsize*dprefactor;
+            aAbsorb[i]=aAbsorb[i]+fnGetAbsorb(d)*dAreaInc*stepsize*dprefactor;
+			//printf("Bin %i Area %f total %f nSL %f total %f \n", i, dAreaInc, aArea[i], fnGetnSLD(d)*dAreaInc*stepsize, anSL[i]);
+		}
+		d=d+stepsize;  
+	};
+	
+	return dMaxArea;
+    
+};
+//the object is rasterized and composited with the branch-free kernel over the bins it covers. Only if
+//mirroring folds two grid points onto one bin, the contributions are overlaid one after the other
+void nSLDObj::fnOverlayProfile(mgreal aArea[], mgreal anSL[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    mgreal temparea;
+	int i, n;
+	
+    fnRasterize(dimension, stepsize, false);
+    
+    if (pRaster->bMonotonic) {
+        if (pRaster->iSize>0) {
+            fnRaster2Scratch(dimension, stepsize, false);
+            i=pRaster->iFirstBin;
+            fnCompositeProfile(aArea+i, anSL+i, pScratch->aArea+i, pScratch->anSL+i, pRaster->iLastBin-i+1, dMaxArea);
+        }
+        return;
+    }
+    
+    for (n=0; n<pRaster->iSize; n++) {
+        i=pRaster->aBin[n];
+        temparea=pRaster->aArea[n]+aArea[i];
+        if (temparea<=dMaxArea) {
+            aArea[i]=aArea[i]+pRaster->aArea[n];
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+        }
+        else if ((temparea-dMaxArea)<=aArea[i]) {                                                   //overfill is not larger than existing area
+            anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));                                      //eliminate the overfilled portion using original content
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+            aArea[i]=dMaxArea;
+        }
+        else {                                                                                      //overfill is larger!!, this is non-physical
+            anSL[i]=pRaster->anSLD[n]*dMaxArea*stepsize;
+            aArea[i]=dMaxArea;
+        }
+    }
 };
 
-
-void PS::fnSetZ(double dz){
-    z=dz;
-    fnAdjustParameters();
+void nSLDObj::fnOverlayProfile(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    mgreal temparea;
+	int i, n;
+	
+    fnRasterize(dimension, stepsize, true);
+    
+    if (pRaster->bMonotonic) {
+        if (pRaster->iSize>0) {
+            fnRaster2Scratch(dimension, stepsize, false);
+            i=pRaster->iFirstBin;
+            fnCompositeProfile(aArea+i, anSL+i, aAbsorb+i, pScratch->aArea+i, pScratch->anSL+i, pScratch->aAbsorb+i, pRaster->iLastBin-i+1, dMaxArea);
+        }
+        return;
+    }
+    
+    for (n=0; n<pRaster->iSize; n++) {
+        i=pRaster->aBin[n];
+        temparea=pRaster->aArea[n]+aArea[i];
+        if (temparea>dMaxArea) {
+            anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));                                      //eliminate the overfilled portion using original content
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+            aAbsorb[i]=aAbsorb[i]*(1-((temparea-dMaxArea)/aArea[i]));
+            aAbsorb[i]=aAbsorb[i]+pRaster->aAbsorb[n]*pRaster->aArea[n]*stepsize;
+            aArea[i]=dMaxArea;
+        }
+        else {
+            aArea[i]=aArea[i]+pRaster->aArea[n];
+            anSL[i]=anSL[i]+pRaster->anSLD[n]*pRaster->aArea[n]*stepsize;
+            aAbsorb[i]=aAbsorb[i]+pRaster->aAbsorb[n]*pRaster->aArea[n]*stepsize;
+        }
+    }
 };
 
-void PS::fnSetnSL(double nSL_cg, double nSL_phosphate, double nSL_serine){
-    //printf("nSL cg %e nSL phosphate %e nSL serine %e \n", nSL_cg, nSL_phosphate, nSL_serine);
-    cg->nSL=nSL_cg;
-    phosphate->nSL=nSL_phosphate;
-    serine->nSL=nSL_serine;
+//contrast-separated canvas: anSL receives the scattering length at zero bulk nSLD and anSLBulk its change
+//per unit bulk nSLD, so that fnWriteContrastCanvas2Model emits any number of contrasts from one
+//rasterization. Area and overlay rules are the same as for fnWriteProfile and fnOverlayProfile
+mgreal nSLDObj::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    int i, n;
+    
+    fnRasterize(dimension, stepsize, false, true);
+    for (n=0; n<pRaster->iSize; n++) {
+        i=pRaster->aBin[n];
+        aArea[i]=aArea[i]+pRaster->aArea[n];
+        if (aArea[i]>dMaxArea) {dMaxArea=aArea[i];};
+        anSL[i]=anSL[i]+(pRaster->anSLD[n]-pRaster->dBulk*pRaster->anSLDBulk[n])*pRaster->aArea[n]*stepsize;
+        anSLBulk[i]=anSLBulk[i]+pRaster->anSLDBulk[n]*pRaster->aArea[n]*stepsize;
+    }
+    return dMaxArea;
 }
 
-
-void PS::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void nSLDObj::fnOverlayContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
 {
-    //char *str = new char[80];
+    mgreal temparea, dnSLD, dfraction;
+    int i, n;
     
-    //fprintf(fp, "PC %s z %lf l %lf nf %lf \n",cName, z, l, nf);
-    //nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
-    cg->fnWriteGroup2File(fp, "cg", dimension, stepsize);
-    phosphate->fnWriteGroup2File(fp, "phosphate", dimension, stepsize);
-    serine->fnWriteGroup2File(fp, "serine", dimension, stepsize);
+    fnRasterize(dimension, stepsize, false, true);
     
-    //delete []str;
+    if (pRaster->bMonotonic) {
+        if (pRaster->iSize>0) {
+            fnRaster2Scratch(dimension, stepsize, true);
+            i=pRaster->iFirstBin;
+            fnCompositeContrastProfile(aArea+i, anSL+i, anSLBulk+i, pScratch->aArea+i, pScratch->anSL+i, pScratch->anSLBulk+i, pRaster->iLastBin-i+1, dMaxArea);
+        }
+        return;
+    }
     
-}
-
-//-----------------------------------------------------------------------------------------------------------
-//Amino Acids
-//-----------------------------------------------------------------------------------------------------------
-//-----------------------------------------------------------------------------------------------------------
-//general implementation
-//-----------------------------------------------------------------------------------------------------------
-//ExchangeRatio is not yet fully implemented
+    for (n=0; n<pRaster->iSize; n++) {
+        i=pRaster->aBin[n];
+        dnSLD=pRaster->anSLD[n]-pRaster->dBulk*pRaster->anSLDBulk[n];
+        temparea=pRaster->aArea[n]+aArea[i];
+        if (temparea<=dMaxArea) {
+            aArea[i]=aArea[i]+pRaster->aArea[n];
+            anSL[i]=anSL[i]+dnSLD*pRaster->aArea[n]*stepsize;
+            anSLBulk[i]=anSLBulk[i]+pRaster->anSLDBulk[n]*pRaster->aArea[n]*stepsize;
+        }
+        else if ((temparea-dMaxArea)<=aArea[i]) {
+            dfraction=1-((temparea-dMaxArea)/aArea[i]);
+            anSL[i]=anSL[i]*dfraction+dnSLD*pRaster->aArea[n]*stepsize;
+            anSLBulk[i]=anSLBulk[i]*dfraction+pRaster->anSLDBulk[n]*pRaster->aArea[n]*stepsize;
+            aArea[i]=dMaxArea;
+        }
+        else {
+            anSL[i]=dnSLD*dMaxArea*stepsize;
+            anSLBulk[i]=pRaster->anSLDBulk[n]*dMaxArea*stepsize;
+            aArea[i]=dMaxArea;
+        }
+    }
+}
 
-AminoAcid::AminoAcid()
+//canvas interface, dispatches to the array functions matching the channels of the canvas
+mgreal nSLDObj::fnWriteCanvas(Canvas &canvas)
 {
-	ExchangeRatio=0;
-	Deuterated=0;
+    if (canvas.bBulk) {
+        canvas.dMaxArea=fnWriteContrastProfile(canvas.aArea, canvas.anSL, canvas.anSLBulk, canvas.dimension, canvas.stepsize, canvas.dMaxArea);
+    }
+    else if (canvas.bAbsorb) {
+        canvas.dMaxArea=fnWriteProfile(canvas.aArea, canvas.anSL, canvas.aAbsorb, canvas.dimension, canvas.stepsize, canvas.dMaxArea);
+    }
+    else {
+        canvas.dMaxArea=fnWriteProfile(canvas.aArea, canvas.anSL, canvas.dimension, canvas.stepsize, canvas.dMaxArea);
+    }
+    return canvas.dMaxArea;
 }
 
-double AminoAcid::fnGetnSLD(double z) 
+void nSLDObj::fnOverlayCanvas(Canvas &canvas, mgreal dMaxArea)
 {
-	double temp;
-    
-	if (Deuterated==1) {temp=1;}
-	else {temp=0.;}
-    //correct for deuterated residues
-	return (nSL-temp*float(nH)*(-3.741e-5)+temp*float(nH)*(6.674e-5))/vol;
+    if (canvas.bBulk) {
+        fnOverlayContrastProfile(canvas.aArea, canvas.anSL, canvas.anSLBulk, canvas.dimension, canvas.stepsize, dMaxArea);
+    }
+    else if (canvas.bAbsorb) {
+        fnOverlayProfile(canvas.aArea, canvas.anSL, canvas.aAbsorb, canvas.dimension, canvas.stepsize, dMaxArea);
+    }
+    else {
+        fnOverlayProfile(canvas.aArea, canvas.anSL, canvas.dimension, canvas.stepsize, dMaxArea);
+    }
 }
-//-----------------------------------------------------------------------------------------------------------
-//-----------------------------------------------------------------------------------------------------------
-//Specific implementations
-//-----------------------------------------------------------------------------------------------------------
-//-----------------------------------------------------------------------------------------------------------
 
-AA_Lys::AA_Lys()
+//------------------------------------------------------------------------------------------------------
+//Function Object Implementation
+//------------------------------------------------------------------------------------------------------
+
+BoxErr::BoxErr(mgreal dz, mgreal dsigma, mgreal dlength, mgreal dvolume, mgreal dnSL, mgreal dnumberfraction=1)
 {
-	nSL=1.5660e-4;
-	vol=171.3;
-	nH=13;
-	nExch=4;
-}
-AA_Arg::AA_Arg()
+    z=dz; sigma=dsigma; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
+};
+
+BoxErr::~BoxErr(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal BoxErr::fnGetArea(mgreal dz) {
+    
+    return (vol/l)*mgconst(0.5)*(erf((dz-z+mgconst(0.5)*l)/sqrt(mgconst(2))/sigma)-erf((dz-z-mgconst(0.5)*l)/sqrt(mgconst(2))/sigma))*nf;
+};
+
+//constant nSLD
+mgreal BoxErr::fnGetnSLD(mgreal dz) {return nSL/vol;};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal BoxErr::fnGetLowerLimit() {return z-0.5*l-3*sigma;};
+mgreal BoxErr::fnGetUpperLimit() {return z+0.5*l+3*sigma;};
+
+void   BoxErr::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-	nSL=3.4260e-4;
-	vol=202.1;
-	nH=13;
-	nExch=6;
+    fprintf(fp, "BoxErr %s z %lf sigma %lf l %lf vol %lf nSL %e nf %lf \n",cName, fnValue(z), fnValue(sigma), fnValue(l), fnValue(vol), fnValue(nSL), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
 }
-AA_His::AA_His()
+
+
+//------------------------------------------------------------------------------------------------------
+
+Box2Err::Box2Err(mgreal dz, mgreal dsigma1, mgreal dsigma2, mgreal dlength, mgreal dvolume, mgreal dnSL, mgreal dnumberfraction=1)
 {
-	nSL=4.7406e-4;
-	vol=167.3;
-	nH=7;
-	nExch=3;
+    z=dz; sigma1=dsigma1; sigma2=dsigma2; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
+    nsldbulk_store=0;
+};
+
+Box2Err::~Box2Err(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal Box2Err::fnGetArea(mgreal dz) {
+    
+    if ((l!=0) && (sigma1!=0) && (sigma2!=0)) {
+        return (vol/l)*mgconst(0.5)*(erf((dz-z+mgconst(0.5)*l)/sqrt(mgconst(2))/sigma1)-erf((dz-z-mgconst(0.5)*l)/sqrt(mgconst(2))/sigma2))*nf;        
+    }
+    else {
+        return 0;
+    }
+};
+
+mgreal Box2Err::fnGetnSL(mgreal bulknsld) {
+    if (bProtonExchange) {
+        if (vol!=0) {
+            return ((bulknsld+0.56e-6)*nSL2+(6.36e-6-bulknsld)*nSL)/(6.36e-6+0.56e-6);
+        }
+        else {
+            return 0;
+        }
+    }
+    else {
+        return nSL;
+    }
+};
+
+
+//constant nSLD
+mgreal Box2Err::fnGetnSLD(mgreal dz) {
+    if (vol!=0) {
+        if (bProtonExchange) {
+            return ((nsldbulk_store+0.56e-6)*nSL2+(6.36e-6-nsldbulk_store)*nSL)/(6.36e-6+0.56e-6)/vol;
+        }
+        else {
+            return nSL/vol;
+        }
+    }
+    else {
+        return 0;
+    }
 }
-AA_Asn::AA_Asn()
+
+mgreal Box2Err::fnGetnSLD(mgreal dz, mgreal bulknsld) {
+    if (bProtonExchange) {
+        if (vol!=0) {
+            nsldbulk_store=bulknsld;                     //store bulk solvent for later plotting purposes
+            return ((bulknsld+0.56e-6)*nSL2+(6.36e-6-bulknsld)*nSL)/(6.36e-6+0.56e-6)/vol;
+        }
+        else {
+            return 0;
+        }
+    }
+    else {
+        return fnGetnSLD(dz);
+    }
+};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal Box2Err::fnGetLowerLimit() {return z-0.5*l-3*sigma1;};
+mgreal Box2Err::fnGetUpperLimit() {return z+0.5*l+3*sigma2;};
+
+void Box2Err::fnSetnSL(mgreal _nSL, mgreal _nSL2)
 {
-	nSL=3.4356e-4;
-	vol=135.2;
-	nH=6;
-	nExch=3;
+	fnUpdate(nSL,_nSL);
+	fnUpdate(nSL2,_nSL2);
+    bProtonExchange=true;
 }
-AA_Asp::AA_Asp()
+
+void Box2Err::fnSetSigma(mgreal sigma)
 {
-	nSL=3.8343e-4;
-	vol=124.5;
-	nH=4;
-	nExch=1;
+	fnUpdate(sigma1,sigma);
+	fnUpdate(sigma2,sigma);
 }
-AA_Cys::AA_Cys()
+void Box2Err::fnSetSigma(mgreal dsigma1, mgreal dsigma2)
 {
-	nSL=1.9191e-4;
-	vol=105.6;
-	nH=5;
-	nExch=1;
+	fnUpdate(sigma1,dsigma1);
+	fnUpdate(sigma2,dsigma2);
 }
-AA_Thr::AA_Thr()
+
+void Box2Err::fnSetZ(mgreal dz)
 {
-	nSL=2.1315e-4;
-	vol=122.1;
-	nH=7;
-	nExch=2;
-}
-AA_Ser::AA_Ser()
+	fnUpdate(z,dz);
+};
+
+void   Box2Err::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-	nSL=2.2149e-4;
-	vol=99.1;
-	nH=5;
-	nExch=2;
+    fprintf(fp, "Box2Err %s z %lf sigma1 %lf sigma2 %lf l %lf vol %lf nSL %lf nSL2 %e nf %lf \n",cName, fnValue(z), fnValue(sigma1), fnValue(sigma2), fnValue(l), fnValue(vol), fnValue(nSL), fnValue(nSL2), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
 }
-AA_Gln::AA_Gln()
+
+//------------------------------------------------------------------------------------------------------
+
+BoxErrLinearSLD::BoxErrLinearSLD(mgreal dz, mgreal dsigma1, mgreal dsigma2, mgreal dlength, mgreal dvolume, mgreal dnSLD1, mgreal dnSLD2, mgreal dnumberfraction=1)
 {
-	nSL=3.3522e-4;
-	vol=161.1;
-	nH=8;
-	nExch=3;
-}
-AA_Glu::AA_Glu()
+    z=dz; sigma1=dsigma1; sigma2=dsigma2; l=dlength, vol=dvolume, nSLD1=dnSLD1, nSLD2=dnSLD2, nf=dnumberfraction;
+};
+
+BoxErrLinearSLD::~BoxErrLinearSLD(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal BoxErrLinearSLD::fnGetArea(mgreal dz) {
+    
+    if ((l!=0) && (sigma1!=0) && (sigma2!=0)) {
+        return (vol/l)*mgconst(0.5)*(erf((dz-z+mgconst(0.5)*l)/sqrt(mgconst(2))/sigma1)-erf((dz-z-mgconst(0.5)*l)/sqrt(mgconst(2))/sigma2))*nf;        
+    }
+    else {
+        return 0;
+    }
+};
+
+//linear nSLD
+mgreal BoxErrLinearSLD::fnGetnSLD(mgreal dz) {
+    if (vol!=0) { 
+
+        if (dz < (z - 0.5*l)) {
+//	printf("Returning 0 because dz is %f and z ranges from %f to %f\n", dz, z-0.5*l, z+0.5*l);
+            return nSLD1;
+        }
+        else if (dz > (z + 0.5*l)) {
+            return nSLD2;
+        }
+        else {
+            return (nSLD1 + (nSLD2-nSLD1)*(dz-(z-0.5*l))/l);
+        //printf("%f\n", (nSLD1 + (nSLD2-nSLD1)*(dz-(z-0.5*l))/l));
+        }
+    }
+    else {
+        return 0;
+    }
+};
+
+mgreal BoxErrLinearSLD::fnGetnSL(mgreal dz) {
+
+    return fnGetnSLD(dz)*vol;
+    
+};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal BoxErrLinearSLD::fnGetLowerLimit() {return z-0.5*l-3*sigma1;};
+mgreal BoxErrLinearSLD::fnGetUpperLimit() {return z+0.5*l+3*sigma2;};
+
+void BoxErrLinearSLD::fnSetSigma(mgreal sigma)
 {
-	nSL=3.7509e-4;
-	vol=155.1;
-	nH=6;
-	nExch=1;
+	fnUpdate(sigma1,sigma);
+	fnUpdate(sigma2,sigma);
 }
-AA_Pro::AA_Pro()
+void BoxErrLinearSLD::fnSetSigma(mgreal dsigma1, mgreal dsigma2)
 {
-	nSL=2.2158e-4;
-	vol=129.3;
-	nH=7;
-	nExch=0;
+	fnUpdate(sigma1,dsigma1);
+	fnUpdate(sigma2,dsigma2);
 }
-AA_Gly::AA_Gly()
+
+void BoxErrLinearSLD::fnSetnSLD(mgreal nSLD)
 {
-	nSL=1.7178e-4;
-	vol=66.4;
-	nH=3;
-	nExch=1;
+	fnUpdate(nSLD1,nSLD);
+	fnUpdate(nSLD2,nSLD);
 }
-AA_Ala::AA_Ala()
+void BoxErrLinearSLD::fnSetnSLD(mgreal dnSLD1, mgreal dnSLD2)
 {
-	nSL=1.6344e-4;
-	vol=91.5;
-	nH=5;
-	nExch=1;
+	fnUpdate(nSLD1,dnSLD1);
+	fnUpdate(nSLD2,dnSLD2);
 }
-AA_Val::AA_Val()
+
+void BoxErrLinearSLD::fnSetZ(mgreal dz)
 {
-	nSL=1.4676e-4;
-	vol=141.7;
-	nH=9;
-	nExch=1;
-}
-AA_Ile::AA_Ile()
+	fnUpdate(z,dz);
+};
+
+void   BoxErrLinearSLD::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-	nSL=1.3842e-4;
-	vol=168.8;
-	nH=11;
-	nExch=1;
+    fprintf(fp, "BoxErrLinearSLD %s z %lf sigma1 %lf sigma2 %lf l %lf vol %lf nSLD1 %1f nSLD2 %e nf %lf \n",cName, fnValue(z), fnValue(sigma1), fnValue(sigma2), fnValue(l), fnValue(vol), fnValue(nSLD1), fnValue(nSLD2), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
 }
-AA_Leu::AA_Leu()
+
+//------------------------------------------------------------------------------------------------------
+
+Gaussian::Gaussian(mgreal dz, mgreal dsigma, mgreal dvolume, mgreal dnSL, mgreal dnumberfraction=1)
 {
-	nSL=1.3842e-4;
-	vol=167.9;
-	nH=11;
+    z=dz; sigma=dsigma; vol=dvolume, nSL=dnSL, nf=dnumberfraction;
+};
+
+Gaussian::~Gaussian(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal Gaussian::fnGetArea(mgreal dz) {return (vol/sqrt(mgconst(2*3.141592654))/sigma)*exp(mgconst(-0.5)*(z-dz)*(z-dz)/sigma/sigma)*nf;};
+
+//constant nSLD
+mgreal Gaussian::fnGetnSLD(mgreal dz) {return nSL/vol;};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal Gaussian::fnGetLowerLimit() {return z-3*sigma;};
+mgreal Gaussian::fnGetUpperLimit() {return z+3*sigma;};
+
+void   Gaussian::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    fprintf(fp, "Gaussian %s z %lf sigma %lf vol %lf nSL %e nf %lf \n",cName, fnValue(z), fnValue(sigma), fnValue(vol), fnValue(nSL), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+Parabolic::Parabolic(mgreal dC, mgreal dH, mgreal dn, mgreal dnSLD, mgreal dnumberfraction=1)
+{
+    C=dC; H=dH, n=dn, nSLD=dnSLD, nf=dnumberfraction;
+    bWrapping=false;
+};
+
+Parabolic::~Parabolic(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal Parabolic::fnGetArea(mgreal dz) {
+    if (dz<H) {return C*(1-pow(dz/H,n))*nf;}
+    else {return 0;}
+};
+
+//constant nSLD
+mgreal Parabolic::fnGetnSLD(mgreal dz) {return nSLD;};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal Parabolic::fnGetLowerLimit() {return 0;};
+mgreal Parabolic::fnGetUpperLimit() {return 0;};
+
+void   Parabolic::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    fprintf(fp, "Parabolic %s C %lf H %lf n %lf  nSLD %e nf %lf \n",cName, fnValue(C), fnValue(H), fnValue(n), fnValue(nSLD), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+}
+//------------------------------------------------------------------------------------------------------
+
+StretchGaussian::StretchGaussian(mgreal dz, mgreal dsigma, mgreal dlength, mgreal dvolume, mgreal dnSL, mgreal dnumberfraction=1)
+{
+    z=dz; sigma=dsigma; l=dlength, vol=dvolume, nSL=dnSL, nf=dnumberfraction;
+};
+
+StretchGaussian::~StretchGaussian(){};
+
+//Gaussian function definition, integral is volume, return value is area at position z
+mgreal StretchGaussian::fnGetArea(mgreal dz) {
+    
+    mgreal returnvalue;
+    mgreal temp, dvgauss;
+    
+    temp=sqrt(2*3.141592654)*sigma;
+    dvgauss=vol/(1+l/temp);
+    
+    if (dz<(z-0.5*l))
+    {
+        returnvalue=dvgauss/temp*exp(-0.5*(z-dz-0.5*l)*(z-dz-0.5*l)/sigma*sigma)*nf;
+    }
+    else if ((dz>=(z-0.5*l)) && (dz<=(z+0.5*l)))
+    {
+        returnvalue=dvgauss/temp*nf;
+    }
+    else
+    {
+        returnvalue=dvgauss/temp*exp(-0.5*(dz-z-0.5*l)*(dz-z-0.5*l)/sigma*sigma)*nf;
+    }
+    
+    return returnvalue;
+};
+
+//constant nSLD
+mgreal StretchGaussian::fnGetnSLD(mgreal dz) {return nSL/vol;};
+
+//Gaussians are cut off below and above 3 sigma
+mgreal StretchGaussian::fnGetLowerLimit() {return z-0.5*l-3*sigma;};
+mgreal StretchGaussian::fnGetUpperLimit() {return z+0.5*l+3*sigma;};
+
+void   StretchGaussian::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    fprintf(fp, "Gaussian %s z %lf sigma %lf l %lf vol %lf nSL %e nf %lf \n",cName, fnValue(z), fnValue(sigma), fnValue(l), fnValue(vol), fnValue(nSL), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Combined Object Implementation
+//------------------------------------------------------------------------------------------------------
+
+//composite objects own their subgroups, copying a composite copies the subgroups into its own instances
+//so that copies can be evaluated concurrently. A NULL source releases the subgroup
+template <class T> void fnCopyGroup(T *&pGroup, const T *pSource)
+{
+    if (pSource==NULL) {delete pGroup; pGroup=NULL;}
+    else if (pGroup==NULL) {pGroup=new T(*pSource);}
+    else {*pGroup=*pSource;}
+}
+
+PC::PC()
+{
+    
+    cg = new Box2Err(0,0,0,0,0,0,1);
+    phosphate = new Box2Err(0,0,0,0,0,0,1);
+    choline = new Box2Err(0,0,0,0,0,0,1);
+    
+    cg->l=4.21; phosphate->l=3.86; choline->l=6.34;                             //from fit to Feller data
+    cg->sigma1=2.53; cg->sigma2=2.29;
+    phosphate->sigma1=2.29; phosphate->sigma2=2.02;
+    choline->sigma1=2.02; choline->sigma2=2.26;
+    //from fit to Feller data
+    l=9.575;                                                                    //group cg    phosphate choline
+    //z     15.00 18.44     19.30
+    //l      4.21  3.86      6.34
+    
+    cg->vol=147; phosphate->vol=54; choline->vol=120;                           //nominal values
+    cg->nSL=3.7755e-4; phosphate->nSL=2.8350e-4; choline->nSL=-6.0930e-5;
+    cg->nf=1; phosphate->nf=1; choline->nf=1;
+    
+    vol=cg->vol+phosphate->vol+choline->vol;
+    nSL=cg->nSL+phosphate->nSL+choline->nSL;
+    
+    fnAdjustParameters();
+    
+};
+
+PC::~PC(){
+    delete cg;
+    delete phosphate;
+    delete choline;
+};
+
+PC::PC(const PC &o) : nSLDObj(o)
+{
+    cg=NULL; phosphate=NULL; choline=NULL;
+    *this=o;
+};
+
+PC& PC::operator=(const PC &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(cg,o.cg); fnCopyGroup(phosphate,o.phosphate); fnCopyGroup(choline,o.choline);
+        z=o.z;
+    }
+    return *this;
+};
+
+void PC::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
+    cg->z=z-0.5*l+0.5*cg->l;
+    choline->z=z+0.5*l-0.5*choline->l;
+    phosphate->z=(cg->z+0.5*cg->l+choline->z-choline->l*0.5)/2;
+
+};
+
+//Return value is area at position z
+mgreal PC::fnGetArea(mgreal dz) {
+    return (cg->fnGetArea(dz)+phosphate->fnGetArea(dz)+choline->fnGetArea(dz))*nf;
+};
+
+mgreal PC::fnGetTotalnSL(){
+    return cg->nSL+phosphate->nSL+choline->nSL;
+};
+
+//get nSLD from molecular subgroups
+mgreal PC::fnGetnSLD(mgreal dz) {
+    mgreal cgarea, pharea, charea, sum;
+    
+    cgarea=cg->fnGetArea(dz);
+    pharea=phosphate->fnGetArea(dz);
+    charea=choline->fnGetArea(dz);
+    sum=cgarea+pharea+charea;
+    
+    if (sum==0) {return 0;}
+    else {
+        return (cg->fnGetnSLD(dz)*cgarea+
+                phosphate->fnGetnSLD(dz)*pharea+
+                choline->fnGetnSLD(dz)*charea)/sum;
+    }
+};
+
+//Use limits of molecular subgroups
+mgreal PC::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
+mgreal PC::fnGetUpperLimit() {return choline->fnGetUpperLimit();};
+
+void PC::fnSetSigma(mgreal sigma)
+{
+    bDirty=true; iStateHash=0;
+    cg->sigma1=sigma;
+    cg->sigma2=sigma;
+    phosphate->sigma1=sigma;
+    phosphate->sigma2=sigma;
+    choline->sigma1=sigma;
+    choline->sigma2=sigma;
+};
+
+
+void PC::fnSetZ(mgreal dz){
+    fnUpdate(z,dz);
+    if ((bDirty==true) || (bCaching==false)) {fnAdjustParameters();}
+};
+
+void PC::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    //char *str = new char[80];
+    
+    fprintf(fp, "PC %s z %lf l %lf vol %lf nf %lf \n",cName, fnValue(z), fnValue(l),fnValue(cg->vol+phosphate->vol+choline->vol), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    //cg->fnWriteGroup2File(fp, "cg", dimension, stepsize);
+    //phosphate->fnWriteGroup2File(fp, "phosphate", dimension, stepsize);
+    //choline->fnWriteGroup2File(fp, "choline", dimension, stepsize);
+    
+    //delete []str;
+    
+}
+//------------------------------------------------------------------------------------------------------
+PCm::PCm() 
+{
+    cg->sigma2=2.53; cg->sigma1=2.29;										//from fit to Feller data
+    phosphate->sigma2=2.29; phosphate->sigma1=2.02;
+    choline->sigma2=2.02; choline->sigma1=2.26;
+    
+    fnAdjustParameters();
+    
+};
+
+PCm::~PCm() {};
+
+void PCm::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
+    cg->z=z+0.5*l-0.5*cg->l;
+    choline->z=z-0.5*l+0.5*choline->l;
+    phosphate->z=(cg->z-0.5*cg->l+choline->z+choline->l*0.5)/2;
+};
+
+//Use limits of molecular subgroups
+mgreal PCm::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
+mgreal PCm::fnGetUpperLimit() {return choline->fnGetUpperLimit();};
+
+void   PCm::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    //char *str = new char[80];
+    
+    fprintf(fp, "PCm %s z %lf l %lf vol %lf nf %lf \n",cName, fnValue(z), fnValue(l),fnValue(cg->vol+phosphate->vol+choline->vol), fnValue(nf));
+    nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    //cg->fnWriteGroup2File(fp, "cg_m", dimension, stepsize);
+    //phosphate->fnWriteGroup2File(fp, "phosphate_m", dimension, stepsize);
+    //choline->fnWriteGroup2File(fp, "choline_m", dimension, stepsize);
+    
+    //delete []str;
+    
+}
+//---------------------------------------------------------------------------------------------------------------
+PS::PS()
+{
+    
+    cg = new Box2Err(0,0,0,0,0,0,1);
+    phosphate = new Box2Err(0,0,0,0,0,0,1);
+    serine = new Box2Err(0,0,0,0,0,0,1);
+    
+    cg->l=3.6; phosphate->l=2.0; serine->l=3.0;                             //from fit to Feller data
+    cg->sigma1=2.53; cg->sigma2=2.29;
+    phosphate->sigma1=2.29; phosphate->sigma2=2.02;
+    serine->sigma1=2.02; serine->sigma2=2.26;
+    //from fit to Feller data
+    l=8.6;                                                                    //group cg    phosphate choline
+    //z     15.00 18.44     19.30
+    //l      4.21  3.86      6.34
+    
+    cg->vol=147; phosphate->vol=54; serine->vol=80;                           //nominal values
+    cg->nSL=3.7755e-4; phosphate->nSL=2.8350e-4; serine->nSL=1.8408E-04;
+    cg->nf=1; phosphate->nf=1; serine->nf=1;
+    
+    fnAdjustParameters();
+    
+};
+
+PS::~PS(){
+    delete cg;
+    delete phosphate;
+    delete serine;
+};
+
+PS::PS(const PS &o) : nSLDObj(o)
+{
+    cg=NULL; phosphate=NULL; serine=NULL;
+    *this=o;
+};
+
+PS& PS::operator=(const PS &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(cg,o.cg); fnCopyGroup(phosphate,o.phosphate); fnCopyGroup(serine,o.serine);
+        z=o.z;
+    }
+    return *this;
+};
+
+void PS::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
+    cg->z=z-0.5*l+0.5*cg->l; phosphate->z=z-0.5*l+cg->l+0.5*phosphate->l;
+    serine->z=z+0.5*l-0.5*serine->l;                                           
+};
+
+//Return value is area at position z
+mgreal PS::fnGetArea(mgreal dz) {
+    return (cg->fnGetArea(dz)+phosphate->fnGetArea(dz)+serine->fnGetArea(dz))*nf;
+};
+
+//get nSLD from molecular subgroups
+mgreal PS::fnGetnSLD(mgreal dz) {
+    mgreal cgarea, pharea, searea, sum;
+    
+    cgarea=cg->fnGetArea(dz);
+    pharea=phosphate->fnGetArea(dz);
+    searea=serine->fnGetArea(dz);
+    sum=cgarea+pharea+searea;
+    
+    if (sum==0) {return 0;}
+    else {
+        return (cg->fnGetnSLD(dz)*cgarea+
+                phosphate->fnGetnSLD(dz)*pharea+
+                serine->fnGetnSLD(dz)*searea)/sum;
+    }
+};
+
+//Use limits of molecular subgroups
+mgreal PS::fnGetLowerLimit() {return cg->fnGetLowerLimit();};
+mgreal PS::fnGetUpperLimit() {return serine->fnGetUpperLimit();};
+
+void PS::fnSetSigma(mgreal sigma)
+{
+    bDirty=true; iStateHash=0;
+    cg->sigma1=sigma;
+    cg->sigma2=sigma;
+    phosphate->sigma1=sigma;
+    phosphate->sigma2=sigma;
+    serine->sigma1=sigma;
+    serine->sigma2=sigma;
+};
+
+
+void PS::fnSetZ(mgreal dz){
+    fnUpdate(z,dz);
+    if ((bDirty==true) || (bCaching==false)) {fnAdjustParameters();}
+};
+
+void PS::fnSetnSL(mgreal nSL_cg, mgreal nSL_phosphate, mgreal nSL_serine){
+    bDirty=true; iStateHash=0;
+    //printf("nSL cg %e nSL phosphate %e nSL serine %e \n", nSL_cg, nSL_phosphate, nSL_serine);
+    cg->nSL=nSL_cg;
+    phosphate->nSL=nSL_phosphate;
+    serine->nSL=nSL_serine;
+}
+
+
+void PS::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
+{
+    //char *str = new char[80];
+    
+    //fprintf(fp, "PC %s z %lf l %lf nf %lf \n",cName, z, l, nf);
+    //nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
+    cg->fnWriteGroup2File(fp, "cg", dimension, stepsize);
+    phosphate->fnWriteGroup2File(fp, "phosphate", dimension, stepsize);
+    serine->fnWriteGroup2File(fp, "serine", dimension, stepsize);
+    
+    //delete []str;
+    
+}
+
+//-----------------------------------------------------------------------------------------------------------
+//Amino Acids
+//-----------------------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------------------
+//general implementation
+//-----------------------------------------------------------------------------------------------------------
+//ExchangeRatio is not yet fully implemented
+
+AminoAcid::AminoAcid()
+{
+	ExchangeRatio=0;
+	Deuterated=0;
+}
+
+mgreal AminoAcid::fnGetnSLD(mgreal z) 
+{
+	mgreal temp;
+    
+	if (Deuterated==1) {temp=1;}
+	else {temp=0.;}
+    //correct for deuterated residues
+	return (nSL-temp*float(nH)*(-3.741e-5)+temp*float(nH)*(6.674e-5))/vol;
+}
+//-----------------------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------------------
+//Specific implementations
+//-----------------------------------------------------------------------------------------------------------
+//-----------------------------------------------------------------------------------------------------------
+
+AA_Lys::AA_Lys()
+{
+	nSL=1.5660e-4;
+	vol=171.3;
+	nH=13;
+	nExch=4;
+}
+AA_Arg::AA_Arg()
+{
+	nSL=3.4260e-4;
+	vol=202.1;
+	nH=13;
+	nExch=6;
+}
+AA_His::AA_His()
+{
+	nSL=4.7406e-4;
+	vol=167.3;
+	nH=7;
+	nExch=3;
+}
+AA_Asn::AA_Asn()
+{
+	nSL=3.4356e-4;
+	vol=135.2;
+	nH=6;
+	nExch=3;
+}
+AA_Asp::AA_Asp()
+{
+	nSL=3.8343e-4;
+	vol=124.5;
+	nH=4;
+	nExch=1;
+}
+AA_Cys::AA_Cys()
+{
+	nSL=1.9191e-4;
+	vol=105.6;
+	nH=5;
+	nExch=1;
+}
+AA_Thr::AA_Thr()
+{
+	nSL=2.1315e-4;
+	vol=122.1;
+	nH=7;
+	nExch=2;
+}
+AA_Ser::AA_Ser()
+{
+	nSL=2.2149e-4;
+	vol=99.1;
+	nH=5;
+	nExch=2;
+}
+AA_Gln::AA_Gln()
+{
+	nSL=3.3522e-4;
+	vol=161.1;
+	nH=8;
+	nExch=3;
+}
+AA_Glu::AA_Glu()
+{
+	nSL=3.7509e-4;
+	vol=155.1;
+	nH=6;
+	nExch=1;
+}
+AA_Pro::AA_Pro()
+{
+	nSL=2.2158e-4;
+	vol=129.3;
+	nH=7;
+	nExch=0;
+}
+AA_Gly::AA_Gly()
+{
+	nSL=1.7178e-4;
+	vol=66.4;
+	nH=3;
+	nExch=1;
+}
+AA_Ala::AA_Ala()
+{
+	nSL=1.6344e-4;
+	vol=91.5;
+	nH=5;
+	nExch=1;
+}
+AA_Val::AA_Val()
+{
+	nSL=1.4676e-4;
+	vol=141.7;
+	nH=9;
+	nExch=1;
+}
+AA_Ile::AA_Ile()
+{
+	nSL=1.3842e-4;
+	vol=168.8;
+	nH=11;
+	nExch=1;
+}
+AA_Leu::AA_Leu()
+{
+	nSL=1.3842e-4;
+	vol=167.9;
+	nH=11;
 	nExch=1;
 }
 AA_Met::AA_Met()
@@ -1147,30 +2712,55 @@ BLM_quaternary::~BLM_quaternary(){
     
 };
 
+BLM_quaternary::BLM_quaternary(const BLM_quaternary &o) : nSLDObj(o)
+{
+    headgroup1=NULL; lipid1=NULL; methyl1=NULL; methyl2=NULL; lipid2=NULL; headgroup2=NULL;
+    headgroup1_2=NULL; headgroup2_2=NULL; headgroup1_3=NULL; headgroup2_3=NULL; defect_hydrocarbon=NULL; defect_headgroup=NULL;
+    *this=o;
+};
+
+BLM_quaternary& BLM_quaternary::operator=(const BLM_quaternary &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(headgroup1,o.headgroup1); fnCopyGroup(lipid1,o.lipid1); fnCopyGroup(methyl1,o.methyl1);
+        fnCopyGroup(methyl2,o.methyl2); fnCopyGroup(lipid2,o.lipid2); fnCopyGroup(headgroup2,o.headgroup2);
+        fnCopyGroup(headgroup1_2,o.headgroup1_2); fnCopyGroup(headgroup2_2,o.headgroup2_2); fnCopyGroup(headgroup1_3,o.headgroup1_3);
+        fnCopyGroup(headgroup2_3,o.headgroup2_3); fnCopyGroup(defect_hydrocarbon,o.defect_hydrocarbon); fnCopyGroup(defect_headgroup,o.defect_headgroup);
+        normarea=o.normarea; sigma=o.sigma; l_lipid1=o.l_lipid1; l_lipid2=o.l_lipid2; vf_bilayer=o.vf_bilayer; startz=o.startz;
+        hc_substitution_1=o.hc_substitution_1; hc_substitution_2=o.hc_substitution_2; radius_defect=o.radius_defect; bulknsld=o.bulknsld; nf_lipid_2=o.nf_lipid_2; nf_lipid_3=o.nf_lipid_3;
+        nf_chol=o.nf_chol; volacyllipid=o.volacyllipid; nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid; volacyllipid_2=o.volacyllipid_2;
+        nslacyllipid_2=o.nslacyllipid_2; volmethyllipid_2=o.volmethyllipid_2; nslmethyllipid_2=o.nslmethyllipid_2; volacyllipid_3=o.volacyllipid_3; nslacyllipid_3=o.nslacyllipid_3; volmethyllipid_3=o.volmethyllipid_3;
+        nslmethyllipid_3=o.nslmethyllipid_3; volchol=o.volchol; nslchol=o.nslchol;
+    }
+    return *this;
+};
+
 void BLM_quaternary::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nSL_im;
-    double c_s_im, c_A_im, c_V_im;
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;
     
-    double defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     //printf("Enter AdjustParameters \n");
     
@@ -1339,7 +2929,7 @@ void BLM_quaternary::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double BLM_quaternary::fnGetArea(double dz) {
+mgreal BLM_quaternary::fnGetArea(mgreal dz) {
     return (lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
             +headgroup2->fnGetArea(dz)+headgroup1_2->fnGetArea(dz)+headgroup2_2->fnGetArea(dz)
@@ -1347,11 +2937,11 @@ double BLM_quaternary::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double BLM_quaternary::fnGetnSLD(double dz) {
-    double lipid1area, headgroup1area;
-	double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
-    double defect_headgroup_area, defect_hydrocarbon_area;
+mgreal BLM_quaternary::fnGetnSLD(mgreal dz) {
+    mgreal lipid1area, headgroup1area;
+	mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
+    mgreal defect_headgroup_area, defect_hydrocarbon_area;
     
     //printf("Enter fnGetnSLD \n");
     
@@ -1391,10 +2981,10 @@ double BLM_quaternary::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double BLM_quaternary::fnGetLowerLimit() {return headgroup1->fnGetLowerLimit();};
-double BLM_quaternary::fnGetUpperLimit()
+mgreal BLM_quaternary::fnGetLowerLimit() {return headgroup1->fnGetLowerLimit();};
+mgreal BLM_quaternary::fnGetUpperLimit()
 {
-	double a,b,c;
+	mgreal a,b,c;
 	a=headgroup2->fnGetUpperLimit();
 	b=headgroup2_2->fnGetUpperLimit();
 	c=headgroup2_3->fnGetUpperLimit();
@@ -1407,27 +2997,47 @@ double BLM_quaternary::fnGetUpperLimit()
 		else return c;}
 };
 
-void BLM_quaternary::fnSet(double _sigma, double _bulknsld, double _startz, double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void BLM_quaternary::fnSet(mgreal _sigma, mgreal _bulknsld, mgreal _startz, mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _bulknsld, _startz, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
-    sigma=_sigma;
-    bulknsld=_bulknsld;
-    startz=_startz;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
+    fnUpdate(sigma,_sigma);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(startz,_startz);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
     
-    fnAdjustParameters();
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
 }
 
+//free parameters in the order of fnSet, with default bounds from typical fit setups
+void BLM_quaternary::fnRegisterParameters(ParameterRegistry &registry)
+{
+    registry.fnSetClass("BLM_quaternary");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "bulknsld", &bulknsld, -5.6e-07, 6.4e-06);
+    registry.fnAdd(this, "startz", &startz, 0, 200);
+    registry.fnAdd(this, "l_lipid1", &l_lipid1, 8, 22);
+    registry.fnAdd(this, "l_lipid2", &l_lipid2, 7, 20);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "nf_lipid_2", &nf_lipid_2, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3", &nf_lipid_3, 0, 1);
+    registry.fnAdd(this, "nf_chol", &nf_chol, 0, 1);
+    registry.fnAdd(this, "hc_substitution_1", &hc_substitution_1, 0, 1);
+    registry.fnAdd(this, "hc_substitution_2", &hc_substitution_2, 0, 1);
+    registry.fnAdd(this, "radius_defect", &radius_defect, 20, 500);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);
+}
 
-void BLM_quaternary::fnSetSigma(double sigma)
+void BLM_quaternary::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -1447,14 +3057,26 @@ void BLM_quaternary::fnSetSigma(double sigma)
     
 }
 
-double BLM_quaternary::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+//headgroup exchange and the defect headgroup depend on the bulk nSLD, the geometry does not
+void BLM_quaternary::fnSetBulknSLD(mgreal _bulknsld)
+{
+    fnUpdate(bulknsld,_bulknsld);
+    fnAdjustParameters();
+}
+
+mgreal BLM_quaternary::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal BLM_quaternary::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
 
-void BLM_quaternary::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void BLM_quaternary::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     headgroup1->fnWriteGroup2File(fp, "blm_headgroup1", dimension, stepsize);
     headgroup1_2->fnWriteGroup2File(fp, "blm_headgroup1_2", dimension, stepsize);
@@ -1504,17 +3126,50 @@ Monolayer::~Monolayer(){
     delete methyl;
 };
 
+//the head group is owned by the derived class that creates it, the base copies the pointer only
+Monolayer::Monolayer(const Monolayer &o) : nSLDObj(o)
+{
+    substrate=NULL; lipid=NULL; methyl=NULL;
+    *this=o;
+};
+
+Monolayer& Monolayer::operator=(const Monolayer &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(substrate,o.substrate); fnCopyGroup(lipid,o.lipid); fnCopyGroup(methyl,o.methyl);
+        headgroup=o.headgroup;
+        normarea=o.normarea; global_rough=o.global_rough; sigma=o.sigma; l_lipid=o.l_lipid; vf_bilayer=o.vf_bilayer; rho_substrate=o.rho_substrate;
+        absorb_substrate=o.absorb_substrate; hc_substitution=o.hc_substitution; volacyllipid=o.volacyllipid; nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid;
+        absorbacyllipid=o.absorbacyllipid; absorbmethyllipid=o.absorbmethyllipid;
+    }
+    return *this;
+};
+
+void Monolayer::fnRegisterParameters(ParameterRegistry &registry)
+{
+    registry.fnSetClass("Monolayer");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "global_rough", &global_rough, 1, 25);
+    registry.fnAdd(this, "rho_substrate", &rho_substrate, -1e-06, 8e-06);
+    registry.fnAdd(this, "absorb_substrate", &absorb_substrate, 0, 1e-06);
+    registry.fnAdd(this, "l_lipid", &l_lipid, 8, 22);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "hc_substitution", &hc_substitution, 0, 1);
+}
+
 void Monolayer::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_hc;
-    double V_hc;
-    double nf_hc_lipid, nSL_hc, absorb_hc;
-    double c_s_hc, c_A_hc, c_V_hc;
+    mgreal l_hc;
+    mgreal V_hc;
+    mgreal nf_hc_lipid, nSL_hc, absorb_hc;
+    mgreal c_s_hc, c_A_hc, c_V_hc;
     
-    double l_m;
-    double V_m;
-    double nf_m_lipid, nSL_m, absorb_m;
-    double c_s_m, c_A_m, c_V_m;  
+    mgreal l_m;
+    mgreal V_m;
+    mgreal nf_m_lipid, nSL_m, absorb_m;
+    mgreal c_s_m, c_A_m, c_V_m;  
     
     //set all sigma
     
@@ -1575,15 +3230,15 @@ void Monolayer::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double Monolayer::fnGetArea(double dz) {
+mgreal Monolayer::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+lipid->fnGetArea(dz)+headgroup->fnGetArea(dz)
             +methyl->fnGetArea(dz));
 };
 
 //get nSLD from molecular subgroups
-double Monolayer::fnGetnSLD(double dz) {
-    double substratearea, lipidarea, headgrouparea;
-    double methylarea, sum;
+mgreal Monolayer::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, lipidarea, headgrouparea;
+    mgreal methylarea, sum;
     
     substratearea=substrate->fnGetArea(dz);
     lipidarea=lipid->fnGetArea(dz);
@@ -1604,22 +3259,28 @@ double Monolayer::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double Monolayer::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double Monolayer::fnGetUpperLimit() {return headgroup->fnGetUpperLimit();};
+mgreal Monolayer::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal Monolayer::fnGetUpperLimit() {return headgroup->fnGetUpperLimit();};
 
-double Monolayer::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+mgreal Monolayer::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
-double Monolayer::fnWriteProfile(double aArea[], double anSLD[], double aAbsorb[], int dimension, double stepsize, double dMaxArea)
+mgreal Monolayer::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
+mgreal Monolayer::fnWriteProfile(mgreal aArea[], mgreal anSLD[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,aAbsorb,dimension,stepsize,dMaxArea);
 	return normarea;
 };
 
-void Monolayer::fnSetSigma(double dsigma)
+void Monolayer::fnSetSigma(mgreal dsigma)
 {
+    bDirty=true; iStateHash=0;
     //set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -1631,15 +3292,15 @@ void Monolayer::fnSetSigma(double dsigma)
     substrate->sigma2=global_rough;
 
 }
-void Monolayer::fnSetnSL(double nSL_methyl, double nSL_lipid, double nSL_headgroup1, double nSL_headgroup2, double nSL_headgroup3)
+void Monolayer::fnSetnSL(mgreal nSL_methyl, mgreal nSL_lipid, mgreal nSL_headgroup1, mgreal nSL_headgroup2, mgreal nSL_headgroup3)
 {
-    nslmethyllipid=nSL_methyl;
-    nslacyllipid=nSL_lipid;
+    bDirty=true; iStateHash=0;
+    fnUpdate(nslmethyllipid,nSL_methyl);
+    fnUpdate(nslacyllipid,nSL_lipid);
     headgroup->fnSetnSL(nSL_headgroup1,nSL_headgroup2,nSL_headgroup3);
 }
 
-
-void Monolayer::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void Monolayer::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -1707,30 +3368,53 @@ ssBLM::~ssBLM(){
     delete defect_headgroup;
 };
 
+ssBLM::ssBLM(const ssBLM &o) : nSLDObj(o)
+{
+    substrate=NULL; siox=NULL; headgroup1=NULL; lipid1=NULL; methyl1=NULL; methyl2=NULL;
+    lipid2=NULL; headgroup2=NULL; defect_hydrocarbon=NULL; defect_headgroup=NULL;
+    *this=o;
+};
+
+ssBLM& ssBLM::operator=(const ssBLM &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(substrate,o.substrate); fnCopyGroup(siox,o.siox); fnCopyGroup(headgroup1,o.headgroup1);
+        fnCopyGroup(lipid1,o.lipid1); fnCopyGroup(methyl1,o.methyl1); fnCopyGroup(methyl2,o.methyl2);
+        fnCopyGroup(lipid2,o.lipid2); fnCopyGroup(headgroup2,o.headgroup2); fnCopyGroup(defect_hydrocarbon,o.defect_hydrocarbon);
+        fnCopyGroup(defect_headgroup,o.defect_headgroup);
+        normarea=o.normarea; global_rough=o.global_rough; sigma=o.sigma; l_lipid1=o.l_lipid1; l_lipid2=o.l_lipid2; vf_bilayer=o.vf_bilayer;
+        rho_substrate=o.rho_substrate; rho_siox=o.rho_siox; l_submembrane=o.l_submembrane; l_siox=o.l_siox; hc_substitution_1=o.hc_substitution_1; hc_substitution_2=o.hc_substitution_2;
+        radius_defect=o.radius_defect; volacyllipid=o.volacyllipid; nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid;
+    }
+    return *this;
+};
+
 void ssBLM::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nSL_om;
-    double c_s_om, c_A_om, c_V_om;  
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;  
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nSL_im;
-    double c_s_im, c_A_im, c_V_im;  
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;  
     
-    double defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     // set all sigma
     
@@ -1858,17 +3542,17 @@ void ssBLM::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double ssBLM::fnGetArea(double dz) {
+mgreal ssBLM::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+siox->fnGetArea(dz)+lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
             +headgroup2->fnGetArea(dz)+defect_hydrocarbon->fnGetArea(dz)+defect_headgroup->fnGetArea(dz));
 };
 
 //get nSLD from molecular subgroups
-double ssBLM::fnGetnSLD(double dz) {
-    double substratearea, sioxarea, lipid1area, headgroup1area;
-    double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double defect_headgroup_area, defect_hydrocarbon_area;
+mgreal ssBLM::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, sioxarea, lipid1area, headgroup1area;
+    mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal defect_headgroup_area, defect_hydrocarbon_area;
     
     substratearea=substrate->fnGetArea(dz);
     sioxarea=siox->fnGetArea(dz);
@@ -1902,30 +3586,49 @@ double ssBLM::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double ssBLM::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double ssBLM::fnGetUpperLimit() {return headgroup2->fnGetUpperLimit();};
-
-void ssBLM::fnSet(double _sigma, double _global_rough, double _rho_substrate, double _rho_siox, double _l_siox, double _l_submembrane, double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
-    
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    rho_siox=_rho_siox;
-    l_siox=_l_siox;
-    l_submembrane=_l_submembrane;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    fnAdjustParameters();
-}
-
-
-void ssBLM::fnSetSigma(double sigma)
-{
+mgreal ssBLM::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal ssBLM::fnGetUpperLimit() {return headgroup2->fnGetUpperLimit();};
+
+void ssBLM::fnSet(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _rho_siox, mgreal _l_siox, mgreal _l_submembrane, mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _rho_siox, _l_siox, _l_submembrane, _l_lipid1, _l_lipid2, _vf_bilayer, _hc_substitution_1, _hc_substitution_2, _radius_defect};
+    
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(rho_siox,_rho_siox);
+    fnUpdate(l_siox,_l_siox);
+    fnUpdate(l_submembrane,_l_submembrane);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
+}
+
+void ssBLM::fnRegisterParameters(ParameterRegistry &registry)
+{
+    registry.fnSetClass("ssBLM");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "global_rough", &global_rough, 1, 25);
+    registry.fnAdd(this, "rho_substrate", &rho_substrate, -1e-06, 8e-06);
+    registry.fnAdd(this, "rho_siox", &rho_siox, 3e-06, 4.2e-06);
+    registry.fnAdd(this, "l_siox", &l_siox, 5, 40);
+    registry.fnAdd(this, "l_submembrane", &l_submembrane, 0, 30);
+    registry.fnAdd(this, "l_lipid1", &l_lipid1, 8, 22);
+    registry.fnAdd(this, "l_lipid2", &l_lipid2, 7, 20);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "hc_substitution_1", &hc_substitution_1, 0, 1);
+    registry.fnAdd(this, "hc_substitution_2", &hc_substitution_2, 0, 1);
+    registry.fnAdd(this, "radius_defect", &radius_defect, 20, 500);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);
+}
+
+void ssBLM::fnSetSigma(mgreal sigma)
+{
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     headgroup1->fnSetSigma(sigma);
@@ -1938,14 +3641,19 @@ void ssBLM::fnSetSigma(double sigma)
     defect_headgroup->fnSetSigma(sigma);
 }
 
-double ssBLM::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+mgreal ssBLM::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal ssBLM::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
 
-void ssBLM::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void ssBLM::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -2059,30 +3767,58 @@ ssBLM_quaternary::~ssBLM_quaternary(){
     
 };
 
+ssBLM_quaternary::ssBLM_quaternary(const ssBLM_quaternary &o) : nSLDObj(o)
+{
+    substrate=NULL; siox=NULL; headgroup1=NULL; lipid1=NULL; methyl1=NULL; methyl2=NULL;
+    lipid2=NULL; headgroup2=NULL; headgroup1_2=NULL; headgroup2_2=NULL; headgroup1_3=NULL; headgroup2_3=NULL;
+    defect_hydrocarbon=NULL; defect_headgroup=NULL;
+    *this=o;
+};
+
+ssBLM_quaternary& ssBLM_quaternary::operator=(const ssBLM_quaternary &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(substrate,o.substrate); fnCopyGroup(siox,o.siox); fnCopyGroup(headgroup1,o.headgroup1);
+        fnCopyGroup(lipid1,o.lipid1); fnCopyGroup(methyl1,o.methyl1); fnCopyGroup(methyl2,o.methyl2);
+        fnCopyGroup(lipid2,o.lipid2); fnCopyGroup(headgroup2,o.headgroup2); fnCopyGroup(headgroup1_2,o.headgroup1_2);
+        fnCopyGroup(headgroup2_2,o.headgroup2_2); fnCopyGroup(headgroup1_3,o.headgroup1_3); fnCopyGroup(headgroup2_3,o.headgroup2_3);
+        fnCopyGroup(defect_hydrocarbon,o.defect_hydrocarbon); fnCopyGroup(defect_headgroup,o.defect_headgroup);
+        normarea=o.normarea; global_rough=o.global_rough; sigma=o.sigma; l_lipid1=o.l_lipid1; l_lipid2=o.l_lipid2; vf_bilayer=o.vf_bilayer;
+        rho_substrate=o.rho_substrate; rho_siox=o.rho_siox; l_submembrane=o.l_submembrane; l_siox=o.l_siox; hc_substitution_1=o.hc_substitution_1; hc_substitution_2=o.hc_substitution_2;
+        radius_defect=o.radius_defect; bulknsld=o.bulknsld; nf_lipid_2=o.nf_lipid_2; nf_lipid_3=o.nf_lipid_3; nf_chol=o.nf_chol; volacyllipid=o.volacyllipid;
+        nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid; volacyllipid_2=o.volacyllipid_2; nslacyllipid_2=o.nslacyllipid_2; volmethyllipid_2=o.volmethyllipid_2;
+        nslmethyllipid_2=o.nslmethyllipid_2; volacyllipid_3=o.volacyllipid_3; nslacyllipid_3=o.nslacyllipid_3; volmethyllipid_3=o.volmethyllipid_3; nslmethyllipid_3=o.nslmethyllipid_3; volchol=o.volchol;
+        nslchol=o.nslchol;
+    }
+    return *this;
+};
+
 void ssBLM_quaternary::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nSL_im;
-    double c_s_im, c_A_im, c_V_im;
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;
     
-    double defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     //printf("Enter AdjustParameters \n");
     
@@ -2260,7 +3996,7 @@ void ssBLM_quaternary::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double ssBLM_quaternary::fnGetArea(double dz) {
+mgreal ssBLM_quaternary::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+siox->fnGetArea(dz)+lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
             +headgroup2->fnGetArea(dz)+headgroup1_2->fnGetArea(dz)+headgroup2_2->fnGetArea(dz)
@@ -2268,11 +4004,11 @@ double ssBLM_quaternary::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double ssBLM_quaternary::fnGetnSLD(double dz) {
-    double substratearea, sioxarea, lipid1area, headgroup1area;
-	double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
-    double defect_headgroup_area, defect_hydrocarbon_area;
+mgreal ssBLM_quaternary::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, sioxarea, lipid1area, headgroup1area;
+	mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
+    mgreal defect_headgroup_area, defect_hydrocarbon_area;
     
     //printf("Enter fnGetnSLD \n");
     
@@ -2317,10 +4053,10 @@ double ssBLM_quaternary::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double ssBLM_quaternary::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double ssBLM_quaternary::fnGetUpperLimit()
+mgreal ssBLM_quaternary::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal ssBLM_quaternary::fnGetUpperLimit()
 {
-	double a,b,c;
+	mgreal a,b,c;
 	a=headgroup2->fnGetUpperLimit();
 	b=headgroup2_2->fnGetUpperLimit();
 	c=headgroup2_3->fnGetUpperLimit();
@@ -2333,36 +4069,59 @@ double ssBLM_quaternary::fnGetUpperLimit()
 		else return c;}
 };
 
-void ssBLM_quaternary::fnSet(double _sigma, double _global_rough, double _rho_substrate, double _bulknsld, double _rho_siox, double _l_siox, double _l_submembrane,  double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void ssBLM_quaternary::fnSet(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _bulknsld, mgreal _rho_siox, mgreal _l_siox, mgreal _l_submembrane,  mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _bulknsld, _rho_siox, _l_siox, _l_submembrane, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
     //printf("Enter fnSet \n");
     
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    bulknsld=_bulknsld;
-    rho_siox=_rho_siox;
-    l_siox=_l_siox;
-    l_submembrane=_l_submembrane;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    
-    fnAdjustParameters();
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(rho_siox,_rho_siox);
+    fnUpdate(l_siox,_l_siox);
+    fnUpdate(l_submembrane,_l_submembrane);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
     
     //printf("Exit fnSet \n");
 }
 
+void ssBLM_quaternary::fnRegisterParameters(ParameterRegistry &registry)
+{
+    registry.fnSetClass("ssBLM_quaternary");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "global_rough", &global_rough, 1, 25);
+    registry.fnAdd(this, "rho_substrate", &rho_substrate, -1e-06, 8e-06);
+    registry.fnAdd(this, "bulknsld", &bulknsld, -5.6e-07, 6.4e-06);
+    registry.fnAdd(this, "rho_siox", &rho_siox, 3e-06, 4.2e-06);
+    registry.fnAdd(this, "l_siox", &l_siox, 5, 40);
+    registry.fnAdd(this, "l_submembrane", &l_submembrane, 0, 30);
+    registry.fnAdd(this, "l_lipid1", &l_lipid1, 8, 22);
+    registry.fnAdd(this, "l_lipid2", &l_lipid2, 7, 20);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "nf_lipid_2", &nf_lipid_2, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3", &nf_lipid_3, 0, 1);
+    registry.fnAdd(this, "nf_chol", &nf_chol, 0, 1);
+    registry.fnAdd(this, "hc_substitution_1", &hc_substitution_1, 0, 1);
+    registry.fnAdd(this, "hc_substitution_2", &hc_substitution_2, 0, 1);
+    registry.fnAdd(this, "radius_defect", &radius_defect, 20, 500);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);
+}
 
-void ssBLM_quaternary::fnSetSigma(double sigma)
+void ssBLM_quaternary::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -2385,14 +4144,26 @@ void ssBLM_quaternary::fnSetSigma(double sigma)
     
 }
 
-double ssBLM_quaternary::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+//headgroup exchange and the defect headgroup depend on the bulk nSLD, the geometry does not
+void ssBLM_quaternary::fnSetBulknSLD(mgreal _bulknsld)
+{
+    fnUpdate(bulknsld,_bulknsld);
+    fnAdjustParameters();
+}
+
+mgreal ssBLM_quaternary::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal ssBLM_quaternary::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
 
-void ssBLM_quaternary::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void ssBLM_quaternary::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -2433,10 +4204,27 @@ ssBLM_quaternary_2sub::~ssBLM_quaternary_2sub(){
     delete cr;
 };
 
+ssBLM_quaternary_2sub::ssBLM_quaternary_2sub(const ssBLM_quaternary_2sub &o) : ssBLM_quaternary(o)
+{
+    cr=NULL;
+    *this=o;
+};
+
+ssBLM_quaternary_2sub& ssBLM_quaternary_2sub::operator=(const ssBLM_quaternary_2sub &o)
+{
+    if (this!=&o) {
+        ssBLM_quaternary::operator=(o);
+        fnCopyGroup(cr,o.cr);
+        rho_cr=o.rho_cr; l_cr=o.l_cr;
+    }
+    return *this;
+};
+
 void ssBLM_quaternary_2sub::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     //Philosophie: take structure from parent class and insert the Cr layer by shifting the bilayer to higher z
     
-    double hclength, hglength;
+    mgreal hclength, hglength;
     
     ssBLM_quaternary::fnAdjustParameters();
 
@@ -2469,13 +4257,13 @@ void ssBLM_quaternary_2sub::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double ssBLM_quaternary_2sub::fnGetArea(double dz) {
+mgreal ssBLM_quaternary_2sub::fnGetArea(mgreal dz) {
     return (ssBLM_quaternary::fnGetArea(dz)+cr->fnGetArea(dz));
 };
 
 //get nSLD from molecular subgroups
-double ssBLM_quaternary_2sub::fnGetnSLD(double dz) {
-	double area1, area2, sum;
+mgreal ssBLM_quaternary_2sub::fnGetnSLD(mgreal dz) {
+	mgreal area1, area2, sum;
     
     //printf("Enter fnGetnSLD \n");
     area1=ssBLM_quaternary::fnGetArea(dz);
@@ -2490,38 +4278,47 @@ double ssBLM_quaternary_2sub::fnGetnSLD(double dz) {
     }
 };
 
-void ssBLM_quaternary_2sub::fnSet_2sub(double _sigma, double _global_rough, double _rho_substrate, double _bulknsld, double _rho_siox, double _l_siox, double _rho_cr, double _l_cr, double _l_submembrane,  double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void ssBLM_quaternary_2sub::fnSet_2sub(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _bulknsld, mgreal _rho_siox, mgreal _l_siox, mgreal _rho_cr, mgreal _l_cr, mgreal _l_submembrane,  mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _bulknsld, _rho_siox, _l_siox, _rho_cr, _l_cr, _l_submembrane, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
     //printf("Enter fnSet \n");
     
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    bulknsld=_bulknsld;
-    rho_siox=_rho_siox;
-    l_siox=_l_siox;
-    rho_cr=_rho_cr;
-    l_cr=_l_cr;
-    l_submembrane=_l_submembrane;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    
-    fnAdjustParameters();
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(rho_siox,_rho_siox);
+    fnUpdate(l_siox,_l_siox);
+    fnUpdate(rho_cr,_rho_cr);
+    fnUpdate(l_cr,_l_cr);
+    fnUpdate(l_submembrane,_l_submembrane);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
     
     //printf("Exit fnSet \n");
 }
 
+void ssBLM_quaternary_2sub::fnRegisterParameters(ParameterRegistry &registry)
+{
+    ssBLM_quaternary::fnRegisterParameters(registry);
+    registry.fnSetClass("ssBLM_quaternary_2sub");
+    registry.fnAdd(this, "rho_cr", &rho_cr, 3.03e-06, 4.15e-06);
+    registry.fnAdd(this, "l_cr", &l_cr, 10, 60);
+}
 
-void ssBLM_quaternary_2sub::fnSetSigma(double sigma)
+void ssBLM_quaternary_2sub::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     // set all sigma
     ssBLM_quaternary::fnSetSigma(sigma);
     cr->sigma1=global_rough;
@@ -2529,7 +4326,7 @@ void ssBLM_quaternary_2sub::fnSetSigma(double sigma)
 }
 
 
-void ssBLM_quaternary_2sub::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void ssBLM_quaternary_2sub::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //fprintf(fp, "PC %s z %lf l %lf nf %lf \n",cName, z, l, nf);
     //nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
@@ -2642,30 +4439,58 @@ hybridBLM_quaternary::~hybridBLM_quaternary(){
     
 };
 
+hybridBLM_quaternary::hybridBLM_quaternary(const hybridBLM_quaternary &o) : nSLDObj(o)
+{
+    substrate=NULL; headgroup1=NULL; lipid1=NULL; methyl1=NULL; methyl2=NULL; lipid2=NULL;
+    headgroup2=NULL; headgroup1_2=NULL; headgroup2_2=NULL; headgroup1_3=NULL; headgroup2_3=NULL; defect_hydrocarbon=NULL;
+    defect_headgroup=NULL;
+    *this=o;
+};
+
+hybridBLM_quaternary& hybridBLM_quaternary::operator=(const hybridBLM_quaternary &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(substrate,o.substrate); fnCopyGroup(headgroup1,o.headgroup1); fnCopyGroup(lipid1,o.lipid1);
+        fnCopyGroup(methyl1,o.methyl1); fnCopyGroup(methyl2,o.methyl2); fnCopyGroup(lipid2,o.lipid2);
+        fnCopyGroup(headgroup2,o.headgroup2); fnCopyGroup(headgroup1_2,o.headgroup1_2); fnCopyGroup(headgroup2_2,o.headgroup2_2);
+        fnCopyGroup(headgroup1_3,o.headgroup1_3); fnCopyGroup(headgroup2_3,o.headgroup2_3); fnCopyGroup(defect_hydrocarbon,o.defect_hydrocarbon);
+        fnCopyGroup(defect_headgroup,o.defect_headgroup);
+        normarea=o.normarea; global_rough=o.global_rough; sigma=o.sigma; l_lipid1=o.l_lipid1; l_lipid2=o.l_lipid2; vf_bilayer=o.vf_bilayer;
+        rho_substrate=o.rho_substrate; hc_substitution_1=o.hc_substitution_1; hc_substitution_2=o.hc_substitution_2; radius_defect=o.radius_defect; bulknsld=o.bulknsld; nf_lipid_2=o.nf_lipid_2;
+        nf_lipid_3=o.nf_lipid_3; nf_chol=o.nf_chol; volacylsam=o.volacylsam; nslacylsam=o.nslacylsam; volheadsam=o.volheadsam; nslheadsam=o.nslheadsam;
+        volmethylsam=o.volmethylsam; nslmethylsam=o.nslmethylsam; volacyllipid=o.volacyllipid; nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid;
+        volacyllipid_2=o.volacyllipid_2; nslacyllipid_2=o.nslacyllipid_2; volmethyllipid_2=o.volmethyllipid_2; nslmethyllipid_2=o.nslmethyllipid_2; volacyllipid_3=o.volacyllipid_3; nslacyllipid_3=o.nslacyllipid_3;
+        volmethyllipid_3=o.volmethyllipid_3; nslmethyllipid_3=o.nslmethyllipid_3; volchol=o.volchol; nslchol=o.nslchol;
+    }
+    return *this;
+};
+
 void hybridBLM_quaternary::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nSL_im;
-    double c_s_im, c_A_im, c_V_im;
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;
     
-    double defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     //printf("Enter AdjustParameters \n");
     
@@ -2817,7 +4642,7 @@ void hybridBLM_quaternary::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double hybridBLM_quaternary::fnGetArea(double dz) {
+mgreal hybridBLM_quaternary::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
             +headgroup2->fnGetArea(dz)+headgroup2_2->fnGetArea(dz)
@@ -2825,11 +4650,11 @@ double hybridBLM_quaternary::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double hybridBLM_quaternary::fnGetnSLD(double dz) {
-    double substratearea, lipid1area, headgroup1area;
-	double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double headgroup2_2_area, headgroup2_3_area;
-    double defect_headgroup_area, defect_hydrocarbon_area;
+mgreal hybridBLM_quaternary::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, lipid1area, headgroup1area;
+	mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal headgroup2_2_area, headgroup2_3_area;
+    mgreal defect_headgroup_area, defect_hydrocarbon_area;
     
     //printf("Enter fnGetnSLD \n");
     
@@ -2868,10 +4693,10 @@ double hybridBLM_quaternary::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double hybridBLM_quaternary::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double hybridBLM_quaternary::fnGetUpperLimit()
+mgreal hybridBLM_quaternary::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal hybridBLM_quaternary::fnGetUpperLimit()
 {
-	double a,b,c;
+	mgreal a,b,c;
 	a=headgroup2->fnGetUpperLimit();
 	b=headgroup2_2->fnGetUpperLimit();
 	c=headgroup2_3->fnGetUpperLimit();
@@ -2884,32 +4709,52 @@ double hybridBLM_quaternary::fnGetUpperLimit()
 		else return c;}
 };
 
-void hybridBLM_quaternary::fnSet(double _sigma, double _global_rough, double _rho_substrate, double _bulknsld, double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void hybridBLM_quaternary::fnSet(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _bulknsld, mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _bulknsld, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
     //printf("Enter fnSet \n");
     
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    bulknsld=_bulknsld;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    fnAdjustParameters();
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
     
     //printf("Exit fnSet \n");
 }
 
+void hybridBLM_quaternary::fnRegisterParameters(ParameterRegistry &registry)
+{
+    registry.fnSetClass("hybridBLM_quaternary");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "global_rough", &global_rough, 1, 25);
+    registry.fnAdd(this, "rho_substrate", &rho_substrate, -1e-06, 8e-06);
+    registry.fnAdd(this, "bulknsld", &bulknsld, -5.6e-07, 6.4e-06);
+    registry.fnAdd(this, "l_lipid1", &l_lipid1, 8, 22);
+    registry.fnAdd(this, "l_lipid2", &l_lipid2, 7, 20);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "nf_lipid_2", &nf_lipid_2, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3", &nf_lipid_3, 0, 1);
+    registry.fnAdd(this, "nf_chol", &nf_chol, 0, 1);
+    registry.fnAdd(this, "hc_substitution_1", &hc_substitution_1, 0, 1);
+    registry.fnAdd(this, "hc_substitution_2", &hc_substitution_2, 0, 1);
+    registry.fnAdd(this, "radius_defect", &radius_defect, 20, 500);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);
+}
 
-void hybridBLM_quaternary::fnSetSigma(double sigma)
+void hybridBLM_quaternary::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -2928,14 +4773,26 @@ void hybridBLM_quaternary::fnSetSigma(double sigma)
     
 }
 
-double hybridBLM_quaternary::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+//headgroup exchange and the defect headgroup depend on the bulk nSLD, the geometry does not
+void hybridBLM_quaternary::fnSetBulknSLD(mgreal _bulknsld)
+{
+    fnUpdate(bulknsld,_bulknsld);
+    fnAdjustParameters();
+}
+
+mgreal hybridBLM_quaternary::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal hybridBLM_quaternary::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
 
-void hybridBLM_quaternary::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void hybridBLM_quaternary::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -3060,38 +4917,67 @@ tBLM_quaternary_chol::~tBLM_quaternary_chol(){
 
 };
 
+tBLM_quaternary_chol::tBLM_quaternary_chol(const tBLM_quaternary_chol &o) : nSLDObj(o)
+{
+    substrate=NULL; bME=NULL; tether=NULL; tetherg=NULL; headgroup1=NULL; lipid1=NULL;
+    methyl1=NULL; methyl2=NULL; lipid2=NULL; headgroup2=NULL; headgroup1_2=NULL; headgroup2_2=NULL;
+    headgroup1_3=NULL; headgroup2_3=NULL; defect_hydrocarbon=NULL; defect_headgroup=NULL;
+    *this=o;
+};
+
+tBLM_quaternary_chol& tBLM_quaternary_chol::operator=(const tBLM_quaternary_chol &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(substrate,o.substrate); fnCopyGroup(bME,o.bME); fnCopyGroup(tether,o.tether);
+        fnCopyGroup(tetherg,o.tetherg); fnCopyGroup(headgroup1,o.headgroup1); fnCopyGroup(lipid1,o.lipid1);
+        fnCopyGroup(methyl1,o.methyl1); fnCopyGroup(methyl2,o.methyl2); fnCopyGroup(lipid2,o.lipid2);
+        fnCopyGroup(headgroup2,o.headgroup2); fnCopyGroup(headgroup1_2,o.headgroup1_2); fnCopyGroup(headgroup2_2,o.headgroup2_2);
+        fnCopyGroup(headgroup1_3,o.headgroup1_3); fnCopyGroup(headgroup2_3,o.headgroup2_3); fnCopyGroup(defect_hydrocarbon,o.defect_hydrocarbon);
+        fnCopyGroup(defect_headgroup,o.defect_headgroup);
+        global_rough=o.global_rough; sigma=o.sigma; l_lipid1=o.l_lipid1; l_lipid2=o.l_lipid2; vf_bilayer=o.vf_bilayer; l_tether=o.l_tether;
+        nf_tether=o.nf_tether; mult_tether=o.mult_tether; rho_substrate=o.rho_substrate; bulknsld=o.bulknsld; hc_substitution_1=o.hc_substitution_1; hc_substitution_2=o.hc_substitution_2;
+        radius_defect=o.radius_defect; nf_lipid_2=o.nf_lipid_2; nf_lipid_3=o.nf_lipid_3; nf_chol=o.nf_chol; normarea=o.normarea; volacyllipid=o.volacyllipid;
+        nslacyllipid=o.nslacyllipid; volmethyllipid=o.volmethyllipid; nslmethyllipid=o.nslmethyllipid; volmethyltether=o.volmethyltether; nslmethyltether=o.nslmethyltether; volacyltether=o.volacyltether;
+        nslacyltether=o.nslacyltether; volacyllipid_2=o.volacyllipid_2; nslacyllipid_2=o.nslacyllipid_2; volmethyllipid_2=o.volmethyllipid_2; nslmethyllipid_2=o.nslmethyllipid_2; volacyllipid_3=o.volacyllipid_3;
+        nslacyllipid_3=o.nslacyllipid_3; volmethyllipid_3=o.volmethyllipid_3; nslmethyllipid_3=o.nslmethyllipid_3; volchol=o.volchol; nslchol=o.nslchol;
+    }
+    return *this;
+};
+
 void tBLM_quaternary_chol::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;  
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;  
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
-    double c_s_im, c_A_im, c_V_im;  
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;  
     
-    double V_tg;
-    double c_s_tg, c_A_tg, c_V_tg;
+    mgreal V_tg;
+    mgreal c_s_tg, c_A_tg, c_V_tg;
     
-    double l_EO,V_EO;
-    double c_s_EO, c_A_EO, c_V_EO;
+    mgreal l_EO,V_EO;
+    mgreal c_s_EO, c_A_EO, c_V_EO;
     
-    double l_bME,V_bME;
+    mgreal l_bME,V_bME;
     
-    double d1, defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal d1, defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     //printf("Enter AdjustParameters \n");
     
@@ -3321,7 +5207,7 @@ void tBLM_quaternary_chol::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double tBLM_quaternary_chol::fnGetArea(double dz) {
+mgreal tBLM_quaternary_chol::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+bME->fnGetArea(dz)+tether->fnGetArea(dz)
             +tetherg->fnGetArea(dz)+lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
@@ -3330,11 +5216,11 @@ double tBLM_quaternary_chol::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double tBLM_quaternary_chol::fnGetnSLD(double dz) {
-    double substratearea, bMEarea, tetherarea, tethergarea, lipid1area, headgroup1area;
-	double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
-    double defect_headgroup_area, defect_hydrocarbon_area;
+mgreal tBLM_quaternary_chol::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, bMEarea, tetherarea, tethergarea, lipid1area, headgroup1area;
+	mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
+    mgreal defect_headgroup_area, defect_hydrocarbon_area;
 
     //printf("Enter fnGetnSLD \n");
     
@@ -3383,10 +5269,10 @@ double tBLM_quaternary_chol::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double tBLM_quaternary_chol::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double tBLM_quaternary_chol::fnGetUpperLimit() 
+mgreal tBLM_quaternary_chol::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal tBLM_quaternary_chol::fnGetUpperLimit() 
 {
-	double a,b,c;
+	mgreal a,b,c;
 	a=headgroup2->fnGetUpperLimit();
 	b=headgroup2_2->fnGetUpperLimit();
 	c=headgroup2_3->fnGetUpperLimit();
@@ -3399,35 +5285,59 @@ double tBLM_quaternary_chol::fnGetUpperLimit()
 		else return c;}
 };
 
-void tBLM_quaternary_chol::fnSet(double _sigma, double _global_rough, double _rho_substrate, double _bulknsld, double _nf_tether, double _mult_tether, double _l_tether, double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void tBLM_quaternary_chol::fnSet(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _bulknsld, mgreal _nf_tether, mgreal _mult_tether, mgreal _l_tether, mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _bulknsld, _nf_tether, _mult_tether, _l_tether, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
     //printf("Enter fnSet \n");
     
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    bulknsld=_bulknsld;
-    nf_tether=_nf_tether;
-    mult_tether=_mult_tether;
-    l_tether=_l_tether;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    
-    fnAdjustParameters();
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(nf_tether,_nf_tether);
+    fnUpdate(mult_tether,_mult_tether);
+    fnUpdate(l_tether,_l_tether);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
     
     //printf("Exit fnSet \n");
 }
 
-void tBLM_quaternary_chol::fnSetSigma(double sigma)
+void tBLM_quaternary_chol::fnRegisterParameters(ParameterRegistry &registry)
 {
+    registry.fnSetClass("tBLM_quaternary_chol");
+    registry.fnAdd(this, "sigma", &sigma, 2, 5);
+    registry.fnAdd(this, "global_rough", &global_rough, 1, 25);
+    registry.fnAdd(this, "rho_substrate", &rho_substrate, -1e-06, 8e-06);
+    registry.fnAdd(this, "bulknsld", &bulknsld, -5.6e-07, 6.4e-06);
+    registry.fnAdd(this, "nf_tether", &nf_tether, 0.5, 1);
+    registry.fnAdd(this, "mult_tether", &mult_tether, 0.1, 4);
+    registry.fnAdd(this, "l_tether", &l_tether, 6, 18);
+    registry.fnAdd(this, "l_lipid1", &l_lipid1, 8, 22);
+    registry.fnAdd(this, "l_lipid2", &l_lipid2, 7, 20);
+    registry.fnAdd(this, "vf_bilayer", &vf_bilayer, 0.6, 1);
+    registry.fnAdd(this, "nf_lipid_2", &nf_lipid_2, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3", &nf_lipid_3, 0, 1);
+    registry.fnAdd(this, "nf_chol", &nf_chol, 0, 1);
+    registry.fnAdd(this, "hc_substitution_1", &hc_substitution_1, 0, 1);
+    registry.fnAdd(this, "hc_substitution_2", &hc_substitution_2, 0, 1);
+    registry.fnAdd(this, "radius_defect", &radius_defect, 20, 500);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);
+}
+
+void tBLM_quaternary_chol::fnSetSigma(mgreal sigma)
+{
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -3453,14 +5363,26 @@ void tBLM_quaternary_chol::fnSetSigma(double sigma)
     
 }
 
-double tBLM_quaternary_chol::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+//headgroup exchange and the defect headgroup depend on the bulk nSLD, the geometry does not
+void tBLM_quaternary_chol::fnSetBulknSLD(mgreal _bulknsld)
+{
+    fnUpdate(bulknsld,_bulknsld);
+    fnAdjustParameters();
+}
+
+mgreal tBLM_quaternary_chol::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal tBLM_quaternary_chol::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
 
-void tBLM_quaternary_chol::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void tBLM_quaternary_chol::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -3504,37 +5426,38 @@ tBLM_quaternary_chol_2leaflet::tBLM_quaternary_chol_2leaflet(){
 
 
 void tBLM_quaternary_chol_2leaflet::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
-    double c_s_im, c_A_im, c_V_im;
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;
     
-    double V_tg;
-    double c_s_tg, c_A_tg, c_V_tg;
+    mgreal V_tg;
+    mgreal c_s_tg, c_A_tg, c_V_tg;
     
-    double l_EO,V_EO;
-    double c_s_EO, c_A_EO, c_V_EO;
+    mgreal l_EO,V_EO;
+    mgreal c_s_EO, c_A_EO, c_V_EO;
     
-    double l_bME,V_bME;
+    mgreal l_bME,V_bME;
     
-    double d1, defectarea, defectratio, hclength, hglength;
-    double volhalftorus, volcylinder;
+    mgreal d1, defectarea, defectratio, hclength, hglength;
+    mgreal volhalftorus, volcylinder;
     
     //printf("Enter AdjustParameters \n");
     
@@ -3759,35 +5682,45 @@ void tBLM_quaternary_chol_2leaflet::fnAdjustParameters(){
     
 };
 
-void tBLM_quaternary_chol_2leaflet::fnSet(double _sigma, double _global_rough, double _rho_substrate, double _bulknsld, double _nf_tether, double _mult_tether, double _l_tether, double _l_lipid1, double _l_lipid2, double _vf_bilayer, double _nf_lipid_2, double _nf_lipid_3, double _nf_chol, double _nf_lipid_2_inner, double _nf_lipid_3_inner, double _nf_chol_inner, double _hc_substitution_1, double _hc_substitution_2, double _radius_defect){
+void tBLM_quaternary_chol_2leaflet::fnSet(mgreal _sigma, mgreal _global_rough, mgreal _rho_substrate, mgreal _bulknsld, mgreal _nf_tether, mgreal _mult_tether, mgreal _l_tether, mgreal _l_lipid1, mgreal _l_lipid2, mgreal _vf_bilayer, mgreal _nf_lipid_2, mgreal _nf_lipid_3, mgreal _nf_chol, mgreal _nf_lipid_2_inner, mgreal _nf_lipid_3_inner, mgreal _nf_chol_inner, mgreal _hc_substitution_1, mgreal _hc_substitution_2, mgreal _radius_defect){
+    mgreal aParameters[]={_sigma, _global_rough, _rho_substrate, _bulknsld, _nf_tether, _mult_tether, _l_tether, _l_lipid1, _l_lipid2, _vf_bilayer, _nf_lipid_2, _nf_lipid_3, _nf_chol, _nf_lipid_2_inner, _nf_lipid_3_inner, _nf_chol_inner, _hc_substitution_1, _hc_substitution_2, _radius_defect};
     
     //printf("Enter fnSet \n");
     
-    sigma=_sigma;
-    global_rough=_global_rough;
-    rho_substrate=_rho_substrate;
-    bulknsld=_bulknsld;
-    nf_tether=_nf_tether;
-    mult_tether=_mult_tether;
-    l_tether=_l_tether;
-    l_lipid1=_l_lipid1;
-    l_lipid2=_l_lipid2;
-    vf_bilayer=_vf_bilayer;
-    nf_lipid_2=_nf_lipid_2;
-    nf_lipid_3=_nf_lipid_3;
-    nf_chol=_nf_chol;
-    nf_lipid_2_inner = _nf_lipid_2_inner;
-    nf_lipid_3_inner = _nf_lipid_3_inner;
-    nf_chol_inner = _nf_chol_inner;
-    hc_substitution_1=_hc_substitution_1;
-    hc_substitution_2=_hc_substitution_2;
-    radius_defect=_radius_defect;
-    
-    fnAdjustParameters();
+    fnUpdate(sigma,_sigma);
+    fnUpdate(global_rough,_global_rough);
+    fnUpdate(rho_substrate,_rho_substrate);
+    fnUpdate(bulknsld,_bulknsld);
+    fnUpdate(nf_tether,_nf_tether);
+    fnUpdate(mult_tether,_mult_tether);
+    fnUpdate(l_tether,_l_tether);
+    fnUpdate(l_lipid1,_l_lipid1);
+    fnUpdate(l_lipid2,_l_lipid2);
+    fnUpdate(vf_bilayer,_vf_bilayer);
+    fnUpdate(nf_lipid_2,_nf_lipid_2);
+    fnUpdate(nf_lipid_3,_nf_lipid_3);
+    fnUpdate(nf_chol,_nf_chol);
+    fnUpdate(nf_lipid_2_inner,_nf_lipid_2_inner);
+    fnUpdate(nf_lipid_3_inner,_nf_lipid_3_inner);
+    fnUpdate(nf_chol_inner,_nf_chol_inner);
+    fnUpdate(hc_substitution_1,_hc_substitution_1);
+    fnUpdate(hc_substitution_2,_hc_substitution_2);
+    fnUpdate(radius_defect,_radius_defect);
+    
+    fnApplyState(aParameters, sizeof(aParameters)/sizeof(mgreal));
     
     //printf("Exit fnSet \n");
 }
 
+void tBLM_quaternary_chol_2leaflet::fnRegisterParameters(ParameterRegistry &registry)
+{
+    tBLM_quaternary_chol::fnRegisterParameters(registry);
+    registry.fnSetClass("tBLM_quaternary_chol_2leaflet");
+    registry.fnAdd(this, "nf_lipid_2_inner", &nf_lipid_2_inner, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3_inner", &nf_lipid_3_inner, 0, 1);
+    registry.fnAdd(this, "nf_chol_inner", &nf_chol_inner, 0, 1);
+}
+
 //------------------------------------------------------------------------------------------------------
 // Lipid bilayer - quaternary system with domains
 //------------------------------------------------------------------------------------------------------
@@ -3862,37 +5795,81 @@ tBLM_quaternary_chol_domain::~tBLM_quaternary_chol_domain(){
     delete tetherg_domain;
 };
 
+tBLM_quaternary_chol_domain::tBLM_quaternary_chol_domain(const tBLM_quaternary_chol_domain &o) : tBLM_quaternary_chol(o)
+{
+    headgroup1_domain=NULL; lipid1_domain=NULL; methyl1_domain=NULL; methyl2_domain=NULL; lipid2_domain=NULL; headgroup2_domain=NULL;
+    headgroup1_2_domain=NULL; headgroup2_2_domain=NULL; headgroup1_3_domain=NULL; headgroup2_3_domain=NULL; tetherg_domain=NULL; tether_domain=NULL;
+    *this=o;
+};
+
+tBLM_quaternary_chol_domain& tBLM_quaternary_chol_domain::operator=(const tBLM_quaternary_chol_domain &o)
+{
+    if (this!=&o) {
+        tBLM_quaternary_chol::operator=(o);
+        fnCopyGroup(headgroup1_domain,o.headgroup1_domain); fnCopyGroup(lipid1_domain,o.lipid1_domain); fnCopyGroup(methyl1_domain,o.methyl1_domain);
+        fnCopyGroup(methyl2_domain,o.methyl2_domain); fnCopyGroup(lipid2_domain,o.lipid2_domain); fnCopyGroup(headgroup2_domain,o.headgroup2_domain);
+        fnCopyGroup(headgroup1_2_domain,o.headgroup1_2_domain); fnCopyGroup(headgroup2_2_domain,o.headgroup2_2_domain); fnCopyGroup(headgroup1_3_domain,o.headgroup1_3_domain);
+        fnCopyGroup(headgroup2_3_domain,o.headgroup2_3_domain); fnCopyGroup(tetherg_domain,o.tetherg_domain); fnCopyGroup(tether_domain,o.tether_domain);
+        normarea=o.normarea; normarea_domain=o.normarea_domain; nf_lipid_2_domain=o.nf_lipid_2_domain; nf_lipid_3_domain=o.nf_lipid_3_domain; nf_chol_domain=o.nf_chol_domain; frac_domain=o.frac_domain;
+        l_lipid1_domain=o.l_lipid1_domain; l_lipid2_domain=o.l_lipid2_domain; l_tether_domain=o.l_tether_domain;
+    }
+    return *this;
+};
+
+void tBLM_quaternary_chol_domain::fnRegisterParameters(ParameterRegistry &registry)
+{
+    tBLM_quaternary_chol::fnRegisterParameters(registry);
+    registry.fnSetClass("tBLM_quaternary_chol_domain");
+    registry.fnAdd(this, "nf_lipid_2_domain", &nf_lipid_2_domain, 0, 1);
+    registry.fnAdd(this, "nf_lipid_3_domain", &nf_lipid_3_domain, 0, 1);
+    registry.fnAdd(this, "nf_chol_domain", &nf_chol_domain, 0, 1);
+    registry.fnAdd(this, "frac_domain", &frac_domain, 0, 1);
+    registry.fnAdd(this, "l_lipid1_domain", &l_lipid1_domain, 8, 22);
+    registry.fnAdd(this, "l_lipid2_domain", &l_lipid2_domain, 7, 20);
+    registry.fnAdd(this, "l_tether_domain", &l_tether_domain, 6, 18);
+    registry.fnAdd(this, "normarea", &normarea, 0, 0, true);              //the domain normarea shadows the base one
+}
+
+//the domain members are assigned directly before fnSet, they are part of its key
+unsigned long long tBLM_quaternary_chol_domain::fnHashMembers(unsigned long long iHash)
+{
+    mgreal aMembers[7]={nf_lipid_2_domain, nf_lipid_3_domain, nf_chol_domain, frac_domain, l_lipid1_domain, l_lipid2_domain, l_tether_domain};
+    
+    return fnHashBytes(aMembers, sizeof(aMembers), tBLM_quaternary_chol::fnHashMembers(iHash));
+}
+
 void tBLM_quaternary_chol_domain::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
     
-    double l_ohc;
-    double V_ohc;
-    double nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
-    double c_s_ohc, c_A_ohc, c_V_ohc;
+    mgreal l_ohc;
+    mgreal V_ohc;
+    mgreal nf_ohc_lipid, nf_ohc_lipid_2, nf_ohc_lipid_3, nf_ohc_chol, nSL_ohc;
+    mgreal c_s_ohc, c_A_ohc, c_V_ohc;
     
-    double l_om;
-    double V_om;
-    double nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
-    double c_s_om, c_A_om, c_V_om;  
+    mgreal l_om;
+    mgreal V_om;
+    mgreal nf_om_lipid, nf_om_lipid_2, nf_om_lipid_3, nSL_om;
+    mgreal c_s_om, c_A_om, c_V_om;  
     
-    double l_ihc;
-    double V_ihc;
-    double nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
-    double c_s_ihc, c_A_ihc, c_V_ihc;
+    mgreal l_ihc;
+    mgreal V_ihc;
+    mgreal nf_ihc_lipid, nf_ihc_lipid_2, nf_ihc_lipid_3, nf_ihc_chol, nf_ihc_tether, nSL_ihc;
+    mgreal c_s_ihc, c_A_ihc, c_V_ihc;
     
-    double l_im;
-    double V_im;
-    double nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
-    double c_s_im, c_A_im, c_V_im;  
+    mgreal l_im;
+    mgreal V_im;
+    mgreal nf_im_lipid, nf_im_lipid_2, nf_im_lipid_3, nf_im_tether, nSL_im;
+    mgreal c_s_im, c_A_im, c_V_im;  
     
-    double V_tg;
-    double c_s_tg, c_A_tg, c_V_tg;
+    mgreal V_tg;
+    mgreal c_s_tg, c_A_tg, c_V_tg;
     
-    double l_EO,V_EO;
-    double c_s_EO, c_A_EO, c_V_EO;
+    mgreal l_EO,V_EO;
+    mgreal c_s_EO, c_A_EO, c_V_EO;
     
-    double l_bME,V_bME;
+    mgreal l_bME,V_bME;
     
-    double d1;
+    mgreal d1;
     
     
     fnSetSigma(sigma);
@@ -4189,7 +6166,7 @@ void tBLM_quaternary_chol_domain::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double tBLM_quaternary_chol_domain::fnGetArea(double dz) {
+mgreal tBLM_quaternary_chol_domain::fnGetArea(mgreal dz) {
     return (substrate->fnGetArea(dz)+bME->fnGetArea(dz)+tether->fnGetArea(dz)
             +tetherg->fnGetArea(dz)+lipid1->fnGetArea(dz)+headgroup1->fnGetArea(dz)
             +methyl1->fnGetArea(dz)+methyl2->fnGetArea(dz)+lipid2->fnGetArea(dz)
@@ -4202,13 +6179,13 @@ double tBLM_quaternary_chol_domain::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double tBLM_quaternary_chol_domain::fnGetnSLD(double dz) {
-    double substratearea, bMEarea, tetherarea, tethergarea, lipid1area, headgroup1area;
-	double methyl1area, methyl2area, lipid2area, headgroup2area, sum;
-    double headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
-    double tetherarea_domain, tethergarea_domain, lipid1area_domain, headgroup1area_domain;
-	double methyl1area_domain, methyl2area_domain, lipid2area_domain, headgroup2area_domain;
-    double headgroup1_2_area_domain, headgroup2_2_area_domain, headgroup1_3_area_domain, headgroup2_3_area_domain;
+mgreal tBLM_quaternary_chol_domain::fnGetnSLD(mgreal dz) {
+    mgreal substratearea, bMEarea, tetherarea, tethergarea, lipid1area, headgroup1area;
+	mgreal methyl1area, methyl2area, lipid2area, headgroup2area, sum;
+    mgreal headgroup1_2_area, headgroup2_2_area, headgroup1_3_area, headgroup2_3_area;
+    mgreal tetherarea_domain, tethergarea_domain, lipid1area_domain, headgroup1area_domain;
+	mgreal methyl1area_domain, methyl2area_domain, lipid2area_domain, headgroup2area_domain;
+    mgreal headgroup1_2_area_domain, headgroup2_2_area_domain, headgroup1_3_area_domain, headgroup2_3_area_domain;
     
     
     substratearea=substrate->fnGetArea(dz);
@@ -4280,10 +6257,10 @@ double tBLM_quaternary_chol_domain::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double tBLM_quaternary_chol_domain::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
-double tBLM_quaternary_chol_domain::fnGetUpperLimit() 
+mgreal tBLM_quaternary_chol_domain::fnGetLowerLimit() {return substrate->fnGetLowerLimit();};
+mgreal tBLM_quaternary_chol_domain::fnGetUpperLimit() 
 {
-	double a,b,c,d,e,f,temp;
+	mgreal a,b,c,d,e,f,temp;
 	a=headgroup2->fnGetUpperLimit();
 	b=headgroup2_2->fnGetUpperLimit();
 	c=headgroup2_3->fnGetUpperLimit();
@@ -4301,14 +6278,20 @@ double tBLM_quaternary_chol_domain::fnGetUpperLimit()
     return temp;
 };
 
-double tBLM_quaternary_chol_domain::fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea)
+mgreal tBLM_quaternary_chol_domain::fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea)
 {
     nSLDObj::fnWriteProfile(aArea,anSLD,dimension,stepsize,dMaxArea);
 	return normarea;
 };
+mgreal tBLM_quaternary_chol_domain::fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea)
+{
+    nSLDObj::fnWriteContrastProfile(aArea,anSL,anSLBulk,dimension,stepsize,dMaxArea);
+	return normarea;
+};
 
-void tBLM_quaternary_chol_domain::fnSetSigma(double sigma)
+void tBLM_quaternary_chol_domain::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     // set all sigma
     
     //sigma=sqrt(2.4*2.4 + global_rough*global_rough);
@@ -4345,8 +6328,7 @@ void tBLM_quaternary_chol_domain::fnSetSigma(double sigma)
     
 }
 
-
-void tBLM_quaternary_chol_domain::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void tBLM_quaternary_chol_domain::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -4463,6 +6445,7 @@ Discrete::Discrete(double dstartposition, double dnormarea, const char *cFileNam
     area    = new double[iNumberOfPoints];
     nSLProt = new double[iNumberOfPoints];
     nSLDeut = new double[iNumberOfPoints];
+    piTableReferences=new int(1);
         
     i=0;
     fscanf(fp, "%s %s %s %s", strTemp[0], strTemp[1], strTemp[2], strTemp[3]);       //read out header
@@ -4508,23 +6491,57 @@ Discrete::Discrete(double dstartposition, double dnormarea, const char *cFileNam
 };
 
 Discrete::~Discrete(){
-    delete [] zcoord;
-    delete [] area;
-    delete [] nSLProt;
-    delete [] nSLDeut;
+    fnReleaseTables();
+};
+
+Discrete::Discrete(const Discrete &o) : nSLDObj(o)
+{
+    piTableReferences=NULL;
+    *this=o;
+};
+
+Discrete& Discrete::operator=(const Discrete &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        if (piTableReferences!=o.piTableReferences) {
+            fnReleaseTables();
+            zcoord=o.zcoord; area=o.area; nSLProt=o.nSLProt; nSLDeut=o.nSLDeut;
+            piTableReferences=o.piTableReferences;
+            (*piTableReferences)++;
+        }
+        dStartPosition=o.dStartPosition; dProtExchange=o.dProtExchange; dnSLDBulkSolvent=o.dnSLDBulkSolvent; nf=o.nf; iNumberOfPoints=o.iNumberOfPoints; dZSpacing=o.dZSpacing;
+        normarea=o.normarea;
+    }
+    return *this;
+};
+
+void Discrete::fnReleaseTables()
+{
+    if (piTableReferences!=NULL) {
+        (*piTableReferences)--;
+        if (*piTableReferences==0) {
+            delete [] zcoord;
+            delete [] area;
+            delete [] nSLProt;
+            delete [] nSLDeut;
+            delete piTableReferences;
+        }
+        piTableReferences=NULL;
+    }
 };
 
 //Return value is area at position z
-double Discrete::fnGetArea(double dz) {
+mgreal Discrete::fnGetArea(mgreal dz) {
     int iBinLow, iBinHigh;
-    double dFraction, dtemp;
+    mgreal dFraction, dtemp;
     
     dz=dz-dStartPosition;                       //internal z for profile
     dz=dz/dZSpacing;                            //floating point bin
     
-    iBinHigh=int(ceil(dz));                     //get bin for dz
+    iBinHigh=int(fnValue(ceil(dz)));                     //get bin for dz
     dFraction=modf(dz,&dtemp);
-    iBinLow=int(dtemp);
+    iBinLow=int(fnValue(dtemp));
     
     if ((iBinLow>=0) && (iBinHigh<iNumberOfPoints)) {
         
@@ -4537,17 +6554,17 @@ double Discrete::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double Discrete::fnGetnSLD(double dz) {
+mgreal Discrete::fnGetnSLD(mgreal dz) {
     
     int iBinLow, iBinHigh;
-    double dFraction, dtemp1, dtemp2, dtemp3,dtemp4;
+    mgreal dFraction, dtemp1, dtemp2, dtemp3,dtemp4;
     
     dz=dz-dStartPosition;                       //internal z for profile
     dz=dz/dZSpacing;                            //floating point bin
     
-    iBinHigh=int(ceil(dz));                     //get bin for dz
+    iBinHigh=int(fnValue(ceil(dz)));                     //get bin for dz
     dFraction=modf(dz,&dtemp1);
-    iBinLow=int(dtemp1);
+    iBinLow=int(fnValue(dtemp1));
     
     if((iBinLow>=0) && (iBinHigh<iNumberOfPoints)) {
         
@@ -4574,11 +6591,11 @@ double Discrete::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double Discrete::fnGetLowerLimit() {return (dStartPosition);}
-double Discrete::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
-double Discrete::fnGetVolume(double dz1, double dz2) {
+mgreal Discrete::fnGetLowerLimit() {return (dStartPosition);}
+mgreal Discrete::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
+mgreal Discrete::fnGetVolume(mgreal dz1, mgreal dz2) {
     
-    double d, temp, integral;
+    mgreal d, temp, integral;
     
     if (dz1>dz2){
         temp=dz2;
@@ -4609,30 +6626,30 @@ double Discrete::fnGetVolume(double dz1, double dz2) {
 };
 
 
-void Discrete::fnSet(double _startposition, double _protonexchange, double _nsldbulksolvent, double _nf, double _normarea) {
+void Discrete::fnSet(mgreal _startposition, mgreal _protonexchange, mgreal _nsldbulksolvent, mgreal _nf, mgreal _normarea) {
     
-    dStartPosition=_startposition;
-    dProtExchange=_protonexchange;
-    dnSLDBulkSolvent=_nsldbulksolvent;
-    nf=_nf;
-    normarea=_normarea;
+    fnUpdate(dStartPosition,_startposition);
+    fnUpdate(dProtExchange,_protonexchange);
+    fnUpdate(dnSLDBulkSolvent,_nsldbulksolvent);
+    fnUpdate(nf,_nf);
+    fnUpdate(normarea,_normarea);
 }
 
 
-void Discrete::fnSetNormarea(double dnormarea)
+void Discrete::fnSetNormarea(mgreal dnormarea)
 {
-    normarea=dnormarea;
+    fnUpdate(normarea,dnormarea);
 };
 
-void Discrete::fnSetSigma(double _sigma)
+void Discrete::fnSetSigma(mgreal _sigma)
 {
-    dSigmaConvolution=_sigma;          //not yet used
+    fnUpdate(dSigmaConvolution,_sigma);          //not yet used
 }
 
 
-void Discrete::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void Discrete::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    fprintf(fp, "Discrete %s StartPosition %e \n",cName, dStartPosition);
+    fprintf(fp, "Discrete %s StartPosition %e \n",cName, fnValue(dStartPosition));
     nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);    
 }
 
@@ -4726,6 +6743,7 @@ DiscreteEuler::DiscreteEuler(double dstartposition, double dnormarea, double Bet
     area    = new double[j];
     nSLProt = new double[j];
     nSLDeut = new double[j];
+    piTableReferences=new int(1);
     
     j=0;
     for (dB=dBetaStart; dB<dBetaEnd; dB+=dBetaInc) {
@@ -4814,10 +6832,45 @@ DiscreteEuler::DiscreteEuler(double dstartposition, double dnormarea, double Bet
 };
 
 DiscreteEuler::~DiscreteEuler(){
-    delete [] zcoord;
-    delete [] area;
-    delete [] nSLProt;
-    delete [] nSLDeut;
+    fnReleaseTables();
+};
+
+DiscreteEuler::DiscreteEuler(const DiscreteEuler &o) : nSLDObj(o)
+{
+    piTableReferences=NULL;
+    *this=o;
+};
+
+DiscreteEuler& DiscreteEuler::operator=(const DiscreteEuler &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        if (piTableReferences!=o.piTableReferences) {
+            fnReleaseTables();
+            zcoord=o.zcoord; area=o.area; nSLProt=o.nSLProt; nSLDeut=o.nSLDeut;
+            piTableReferences=o.piTableReferences;
+            (*piTableReferences)++;
+        }
+        dStartPosition=o.dStartPosition; dProtExchange=o.dProtExchange; dnSLDBulkSolvent=o.dnSLDBulkSolvent; dBeta=o.dBeta; dGamma=o.dGamma; nf=o.nf;
+        dsigma=o.dsigma; iNumberOfBeta=o.iNumberOfBeta; iNumberOfGamma=o.iNumberOfGamma; iNumberOfPoints=o.iNumberOfPoints; dBetaStart=o.dBetaStart; dBetaEnd=o.dBetaEnd;
+        dBetaInc=o.dBetaInc; dGammaStart=o.dGammaStart; dGammaEnd=o.dGammaEnd; dGammaInc=o.dGammaInc; dZSpacing=o.dZSpacing; normarea=o.normarea;
+    }
+    return *this;
+};
+
+void DiscreteEuler::fnReleaseTables()
+{
+    if (piTableReferences!=NULL) {
+        (*piTableReferences)--;
+        if (*piTableReferences==0) {
+            delete [] zcoord;
+            delete [] area;
+            delete [] nSLProt;
+            delete [] nSLDeut;
+            delete piTableReferences;
+        }
+        piTableReferences=NULL;
+    }
 };
 
 //Do coordinate conversion to go from 3D array to 1D array
@@ -4826,16 +6879,16 @@ int DiscreteEuler::fn3Cto1C(int iBeta, int iGamma, int iZ) {
 }
 
 //Return value is area at position z
-double DiscreteEuler::fnGetArea(double dz) {
+mgreal DiscreteEuler::fnGetArea(mgreal dz) {
     
     int i,j,k, ii, jj, kk;
     int iPosBinLow, iPosBinHigh;
     int iBetaBinLow, iBetaBinHigh;
     int iGammaBinLow, iGammaBinHigh;
-    double dPosT, dBetaT, dGammaT;
-    double returnvalue, dtemp;
-    double t[3];                                // tvalues for beta, gamma, position
-    double p[4][4][4];                          // all function values for tricubic spline interpolations
+    mgreal dPosT, dBetaT, dGammaT;
+    mgreal returnvalue, dtemp;
+    mgreal t[3];                                // tvalues for beta, gamma, position
+    mgreal p[4][4][4];                          // all function values for tricubic spline interpolations
                                                 // [beta][gamma][position]
                                                 // index values: 0->-1, 1->0, 2->1, 3->2
     
@@ -4845,17 +6898,17 @@ double DiscreteEuler::fnGetArea(double dz) {
     dz=dz/dZSpacing;                            //floating point bin    
     dPosT=modf(dz,&dtemp);
     t[2]=dPosT;
-    iPosBinLow=int(dtemp);
+    iPosBinLow=int(fnValue(dtemp));
     iPosBinHigh=iPosBinLow+1;
     
     dBetaT=modf((dBeta-dBetaStart)/dBetaInc,&dtemp);
     t[0]=dBetaT;
-    iBetaBinLow=int(dtemp);
+    iBetaBinLow=int(fnValue(dtemp));
     iBetaBinHigh=iBetaBinLow+1;
     
     dGammaT=modf((dGamma-dGammaStart)/dGammaInc,&dtemp);
     t[1]=dGammaT;
-    iGammaBinLow=int(dtemp);
+    iGammaBinLow=int(fnValue(dtemp));
     iGammaBinHigh=iGammaBinLow+1;
     
     //printf("iNumberOfBeta %i iNumberOfGamma %i iNumberOfPoints %i \n",iNumberOfBeta, iNumberOfGamma, iNumberOfPoints);
@@ -4904,17 +6957,17 @@ double DiscreteEuler::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double DiscreteEuler::fnGetnSLD(double dz) {
+mgreal DiscreteEuler::fnGetnSLD(mgreal dz) {
     
     int i,j,k, ii, jj, kk;
     int iPosBinLow, iPosBinHigh;
     int iBetaBinLow, iBetaBinHigh;
     int iGammaBinLow, iGammaBinHigh;
-    double dPosT, dBetaT, dGammaT;
-    double returnvalue, dtemp;
-    double dtemp1, dtemp2, dtemp3,dtemp4;
-    double t[3];                                           // tvalues for beta, gamma, position
-    double parea[4][4][4],pprot[4][4][4],pdeut[4][4][4];   // all function values for tricubic spline interpolations
+    mgreal dPosT, dBetaT, dGammaT;
+    mgreal returnvalue, dtemp;
+    mgreal dtemp1, dtemp2, dtemp3,dtemp4;
+    mgreal t[3];                                           // tvalues for beta, gamma, position
+    mgreal parea[4][4][4],pprot[4][4][4],pdeut[4][4][4];   // all function values for tricubic spline interpolations
     // [beta][gamma][position]
     // index values: 0->-1, 1->0, 2->1, 3->2
     
@@ -4922,17 +6975,17 @@ double DiscreteEuler::fnGetnSLD(double dz) {
     dz=dz/dZSpacing;                            //floating point bin    
     dPosT=modf(dz,&dtemp);
     t[2]=dPosT;
-    iPosBinLow=int(dtemp);
+    iPosBinLow=int(fnValue(dtemp));
     iPosBinHigh=iPosBinLow+1;
     
     dBetaT=modf((dBeta-dBetaStart)/dBetaInc,&dtemp);
     t[0]=dBetaT;
-    iBetaBinLow=int(dtemp);
+    iBetaBinLow=int(fnValue(dtemp));
     iBetaBinHigh=iBetaBinLow+1;
     
     dGammaT=modf((dGamma-dGammaStart)/dGammaInc,&dtemp);
     t[1]=dGammaT;
-    iGammaBinLow=int(dtemp);
+    iGammaBinLow=int(fnValue(dtemp));
     iGammaBinHigh=iGammaBinLow+1;
     
     if ((iPosBinLow>=0) && (iPosBinHigh<=iNumberOfPoints) && (iBetaBinLow>=0) &&
@@ -4981,11 +7034,11 @@ double DiscreteEuler::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double DiscreteEuler::fnGetLowerLimit() {return (dStartPosition);}
-double DiscreteEuler::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
-double DiscreteEuler::fnGetVolume(double dz1, double dz2) {
+mgreal DiscreteEuler::fnGetLowerLimit() {return (dStartPosition);}
+mgreal DiscreteEuler::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
+mgreal DiscreteEuler::fnGetVolume(mgreal dz1, mgreal dz2) {
     
-    double d, temp, integral;
+    mgreal d, temp, integral;
     
     if (dz1>dz2){
         temp=dz2;
@@ -5015,15 +7068,15 @@ double DiscreteEuler::fnGetVolume(double dz1, double dz2) {
     return integral;
 };
 
-void DiscreteEuler::fnSetNormarea(double dnormarea)
+void DiscreteEuler::fnSetNormarea(mgreal dnormarea)
 {
-    normarea=dnormarea;
+    fnUpdate(normarea,dnormarea);
 };
 
 
-void DiscreteEuler::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void DiscreteEuler::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    fprintf(fp, "DiscreteEuler %s StartPosition %e Beta %g Gamma %g nf %g \n",cName, dStartPosition,dBeta, dGamma, nf);
+    fprintf(fp, "DiscreteEuler %s StartPosition %e Beta %g Gamma %g nf %g \n",cName, fnValue(dStartPosition),fnValue(dBeta), fnValue(dGamma), fnValue(nf));
     nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);    
 }
 //---------------------------------------------------------------------------------------------------------------------
@@ -5328,10 +7381,46 @@ DiscreteEulerSigma::DiscreteEulerSigma(double dstartposition, double dnormarea,
 };
 
 DiscreteEulerSigma::~DiscreteEulerSigma(){
-    delete [] zcoord;
-    delete [] area;
-    delete [] nSLProt;
-    delete [] nSLDeut;
+    fnReleaseTables();
+};
+
+DiscreteEulerSigma::DiscreteEulerSigma(const DiscreteEulerSigma &o) : nSLDObj(o)
+{
+    piTableReferences=NULL;
+    *this=o;
+};
+
+DiscreteEulerSigma& DiscreteEulerSigma::operator=(const DiscreteEulerSigma &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        if (piTableReferences!=o.piTableReferences) {
+            fnReleaseTables();
+            zcoord=o.zcoord; area=o.area; nSLProt=o.nSLProt; nSLDeut=o.nSLDeut;
+            piTableReferences=o.piTableReferences;
+            (*piTableReferences)++;
+        }
+        dStartPosition=o.dStartPosition; dProtExchange=o.dProtExchange; dnSLDBulkSolvent=o.dnSLDBulkSolvent; dBeta=o.dBeta; dGamma=o.dGamma; nf=o.nf;
+        dSigma=o.dSigma; iNumberOfBeta=o.iNumberOfBeta; iNumberOfGamma=o.iNumberOfGamma; iNumberOfPoints=o.iNumberOfPoints; iNumberOfSigma=o.iNumberOfSigma; dBetaStart=o.dBetaStart;
+        dBetaEnd=o.dBetaEnd; dBetaInc=o.dBetaInc; dGammaStart=o.dGammaStart; dGammaEnd=o.dGammaEnd; dGammaInc=o.dGammaInc; dZSpacing=o.dZSpacing;
+        normarea=o.normarea; dSigmaStart=o.dSigmaStart; dSigmaEnd=o.dSigmaEnd; dSigmaInc=o.dSigmaInc;
+    }
+    return *this;
+};
+
+void DiscreteEulerSigma::fnReleaseTables()
+{
+    if (piTableReferences!=NULL) {
+        (*piTableReferences)--;
+        if (*piTableReferences==0) {
+            delete [] zcoord;
+            delete [] area;
+            delete [] nSLProt;
+            delete [] nSLDeut;
+            delete piTableReferences;
+        }
+        piTableReferences=NULL;
+    }
 };
 
 //Do coordinate conversion to go from 4D array to 1D array
@@ -5340,17 +7429,17 @@ long int DiscreteEulerSigma::fn4Cto1C(int iSigma, int iBeta, int iGamma, int iZ)
 }
 
 //Return value is area at position z
-double DiscreteEulerSigma::fnGetArea(double dz) {
+mgreal DiscreteEulerSigma::fnGetArea(mgreal dz) {
     
     int h,i,j,k, ii, jj, kk, hh;
     int iPosBinLow, iPosBinHigh;
     int iBetaBinLow, iBetaBinHigh;
     int iGammaBinLow, iGammaBinHigh;
     int iSigmaBinLow, iSigmaBinHigh;
-    double dPosT, dBetaT, dGammaT, dSigmaT;
-    double returnvalue, dtemp;
-    double t[4];                                // tvalues for beta, gamma, position
-    double p[4][4][4][4];                          // all function values for tricubic spline interpolations
+    mgreal dPosT, dBetaT, dGammaT, dSigmaT;
+    mgreal returnvalue, dtemp;
+    mgreal t[4];                                // tvalues for beta, gamma, position
+    mgreal p[4][4][4][4];                          // all function values for tricubic spline interpolations
     // [beta][gamma][position][sigma]
     // index values: 0->-1, 1->0, 2->1, 3->2
     
@@ -5360,22 +7449,22 @@ double DiscreteEulerSigma::fnGetArea(double dz) {
     dz=dz/dZSpacing;                            //floating point bin
     dPosT=modf(dz,&dtemp);
     t[2]=dPosT;
-    iPosBinLow=int(dtemp);
+    iPosBinLow=int(fnValue(dtemp));
     iPosBinHigh=iPosBinLow+1;
     
     dBetaT=modf((dBeta-dBetaStart)/dBetaInc,&dtemp);
     t[0]=dBetaT;
-    iBetaBinLow=int(dtemp);
+    iBetaBinLow=int(fnValue(dtemp));
     iBetaBinHigh=iBetaBinLow+1;
     
     dGammaT=modf((dGamma-dGammaStart)/dGammaInc,&dtemp);
     t[1]=dGammaT;
-    iGammaBinLow=int(dtemp);
+    iGammaBinLow=int(fnValue(dtemp));
     iGammaBinHigh=iGammaBinLow+1;
     
     dSigmaT=modf((dSigma-dSigmaStart)/dSigmaInc,&dtemp);
     t[3]=dSigmaT;
-    iSigmaBinLow=int(dtemp);
+    iSigmaBinLow=int(fnValue(dtemp));
     iSigmaBinHigh=iSigmaBinLow+1;
     
     //printf("iNumberOfBeta %i iNumberOfGamma %i iNumberOfPoints %i \n",iNumberOfBeta, iNumberOfGamma, iNumberOfPoints);
@@ -5423,18 +7512,18 @@ double DiscreteEulerSigma::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double DiscreteEulerSigma::fnGetnSLD(double dz) {
+mgreal DiscreteEulerSigma::fnGetnSLD(mgreal dz) {
     
     int h, i, j, k, hh, ii, jj, kk;
     int iPosBinLow, iPosBinHigh;
     int iBetaBinLow, iBetaBinHigh;
     int iGammaBinLow, iGammaBinHigh;
     int iSigmaBinLow, iSigmaBinHigh;
-    double dPosT, dBetaT, dGammaT, dSigmaT;
-    double returnvalue, dtemp;
-    double dtemp1, dtemp2, dtemp3,dtemp4;
-    double t[4];                                                    // tvalues for beta, gamma, position
-    double parea[4][4][4][4],pprot[4][4][4][4],pdeut[4][4][4][4];   // all function values for tricubic spline interpolations
+    mgreal dPosT, dBetaT, dGammaT, dSigmaT;
+    mgreal returnvalue, dtemp;
+    mgreal dtemp1, dtemp2, dtemp3,dtemp4;
+    mgreal t[4];                                                    // tvalues for beta, gamma, position
+    mgreal parea[4][4][4][4],pprot[4][4][4][4],pdeut[4][4][4][4];   // all function values for tricubic spline interpolations
     // [beta][gamma][position][sigma]
     // index values: 0->-1, 1->0, 2->1, 3->2
     
@@ -5442,22 +7531,22 @@ double DiscreteEulerSigma::fnGetnSLD(double dz) {
     dz=dz/dZSpacing;                            //floating point bin
     dPosT=modf(dz,&dtemp);
     t[2]=dPosT;
-    iPosBinLow=int(dtemp);
+    iPosBinLow=int(fnValue(dtemp));
     iPosBinHigh=iPosBinLow+1;
     
     dBetaT=modf((dBeta-dBetaStart)/dBetaInc,&dtemp);
     t[0]=dBetaT;
-    iBetaBinLow=int(dtemp);
+    iBetaBinLow=int(fnValue(dtemp));
     iBetaBinHigh=iBetaBinLow+1;
     
     dGammaT=modf((dGamma-dGammaStart)/dGammaInc,&dtemp);
     t[1]=dGammaT;
-    iGammaBinLow=int(dtemp);
+    iGammaBinLow=int(fnValue(dtemp));
     iGammaBinHigh=iGammaBinLow+1;
     
     dSigmaT=modf((dSigma-dSigmaStart)/dSigmaInc,&dtemp);
     t[3]=dSigmaT;
-    iSigmaBinLow=int(dtemp);
+    iSigmaBinLow=int(fnValue(dtemp));
     iSigmaBinHigh=iSigmaBinLow+1;
     
     if ((iPosBinLow>=0) && (iPosBinHigh<=iNumberOfPoints) && (iBetaBinLow>=0) &&
@@ -5511,11 +7600,11 @@ double DiscreteEulerSigma::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double DiscreteEulerSigma::fnGetLowerLimit() {return (dStartPosition);}
-double DiscreteEulerSigma::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
-double DiscreteEulerSigma::fnGetVolume(double dz1, double dz2) {
+mgreal DiscreteEulerSigma::fnGetLowerLimit() {return (dStartPosition);}
+mgreal DiscreteEulerSigma::fnGetUpperLimit() {return (dStartPosition+double(iNumberOfPoints)*dZSpacing);}
+mgreal DiscreteEulerSigma::fnGetVolume(mgreal dz1, mgreal dz2) {
     
-    double d, temp, integral;
+    mgreal d, temp, integral;
     
     if (dz1>dz2){
         temp=dz2;
@@ -5545,15 +7634,15 @@ double DiscreteEulerSigma::fnGetVolume(double dz1, double dz2) {
     return integral;
 };
 
-void DiscreteEulerSigma::fnSetNormarea(double dnormarea)
+void DiscreteEulerSigma::fnSetNormarea(mgreal dnormarea)
 {
-    normarea=dnormarea;
+    fnUpdate(normarea,dnormarea);
 };
 
 
-void DiscreteEulerSigma::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void DiscreteEulerSigma::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    fprintf(fp, "DiscreteEuler %s StartPosition %e Beta %g Gamma %g Sigma %g nf %g \n",cName, dStartPosition,dBeta, dGamma, dSigma, nf);
+    fprintf(fp, "DiscreteEuler %s StartPosition %e Beta %g Gamma %g Sigma %g nf %g \n",cName, fnValue(dStartPosition),fnValue(dBeta), fnValue(dGamma), fnValue(dSigma), fnValue(nf));
     nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
 }
 
@@ -5572,13 +7661,29 @@ Discrete3Euler::~Discrete3Euler(){
     delete protein3;
 };
 
+Discrete3Euler::Discrete3Euler(const Discrete3Euler &o) : nSLDObj(o)
+{
+    protein1=NULL; protein2=NULL; protein3=NULL;
+    *this=o;
+};
+
+Discrete3Euler& Discrete3Euler::operator=(const Discrete3Euler &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(protein1,o.protein1); fnCopyGroup(protein2,o.protein2); fnCopyGroup(protein3,o.protein3);
+
+    }
+    return *this;
+};
+
 //Return value is area at position z
-double Discrete3Euler::fnGetArea(double dz) {
+mgreal Discrete3Euler::fnGetArea(mgreal dz) {
     return protein1->fnGetArea(dz)+protein2->fnGetArea(dz)+protein3->fnGetArea(dz);
 };
 
 //get nSLD from molecular subgroups
-double Discrete3Euler::fnGetnSLD(double dz) {
+mgreal Discrete3Euler::fnGetnSLD(mgreal dz) {
     if ((protein1->fnGetArea(dz)+protein2->fnGetArea(dz)+protein3->fnGetArea(dz)) > 0) {
         return (protein1->fnGetnSLD(dz)*protein1->fnGetArea(dz)+protein2->fnGetnSLD(dz)*protein2->fnGetArea(dz)+protein3->fnGetnSLD(dz)*protein3->fnGetArea(dz))/(protein1->fnGetArea(dz)+protein2->fnGetArea(dz)+protein3->fnGetArea(dz));
     }
@@ -5588,18 +7693,19 @@ double Discrete3Euler::fnGetnSLD(double dz) {
 };
 
 //Use limits of molecular subgroups
-double Discrete3Euler::fnGetLowerLimit() {
+mgreal Discrete3Euler::fnGetLowerLimit() {
     return fmin(protein1->fnGetLowerLimit(), fmin(protein2->fnGetLowerLimit(),protein3->fnGetLowerLimit()));
 }
-double Discrete3Euler::fnGetUpperLimit() {
+mgreal Discrete3Euler::fnGetUpperLimit() {
     return fmax(protein1->fnGetUpperLimit(), fmax(protein2->fnGetUpperLimit(),protein3->fnGetUpperLimit()));
 }
-double Discrete3Euler::fnGetVolume(double dz1, double dz2) {
+mgreal Discrete3Euler::fnGetVolume(mgreal dz1, mgreal dz2) {
     return protein1->fnGetVolume(dz1,dz2)+protein2->fnGetVolume(dz1,dz2)+protein3->fnGetVolume(dz1,dz2);
 };
 
-void Discrete3Euler::fnSet(double bulknsld, double protonexchangeratio, double dBeta1, double dGamma1, double dStartPosition1, double nf_protein1, double dBeta2, double dGamma2, double dStartPosition2, double nf_protein2, double dBeta3, double dGamma3, double dStartPosition3, double nf_protein3)
+void Discrete3Euler::fnSet(mgreal bulknsld, mgreal protonexchangeratio, mgreal dBeta1, mgreal dGamma1, mgreal dStartPosition1, mgreal nf_protein1, mgreal dBeta2, mgreal dGamma2, mgreal dStartPosition2, mgreal nf_protein2, mgreal dBeta3, mgreal dGamma3, mgreal dStartPosition3, mgreal nf_protein3)
 {
+    bDirty=true; iStateHash=0;
     protein1->dnSLDBulkSolvent=bulknsld;
     protein1->dProtExchange=protonexchangeratio;
     protein1->dBeta=dBeta1;
@@ -5620,32 +7726,43 @@ void Discrete3Euler::fnSet(double bulknsld, double protonexchangeratio, double d
     protein3->nf=nf_protein3;
 }
 
-void Discrete3Euler::fnSetSigma(double ds)
+void Discrete3Euler::fnSetSigma(mgreal ds)
 {
+    bDirty=true; iStateHash=0;
     protein1->fnSetSigma(ds);
     protein2->fnSetSigma(ds);
     protein3->fnSetSigma(ds);
 }
 
-void Discrete3Euler::fnSetNormarea(double dnormarea)
+void Discrete3Euler::fnSetBulknSLD(mgreal _bulknsld)
+{
+    bDirty=true; iStateHash=0;
+    protein1->fnSetBulknSLD(_bulknsld);
+    protein2->fnSetBulknSLD(_bulknsld);
+    protein3->fnSetBulknSLD(_bulknsld);
+}
+
+void Discrete3Euler::fnSetNormarea(mgreal dnormarea)
 {
+    bDirty=true; iStateHash=0;
     protein1->fnSetNormarea(dnormarea);
     protein2->fnSetNormarea(dnormarea);
     protein3->fnSetNormarea(dnormarea);
 };
 
-void Discrete3Euler::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void Discrete3Euler::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    fprintf(fp, "Discrete3Euler %s StartPosition1 %e Beta1 %g Gamma1 %g nf1 %g StartPosition2 %e Beta2 %g Gamma2 %g nf2 %g StartPosition3 %e Beta3 %g Gamma3 %g nf3 %g \n",cName, protein1->dStartPosition , protein1->dBeta, protein1->dGamma, protein1->nf, protein2->dStartPosition , protein2->dBeta, protein2->dGamma, protein2->nf, protein3->dStartPosition , protein3->dBeta, protein3->dGamma, protein3->nf);
+    fprintf(fp, "Discrete3Euler %s StartPosition1 %e Beta1 %g Gamma1 %g nf1 %g StartPosition2 %e Beta2 %g Gamma2 %g nf2 %g StartPosition3 %e Beta3 %g Gamma3 %g nf3 %g \n",cName, fnValue(protein1->dStartPosition), fnValue(protein1->dBeta), fnValue(protein1->dGamma), fnValue(protein1->nf), fnValue(protein2->dStartPosition), fnValue(protein2->dBeta), fnValue(protein2->dGamma), fnValue(protein2->nf), fnValue(protein3->dStartPosition), fnValue(protein3->dBeta), fnValue(protein3->dGamma), fnValue(protein3->nf));
     nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);
 };
 
 //---------------------------------------------------------------------------------------------------------
 //Freeform group 4 boxes
 //---------------------------------------------------------------------------------------------------------
-FreeBox::FreeBox(int n, double dstartposition, double dnSLD, double dnormarea)
+FreeBox::FreeBox(int n, mgreal dstartposition, mgreal dnSLD, mgreal dnormarea)
 {
     numberofboxes = n;
+    box1=NULL; box2=NULL; box3=NULL; box4=NULL; box5=NULL; box6=NULL; box7=NULL; box8=NULL; box9=NULL; box10=NULL;
 	startposition = dstartposition;
 	nSLD=dnSLD;
 	normarea=dnormarea;
@@ -5678,7 +7795,30 @@ FreeBox::~FreeBox(){
     if (numberofboxes>9) {delete box10;};
 };
 
+FreeBox::FreeBox(const FreeBox &o) : nSLDObj(o)
+{
+    box1=NULL; box2=NULL; box3=NULL; box4=NULL; box5=NULL; box6=NULL;
+    box7=NULL; box8=NULL; box9=NULL; box10=NULL;
+    *this=o;
+};
+
+FreeBox& FreeBox::operator=(const FreeBox &o)
+{
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        fnCopyGroup(box1,o.box1); fnCopyGroup(box2,o.box2); fnCopyGroup(box3,o.box3);
+        fnCopyGroup(box4,o.box4); fnCopyGroup(box5,o.box5); fnCopyGroup(box6,o.box6);
+        fnCopyGroup(box7,o.box7); fnCopyGroup(box8,o.box8); fnCopyGroup(box9,o.box9);
+        fnCopyGroup(box10,o.box10);
+        numberofboxes=o.numberofboxes; vf1=o.vf1; vf2=o.vf2; vf3=o.vf3; vf4=o.vf4; vf5=o.vf5;
+        vf6=o.vf6; vf7=o.vf7; vf8=o.vf8; vf9=o.vf9; vf10=o.vf10; normarea=o.normarea;
+        startposition=o.startposition; nSLD=o.nSLD;
+    }
+    return *this;
+};
+
 void FreeBox::fnAdjustParameters(){
+    bDirty=true; iStateHash=0;
 	if (numberofboxes>0) {
 		box1->z=startposition+0.5*box1->l;
 		box1->vol=box1->l*normarea*vf1;
@@ -5732,8 +7872,8 @@ void FreeBox::fnAdjustParameters(){
 };
 
 //Return value is area at position z
-double FreeBox::fnGetArea(double dz) {
-    double sum;
+mgreal FreeBox::fnGetArea(mgreal dz) {
+    mgreal sum;
     sum=0;
     if (numberofboxes>0) {sum=box1->fnGetArea(dz);};
     if (numberofboxes>1) {sum=sum+box2->fnGetArea(dz);};
@@ -5750,14 +7890,14 @@ double FreeBox::fnGetArea(double dz) {
 };
 
 //get nSLD from molecular subgroups
-double FreeBox::fnGetnSLD(double dz) {
+mgreal FreeBox::fnGetnSLD(mgreal dz) {
     //printf("nSLD %e \n", nSLD);
 	return nSLD;
 };
 
 //Use limits of molecular subgroups
-double FreeBox::fnGetLowerLimit() {return box1->fnGetLowerLimit();};
-double FreeBox::fnGetUpperLimit() {
+mgreal FreeBox::fnGetLowerLimit() {return box1->fnGetLowerLimit();};
+mgreal FreeBox::fnGetUpperLimit() {
     if (numberofboxes>9) {return box10->fnGetUpperLimit();}
     else if (numberofboxes>8) {return box9->fnGetUpperLimit();}
     else if (numberofboxes>7) {return box8->fnGetUpperLimit();}
@@ -5773,8 +7913,9 @@ double FreeBox::fnGetUpperLimit() {
     
 };
 
-void FreeBox::fnSetSigma(double sigma)
+void FreeBox::fnSetSigma(mgreal sigma)
 {
+    bDirty=true; iStateHash=0;
     if (numberofboxes>0) {box1->sigma1=sigma; box1->sigma2=sigma;};
     if (numberofboxes>1) {box2->sigma1=sigma; box2->sigma2=sigma;};
     if (numberofboxes>2) {box3->sigma1=sigma; box3->sigma2=sigma;};
@@ -5787,26 +7928,26 @@ void FreeBox::fnSetSigma(double sigma)
     if (numberofboxes>9) {box10->sigma1=sigma; box10->sigma2=sigma;};
 };
 
-void FreeBox::fnSetStartposition(double dz)
+void FreeBox::fnSetStartposition(mgreal dz)
 {
-    startposition=dz;
-	fnAdjustParameters();
+    fnUpdate(startposition,dz);
+	if ((bDirty==true) || (bCaching==false)) {fnAdjustParameters();}
 };
 
-void FreeBox::fnSetNormarea(double dnormarea)
+void FreeBox::fnSetNormarea(mgreal dnormarea)
 {
-    normarea=dnormarea;
-	fnAdjustParameters();
+    fnUpdate(normarea,dnormarea);
+	if ((bDirty==true) || (bCaching==false)) {fnAdjustParameters();}
 };
 
-void FreeBox::fnSetnSLD(double dnSLD)
+void FreeBox::fnSetnSLD(mgreal dnSLD)
 {
-    nSLD=dnSLD;
-	fnAdjustParameters();
+    fnUpdate(nSLD,dnSLD);
+	if ((bDirty==true) || (bCaching==false)) {fnAdjustParameters();}
 };
 
 
-void FreeBox::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void FreeBox::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
     //char *str = new char[80];
     
@@ -5823,7 +7964,13 @@ void FreeBox::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, doub
 //Hermite spline interpolation
 //---------------------------------------------------------------------------------------------------------
 
-Hermite::Hermite(int n, double dstartposition, double dnSLD, double dnormarea)
+Hermite::Hermite()
+{
+    numberofcontrolpoints=0;
+    dp=NULL; vf=NULL;
+};
+
+Hermite::Hermite(int n, mgreal dstartposition, mgreal dnSLD, mgreal dnormarea)
 {
     
     numberofcontrolpoints = n;
@@ -5835,23 +7982,52 @@ Hermite::Hermite(int n, double dstartposition, double dnSLD, double dnormarea)
     dampFWHM=0.0002;
     damptrigger=0.04;
     
-    dp     = new double[n];
-    vf     = new double[n];
-    damp   = new double[n];
+    dp     = new mgreal[n];
+    vf     = new mgreal[n];
 };
 
 Hermite::~Hermite(){
-    delete [] damp;
     delete [] dp;
     delete [] vf;
 };
 
-double Hermite::fnGetSplineArea(double dz, double dp[], double dh[], int damping=0) {
+Hermite::Hermite(const Hermite &o) : nSLDObj(o)
+{
+    numberofcontrolpoints=0;
+    dp=NULL; vf=NULL;
+    *this=o;
+};
+
+Hermite& Hermite::operator=(const Hermite &o)
+{
+    int i;
+    
+    if (this!=&o) {
+        nSLDObj::operator=(o);
+        if ((numberofcontrolpoints!=o.numberofcontrolpoints) || (dp==NULL)) {
+            delete [] dp; delete [] vf;
+            dp=NULL; vf=NULL;
+            if (o.dp!=NULL) {dp=new mgreal[o.numberofcontrolpoints];}
+            if (o.vf!=NULL) {vf=new mgreal[o.numberofcontrolpoints];}
+        }
+        for (i=0; i<o.numberofcontrolpoints; i++) {dp[i]=o.dp[i]; vf[i]=o.vf[i];}
+        numberofcontrolpoints=o.numberofcontrolpoints; monotonic=o.monotonic; damping=o.damping;
+        dampthreshold=o.dampthreshold; dampFWHM=o.dampFWHM; damptrigger=o.damptrigger;
+        normarea=o.normarea; nSLD=o.nSLD;
+    }
+    return *this;
+};
+
+mgreal Hermite::fnGetSplineArea(mgreal dz, mgreal dp[], mgreal dh[], int damping=0) {
     
-    double h00, h01, h10, h11, t, dd, t_2, t_3;
-    double p0, p1, m0, m1, dampfactor;
+    mgreal h00, h01, h10, h11, t, dd, t_2, t_3;
+    mgreal p0, p1, m0, m1, dampfactor, aDampLocal[MOLGROUPS_SPLINEPOINTS], *damp;
     int interval, i, peaked;
     
+    //the damped control points are evaluation scratch and kept off the object, which stays re-entrant
+    if (numberofcontrolpoints<=MOLGROUPS_SPLINEPOINTS) {damp=aDampLocal;}
+    else {damp=new mgreal[numberofcontrolpoints];}
+    
     peaked=0;
     dampfactor=1;
     for (i=0; i<numberofcontrolpoints; i++) {
@@ -5871,6 +8047,7 @@ double Hermite::fnGetSplineArea(double dz, double dp[], double dh[], int damping
     }
     
     interval=fnGetSplinePars(dz, dp, damp, m0, m1, p0, p1);
+    if (damp!=aDampLocal) {delete [] damp;}
 
     if ((interval>=0) && (interval<numberofcontrolpoints-1)) {
         
@@ -5897,10 +8074,10 @@ double Hermite::fnGetSplineArea(double dz, double dp[], double dh[], int damping
     }
 
 }
-double Hermite::fnGetSplineAntiDerivative(double dz, double dp[], double dh[]) {
+mgreal Hermite::fnGetSplineAntiDerivative(mgreal dz, mgreal dp[], mgreal dh[]) {
     
-    double h00, h01, h10, h11, t, dd, t_2, t_3, t_4;
-    double p0, p1, m0, m1;
+    mgreal h00, h01, h10, h11, t, dd, t_2, t_3, t_4;
+    mgreal p0, p1, m0, m1;
     int interval;
     
     interval=fnGetSplinePars(dz, dp, dh, m0, m1, p0, p1);
@@ -5926,10 +8103,10 @@ double Hermite::fnGetSplineAntiDerivative(double dz, double dp[], double dh[]) {
         return 0;
     }
 }
-int Hermite::fnGetSplinePars(double dz, double dp[], double dh[], double &m0, double &m1, double &p0, double &p1){
+int Hermite::fnGetSplinePars(mgreal dz, mgreal dp[], mgreal dh[], mgreal &m0, mgreal &m1, mgreal &p0, mgreal &p1){
     
-    double m2, km1, k0, k1, k2, tau;
-    double alpha0, beta0, alpha1, beta1;
+    mgreal m2, km1, k0, k1, k2, tau;
+    mgreal alpha0, beta0, alpha1, beta1;
     int    i, interval;
     
     interval=-1;
@@ -6036,9 +8213,9 @@ int Hermite::fnGetSplinePars(double dz, double dp[], double dh[], double &m0, do
         
 }
 
-double Hermite::fnGetSplineIntegral(double dz1, double dz2, double dp[], double dh[], int damping=0) {
+mgreal Hermite::fnGetSplineIntegral(mgreal dz1, mgreal dz2, mgreal dp[], mgreal dh[], int damping=0) {
     
-    double temp, integral, d;
+    mgreal temp, integral, d;
     
     /*printf("Single integral ... \n");
     for (i=0; i<numberofcontrolpoints; i++) {
@@ -6063,9 +8240,9 @@ double Hermite::fnGetSplineIntegral(double dz1, double dz2, double dp[], double
     return integral;
 }
 
-double Hermite::fnGetSplineProductIntegral(double dz1, double dz2, double dp[], double dh1[], double dh2[], int damping1=0, int damping2=0) {
+mgreal Hermite::fnGetSplineProductIntegral(mgreal dz1, mgreal dz2, mgreal dp[], mgreal dh1[], mgreal dh2[], int damping1=0, int damping2=0) {
     
-    double temp, integral, d;
+    mgreal temp, integral, d;
     
     /*printf("Double integral ... \n");
     for (i=0; i<numberofcontrolpoints; i++) {
@@ -6093,9 +8270,9 @@ double Hermite::fnGetSplineProductIntegral(double dz1, double dz2, double dp[],
 
 
 //Return value is area at position z
-double Hermite::fnGetArea(double dz)
+mgreal Hermite::fnGetArea(mgreal dz)
 {
-    double temp;
+    mgreal temp;
     
     temp=fnGetSplineArea(dz, dp, vf, damping)*normarea*nf;
     
@@ -6106,53 +8283,53 @@ double Hermite::fnGetArea(double dz)
         return 0;
     }
 };
-double Hermite::fnGetVolume(double dz1, double dz2)
+mgreal Hermite::fnGetVolume(mgreal dz1, mgreal dz2)
 {        
     return fnGetSplineIntegral(dz1, dz2, dp, vf, damping)*normarea*nf;
 };
 
 //get nSLD from molecular subgroups
-double Hermite::fnGetnSLD(double dz) {
+mgreal Hermite::fnGetnSLD(mgreal dz) {
     //printf("nSLD %e \n", nSLD);
 	return nSLD;
 };
 
 //Use limits of molecular subgroups
-double Hermite::fnGetLowerLimit() {return dp[0];};
-double Hermite::fnGetUpperLimit() {return dp[numberofcontrolpoints-1];}
+mgreal Hermite::fnGetLowerLimit() {return dp[0];};
+mgreal Hermite::fnGetUpperLimit() {return dp[numberofcontrolpoints-1];}
 
 
-void Hermite::fnSetNormarea(double dnormarea)
+void Hermite::fnSetNormarea(mgreal dnormarea)
 {
-    normarea=dnormarea;
+    fnUpdate(normarea,dnormarea);
 };
 
-void Hermite::fnSetRelative(double _spacing, double _start, double _dp[], double _vf[], double _nf)
+void Hermite::fnSetRelative(mgreal _spacing, mgreal _start, mgreal _dp[], mgreal _vf[], mgreal _nf)
 {
     int i;
     
     for (i=0; i<numberofcontrolpoints; i++) {
         if (_vf[i]<0)
         {
-            vf[i]=0;
+            fnUpdate(vf[i],0);
         }
         else {
-            vf[i]=_vf[i];
+            fnUpdate(vf[i],_vf[i]);
         }
-        dp[i]=_start+_spacing*double(i)+_dp[i];
-        nf=_nf;
+        fnUpdate(dp[i],_start+_spacing*double(i)+_dp[i]);
+        fnUpdate(nf,_nf);
     }    
 };
 
-void Hermite::fnSetnSLD(double dnSLD)
+void Hermite::fnSetnSLD(mgreal dnSLD)
 {
-    nSLD=dnSLD;
+    fnUpdate(nSLD,dnSLD);
 };
 
 
-void Hermite::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize)
+void Hermite::fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize)
 {
-    fprintf(fp, "Hermite %s numberofcontrolpoints %i normarea %e nf %e\n",cName, numberofcontrolpoints,normarea, nf);
+    fprintf(fp, "Hermite %s numberofcontrolpoints %i normarea %e nf %e\n",cName, numberofcontrolpoints,fnValue(normarea), fnValue(nf));
     nSLDObj::fnWriteData2File(fp, cName, dimension, stepsize);    
 }
 
@@ -6160,7 +8337,7 @@ void Hermite::fnWriteGroup2File(FILE *fp, const char *cName, int dimension, doub
 // SLDHermite
 // This Hermite spline also provides a spline nSLD profile
 //----------------------------------------------------------------------------------------------------------
-SLDHermite::SLDHermite(int n, double dstartposition, double dnormarea)
+SLDHermite::SLDHermite(int n, mgreal dstartposition, mgreal dnormarea)
 {
     
     numberofcontrolpoints = n;
@@ -6172,45 +8349,67 @@ SLDHermite::SLDHermite(int n, double dstartposition, double dnormarea)
     damptrigger=0.04;
     bTotalnSLD=0;                     //whether overal nSLD should be normalized to a particular value
     
-    dp     = new double[n];
-    vf     = new double[n];
-    sld    = new double[n];
-    damp   = new double[n];
+    dp     = new mgreal[n];
+    vf     = new mgreal[n];
+    sld    = new mgreal[n];
 };
 
 SLDHermite::~SLDHermite(){
     delete [] sld;
 };
-double SLDHermite::fnGetnSL(double dz1, double dz2) {
+
+SLDHermite::SLDHermite(const SLDHermite &o) : Hermite(o)
+{
+    sld=NULL;
+    *this=o;
+};
+
+SLDHermite& SLDHermite::operator=(const SLDHermite &o)
+{
+    int i;
+    
+    if (this!=&o) {
+        if ((numberofcontrolpoints!=o.numberofcontrolpoints) || (sld==NULL)) {
+            delete [] sld;
+            sld=NULL;
+            if (o.sld!=NULL) {sld=new mgreal[o.numberofcontrolpoints];}
+        }
+        Hermite::operator=(o);
+        for (i=0; i<o.numberofcontrolpoints; i++) {sld[i]=o.sld[i];}
+        totalnSLD=o.totalnSLD; bTotalnSLD=o.bTotalnSLD;
+    }
+    return *this;
+};
+mgreal SLDHermite::fnGetnSL(mgreal dz1, mgreal dz2) {
     //printf("dz1 %g dz2 %g nSL %g \n", dz1, dz2, fnGetSplineProductIntegral(dz1, dz2, dp, vf, sld, damping));
 
     return fnGetSplineProductIntegral(dz1, dz2, dp, vf, sld, damping, 0)*nf*normarea;
 };
 
-double SLDHermite::fnGetnSLD(double dz) {
+mgreal SLDHermite::fnGetnSLD(mgreal dz) {
     return fnGetSplineArea(dz, dp, sld);
 };
 
-double SLDHermite::fnGetnSLDIntegral(double dz1, double dz2)
+mgreal SLDHermite::fnGetnSLDIntegral(mgreal dz1, mgreal dz2)
 {
     return fnGetSplineIntegral(dz1, dz2, dp, sld);
 }
 
-void SLDHermite::fnSetRelative(double _spacing, double _start, double _dp[], double _vf[], double _sld[], double _nf)
+void SLDHermite::fnSetRelative(mgreal _spacing, mgreal _start, mgreal _dp[], mgreal _vf[], mgreal _sld[], mgreal _nf)
 {
     int i;
     
     for (i=0; i<numberofcontrolpoints; i++) {
-        vf[i]=fabs(_vf[i]);
-        dp[i]=_start+_spacing*double(i)+_dp[i];
-        sld[i]=_sld[i];
-        nf=_nf;
+        fnUpdate(vf[i],fabs(_vf[i]));
+        fnUpdate(dp[i],_start+_spacing*double(i)+_dp[i]);
+        fnUpdate(sld[i],_sld[i]);
+        fnUpdate(nf,_nf);
     }
     
 };
 
-void SLDHermite::fnSetTotalnSLD(double _totalnSLD) {
-    totalnSLD=_totalnSLD;
+void SLDHermite::fnSetTotalnSLD(mgreal _totalnSLD) {
+    fnUpdate(totalnSLD,_totalnSLD);
     bTotalnSLD=1;
 }
 
@@ -6344,6 +8543,22 @@ Monolayer_DOPS::~Monolayer_DOPS()
 {
     delete headgroup;
 }
+Monolayer_DOPS::Monolayer_DOPS(const Monolayer_DOPS &o) : Monolayer(o)
+{
+    headgroup=new PS(*(PS *)o.headgroup);
+}
+Monolayer_DOPS& Monolayer_DOPS::operator=(const Monolayer_DOPS &o)
+{
+    nSLDObj *pHeadgroup;
+    
+    if (this!=&o) {
+        pHeadgroup=headgroup;
+        Monolayer::operator=(o);
+        headgroup=pHeadgroup;
+        *(PS *)headgroup=*(PS *)o.headgroup;
+    }
+    return *this;
+}
 Monolayer_DOPS_xray::Monolayer_DOPS_xray()
 {
     
@@ -6376,6 +8591,22 @@ Monolayer_DPPS::~Monolayer_DPPS()
 {
     delete headgroup;
 }
+Monolayer_DPPS::Monolayer_DPPS(const Monolayer_DPPS &o) : Monolayer(o)
+{
+    headgroup=new PS(*(PS *)o.headgroup);
+}
+Monolayer_DPPS& Monolayer_DPPS::operator=(const Monolayer_DPPS &o)
+{
+    nSLDObj *pHeadgroup;
+    
+    if (this!=&o) {
+        pHeadgroup=headgroup;
+        Monolayer::operator=(o);
+        headgroup=pHeadgroup;
+        *(PS *)headgroup=*(PS *)o.headgroup;
+    }
+    return *this;
+}
 Monolayer_DPPS_xray::Monolayer_DPPS_xray()
 {
     fnSetnSL(5.07E-4,6.81E-3,1.885e-3,1.33E-3,1.323E-3);
@@ -6597,41 +8828,144 @@ ssBLM_DOPC_DPPC::ssBLM_DOPC_DPPC()
 }
 
 
-ssBLM_DPPC_d62DPPC::ssBLM_DPPC_d62DPPC()
+ssBLM_DPPC_d62DPPC::ssBLM_DPPC_d62DPPC()
+{
+    volacyllipid=789;
+    nslacyllipid=-3.2477E-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    
+    headgroup1_2->vol=335;                //PS volume and length are estimates
+    headgroup2_2->vol=335;
+    headgroup1_2->nSL=6.0063E-4;
+    headgroup2_2->nSL=6.0063E-4;
+    headgroup1_2->l=9.56;
+    headgroup2_2->l=9.56;
+    
+    volacyllipid_2=789;
+    nslacyllipid_2=6.1304E-3;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=5.3322e-4;
+    
+    fnAdjustParameters();
+}
+
+
+ssBLM_POPC_POPS_PIP_chol::ssBLM_POPC_POPS_PIP_chol()
+{
+    volacyllipid=925;
+    nslacyllipid=-2.6688e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	
+    volacyllipid_2=1025;
+    nslacyllipid_2=-7.5785e-5;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    headgroup1_2->vol=280;                //PS volume and length are estimates
+	headgroup2_2->vol=280;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup1_2->l=8.1;
+	headgroup2_2->l=8.1;
+	
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    fnAdjustParameters();
+    
+}
+
+ssBLM_DOPC_DOPS_PIP_chol::ssBLM_DOPC_DOPS_PIP_chol()
+{
+    volacyllipid=972.00;
+    nslacyllipid=-2.0874E-04;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	
+    volacyllipid_2=972.00;
+    nslacyllipid_2=-2.0874E-04;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    headgroup1_2->vol=280;                //PS volume and length are estimates
+	headgroup2_2->vol=280;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup1_2->l=8.1;
+	headgroup2_2->l=8.1;
+	
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    fnAdjustParameters();
+    
+}
+
+
+ssBLM_2sub_POPC_POPS_PIP_chol::ssBLM_2sub_POPC_POPS_PIP_chol()
 {
-    volacyllipid=789;
-    nslacyllipid=-3.2477E-4;
+    volacyllipid=925;
+    nslacyllipid=-2.6688e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     
-    headgroup1_2->vol=335;                //PS volume and length are estimates
-    headgroup2_2->vol=335;
-    headgroup1_2->nSL=6.0063E-4;
-    headgroup2_2->nSL=6.0063E-4;
-    headgroup1_2->l=9.56;
-    headgroup2_2->l=9.56;
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	
+    volacyllipid_2=1025;
+    nslacyllipid_2=-7.5785e-5;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
     
-    volacyllipid_2=789;
-    nslacyllipid_2=6.1304E-3;
+    headgroup1_2->vol=280;                //PS volume and length are estimates
+	headgroup2_2->vol=280;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup1_2->l=8.1;
+	headgroup2_2->l=8.1;
+	
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
-    nslmethyllipid_2=5.3322e-4;
+    nslmethyllipid_2=-9.15e-5;
     
     fnAdjustParameters();
+    
 }
 
-
-ssBLM_POPC_POPS_PIP_chol::ssBLM_POPC_POPS_PIP_chol()
+hybridBLM_POPC_POPS_PIP_chol::hybridBLM_POPC_POPS_PIP_chol()
 {
     volacyllipid=925;
     nslacyllipid=-2.6688e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
 	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
 	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
 	headgroup2_3->l=12.0;
 	
     volacyllipid_2=1025;
@@ -6639,11 +8973,8 @@ ssBLM_POPC_POPS_PIP_chol::ssBLM_POPC_POPS_PIP_chol()
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    headgroup1_2->vol=280;                //PS volume and length are estimates
 	headgroup2_2->vol=280;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
 	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=8.1;
 	headgroup2_2->l=8.1;
 	
     volacyllipid_2=925;
@@ -6655,18 +8986,15 @@ ssBLM_POPC_POPS_PIP_chol::ssBLM_POPC_POPS_PIP_chol()
     
 }
 
-ssBLM_DOPC_DOPS_PIP_chol::ssBLM_DOPC_DOPS_PIP_chol()
+hybridBLM_DOPC_DOPS_PIP_chol::hybridBLM_DOPC_DOPS_PIP_chol()
 {
     volacyllipid=972.00;
     nslacyllipid=-2.0874E-04;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
 	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
 	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
 	headgroup2_3->l=12.0;
 	
     volacyllipid_2=972.00;
@@ -6674,11 +9002,8 @@ ssBLM_DOPC_DOPS_PIP_chol::ssBLM_DOPC_DOPS_PIP_chol()
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    headgroup1_2->vol=280;                //PS volume and length are estimates
 	headgroup2_2->vol=280;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
 	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=8.1;
 	headgroup2_2->l=8.1;
 	
     volacyllipid_2=925;
@@ -6691,26 +9016,209 @@ ssBLM_DOPC_DOPS_PIP_chol::ssBLM_DOPC_DOPS_PIP_chol()
 }
 
 
-ssBLM_2sub_POPC_POPS_PIP_chol::ssBLM_2sub_POPC_POPS_PIP_chol()
+tBLM_HC18_DOPC::tBLM_HC18_DOPC()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_HC18_d54DMPC::tBLM_HC18_d54DMPC()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=770;
+    nslacyllipid=5.3324E-03;
+    volmethyllipid=98.8;
+    nslmethyllipid=5.334e-4;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_HC18_d31POPC::tBLM_HC18_d31POPC()
 {
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
     volacyllipid=925;
-    nslacyllipid=-2.6688e-4;
+    nslacyllipid=2.9618E-03;
+    volmethyllipid=98.8;
+    nslmethyllipid=2.2087e-4;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_WC14_DPPC::tBLM_WC14_DPPC()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=789;
+    nslacyllipid=-3.2477E-04;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
     
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
-	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
-	headgroup2_3->l=12.0;
+    fnAdjustParameters();
+    
+}
+tBLM_WC14_DOPC::tBLM_WC14_DOPC()
+{
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
+    
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_WC14_DPhyPC::tBLM_WC14_DPhyPC()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid_2=1025;
-    nslacyllipid_2=-7.5785e-5;
+    volacyllipid=1095.00;
+    nslacyllipid=-3.9174E-04;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
+    
+    fnAdjustParameters();
+    
+}
+
+
+tBLM_HC18_POPC_POPA::tBLM_HC18_POPC_POPA()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+	headgroup1_2->vol=174;                //was 174
+	headgroup2_2->vol=174;                //was 174
+	headgroup1_2->nSL=6.2364e-4;          //was 6.2364e-4
+	headgroup2_2->nSL=6.2364e-4;          //was 6.2364e-4
+	headgroup1_2->l=5;
+	headgroup2_2->l=5;
+	
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_HC18_POPC_POPG::tBLM_HC18_POPC_POPG()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+	
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    
+	headgroup1_2->vol=270;                //PG volume and length are estimates
+	headgroup2_2->vol=270;
+	headgroup1_2->nSL=7.1472e-4;
+	headgroup2_2->nSL=7.1472e-4;
+	headgroup1_2->l=7.8;
+	headgroup2_2->l=7.8;
+	
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    headgroup1_2->vol=280;                //PS volume and length are estimates
+    fnAdjustParameters();
+    
+}
+tBLM_HC18_POPC_POPS::tBLM_HC18_POPC_POPS()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+	headgroup1_2->vol=280;                //PS volume and length are estimates
 	headgroup2_2->vol=280;
 	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
 	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
@@ -6725,67 +9233,130 @@ ssBLM_2sub_POPC_POPS_PIP_chol::ssBLM_2sub_POPC_POPS_PIP_chol()
     fnAdjustParameters();
     
 }
-
-hybridBLM_POPC_POPS_PIP_chol::hybridBLM_POPC_POPS_PIP_chol()
+tBLM_HC18_d31POPC_POPS::tBLM_HC18_d31POPC_POPS()
 {
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
     volacyllipid=925;
-    nslacyllipid=-2.6688e-4;
+    nslacyllipid=2.9618E-03;
     volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
+    nslmethyllipid=2.2087e-4;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-	headgroup2_3->vol=500;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup2_3->l=12.0;
-	
-    volacyllipid_2=1025;
-    nslacyllipid_2=-7.5785e-5;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    headgroup1_2->vol=280;                //PS volume and length are estimates
+    headgroup2_2->vol=280;
+    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup1_2->l=8.1;
+    headgroup2_2->l=8.1;
     
-	headgroup2_2->vol=280;
-	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->l=8.1;
-	
     volacyllipid_2=925;
     nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    fnAdjustParameters();
-    
+    fnAdjustParameters();    
 }
-
-hybridBLM_DOPC_DOPS_PIP_chol::hybridBLM_DOPC_DOPS_PIP_chol()
+tBLM_HC18_DOPC_DOPG::tBLM_HC18_DOPC_DOPG()
 {
-    volacyllipid=972.00;
-    nslacyllipid=-2.0874E-04;
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-	headgroup2_3->vol=500;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup2_3->l=12.0;
-	
-    volacyllipid_2=972.00;
-    nslacyllipid_2=-2.0874E-04;
+    headgroup1_2->vol=270;                //PG volume and length are estimates
+    headgroup2_2->vol=270;
+    headgroup1_2->nSL=7.1472e-4;
+    headgroup2_2->nSL=7.1472e-4;
+    headgroup1_2->l=7.8;
+    headgroup2_2->l=7.8;
+    
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-	headgroup2_2->vol=280;
+    fnAdjustParameters();
+}
+tBLM_HC18_DOPC_DOPS::tBLM_HC18_DOPC_DOPS()
+{
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+	headgroup1_2->vol=260;                //PS volume and length are estimates
+	headgroup2_2->vol=260;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
 	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->l=8.1;
+	headgroup1_2->l=7.5;
+	headgroup2_2->l=7.5;
 	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
     fnAdjustParameters();
     
+}
+tBLM_HC18_DOPC_LPSshort::tBLM_HC18_DOPC_LPSshort()
+{
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    headgroup1_2->vol=900;                //PS volume and length are estimates
+    headgroup2_2->vol=900;
+    headgroup1_2->fnSetnSL(2.4384E-03,2.4384E-03);
+    headgroup2_2->fnSetnSL(2.4384E-03,2.4384E-03);
+    headgroup1_2->l=11;
+    headgroup2_2->l=11;
+    
+    volacyllipid_2=1968.00;
+    nslacyllipid_2=-7.9101E-04;
+    volmethyllipid_2=98.8*3;
+    nslmethyllipid_2=-9.15e-5*3;
+    
+    fnAdjustParameters();
+    
 }
 
-
-tBLM_HC18_DOPC::tBLM_HC18_DOPC()
+tBLM_HC18_DOPC_DGSNTA::tBLM_HC18_DOPC_DGSNTA()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
@@ -6801,59 +9372,128 @@ tBLM_HC18_DOPC::tBLM_HC18_DOPC()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
+	headgroup1_2->vol=700;                //NTA volume and length are estimates
+	headgroup2_2->vol=700;
+	headgroup1_2->nSL=1.4128E-03;
+	headgroup2_2->nSL=1.4128E-03;
+	headgroup1_2->l=9.56;
+	headgroup2_2->l=11.;
+	
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
     fnAdjustParameters();
     
 }
 
-tBLM_HC18_d54DMPC::tBLM_HC18_d54DMPC()
+
+tBLM_HC18_DOPC_d54DMPC::tBLM_HC18_DOPC_d54DMPC()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=770;
-    nslacyllipid=5.3324E-03;
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
-    nslmethyllipid=5.334e-4;
+    nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
+	headgroup1_2->vol=330;       
+	headgroup2_2->vol=330;       
+	headgroup1_2->nSL=6.0012e-4; 
+	headgroup2_2->nSL=6.0012e-4; 
+	headgroup1_2->l=9.5;
+	headgroup2_2->l=9.5;
+	
+    volacyllipid_2=770;
+    nslacyllipid_2=5.3324E-03;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=5.334e-4;
+    
     fnAdjustParameters();
     
 }
 
-tBLM_HC18_d31POPC::tBLM_HC18_d31POPC()
+tBLM_HC18_DMPC_d54DMPC::tBLM_HC18_DMPC_d54DMPC()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=925;
-    nslacyllipid=2.9618E-03;
+    volacyllipid=770;
+    nslacyllipid=-2.9166E-04;
     volmethyllipid=98.8;
-    nslmethyllipid=2.2087e-4;
+    nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
+	headgroup1_2->vol=330;       
+	headgroup2_2->vol=330;       
+	headgroup1_2->nSL=6.0012e-4; 
+	headgroup2_2->nSL=6.0012e-4; 
+	headgroup1_2->l=9.5;
+	headgroup2_2->l=9.5;
+	
+    volacyllipid_2=770;
+    nslacyllipid_2=5.3324E-03;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=5.334e-4;
+    
     fnAdjustParameters();
     
 }
 
-tBLM_WC14_DPPC::tBLM_WC14_DPPC()
+tBLM_WC14_DMPC_DMPG::tBLM_WC14_DMPC_DMPG()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=789;
-    nslacyllipid=-3.2477E-04;
+    volacyllipid=770;
+    nslacyllipid=-2.9166E-04;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
+    
+	headgroup1_2->vol=330;
+	headgroup1_2->nSL=6.0012e-4;
+	headgroup1_2->l=9.5;
+	headgroup2_2->vol=270;
+	headgroup2_2->nSL=7.1472e-4;
+	headgroup2_2->l=7.8;
+	
+    volacyllipid_2=770;
+    nslacyllipid_2=-2.9166E-04;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    fnAdjustParameters();
+    
+}
+
+tBLM_WC14_DMPC_DMPG_d54DMPC::tBLM_WC14_DMPC_DMPG_d54DMPC()
+{
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=770;
+    nslacyllipid=-2.9166E-04;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
@@ -6861,18 +9501,43 @@ tBLM_WC14_DPPC::tBLM_WC14_DPPC()
     volacyltether=850;
     nslacyltether=-3.5834e-4;
     
+    headgroup1_2->vol=270;
+    headgroup1_2->nSL=7.1472e-4;
+    headgroup1_2->l=7.8;
+    headgroup2_2->vol=270;
+    headgroup2_2->nSL=7.1472e-4;
+    headgroup2_2->l=7.8;
+    
+    headgroup1_3->vol=335;
+    headgroup1_3->nSL=6.0063E-04;
+    headgroup1_3->l=9.5;
+    headgroup2_3->vol=335;
+    headgroup2_3->nSL=6.0063E-04;
+    headgroup2_3->l=9.5;
+    
+    volacyllipid_2=770;
+    nslacyllipid_2=-2.9166E-04;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    volacyllipid_3=770;
+    nslacyllipid_3=5.3324E-03;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=5.334e-4;
+
+    
     fnAdjustParameters();
-    
 }
-tBLM_WC14_DOPC::tBLM_WC14_DOPC()
+
+tBLM_WC14_DMPC_DMPG_d54DMPC_2leaflet::tBLM_WC14_DMPC_DMPG_d54DMPC_2leaflet()
 {
     tether->vol=380;
     tether->nSL=2.1864e-4;
     tetherg->vol=110;
     tetherg->nSL=1.8654e-4;
     
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
+    volacyllipid=770;
+    nslacyllipid=-2.9166E-04;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
@@ -6880,22 +9545,42 @@ tBLM_WC14_DOPC::tBLM_WC14_DOPC()
     volacyltether=850;
     nslacyltether=-3.5834e-4;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    headgroup1_2->vol=270;
+    headgroup1_2->nSL=7.1472e-4;
+    headgroup1_2->l=7.8;
+    headgroup2_2->vol=270;
+    headgroup2_2->nSL=7.1472e-4;
+    headgroup2_2->l=7.8;
     
-    fnAdjustParameters();
+    headgroup1_3->vol=335;
+    headgroup1_3->nSL=6.0063E-04;
+    headgroup1_3->l=9.5;
+    headgroup2_3->vol=335;
+    headgroup2_3->nSL=6.0063E-04;
+    headgroup2_3->l=9.5;
+    
+    volacyllipid_2=770;
+    nslacyllipid_2=-2.9166E-04;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    volacyllipid_3=770;
+    nslacyllipid_3=5.3324E-03;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=5.334e-4;
     
+    fnAdjustParameters();
 }
 
-tBLM_WC14_DPhyPC::tBLM_WC14_DPhyPC()
+tBLM_WC14_DOPC_DOPS::tBLM_WC14_DOPC_DOPS()
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=1095.00;
-    nslacyllipid=-3.9174E-04;
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
@@ -6903,36 +9588,47 @@ tBLM_WC14_DPhyPC::tBLM_WC14_DPhyPC()
     volacyltether=850;
     nslacyltether=-3.5834e-4;
     
+    headgroup1_2->vol=260;                //PS volume and length are estimates
+    headgroup2_2->vol=260;
+    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup1_2->l=7.5;
+    headgroup2_2->l=7.5;
+    
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
     fnAdjustParameters();
     
 }
 
-
-tBLM_HC18_POPC_POPA::tBLM_HC18_POPC_POPA()
+tBLM_WC14_DOPC_PIP::tBLM_WC14_DOPC_PIP()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
     
-	headgroup1_2->vol=174;                //was 174
-	headgroup2_2->vol=174;                //was 174
-	headgroup1_2->nSL=6.2364e-4;          //was 6.2364e-4
-	headgroup2_2->nSL=6.2364e-4;          //was 6.2364e-4
-	headgroup1_2->l=5;
-	headgroup2_2->l=5;
+	headgroup1_2->vol=500;                //PIP volume and length are estimates
+	headgroup2_2->vol=500;
+	headgroup1_2->nSL=1.22e-3;
+	headgroup2_2->nSL=1.22e-3;
+	headgroup1_2->l=12.0;
+	headgroup2_2->l=12.0;
 	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
+    volacyllipid_2=1025;
+    nslacyllipid_2=-7.5785e-5;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
@@ -6940,46 +9636,47 @@ tBLM_HC18_POPC_POPA::tBLM_HC18_POPC_POPA()
     
 }
 
-tBLM_HC18_POPC_POPG::tBLM_HC18_POPC_POPG()
+tBLM_HC18_DOPC_PIP::tBLM_HC18_DOPC_PIP()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
+	
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
     volacyltether=999;
     nslacyltether=-2.25e-4;
-	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
     
-	headgroup1_2->vol=270;                //PG volume and length are estimates
-	headgroup2_2->vol=270;
-	headgroup1_2->nSL=7.1472e-4;
-	headgroup2_2->nSL=7.1472e-4;
-	headgroup1_2->l=7.8;
-	headgroup2_2->l=7.8;
+	headgroup1_2->vol=500;                //PS volume and length are estimates
+	headgroup2_2->vol=500;
+	headgroup1_2->nSL=1.22e-3;
+	headgroup2_2->nSL=1.22e-3;
+	headgroup1_2->l=12.0;
+	headgroup2_2->l=12.0;
 	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
+    volacyllipid_2=1025;
+    nslacyllipid_2=-7.5785e-5;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
     fnAdjustParameters();
     
 }
-tBLM_HC18_POPC_POPS::tBLM_HC18_POPC_POPS()
+
+tBLM_HC18_DOPC_DOPS_PIP::tBLM_HC18_DOPC_DOPS_PIP()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
@@ -6994,51 +9691,34 @@ tBLM_HC18_POPC_POPS::tBLM_HC18_POPC_POPS()
 	headgroup1_2->l=8.1;
 	headgroup2_2->l=8.1;
 	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    fnAdjustParameters();
-    
-}
-tBLM_HC18_d31POPC_POPS::tBLM_HC18_d31POPC_POPS()
-{
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
-    
-    volacyllipid=925;
-    nslacyllipid=2.9618E-03;
-    volmethyllipid=98.8;
-    nslmethyllipid=2.2087e-4;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
-    
-    headgroup1_2->vol=280;                //PS volume and length are estimates
-    headgroup2_2->vol=280;
-    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup1_2->l=8.1;
-    headgroup2_2->l=8.1;
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	
+    volacyllipid_3=1025;
+    nslacyllipid_3=-7.5785e-5;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    fnAdjustParameters();
     
-    fnAdjustParameters();    
 }
-tBLM_HC18_DOPC_DOPG::tBLM_HC18_DOPC_DOPG()
+
+tBLM_HC18_DOPC_DOPS_PI::tBLM_HC18_DOPC_DOPS_PI()
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
-    
+	tether->vol=380;
+	tether->nSL=2.1864e-4;
+	tetherg->vol=110;
+	tetherg->nSL=1.8654e-4;
+	
     volacyllipid=972;
     nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
@@ -7048,21 +9728,35 @@ tBLM_HC18_DOPC_DOPG::tBLM_HC18_DOPC_DOPG()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
-    headgroup1_2->vol=270;                //PG volume and length are estimates
-    headgroup2_2->vol=270;
-    headgroup1_2->nSL=7.1472e-4;
-    headgroup2_2->nSL=7.1472e-4;
-    headgroup1_2->l=7.8;
-    headgroup2_2->l=7.8;
-    
+	headgroup1_2->vol=280;                //PS volume and length are estimates
+	headgroup2_2->vol=280;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup1_2->l=8.1;
+	headgroup2_2->l=8.1;
+	
     volacyllipid_2=972;
     nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
+	headgroup1_3->vol=370;                //PIP volume and length are from bulk
+	headgroup2_3->vol=370;
+	headgroup1_3->fnSetnSL(9.9672e-4,1.5175E-03);
+	headgroup2_3->fnSetnSL(9.9672e-4,1.5175E-03);
+	headgroup1_3->l=10.7;
+	headgroup2_3->l=10.7;
+	
+    volacyllipid_3=1025;
+    nslacyllipid_3=-7.5785e-5;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
+    
     fnAdjustParameters();
+    
 }
-tBLM_HC18_DOPC_DOPS::tBLM_HC18_DOPC_DOPS()
+
+tBLM_WC14_DOPC_DOPS_CHOL::tBLM_WC14_DOPC_DOPS_CHOL()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
@@ -7075,8 +9769,8 @@ tBLM_HC18_DOPC_DOPS::tBLM_HC18_DOPC_DOPS()
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
     
 	headgroup1_2->vol=260;                //PS volume and length are estimates
 	headgroup2_2->vol=260;
@@ -7089,43 +9783,15 @@ tBLM_HC18_DOPC_DOPS::tBLM_HC18_DOPC_DOPS()
     nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
-    
-    fnAdjustParameters();
-    
-}
-tBLM_HC18_DOPC_LPSshort::tBLM_HC18_DOPC_LPSshort()
-{
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
-    
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
-    
-    headgroup1_2->vol=900;                //PS volume and length are estimates
-    headgroup2_2->vol=900;
-    headgroup1_2->fnSetnSL(2.4384E-03,2.4384E-03);
-    headgroup2_2->fnSetnSL(2.4384E-03,2.4384E-03);
-    headgroup1_2->l=11;
-    headgroup2_2->l=11;
-    
-    volacyllipid_2=1968.00;
-    nslacyllipid_2=-7.9101E-04;
-    volmethyllipid_2=98.8*3;
-    nslmethyllipid_2=-9.15e-5*3;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
     
     fnAdjustParameters();
     
 }
 
-tBLM_HC18_DOPC_DGSNTA::tBLM_HC18_DOPC_DGSNTA()
+tBLM_HC18_DOPC_DOPS_CHOL::tBLM_HC18_DOPC_DOPS_CHOL()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
@@ -7141,207 +9807,331 @@ tBLM_HC18_DOPC_DGSNTA::tBLM_HC18_DOPC_DGSNTA()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
-	headgroup1_2->vol=700;                //NTA volume and length are estimates
-	headgroup2_2->vol=700;
-	headgroup1_2->nSL=1.4128E-03;
-	headgroup2_2->nSL=1.4128E-03;
-	headgroup1_2->l=9.56;
-	headgroup2_2->l=11.;
+	headgroup1_2->vol=260;                //PS volume and length are estimates
+	headgroup2_2->vol=260;
+	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+	headgroup1_2->l=7.5;
+	headgroup2_2->l=7.5;
 	
     volacyllipid_2=972;
     nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
     
     fnAdjustParameters();
     
 }
 
-
-tBLM_HC18_DOPC_d54DMPC::tBLM_HC18_DOPC_d54DMPC()
+tBLM_HC18_POPC_POPG_CHOL::tBLM_HC18_POPC_POPG_CHOL()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
     volacyltether=999;
     nslacyltether=-2.25e-4;
+	
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
     
-	headgroup1_2->vol=330;       
-	headgroup2_2->vol=330;       
-	headgroup1_2->nSL=6.0012e-4; 
-	headgroup2_2->nSL=6.0012e-4; 
-	headgroup1_2->l=9.5;
-	headgroup2_2->l=9.5;
+	headgroup1_2->vol=270;                //PG volume and length are estimates
+	headgroup2_2->vol=270;
+	headgroup1_2->nSL=7.1472e-4;
+	headgroup2_2->nSL=7.1472e-4;
+	headgroup1_2->l=7.8;
+	headgroup2_2->l=7.8;
 	
-    volacyllipid_2=770;
-    nslacyllipid_2=5.3324E-03;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
-    nslmethyllipid_2=5.334e-4;
+    nslmethyllipid_2=-9.15e-5;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
     
     fnAdjustParameters();
     
 }
-
-tBLM_HC18_DMPC_d54DMPC::tBLM_HC18_DMPC_d54DMPC()
+tBLM_HC18_POPC_POPE_CHOL::tBLM_HC18_POPC_POPE_CHOL()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=770;
-    nslacyllipid=-2.9166E-04;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
     volacyltether=999;
     nslacyltether=-2.25e-4;
+	
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
     
-	headgroup1_2->vol=330;       
-	headgroup2_2->vol=330;       
-	headgroup1_2->nSL=6.0012e-4; 
-	headgroup2_2->nSL=6.0012e-4; 
-	headgroup1_2->l=9.5;
-	headgroup2_2->l=9.5;
+	headgroup1_2->vol=262;                //PE volume and length are estimates
+	headgroup2_2->vol=262;
+	headgroup1_2->nSL=5.4558E-04;
+	headgroup2_2->nSL=5.4558E-04;
+	headgroup1_2->l=7.7;
+	headgroup2_2->l=7.7;
 	
-    volacyllipid_2=770;
-    nslacyllipid_2=5.3324E-03;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
-    nslmethyllipid_2=5.334e-4;
+    nslmethyllipid_2=-9.15e-5;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
     
     fnAdjustParameters();
     
 }
 
-tBLM_WC14_DMPC_DMPG::tBLM_WC14_DMPC_DMPG()
+
+tBLM_HC18_DOPC_DOPS_PIP_CHOL::tBLM_HC18_DOPC_DOPS_PIP_CHOL()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=770;
-    nslacyllipid=-2.9166E-04;
+    volacyllipid=972;
+    nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-	headgroup1_2->vol=330;
-	headgroup1_2->nSL=6.0012e-4;
-	headgroup1_2->l=9.5;
-	headgroup2_2->vol=270;
-	headgroup2_2->nSL=7.1472e-4;
-	headgroup2_2->l=7.8;
+	headgroup1_2->vol=260;                //PS volume and length are estimates
+	headgroup2_2->vol=260;
+	headgroup1_2->nSL=8.4513e-4;
+	headgroup2_2->nSL=8.4513e-4;
+	headgroup1_2->l=7.5;
+	headgroup2_2->l=7.5;
 	
-    volacyllipid_2=770;
-    nslacyllipid_2=-2.9166E-04;
+    volacyllipid_2=972;
+    nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
+	
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	
+    volacyllipid_3=1025;
+    nslacyllipid_3=-7.5785e-5;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
     
     fnAdjustParameters();
     
 }
 
-tBLM_WC14_DMPC_DMPG_d54DMPC::tBLM_WC14_DMPC_DMPG_d54DMPC()
+tBLM_HC18_POPC_POPS_PIP_CHOL::tBLM_HC18_POPC_POPS_PIP_CHOL()
 {
     tether->vol=380;
     tether->nSL=2.1864e-4;
     tetherg->vol=110;
     tetherg->nSL=1.8654e-4;
     
-    volacyllipid=770;
-    nslacyllipid=-2.9166E-04;
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-    headgroup1_2->vol=270;
-    headgroup1_2->nSL=7.1472e-4;
-    headgroup1_2->l=7.8;
+    headgroup1_2->vol=260;                //PS volume and length are estimates
+    headgroup2_2->vol=260;
+    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup1_2->l=7.5;
+    headgroup2_2->l=7.5;
+    
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
+    
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=500;                //PIP volume and length are estimates
+    headgroup2_3->vol=500;
+    headgroup1_3->nSL=1.22e-3;
+    headgroup2_3->nSL=1.22e-3;
+    headgroup1_3->l=12.0;
+    headgroup2_3->l=12.0;
+    
+    volacyllipid_3=1025;
+    nslacyllipid_3=-7.5785e-5;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
+    
+    fnAdjustParameters();
+    
+}
+tBLM_HC18_POPC_POPG_Cardiolipin18T1_CHOL::tBLM_HC18_POPC_POPG_Cardiolipin18T1_CHOL()
+{
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    headgroup1_2->vol=270;                //PG volume and length are estimates
     headgroup2_2->vol=270;
+    headgroup1_2->nSL=7.1472e-4;
     headgroup2_2->nSL=7.1472e-4;
+    headgroup1_2->l=7.8;
     headgroup2_2->l=7.8;
     
-    headgroup1_3->vol=335;
-    headgroup1_3->nSL=6.0063E-04;
-    headgroup1_3->l=9.5;
-    headgroup2_3->vol=335;
-    headgroup2_3->nSL=6.0063E-04;
-    headgroup2_3->l=9.5;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
+    volmethyllipid_2=98.8;
+    nslmethyllipid_2=-9.15e-5;
     
-    volacyllipid_2=770;
-    nslacyllipid_2=-2.9166E-04;
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=684.40;                //cardiolipin
+    headgroup2_3->vol=684.40;
+    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup1_3->l=9.56;
+    headgroup2_3->l=9.56;
+    
+    volacyllipid_3=972*2;
+    nslacyllipid_3=-2.09e-4*2;
+    volmethyllipid_3=98.8*2;
+    nslmethyllipid_3=-9.15e-5*2;
+    
+    fnAdjustParameters();
+    
+}
+tBLM_HC18_POPC_POPE_Cardiolipin18T1_CHOL::tBLM_HC18_POPC_POPE_Cardiolipin18T1_CHOL()
+{
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
+    volmethyllipid=98.8;
+    nslmethyllipid=-9.15e-5;
+    volmethyltether=98.8;
+    nslmethyltether=-9.15e-5;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
+    
+    headgroup1_2->vol=262;                //PE volume and length are estimates
+    headgroup2_2->vol=262;
+    headgroup1_2->nSL=5.4558E-04;
+    headgroup2_2->nSL=5.4558E-04;
+    headgroup1_2->l=7.7;
+    headgroup2_2->l=7.7;
+    
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    volacyllipid_3=770;
-    nslacyllipid_3=5.3324E-03;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=5.334e-4;
-
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=684.40;                //cardiolipin
+    headgroup2_3->vol=684.40;
+    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup1_3->l=9.56;
+    headgroup2_3->l=9.56;
+    
+    volacyllipid_3=972*2;
+    nslacyllipid_3=-2.09e-4*2;
+    volmethyllipid_3=98.8*2;
+    nslmethyllipid_3=-9.15e-5*2;
     
     fnAdjustParameters();
+    
 }
 
-tBLM_WC14_DMPC_DMPG_d54DMPC_2leaflet::tBLM_WC14_DMPC_DMPG_d54DMPC_2leaflet()
+tBLM_HC18_POPC_POPE_KDO2_CHOL::tBLM_HC18_POPC_POPE_KDO2_CHOL()
 {
     tether->vol=380;
     tether->nSL=2.1864e-4;
     tetherg->vol=110;
     tetherg->nSL=1.8654e-4;
     
-    volacyllipid=770;
-    nslacyllipid=-2.9166E-04;
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
-    
-    headgroup1_2->vol=270;
-    headgroup1_2->nSL=7.1472e-4;
-    headgroup1_2->l=7.8;
-    headgroup2_2->vol=270;
-    headgroup2_2->nSL=7.1472e-4;
-    headgroup2_2->l=7.8;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-    headgroup1_3->vol=335;
-    headgroup1_3->nSL=6.0063E-04;
-    headgroup1_3->l=9.5;
-    headgroup2_3->vol=335;
-    headgroup2_3->nSL=6.0063E-04;
-    headgroup2_3->l=9.5;
+    headgroup1_2->vol=262;                //PE volume and length are estimates
+    headgroup2_2->vol=262;
+    headgroup1_2->nSL=5.4558E-04;
+    headgroup2_2->nSL=5.4558E-04;
+    headgroup1_2->l=7.7;
+    headgroup2_2->l=7.7;
     
-    volacyllipid_2=770;
-    nslacyllipid_2=-2.9166E-04;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    volacyllipid_3=770;
-    nslacyllipid_3=5.3324E-03;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=5.334e-4;
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=200.00;                //KDO2
+    headgroup2_3->vol=1359.00;
+    headgroup1_3->fnSetnSL(3.1008E-03,3.45883E-03);
+    headgroup2_3->fnSetnSL(3.1008E-03,3.45883E-03);
+    headgroup1_3->l=12.0;
+    headgroup2_3->l=12.0;
     
+    volacyllipid_3=2066.40;
+    nslacyllipid_3=-7.9101E-04;
+    volmethyllipid_3=98.8*3;
+    nslmethyllipid_3=-9.15e-5*3;
+
     fnAdjustParameters();
+    
 }
 
-tBLM_WC14_DOPC_DOPS::tBLM_WC14_DOPC_DOPS()
+
+
+tBLM_HC18_DOPC_POPG_Cardiolipin18T1_CHOL::tBLM_HC18_DOPC_POPG_Cardiolipin18T1_CHOL()
 {
     tether->vol=380;
     tether->nSL=2.1864e-4;
@@ -7354,64 +10144,47 @@ tBLM_WC14_DOPC_DOPS::tBLM_WC14_DOPC_DOPS()
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
+    volacyltether=999;
+    nslacyltether=-2.25e-4;
     
-    headgroup1_2->vol=260;                //PS volume and length are estimates
-    headgroup2_2->vol=260;
-    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup1_2->l=7.5;
-    headgroup2_2->l=7.5;
+    headgroup1_2->vol=270;                //PG volume and length are estimates
+    headgroup2_2->vol=270;
+    headgroup1_2->nSL=7.1472e-4;
+    headgroup2_2->nSL=7.1472e-4;
+    headgroup1_2->l=7.8;
+    headgroup2_2->l=7.8;
     
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    fnAdjustParameters();
+    volchol=630;
+    nslchol=1.3215e-4;
     
-}
-
-tBLM_WC14_DOPC_PIP::tBLM_WC14_DOPC_PIP()
-{
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
+    headgroup1_3->vol=684.40;                //cardiolipin
+    headgroup2_3->vol=684.40;
+    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
+    headgroup1_3->l=9.56;
+    headgroup2_3->l=9.56;
     
-	headgroup1_2->vol=500;                //PIP volume and length are estimates
-	headgroup2_2->vol=500;
-	headgroup1_2->nSL=1.22e-3;
-	headgroup2_2->nSL=1.22e-3;
-	headgroup1_2->l=12.0;
-	headgroup2_2->l=12.0;
-	
-    volacyllipid_2=1025;
-    nslacyllipid_2=-7.5785e-5;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    volacyllipid_3=972*2;
+    nslacyllipid_3=-2.09e-4*2;
+    volmethyllipid_3=98.8*2;
+    nslmethyllipid_3=-9.15e-5*2;
     
     fnAdjustParameters();
-    
 }
 
-tBLM_HC18_DOPC_PIP::tBLM_HC18_DOPC_PIP()
+
+tBLM_HC18_DOPC_CERNP_STEARIC_CHOL::tBLM_HC18_DOPC_CERNP_STEARIC_CHOL()
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
     volacyllipid=972;
     nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
@@ -7421,29 +10194,43 @@ tBLM_HC18_DOPC_PIP::tBLM_HC18_DOPC_PIP()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
-	headgroup1_2->vol=500;                //PS volume and length are estimates
-	headgroup2_2->vol=500;
-	headgroup1_2->nSL=1.22e-3;
-	headgroup2_2->nSL=1.22e-3;
-	headgroup1_2->l=12.0;
-	headgroup2_2->l=12.0;
-	
-    volacyllipid_2=1025;
-    nslacyllipid_2=-7.5785e-5;
+    headgroup1_2->vol=200;                //PG volume and length are estimates
+    headgroup2_2->vol=200;
+    headgroup1_2->fnSetnSL(1.60733E-06,3.68965E-06);
+    headgroup2_2->fnSetnSL(1.60733E-06,3.68965E-06);
+    headgroup1_2->l=7.8;
+    headgroup2_2->l=7.8;
+    
+    volacyllipid_2=1093.00;
+    nslacyllipid_2=-3.8310E-04;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-    fnAdjustParameters();
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=55;                //cardiolipin
+    headgroup2_3->vol=55;
+    headgroup1_3->fnSetnSL(1.8254E-04,1.8254E-04);
+    headgroup2_3->fnSetnSL(1.8254E-04,1.8254E-04);
+    headgroup1_3->l=5.0;
+    headgroup2_3->l=5.0;
+    
+    volacyllipid_3=504.20;
+    nslacyllipid_3=-1.7905E-04;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
     
+    fnAdjustParameters();
 }
 
-tBLM_HC18_DOPC_DOPS_PIP::tBLM_HC18_DOPC_DOPS_PIP()
+tBLM_HC18_DOPC_CERNP_LIGNOCERIC_CHOL::tBLM_HC18_DOPC_CERNP_LIGNOCERIC_CHOL()
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
     volacyllipid=972;
     nslacyllipid=-2.09e-4;
     volmethyllipid=98.8;
@@ -7453,40 +10240,47 @@ tBLM_HC18_DOPC_DOPS_PIP::tBLM_HC18_DOPC_DOPS_PIP()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
-	headgroup1_2->vol=280;                //PS volume and length are estimates
-	headgroup2_2->vol=280;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=8.1;
-	headgroup2_2->l=8.1;
-	
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
+    headgroup1_2->vol=200;                //PG volume and length are estimates
+    headgroup2_2->vol=200;
+    headgroup1_2->fnSetnSL(1.60733E-06,3.68965E-06);
+    headgroup2_2->fnSetnSL(1.60733E-06,3.68965E-06);
+    headgroup1_2->l=7.8;
+    headgroup2_2->l=7.8;
+    
+    volacyllipid_2=1093.00;
+    nslacyllipid_2=-3.8310E-04;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
     
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
-	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
-	headgroup2_3->l=12.0;
-	
-    volacyllipid_3=1025;
-    nslacyllipid_3=-7.5785e-5;
+    volchol=630;
+    nslchol=1.3215e-4;
+    
+    headgroup1_3->vol=55;                //cardiolipin
+    headgroup2_3->vol=55;
+    headgroup1_3->fnSetnSL(1.8254E-04,1.8254E-04);
+    headgroup2_3->fnSetnSL(1.8254E-04,1.8254E-04);
+    headgroup1_3->l=5.0;
+    headgroup2_3->l=5.0;
+    
+    volacyllipid_3=673.40;
+    nslacyllipid_3=-2.2904E-04;
     volmethyllipid_3=98.8;
     nslmethyllipid_3=-9.15e-5;
     
     fnAdjustParameters();
-    
 }
 
-tBLM_HC18_DOPC_DOPS_PI::tBLM_HC18_DOPC_DOPS_PI()
+
+tBLM_HC18_DOPC_DOPS_PIP_CHOL_domain::tBLM_HC18_DOPC_DOPS_PIP_CHOL_domain()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
+	tether_domain->vol=380;
+	tether_domain->nSL=2.1864e-4;
+	tetherg_domain->vol=110;
+	tetherg_domain->nSL=1.8654e-4;
 	
     volacyllipid=972;
     nslacyllipid=-2.09e-4;
@@ -7497,24 +10291,39 @@ tBLM_HC18_DOPC_DOPS_PI::tBLM_HC18_DOPC_DOPS_PI()
     volacyltether=999;
     nslacyltether=-2.25e-4;
     
-	headgroup1_2->vol=280;                //PS volume and length are estimates
-	headgroup2_2->vol=280;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=8.1;
-	headgroup2_2->l=8.1;
+	headgroup1_2->vol=260;                //PS volume and length are estimates
+	headgroup2_2->vol=260;
+	headgroup1_2->nSL=8.4513e-4;
+	headgroup2_2->nSL=8.4513e-4;
+	headgroup1_2->l=7.5;
+	headgroup2_2->l=7.5;
+	headgroup1_2_domain->vol=260;                //PS volume and length are estimates
+	headgroup2_2_domain->vol=260;
+	headgroup1_2_domain->nSL=8.4513e-4;
+	headgroup2_2_domain->nSL=8.4513e-4;
+	headgroup1_2_domain->l=7.5;
+	headgroup2_2_domain->l=7.5;
 	
     volacyllipid_2=972;
     nslacyllipid_2=-2.09e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
-    
-	headgroup1_3->vol=370;                //PIP volume and length are from bulk
-	headgroup2_3->vol=370;
-	headgroup1_3->fnSetnSL(9.9672e-4,1.5175E-03);
-	headgroup2_3->fnSetnSL(9.9672e-4,1.5175E-03);
-	headgroup1_3->l=10.7;
-	headgroup2_3->l=10.7;
+	
+    volchol=630;
+    nslchol=1.3215e-4;
+	
+	headgroup1_3->vol=500;                //PIP volume and length are estimates
+	headgroup2_3->vol=500;
+	headgroup1_3->nSL=1.22e-3;
+	headgroup2_3->nSL=1.22e-3;
+	headgroup1_3->l=12.0;
+	headgroup2_3->l=12.0;
+	headgroup1_3_domain->vol=500;                //PIP volume and length are estimates
+	headgroup2_3_domain->vol=500;
+	headgroup1_3_domain->nSL=1.22e-3;
+	headgroup2_3_domain->nSL=1.22e-3;
+	headgroup1_3_domain->l=12.0;
+	headgroup2_3_domain->l=12.0;
 	
     volacyllipid_3=1025;
     nslacyllipid_3=-7.5785e-5;
@@ -7525,15 +10334,15 @@ tBLM_HC18_DOPC_DOPS_PI::tBLM_HC18_DOPC_DOPS_PI()
     
 }
 
-tBLM_WC14_DOPC_DOPS_CHOL::tBLM_WC14_DOPC_DOPS_CHOL()
+tBLM_WC14_POPC_POPS_POPA::tBLM_WC14_POPC_POPS_POPA()
 {
 	tether->vol=380;
 	tether->nSL=2.1864e-4;
 	tetherg->vol=110;
 	tetherg->nSL=1.8654e-4;
 	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
@@ -7541,783 +10350,2697 @@ tBLM_WC14_DOPC_DOPS_CHOL::tBLM_WC14_DOPC_DOPS_CHOL()
     volacyltether=850;
     nslacyltether=-3.5834e-4;
     
-	headgroup1_2->vol=260;                //PS volume and length are estimates
-	headgroup2_2->vol=260;
+	headgroup1_2->vol=280;                //PS volume and length are estimates
+	headgroup2_2->vol=280;
 	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
 	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=7.5;
-	headgroup2_2->l=7.5;
+	headgroup1_2->l=8.1;
+	headgroup2_2->l=8.1;
 	
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
+    volacyllipid_2=925;
+    nslacyllipid_2=-2.67e-4;
     volmethyllipid_2=98.8;
     nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
     
+	headgroup1_3->vol=174;                //was 174
+	headgroup2_3->vol=174;                //was 174
+	headgroup1_3->nSL=6.2364e-4;          //was 6.2364e-4
+	headgroup2_3->nSL=6.2364e-4;          //was 6.2364e-4
+	headgroup1_3->l=5;
+	headgroup2_3->l=5;
+	
+    volacyllipid_3=925;
+    nslacyllipid_3=-2.67e-4;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
+ 
     fnAdjustParameters();
     
 }
 
-tBLM_HC18_DOPC_DOPS_CHOL::tBLM_HC18_DOPC_DOPS_CHOL()
+tBLM_WC14_POPC_d31POPC_POPA::tBLM_WC14_POPC_d31POPC_POPA()
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
+    tether->vol=380;
+    tether->nSL=2.1864e-4;
+    tetherg->vol=110;
+    tetherg->nSL=1.8654e-4;
+    
+    volacyllipid=925;
+    nslacyllipid=-2.67e-4;
     volmethyllipid=98.8;
     nslmethyllipid=-9.15e-5;
     volmethyltether=98.8;
     nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    volacyltether=850;
+    nslacyltether=-3.5834e-4;
     
-	headgroup1_2->vol=260;                //PS volume and length are estimates
-	headgroup2_2->vol=260;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=7.5;
-	headgroup2_2->l=7.5;
-	
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
+    headgroup1_2->vol=280;                //PS volume and length are estimates
+    headgroup2_2->vol=280;
+    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
+    headgroup1_2->l=8.1;
+    headgroup2_2->l=8.1;
+    
+    volacyllipid_2=925;
+    nslacyllipid_2=2.9618E-03;
     volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
+    nslmethyllipid_2=2.2087e-4;
+
+    headgroup1_3->vol=174;                //was 174
+    headgroup2_3->vol=174;                //was 174
+    headgroup1_3->nSL=6.2364e-4;          //was 6.2364e-4
+    headgroup2_3->nSL=6.2364e-4;          //was 6.2364e-4
+    headgroup1_3->l=5;
+    headgroup2_3->l=5;
     
+    volacyllipid_3=925;
+    nslacyllipid_3=-2.67e-4;
+    volmethyllipid_3=98.8;
+    nslmethyllipid_3=-9.15e-5;
+ 
     fnAdjustParameters();
     
 }
 
-tBLM_HC18_POPC_POPG_CHOL::tBLM_HC18_POPC_POPG_CHOL()
+
+//------------------------------------------------------------------------------------------------------
+// FNV-1a hash of n bytes, iHash continues a previous hash
+
+unsigned long long fnHashBytes(const void *p, size_t n, unsigned long long iHash)
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    const unsigned char *c;
+    size_t i;
+    
+    c=(const unsigned char *) p;
+    for (i=0; i<n; i++) {
+        iHash^=c[i];
+        iHash*=1099511628211ULL;
+    }
+    return iHash;
+}
+
+//------------------------------------------------------------------------------------------------------
+void fnWriteConstant(MolSink fp, const char *cName, mgreal area, mgreal nSLD, int dimension, double stepsize)
+{
+    int i;
+    double d;
+    double *aZ;
+    MolDump *pDump=fp.pDump;
+    
+    fprintf(fp, "Constant %s area %lf \n",cName, fnValue(area));
+    if (pDump!=NULL) {
+        aZ=new double[3*dimension+1];
+        for (i=0; i<dimension; i++)
+        {
+            aZ[i]=double(i)*stepsize;
+            aZ[dimension+i]=fnValue(area);
+            aZ[2*dimension+i]=fnValue(nSLD*area*stepsize);
+        }
+        pDump->fnWriteBlock(cName, dimension, aZ, aZ+dimension, aZ+2*dimension);
+        delete [] aZ;
+        return;
+    }
+    fprintf(fp, "z%s a%s nsl%s \n",cName, cName, cName);
+	for (i=0; i<dimension; i++)
+	{
+        d=double(i)*stepsize;
+        fprintf(fp, "%lf %lf %e \n", d, fnValue(area), fnValue(nSLD*area*stepsize));
+	};
+	fprintf(fp,"\n");
+    
+}
+
+
+//------------------------------------------------------------------------------------------------------
+mgreal fnClearCanvas(mgreal aArea[], mgreal anSL[], int dimension)
+{
+	int j;
 	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
+	for (j=0; j<dimension; j++) {
+		aArea[j]=0; anSL[j]=0;
+	};
+	
+	return 0;
+}
+mgreal fnClearCanvas(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], int dimension)
+{
+	int j;
+	
+	for (j=0; j<dimension; j++) {
+		aArea[j]=0; anSL[j]=0; aAbsorb[j]=0;
+	};
+	
+	return 0;
+}
+//------------------------------------------------------------------------------------------------------
+// Overlays one canvas onto another 
+
+//the rules are written without branches: the overfill is clamped at zero and divisors are shifted away
+//from zero, so that all lanes compute finite values, and the compiler emits masked vector operations
+//with ddivisor=aArea[i] wherever the original rule divides, results are bitwise those of the branched rule
+void fnOverlayCanvasOnCanvas(mgreal aArea[], mgreal anSL[], mgreal aArea2[], mgreal anSL2[], int dimension, mgreal dMaxArea)
+{
+    mgreal temparea, dover, ddivisor, dfraction;
+	int i;
+	
+	for(i=0; i<dimension; i++)
+	{
+        temparea=aArea2[i]+aArea[i];
+        dover=temparea-dMaxArea;
+        dover=(dover>0) ? dover : 0;
+        ddivisor=aArea[i]+((aArea[i]>0) ? mgconst(0) : mgconst(1));
+        dfraction=1-(dover/ddivisor);                                                             //eliminate the overfilled portion using original content
+        anSL[i]=anSL[i]*dfraction+anSL2[i];
+        aArea[i]=(temparea<dMaxArea) ? temparea : dMaxArea;
+	};
+};
+void fnOverlayCanvasOnCanvas(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], mgreal aArea2[], mgreal anSL2[], mgreal aAbsorb2[], int dimension, mgreal dMaxArea)
+{
+    fnCompositeProfile(aArea, anSL, aAbsorb, aArea2, anSL2, aAbsorb2, dimension, dMaxArea);
+};
+void fnOverlayCanvasOnCanvas(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT aAbsorb, mgreal * MOLGROUPS_RESTRICT anSLBulk, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT aAbsorb2, const mgreal * MOLGROUPS_RESTRICT anSLBulk2, int dimension, mgreal dMaxArea)
+{
+    mgreal temparea, dover, ddivisor, dfraction;
+	int i;
+	
+	for(i=0; i<dimension; i++)
+	{
+        temparea=aArea2[i]+aArea[i];
+        dover=temparea-dMaxArea;
+        dover=(dover>0) ? dover : 0;
+        ddivisor=aArea[i]+((aArea[i]>0) ? mgconst(0) : mgconst(1));
+        dfraction=1-(dover/ddivisor);
+        anSL[i]=anSL[i]*dfraction+anSL2[i];
+        aAbsorb[i]=aAbsorb[i]*dfraction+aAbsorb2[i];
+        anSLBulk[i]=anSLBulk[i]*dfraction+anSLBulk2[i];
+        aArea[i]=(temparea<dMaxArea) ? temparea : dMaxArea;
+	};
+};
+
+//------------------------------------------------------------------------------------------------------
+// Composites a rasterized object (aArea2 ...) onto a canvas with the rules of nSLDObj::fnOverlayProfile
+
+void fnCompositeProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, int dimension, mgreal dMaxArea)
+{
+    mgreal temparea, dover, ddivisor, dfraction, dexcess, dweight;
+	int i;
+	
+	for(i=0; i<dimension; i++)
+	{
+        temparea=aArea2[i]+aArea[i];
+        dover=temparea-dMaxArea;
+        dover=(dover>0) ? dover : 0;
+        ddivisor=aArea[i]+((aArea[i]>0) ? mgconst(0) : mgconst(1));
+        dfraction=1-(dover/ddivisor);
+        dweight=(dover>aArea[i]) ? mgconst(1) : mgconst(0);                                                        //overfill is larger, non-physical
+        ddivisor=aArea2[i]+((aArea2[i]>0) ? mgconst(0) : mgconst(1));
+        dexcess=anSL2[i]/ddivisor*dMaxArea;
+        anSL[i]=(anSL[i]*dfraction+anSL2[i])*(1-dweight)+dexcess*dweight;
+        aArea[i]=(temparea<dMaxArea) ? temparea : dMaxArea;
+	};
+}
+
+void fnCompositeProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT aAbsorb, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT aAbsorb2, int dimension, mgreal dMaxArea)
+{
+    mgreal temparea, dover, ddivisor, dfraction;
+	int i;
+	
+	for(i=0; i<dimension; i++)
+	{
+        temparea=aArea2[i]+aArea[i];
+        dover=temparea-dMaxArea;
+        dover=(dover>0) ? dover : 0;
+        ddivisor=aArea[i]+((aArea[i]>0) ? mgconst(0) : mgconst(1));
+        dfraction=1-(dover/ddivisor);
+        anSL[i]=anSL[i]*dfraction+anSL2[i];
+        aAbsorb[i]=aAbsorb[i]*dfraction+aAbsorb2[i];
+        aArea[i]=(temparea<dMaxArea) ? temparea : dMaxArea;
+	};
+}
+
+void fnCompositeContrastProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT anSLBulk, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT anSLBulk2, int dimension, mgreal dMaxArea)
+{
+    mgreal temparea, dover, ddivisor, dfraction, dexcess, dweight;
+	int i;
+	
+	for(i=0; i<dimension; i++)
+	{
+        temparea=aArea2[i]+aArea[i];
+        dover=temparea-dMaxArea;
+        dover=(dover>0) ? dover : 0;
+        ddivisor=aArea[i]+((aArea[i]>0) ? mgconst(0) : mgconst(1));
+        dfraction=1-(dover/ddivisor);
+        dweight=(dover>aArea[i]) ? mgconst(1) : mgconst(0);
+        ddivisor=aArea2[i]+((aArea2[i]>0) ? mgconst(0) : mgconst(1));
+        dexcess=dMaxArea/ddivisor;
+        anSL[i]=(anSL[i]*dfraction+anSL2[i])*(1-dweight)+anSL2[i]*dexcess*dweight;
+        anSLBulk[i]=(anSLBulk[i]*dfraction+anSLBulk2[i])*(1-dweight)+anSLBulk2[i]*dexcess*dweight;
+        aArea[i]=(temparea<dMaxArea) ? temparea : dMaxArea;
+	};
+}
+
+//------------------------------------------------------------------------------------------------------
+//writes out canvas to reflectivity model taking into account bulk nSLD
+
+void fnWriteCanvas2Model(mgreal aArea[], mgreal anSL[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend)
+{
+    int i, j;
+    if (dMaxArea!=0)  {
+        for (i=modelstart; i<modelend+1; i++)
+            for (j=0; j<dimension; j++)  {
+                fit[i].m.rho[j+gaussstart]=fnValue((anSL[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.rho[fit[i].m.n-1]);
+            }
+    }
+    else  {
+        for (i=modelstart; i<modelend+1; i++)  
+            for (j=0; j<dimension; j++)  {fit[i].m.rho[j+gaussstart]=fit[i].m.rho[fit[i].m.n-1];}
+    }
+}
+void fnWriteCanvas2Model(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend)
+{
+    int i, j;
+    if (dMaxArea!=0)  {
+        for (i=modelstart; i<modelend+1; i++)
+            for (j=0; j<dimension; j++)  {
+                //printf("bin %i area %e normarea %e areafraction %e bulk mu %e absorption %e result %e \n",j, aArea[j], normarea, aArea[j]/normarea,fit[i].m.mu[fit[i].m.n-1], aAbsorb[j],(aAbsorb[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.mu[fit[i].m.n-1]);
+                fit[i].m.rho[j+gaussstart]=fnValue((anSL[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.rho[fit[i].m.n-1]);
+                fit[i].m.mu[j+gaussstart]=fnValue((aAbsorb[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.mu[fit[i].m.n-1]);
+            }
+    }
+    else  {
+        for (i=modelstart; i<modelend+1; i++)  
+            for (j=0; j<dimension; j++)  {
+                fit[i].m.rho[j+gaussstart]=fit[i].m.rho[fit[i].m.n-1];
+                fit[i].m.mu[j+gaussstart]=fit[i].m.mu[fit[i].m.n-1];
+            }
+    }
+}
+
+//writes out a contrast-separated canvas (see nSLDObj::fnWriteContrastProfile) to all models from
+//modelstart to modelend, each with its own bulk nSLD
+void fnWriteContrastCanvas2Model(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend)
+{
+    int i, j;
+    mgreal bulknsld;
+    if (dMaxArea!=0)  {
+        for (i=modelstart; i<modelend+1; i++) {
+            bulknsld=fit[i].m.rho[fit[i].m.n-1];
+            for (j=0; j<dimension; j++)  {
+                fit[i].m.rho[j+gaussstart]=fnValue(((anSL[j]+bulknsld*anSLBulk[j])/(normarea*stepsize))+(1-(aArea[j]/normarea))*bulknsld);
+            }
+        }
+    }
+    else  {
+        for (i=modelstart; i<modelend+1; i++)  
+            for (j=0; j<dimension; j++)  {fit[i].m.rho[j+gaussstart]=fit[i].m.rho[fit[i].m.n-1];}
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+// Canvas versions of the standalone functions
+
+mgreal fnClearCanvas(Canvas &canvas)
+{
+    return canvas.fnClear();
+}
+
+//canvas2 needs the same dimension and at least the channels of canvas
+//inactive channels are zero and stay zero, so all four are processed without branching
+void fnOverlayCanvasOnCanvas(Canvas &canvas, Canvas &canvas2, mgreal dMaxArea)
+{
+    fnOverlayCanvasOnCanvas(canvas.aArea, canvas.anSL, canvas.aAbsorb, canvas.anSLBulk, canvas2.aArea, canvas2.anSL, canvas2.aAbsorb, canvas2.anSLBulk, canvas.dimension, dMaxArea);
+}
+
+//all models from modelstart to modelend in one pass over the canvas, see fnWriteCanvas2Targets
+void fnWriteCanvas2Model(Canvas &canvas, fitinfo fit[], int gaussstart, mgreal normarea, int modelstart, int modelend)
+{
+    ModelTarget *targets;
+    int i, n;
     
-	headgroup1_2->vol=270;                //PG volume and length are estimates
-	headgroup2_2->vol=270;
-	headgroup1_2->nSL=7.1472e-4;
-	headgroup2_2->nSL=7.1472e-4;
-	headgroup1_2->l=7.8;
-	headgroup2_2->l=7.8;
-	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
+    n=modelend-modelstart+1;
+    if (n<1) {return;}
+    targets=new ModelTarget[n];
+    for (i=0; i<n; i++) {
+        model &m=fit[modelstart+i].m;
+        targets[i].bulkrho=m.rho[m.n-1];
+        targets[i].rho=m.rho+gaussstart;
+        if (canvas.bAbsorb) {
+            targets[i].bulkmu=m.mu[m.n-1];
+            targets[i].mu=m.mu+gaussstart;
+        }
+    }
+    fnWriteCanvas2Targets(canvas, targets, n, normarea);
+    delete [] targets;
+}
+
+//fused writer: the canvas is converted block by block into slab coefficients, which are then expanded
+//into every target while they are in cache. The expansion loops are plain multiply-adds that vectorize.
+//With canvas.bIncremental set, blocks whose coefficients did not change are skipped, as long as
+//targets and bulk values are the same as in the last call
+void fnWriteCanvas2Targets(Canvas &canvas, ModelTarget targets[], int ntargets, mgreal normarea)
+{
+    double anSLr[MOLGROUPS_SLABBLOCK], aAbsorbr[MOLGROUPS_SLABBLOCK], aVoid[MOLGROUPS_SLABBLOCK], aVoidBulk[MOLGROUPS_SLABBLOCK];
+    double bulkrho, bulkmu;
+    bool bFull;
+    Real *rho, *mu;
+    int i, j, k, n;
     
-    fnAdjustParameters();
+    bFull=canvas.fnSetSlabKey(fnHashBytes(targets, sizeof(ModelTarget)*ntargets));
     
+    for (i=0; i<canvas.dimension; i+=MOLGROUPS_SLABBLOCK) {
+        n=canvas.dimension-i;
+        if (n>MOLGROUPS_SLABBLOCK) {n=MOLGROUPS_SLABBLOCK;}
+        if ((canvas.fnSlabBlock(i, i+n, normarea, anSLr, aAbsorbr, aVoid, aVoidBulk)==false) && (bFull==false)) {continue;}
+        
+        for (k=0; k<ntargets; k++) {
+            bulkrho=targets[k].bulkrho;
+            rho=targets[k].rho+i;
+            for (j=0; j<n; j++) {rho[j]=anSLr[j]+aVoidBulk[j]*bulkrho;}
+            if (targets[k].mu!=NULL) {
+                bulkmu=targets[k].bulkmu;
+                mu=targets[k].mu+i;
+                for (j=0; j<n; j++) {mu[j]=aAbsorbr[j]+aVoid[j]*bulkmu;}
+            }
+        }
+    }
 }
-tBLM_HC18_POPC_POPE_CHOL::tBLM_HC18_POPC_POPE_CHOL()
+
+//the same for engines outside garefl: contrast k goes to arho[k*dimension ...] and, if amu is not NULL,
+//its absorption to amu[k*dimension ...] with the bulk values abulkrho[k] and abulkmu[k]
+void fnWriteCanvas2Buffer(Canvas &canvas, const double abulkrho[], const double abulkmu[], int ncontrasts, mgreal normarea, double arho[], double amu[])
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
-	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    
-	headgroup1_2->vol=262;                //PE volume and length are estimates
-	headgroup2_2->vol=262;
-	headgroup1_2->nSL=5.4558E-04;
-	headgroup2_2->nSL=5.4558E-04;
-	headgroup1_2->l=7.7;
-	headgroup2_2->l=7.7;
-	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
+    double anSLr[MOLGROUPS_SLABBLOCK], aAbsorbr[MOLGROUPS_SLABBLOCK], aVoid[MOLGROUPS_SLABBLOCK], aVoidBulk[MOLGROUPS_SLABBLOCK];
+    double bulkrho, bulkmu;
+    double *rho, *mu;
+    unsigned long long iKey;
+    bool bFull;
+    int i, j, k, n;
     
-    fnAdjustParameters();
+    iKey=fnHashBytes(&arho, sizeof(double *));
+    iKey=fnHashBytes(&amu, sizeof(double *), iKey);
+    iKey=fnHashBytes(abulkrho, sizeof(double)*ncontrasts, iKey);
+    if (amu!=NULL) {iKey=fnHashBytes(abulkmu, sizeof(double)*ncontrasts, iKey);}
+    bFull=canvas.fnSetSlabKey(iKey);
     
+    for (i=0; i<canvas.dimension; i+=MOLGROUPS_SLABBLOCK) {
+        n=canvas.dimension-i;
+        if (n>MOLGROUPS_SLABBLOCK) {n=MOLGROUPS_SLABBLOCK;}
+        if ((canvas.fnSlabBlock(i, i+n, normarea, anSLr, aAbsorbr, aVoid, aVoidBulk)==false) && (bFull==false)) {continue;}
+        
+        for (k=0; k<ncontrasts; k++) {
+            bulkrho=abulkrho[k];
+            rho=arho+k*canvas.dimension+i;
+            for (j=0; j<n; j++) {rho[j]=anSLr[j]+aVoidBulk[j]*bulkrho;}
+            if (amu!=NULL) {
+                bulkmu=abulkmu[k];
+                mu=amu+k*canvas.dimension+i;
+                for (j=0; j<n; j++) {mu[j]=aAbsorbr[j]+aVoid[j]*bulkmu;}
+            }
+        }
+    }
 }
 
+//------------------------------------------------------------------------------------------------------
+//merges adjacent bins into slabs of variable thickness. A slab grows as long as the spread (max-min) of
+//its rho stays within dTolerance and that of its mu within dToleranceMu, its values are the bin averages,
+//which conserves the integrated scattering length. amu may be NULL. aSlabs needs room for dimension
+//entries, the number of slabs is returned. Flat solvent or substrate regions collapse into single slabs
 
-tBLM_HC18_DOPC_DOPS_PIP_CHOL::tBLM_HC18_DOPC_DOPS_PIP_CHOL()
+int fnMergeSlabs(const double arho[], const double amu[], int dimension, double stepsize, double dTolerance, double dToleranceMu, Slab aSlabs[])
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    double rhomin, rhomax, mumin, mumax, rhosum, musum, mu;
+    int j, n, nbins;
     
-	headgroup1_2->vol=260;                //PS volume and length are estimates
-	headgroup2_2->vol=260;
-	headgroup1_2->nSL=8.4513e-4;
-	headgroup2_2->nSL=8.4513e-4;
-	headgroup1_2->l=7.5;
-	headgroup2_2->l=7.5;
-	
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
-	
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
-	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
-	headgroup2_3->l=12.0;
-	
-    volacyllipid_3=1025;
-    nslacyllipid_3=-7.5785e-5;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
+    n=0;
+    j=0;
+    while (j<dimension) {
+        rhomin=arho[j]; rhomax=arho[j]; rhosum=arho[j];
+        mu=(amu!=NULL) ? amu[j] : 0;
+        mumin=mu; mumax=mu; musum=mu;
+        nbins=1;
+        j++;
+        while (j<dimension) {
+            mu=(amu!=NULL) ? amu[j] : 0;
+            if ((fmax(rhomax,arho[j])-fmin(rhomin,arho[j])>dTolerance) || (fmax(mumax,mu)-fmin(mumin,mu)>dToleranceMu)) {break;}
+            rhomin=fmin(rhomin,arho[j]); rhomax=fmax(rhomax,arho[j]); rhosum+=arho[j];
+            mumin=fmin(mumin,mu); mumax=fmax(mumax,mu); musum+=mu;
+            nbins++;
+            j++;
+        }
+        aSlabs[n].d=double(nbins)*stepsize;
+        aSlabs[n].rho=rhosum/double(nbins);
+        aSlabs[n].mu=musum/double(nbins);
+        n++;
+    }
+    return n;
+}
+
+//merged slabs of a canvas embedded in a bulk, rho and mu per bin as written by fnWriteCanvas2Model
+int fnWriteCanvas2Slabs(Canvas &canvas, double bulkrho, double bulkmu, mgreal normarea, double dTolerance, double dToleranceMu, Slab aSlabs[])
+{
+    double *arho, *amu;
+    double dscale, dinvnorm, dvoid;
+    int j, n;
     
-    fnAdjustParameters();
+    arho=new double[2*canvas.dimension];
+    amu=arho+canvas.dimension;
+    if (canvas.dMaxArea!=0) {
+        dscale=1/fnValue(normarea*canvas.stepsize);
+        dinvnorm=1/fnValue(normarea);
+        for (j=0; j<canvas.dimension; j++) {
+            dvoid=1-fnValue(canvas.aArea[j])*dinvnorm;
+            arho[j]=fnValue(canvas.anSL[j])*dscale+(dvoid+fnValue(canvas.anSLBulk[j])*dscale)*bulkrho;
+            amu[j]=fnValue(canvas.aAbsorb[j])*dscale+dvoid*bulkmu;
+        }
+    }
+    else {
+        for (j=0; j<canvas.dimension; j++) {arho[j]=bulkrho; amu[j]=bulkmu;}
+    }
+    n=fnMergeSlabs(arho, amu, canvas.dimension, canvas.stepsize, dTolerance, dToleranceMu, aSlabs);
+    delete [] arho;
+    return n;
+}
+
+//------------------------------------------------------------------------------------------------------
+//Reflectivity
+//------------------------------------------------------------------------------------------------------
+//specular reflectivity of a slab stack by the Abeles matrix method. aSlabs[0] is the incident medium,
+//aSlabs[nslabs-1] the backing medium, the thicknesses of both are ignored. The complex SLD of a layer is
+//rho+i*mu. Q>0 in A^-1, negative Q are taken as |Q|
+//Q points are processed in chunks of MOLGROUPS_QCHUNK with all complex quantities split into real and
+//imaginary arrays. Per layer, the square roots and transcendental functions are evaluated in a loop of
+//their own, which leaves the complex matrix arithmetic as a branch-free loop that the compiler vectorizes
+
+void fnReflectivityKernel(const Slab aSlabs[], int nslabs, const double aQ[], int nQ, double aR[])
+{
+    double kzsq[MOLGROUPS_QCHUNK], kr[MOLGROUPS_QCHUNK], ki[MOLGROUPS_QCHUNK], knr[MOLGROUPS_QCHUNK], kni[MOLGROUPS_QCHUNK];
+    double Er[MOLGROUPS_QCHUNK], Ei[MOLGROUPS_QCHUNK], Pr[MOLGROUPS_QCHUNK], Pi[MOLGROUPS_QCHUNK];
+    double B11r[MOLGROUPS_QCHUNK], B11i[MOLGROUPS_QCHUNK], B12r[MOLGROUPS_QCHUNK], B12i[MOLGROUPS_QCHUNK];
+    double B21r[MOLGROUPS_QCHUNK], B21i[MOLGROUPS_QCHUNK], B22r[MOLGROUPS_QCHUNK], B22i[MOLGROUPS_QCHUNK];
+    double a, b, r, e, gr, gi, nr, ni, dr, di, den, Fr, Fi, inv;
+    double M11r, M11i, M12r, M12i, M21r, M21i, M22r, M22i, C1r, C1i, C2r, C2i;
+    double V, Vi, sigma2, d;
+    int i, l, q0, n;
+    
+    if (nslabs<1) {return;}
+    
+    for (q0=0; q0<nQ; q0+=MOLGROUPS_QCHUNK) {
+        n=nQ-q0;
+        if (n>MOLGROUPS_QCHUNK) {n=MOLGROUPS_QCHUNK;}
+        
+        for (l=0; l<n; l++) {
+            kr[l]=0.5*fabs(aQ[q0+l]); ki[l]=0;
+            kzsq[l]=kr[l]*kr[l];
+            B11r[l]=1; B11i[l]=0; B12r[l]=0; B12i[l]=0;
+            B21r[l]=0; B21i[l]=0; B22r[l]=1; B22i[l]=0;
+        }
+        
+        for (i=0; i<nslabs-1; i++) {
+            V=4*M_PI*(aSlabs[i+1].rho-aSlabs[0].rho);
+            Vi=4*M_PI*(aSlabs[i+1].mu-aSlabs[0].mu);
+            sigma2=aSlabs[i].rough*aSlabs[i].rough;
+            d=(i>0) ? aSlabs[i].d : 0;
+            
+            //square root and transcendental functions
+            for (l=0; l<n; l++) {
+                a=kzsq[l]-V; b=(-1)*Vi;                                             //k_next=sqrt(kz^2-4pi(rho-i*mu-rho_0))
+                r=sqrt(0.5*(sqrt(a*a+b*b)+fabs(a)));                                //larger component, the smaller one is b/2 over
+                if (a>=0) {knr[l]=r; kni[l]=(r>0) ? b/(2*r) : 0;}                   //it, sqrt(0.5*(|z|-|a|)) would cancel
+                else {knr[l]=fabs(b)/(2*r); kni[l]=copysign(r,b);}
+                
+                gr=(-2)*sigma2*(kr[l]*knr[l]-ki[l]*kni[l]);                         //Nevot-Croce factor exp(-2 k k_next sigma^2)
+                gi=(-2)*sigma2*(kr[l]*kni[l]+ki[l]*knr[l]);
+                e=exp(gr);
+                Er[l]=e*cos(gi); Ei[l]=e*sin(gi);
+                
+                e=exp((-1)*ki[l]*d);                                                //phase exp(i k d)
+                Pr[l]=e*cos(kr[l]*d); Pi[l]=e*sin(kr[l]*d);
+            }
+            
+            //complex arithmetic of the transfer matrix
+            for (l=0; l<n; l++) {
+                nr=kr[l]-knr[l]; ni=ki[l]-kni[l];                                   //Fresnel coefficient (k-k_next)/(k+k_next)
+                dr=kr[l]+knr[l]; di=ki[l]+kni[l];
+                den=dr*dr+di*di;
+                a=(nr*dr+ni*di)/den;
+                b=(ni*dr-nr*di)/den;
+                Fr=a*Er[l]-b*Ei[l];
+                Fi=a*Ei[l]+b*Er[l];
+                
+                M11r=Pr[l]; M11i=Pi[l];
+                inv=1/(Pr[l]*Pr[l]+Pi[l]*Pi[l]);                                    //exp(-i k d)=1/exp(i k d)
+                M22r=Pr[l]*inv; M22i=(-1)*Pi[l]*inv;
+                M21r=Fr*M11r-Fi*M11i; M21i=Fr*M11i+Fi*M11r;
+                M12r=Fr*M22r-Fi*M22i; M12i=Fr*M22i+Fi*M22r;
+                
+                C1r=B11r[l]*M11r-B11i[l]*M11i+B21r[l]*M12r-B21i[l]*M12i;
+                C1i=B11r[l]*M11i+B11i[l]*M11r+B21r[l]*M12i+B21i[l]*M12r;
+                C2r=B11r[l]*M21r-B11i[l]*M21i+B21r[l]*M22r-B21i[l]*M22i;
+                C2i=B11r[l]*M21i+B11i[l]*M21r+B21r[l]*M22i+B21i[l]*M22r;
+                B11r[l]=C1r; B11i[l]=C1i; B21r[l]=C2r; B21i[l]=C2i;
+                
+                C1r=B12r[l]*M11r-B12i[l]*M11i+B22r[l]*M12r-B22i[l]*M12i;
+                C1i=B12r[l]*M11i+B12i[l]*M11r+B22r[l]*M12i+B22i[l]*M12r;
+                C2r=B12r[l]*M21r-B12i[l]*M21i+B22r[l]*M22r-B22i[l]*M22i;
+                C2i=B12r[l]*M21i+B12i[l]*M21r+B22r[l]*M22i+B22i[l]*M22r;
+                B12r[l]=C1r; B12i[l]=C1i; B22r[l]=C2r; B22i[l]=C2i;
+                
+                kr[l]=knr[l]; ki[l]=kni[l];
+            }
+        }
+        
+        for (l=0; l<n; l++) {
+            den=B11r[l]*B11r[l]+B11i[l]*B11i[l];                                   //R=|B12/B11|^2
+            aR[q0+l]=(B12r[l]*B12r[l]+B12i[l]*B12i[l])/den;
+        }
+    }
+}
+
+//with a thread pool, chunks of Q points are distributed over the threads
+class ReflectivityJob
+{
+public:
+    const Slab *aSlabs;
+    const double *aQ;
+    double *aR;
+    int nslabs, nQ;
+};
+
+void fnReflectivityTask(int i, void *pData)
+{
+    ReflectivityJob *job;
+    int q0, n;
     
+    job=(ReflectivityJob *) pData;
+    q0=i*MOLGROUPS_QCHUNK;
+    n=job->nQ-q0;
+    if (n>MOLGROUPS_QCHUNK) {n=MOLGROUPS_QCHUNK;}
+    fnReflectivityKernel(job->aSlabs, job->nslabs, job->aQ+q0, n, job->aR+q0);
 }
 
-tBLM_HC18_POPC_POPS_PIP_CHOL::tBLM_HC18_POPC_POPS_PIP_CHOL()
+void fnReflectivity(const Slab aSlabs[], int nslabs, const double aQ[], int nQ, double aR[], ThreadPool *pool)
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+    ReflectivityJob job;
     
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    if ((pool==NULL) || (nQ<=MOLGROUPS_QCHUNK)) {
+        fnReflectivityKernel(aSlabs, nslabs, aQ, nQ, aR);
+        return;
+    }
+    job.aSlabs=aSlabs; job.nslabs=nslabs;
+    job.aQ=aQ; job.nQ=nQ; job.aR=aR;
+    pool->fnParallelFor(0, (nQ+MOLGROUPS_QCHUNK-1)/MOLGROUPS_QCHUNK, fnReflectivityTask, &job);
+}
+
+//nodes and weights of the n-point Gauss-Hermite quadrature for the weight exp(-x^2), Newton iteration
+//on the orthonormal Hermite recurrence, starting values after Numerical Recipes (gauher)
+void fnGaussHermite(int n, double x[], double w[])
+{
+    double z, z1, p1, p2, p3, pp;
+    int i, j, its, m;
+    
+    m=(n+1)/2;
+    z=0; pp=1;
+    for (i=0; i<m; i++) {
+        if (i==0) {z=sqrt(double(2*n+1))-1.85575*pow(double(2*n+1),-0.16667);}
+        else if (i==1) {z=z-1.14*pow(double(n),0.426)/z;}
+        else if (i==2) {z=1.86*z-0.86*x[0];}
+        else if (i==3) {z=1.91*z-0.91*x[1];}
+        else {z=2.0*z-x[i-2];}
+        for (its=0; its<100; its++) {
+            p1=pow(M_PI,-0.25); p2=0;
+            for (j=0; j<n; j++) {
+                p3=p2; p2=p1;
+                p1=z*sqrt(2.0/double(j+1))*p2-sqrt(double(j)/double(j+1))*p3;
+            }
+            pp=sqrt(2.0*double(n))*p2;
+            z1=z;
+            z=z1-p1/pp;
+            if (fabs(z-z1)<=3e-14) {break;}
+        }
+        x[i]=z; x[n-1-i]=(-1)*z;
+        w[i]=2.0/(pp*pp); w[n-1-i]=w[i];
+    }
+}
+
+//reflectivity convolved with a Gaussian resolution of standard deviation adQ[k] at every Q,
+//integrated by nquadrature-point Gauss-Hermite quadrature. All quadrature points of all Q are passed
+//to fnReflectivity at once
+void fnReflectivitySmeared(const Slab aSlabs[], int nslabs, const double aQ[], const double adQ[], int nQ, int nquadrature, double aR[], ThreadPool *pool)
+{
+    double *x, *w, *aQq, *aRq;
+    int k, m;
     
-    headgroup1_2->vol=260;                //PS volume and length are estimates
-    headgroup2_2->vol=260;
-    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup1_2->l=7.5;
-    headgroup2_2->l=7.5;
+    if (nquadrature<2) {fnReflectivity(aSlabs, nslabs, aQ, nQ, aR, pool); return;}
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    x=new double[2*nquadrature+2*nQ*nquadrature];
+    w=x+nquadrature;
+    aQq=w+nquadrature;
+    aRq=aQq+nQ*nquadrature;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    fnGaussHermite(nquadrature, x, w);
+    for (k=0; k<nQ; k++) {
+        for (m=0; m<nquadrature; m++) {aQq[k*nquadrature+m]=aQ[k]+sqrt(2.0)*adQ[k]*x[m];}
+    }
+    fnReflectivity(aSlabs, nslabs, aQq, nQ*nquadrature, aRq, pool);
+    for (k=0; k<nQ; k++) {
+        aR[k]=0;
+        for (m=0; m<nquadrature; m++) {aR[k]+=w[m]*aRq[k*nquadrature+m];}
+        aR[k]=aR[k]/sqrt(M_PI);
+    }
     
-    headgroup1_3->vol=500;                //PIP volume and length are estimates
-    headgroup2_3->vol=500;
-    headgroup1_3->nSL=1.22e-3;
-    headgroup2_3->nSL=1.22e-3;
-    headgroup1_3->l=12.0;
-    headgroup2_3->l=12.0;
+    delete [] x;
+}
+
+//profile-to-R(Q) in one call: the layers aTop (incident medium first) are followed by the canvas, merged
+//with dTolerance, and the bulk, which is the backing medium. adQ may be NULL for no smearing
+void fnCanvasReflectivity(const Slab aTop[], int ntop, Canvas &canvas, double bulkrho, double bulkmu, mgreal normarea, double dTolerance, const double aQ[], const double adQ[], int nQ, int nquadrature, double aR[], ThreadPool *pool)
+{
+    Slab *aSlabs;
+    int i, n;
     
-    volacyllipid_3=1025;
-    nslacyllipid_3=-7.5785e-5;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
+    aSlabs=new Slab[ntop+canvas.dimension+1];
+    for (i=0; i<ntop; i++) {aSlabs[i]=aTop[i];}
+    n=ntop+fnWriteCanvas2Slabs(canvas, bulkrho, bulkmu, normarea, dTolerance, dTolerance, aSlabs+ntop);
+    aSlabs[n].rho=bulkrho;
+    aSlabs[n].mu=bulkmu;
+    n++;
     
-    fnAdjustParameters();
+    if (adQ!=NULL) {fnReflectivitySmeared(aSlabs, n, aQ, adQ, nQ, nquadrature, aR, pool);}
+    else {fnReflectivity(aSlabs, n, aQ, nQ, aR, pool);}
     
+    delete [] aSlabs;
 }
-tBLM_HC18_POPC_POPG_Cardiolipin18T1_CHOL::tBLM_HC18_POPC_POPG_Cardiolipin18T1_CHOL()
+
+//R(Q) of several contrasts that share one canvas and differ in the bulk, e.g. the canvas of
+//fnWriteContrastProfile, which fnWriteCanvas2Slabs embeds in the bulk of each contrast. With at least as
+//many contrasts as threads, every contrast is a task of its own, otherwise the contrasts are computed one
+//after the other with their Q points split over the pool. The canvas is only read
+class ContrastReflectivityJob
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
-    
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
-    
-    headgroup1_2->vol=270;                //PG volume and length are estimates
-    headgroup2_2->vol=270;
-    headgroup1_2->nSL=7.1472e-4;
-    headgroup2_2->nSL=7.1472e-4;
-    headgroup1_2->l=7.8;
-    headgroup2_2->l=7.8;
+public:
+    Canvas *canvas;
+    mgreal normarea;
+    double dTolerance;
+    int    nquadrature;
+    ContrastJob *aJobs;
+};
+
+void fnContrastReflectivityTask(int i, void *pData)
+{
+    ContrastReflectivityJob *job;
+    ContrastJob *c;
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    job=(ContrastReflectivityJob *) pData;
+    c=&job->aJobs[i];
+    fnCanvasReflectivity(c->aTop, c->ntop, *job->canvas, c->bulkrho, c->bulkmu, job->normarea, job->dTolerance, c->aQ, c->adQ, c->nQ, job->nquadrature, c->aR);
+}
+
+void fnContrastReflectivity(Canvas &canvas, mgreal normarea, double dTolerance, int nquadrature, ContrastJob aJobs[], int ncontrasts, ThreadPool *pool)
+{
+    ContrastReflectivityJob job;
+    ContrastJob *c;
+    int i;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    if ((pool==NULL) || (ncontrasts<pool->fnGetThreads())) {
+        for (i=0; i<ncontrasts; i++) {
+            c=&aJobs[i];
+            fnCanvasReflectivity(c->aTop, c->ntop, canvas, c->bulkrho, c->bulkmu, normarea, dTolerance, c->aQ, c->adQ, c->nQ, nquadrature, c->aR, pool);
+        }
+        return;
+    }
+    job.canvas=&canvas; job.normarea=normarea; job.dTolerance=dTolerance;
+    job.nquadrature=nquadrature; job.aJobs=aJobs;
+    pool->fnParallelFor(0, ncontrasts, fnContrastReflectivityTask, &job);
+}
+
+//------------------------------------------------------------------------------------------------------
+//Population evaluation
+//------------------------------------------------------------------------------------------------------
+//evaluates a population of parameter vectors, aParameters is laid out [member][parameter]. The members
+//are split into one contiguous block per thread, each block works on its own clone of the model
+
+class PopulationJob
+{
+public:
+    PopulationModel **aModels;
+    const double *aParameters, *aQ, *adQ;
+    Canvas *aCanvas;                        //one per member, or one scratch canvas per block for R(Q)
+    double *aR;
+    int nmembers, nparameters, nblocks, nQ;
+};
+
+void fnPopulationTask(int iblock, void *pData)
+{
+    PopulationJob *job;
+    PopulationModel *model;
+    Canvas *canvas;
+    int i, istart, iend;
     
-    headgroup1_3->vol=684.40;                //cardiolipin
-    headgroup2_3->vol=684.40;
-    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup1_3->l=9.56;
-    headgroup2_3->l=9.56;
+    job=(PopulationJob *) pData;
+    model=job->aModels[iblock];
+    istart=(job->nmembers*iblock)/job->nblocks;
+    iend=(job->nmembers*(iblock+1))/job->nblocks;
+    for (i=istart; i<iend; i++) {
+        if (job->aR==NULL) {
+            model->fnEvaluate(job->aParameters+i*job->nparameters, job->aCanvas[i]);
+        }
+        else {
+            canvas=&job->aCanvas[iblock];
+            model->fnEvaluate(job->aParameters+i*job->nparameters, *canvas);
+            fnCanvasReflectivity(model->aTop, model->ntop, *canvas, model->bulkrho, model->bulkmu, model->normarea, model->dTolerance, job->aQ, job->adQ, job->nQ, model->nquadrature, job->aR+i*job->nQ);
+        }
+    }
+}
+
+void fnRunPopulation(PopulationModel &model, PopulationJob &job, ThreadPool *pool)
+{
+    int i;
     
-    volacyllipid_3=972*2;
-    nslacyllipid_3=-2.09e-4*2;
-    volmethyllipid_3=98.8*2;
-    nslmethyllipid_3=-9.15e-5*2;
+    job.aModels=new PopulationModel*[job.nblocks];
+    for (i=0; i<job.nblocks; i++) {job.aModels[i]=model.fnClone();}
+    if (pool!=NULL) {pool->fnParallelFor(0, job.nblocks, fnPopulationTask, &job);}
+    else {fnPopulationTask(0, &job);}
+    for (i=0; i<job.nblocks; i++) {delete job.aModels[i];}
+    delete [] job.aModels;
+}
+
+//profiles of all members into aCanvas[0..nmembers-1]
+void fnEvaluatePopulation(PopulationModel &model, const double aParameters[], int nmembers, int nparameters, Canvas aCanvas[], ThreadPool *pool)
+{
+    PopulationJob job;
     
-    fnAdjustParameters();
+    if (nmembers<1) {return;}
+    job.aParameters=aParameters; job.nmembers=nmembers; job.nparameters=nparameters;
+    job.aCanvas=aCanvas;
+    job.aQ=NULL; job.adQ=NULL; job.aR=NULL; job.nQ=0;
+    job.nblocks=(pool!=NULL) ? pool->fnGetThreads() : 1;
+    if (job.nblocks>nmembers) {job.nblocks=nmembers;}
+    fnRunPopulation(model, job, pool);
+}
+
+//reflectivities of all members into aR, laid out [member][Q], adQ may be NULL for no smearing
+void fnEvaluatePopulation(PopulationModel &model, const double aParameters[], int nmembers, int nparameters, const double aQ[], const double adQ[], int nQ, double aR[], ThreadPool *pool)
+{
+    PopulationJob job;
     
+    if (nmembers<1) {return;}
+    job.aParameters=aParameters; job.nmembers=nmembers; job.nparameters=nparameters;
+    job.aQ=aQ; job.adQ=adQ; job.aR=aR; job.nQ=nQ;
+    job.nblocks=(pool!=NULL) ? pool->fnGetThreads() : 1;
+    if (job.nblocks>nmembers) {job.nblocks=nmembers;}
+    job.aCanvas=new Canvas[job.nblocks];
+    fnRunPopulation(model, job, pool);
+    delete [] job.aCanvas;
 }
-tBLM_HC18_POPC_POPE_Cardiolipin18T1_CHOL::tBLM_HC18_POPC_POPE_Cardiolipin18T1_CHOL()
+
+//------------------------------------------------------------------------------------------------------
+//re-evaluation of statistical results
+//every block of a batch writes its samples into a temporary store of its own, the blocks are appended to
+//the result store in order after the batch
+
+class RecreateJob
+{
+public:
+    PopulationModel **aModels;
+    MolDump *aDumps;
+    Canvas *aCanvas;
+    const double *aParameters, *aChisq;
+    double *aProfiles;                      //rho of every member on the envelope grid, or NULL
+    double *aProperties;                    //property values of every member, or NULL
+    const PropertyStatistics *pProperties;
+    ContourHistogram **aContours;           //one per block, or NULL
+    int nmembers, nparameters, nblocks, ioffset, nenvelope;
+    bool bMolgroups, bChisq;
+};
+
+void fnRecreateTask(int iblock, void *pData)
+{
+    RecreateJob *job;
+    PopulationModel *model;
+    Canvas *canvas;
+    FILE *fp;
+    double *aZ, *arho, *amu;
+    int i, j, istart, iend, ndimension=0;
+    
+    job=(RecreateJob *) pData;
+    model=job->aModels[iblock];
+    canvas=&job->aCanvas[iblock];
+    fp=job->aDumps[iblock].fp;
+    aZ=NULL; arho=NULL; amu=NULL;
+    istart=(job->nmembers*iblock)/job->nblocks;
+    iend=(job->nmembers*(iblock+1))/job->nblocks;
+    for (i=istart; i<iend; i++) {
+        model->fnEvaluate(job->aParameters+i*job->nparameters, *canvas);
+        if (canvas->dimension!=ndimension) {
+            delete [] aZ;
+            ndimension=canvas->dimension;
+            aZ=new double[3*ndimension+1];
+            arho=aZ+ndimension;
+            amu=arho+ndimension;
+            canvas->fnSetSlabKey(0);        //a new buffer may reuse the address of the last one
+        }
+        for (j=0; j<ndimension; j++) {aZ[j]=double(j)*canvas->stepsize;}
+        fnWriteCanvas2Buffer(*canvas, &model->bulkrho, &model->bulkmu, 1, model->normarea, arho, amu);
+        
+        fprintf(fp, "#SAMPLE %i", job->ioffset+i);
+        for (j=0; j<job->nparameters; j++) {fprintf(fp, " %.17g", job->aParameters[i*job->nparameters+j]);}
+        if (job->bChisq) {fprintf(fp, " %.17g", job->aChisq[i]);}
+        fprintf(fp, "\n");
+        job->aDumps[iblock].fnWriteProfile(ndimension, aZ, arho, amu);
+        if (job->bMolgroups) {model->fnWriteGroups(MolSink(job->aDumps[iblock]), ndimension, canvas->stepsize);}
+        if ((job->aProfiles!=NULL) && (ndimension>0)) {
+            for (j=0; j<job->nenvelope; j++) {job->aProfiles[i*job->nenvelope+j]=arho[(j<ndimension) ? j : ndimension-1];}
+        }
+        if (job->aContours!=NULL) {job->aContours[iblock]->fnAdd(arho, ndimension, canvas->stepsize);}
+        if (job->aProperties!=NULL) {
+            for (j=0; j<job->pProperties->nproperties; j++) {job->aProperties[i*job->pProperties->nproperties+j]=0;}
+            model->fnGetProperties(*job->pProperties, job->aProperties+i*job->pProperties->nproperties);
+        }
+    }
+    delete [] aZ;
+}
+
+//appends what was written to a temporary store since its file header line to fp, then positions the
+//temporary store behind the header line again for the next batch
+void fnAppendStore(FILE *fp, MolDump &dump)
+{
+    char buffer[65536];
+    long iHeader, iEnd;
+    size_t n, nleft;
+    int c;
+    
+    fflush(dump.fp);
+    iEnd=ftell(dump.fp);
+    rewind(dump.fp);
+    while (((c=fgetc(dump.fp))!=EOF) && (c!='\n')) {}
+    iHeader=ftell(dump.fp);
+    nleft=(iEnd>iHeader) ? size_t(iEnd-iHeader) : 0;
+    while (nleft>0) {
+        n=fread(buffer, 1, (nleft<sizeof(buffer)) ? nleft : sizeof(buffer), dump.fp);
+        if (n==0) {break;}
+        fwrite(buffer, 1, n, fp);
+        nleft-=n;
+    }
+    fseek(dump.fp, iHeader, SEEK_SET);
+}
+
+//evaluates every sample of cStatFile, see StatReader. Returns the number of samples written or -1 if the
+//stat file or the store cannot be opened or lacks a parameter
+int fnRecreateStatistical(PopulationModel &model, const char *cStatFile, const char *acNames[], int nparameters, const char *cStoreFile, bool bMolgroups, bool bCompress, ThreadPool *pool, int nbatch, Envelope *pEnvelope, PropertyStatistics *pProperties, ContourHistogram *pContour)
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+    StatReader reader;
+    MolDump store;
+    RecreateJob job;
+    FILE *fp, *fpTemp;
+    double *aParameters, *aChisq;
+    int i, n, nblocks, nsamples=0;
     
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    if (nbatch<1) {nbatch=1;}
+    if (reader.fnOpen(cStatFile, acNames, nparameters)==false) {
+        if (reader.cMissing[0]!=0) {fprintf(stderr, "fnRecreateStatistical: %s not in %s \n", reader.cMissing, cStatFile);}
+        return -1;
+    }
+    fp=store.fnOpen(cStoreFile, bCompress);
+    if (fp==NULL) {return -1;}
+    fprintf(fp, "#PARAMETERS");
+    for (i=0; i<nparameters; i++) {fprintf(fp, " %s", acNames[i]);}
+    if (reader.bChisq) {fprintf(fp, " Chisq");}
+    fprintf(fp, "\n");
     
-    headgroup1_2->vol=262;                //PE volume and length are estimates
-    headgroup2_2->vol=262;
-    headgroup1_2->nSL=5.4558E-04;
-    headgroup2_2->nSL=5.4558E-04;
-    headgroup1_2->l=7.7;
-    headgroup2_2->l=7.7;
+    nblocks=(pool!=NULL) ? pool->fnGetThreads() : 1;
+    if (nblocks>nbatch) {nblocks=nbatch;}
+    job.aModels=new PopulationModel*[nblocks];
+    job.aDumps=new MolDump[nblocks];
+    job.aCanvas=new Canvas[nblocks];
+    for (i=0; i<nblocks; i++) {
+        job.aModels[i]=model.fnClone();
+        fpTemp=tmpfile();
+        if (fpTemp!=NULL) {job.aDumps[i].fnOpen(fpTemp, bCompress);}
+    }
+    aParameters=new double[nbatch*nparameters+1];
+    aChisq=new double[nbatch];
+    job.aParameters=aParameters; job.aChisq=aChisq;
+    job.nparameters=nparameters; job.bMolgroups=bMolgroups; job.bChisq=reader.bChisq;
+    job.aProfiles=NULL; job.nenvelope=0;
+    if (pEnvelope!=NULL) {
+        job.nenvelope=pEnvelope->dimension;
+        job.aProfiles=new double[size_t(nbatch)*job.nenvelope+1];
+    }
+    job.aProperties=NULL; job.pProperties=pProperties;
+    if (pProperties!=NULL) {job.aProperties=new double[size_t(nbatch)*pProperties->nproperties+1];}
+    job.aContours=NULL;
+    if (pContour!=NULL) {
+        job.aContours=new ContourHistogram*[nblocks];
+        for (i=0; i<nblocks; i++) {job.aContours[i]=new ContourHistogram(pContour->z0, pContour->dz, pContour->nz, pContour->y0, pContour->dy, pContour->ny, pContour->bRasterize);}
+    }
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    for (i=0; i<nblocks; i++) {
+        if (job.aDumps[i].fp==NULL) {nsamples=-1;}
+    }
+    while (nsamples>=0) {
+        n=reader.fnRead(aParameters, aChisq, nbatch);
+        if (n==0) {break;}
+        job.nmembers=n; job.ioffset=nsamples;
+        job.nblocks=(nblocks>n) ? n : nblocks;
+        if (pool!=NULL) {pool->fnParallelFor(0, job.nblocks, fnRecreateTask, &job);}
+        else {fnRecreateTask(0, &job);}
+        for (i=0; i<job.nblocks; i++) {fnAppendStore(fp, job.aDumps[i]);}
+        if (pEnvelope!=NULL) {
+            for (i=0; i<n; i++) {pEnvelope->fnAdd(job.aProfiles+i*job.nenvelope, job.nenvelope);}
+        }
+        if (pProperties!=NULL) {
+            for (i=0; i<n; i++) {pProperties->fnAdd(job.aProperties+i*pProperties->nproperties);}
+        }
+        nsamples+=n;
+    }
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    for (i=0; i<nblocks; i++) {delete job.aModels[i];}
+    delete [] job.aModels;
+    delete [] job.aDumps;
+    delete [] job.aCanvas;
+    delete [] aParameters;
+    delete [] aChisq;
+    delete [] job.aProfiles;
+    delete [] job.aProperties;
+    if (pContour!=NULL) {
+        for (i=0; i<nblocks; i++) {pContour->fnMerge(*job.aContours[i]); delete job.aContours[i];}
+        delete [] job.aContours;
+    }
+    return nsamples;
+}
+
+//------------------------------------------------------------------------------------------------------
+//Bootstrap
+//------------------------------------------------------------------------------------------------------
+
+unsigned long long RandomStream::fnNext()
+{
+    unsigned long long z;
     
-    headgroup1_3->vol=684.40;                //cardiolipin
-    headgroup2_3->vol=684.40;
-    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup1_3->l=9.56;
-    headgroup2_3->l=9.56;
+    iState+=0x9E3779B97F4A7C15ULL;
+    z=iState;
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    return z^(z>>31);
+}
+
+double RandomStream::fnUniform()
+{
+    return (double(fnNext()>>11)+0.5)*(1.0/9007199254740992.0);
+}
+
+double RandomStream::fnGauss()
+{
+    double r, phi;
     
-    volacyllipid_3=972*2;
-    nslacyllipid_3=-2.09e-4*2;
-    volmethyllipid_3=98.8*2;
-    nslmethyllipid_3=-9.15e-5*2;
+    if (bSpare) {bSpare=false; return dSpare;}
+    r=sqrt(-2*log(fnUniform()));
+    phi=2*M_PI*fnUniform();
+    dSpare=r*sin(phi);
+    bSpare=true;
+    return r*cos(phi);
+}
+
+//three data columns (NIST) or four (ISIS), the rows are counted before reading. As in rs.py, a file is
+//rejected if a row that is neither a comment nor blank has another number of columns than the first one
+bool ReflData::fnLoad(const char *cFileName)
+{
+    FILE *fp;
+    char cLine[4096], *cPos, *cEnd;
+    double a[5];
+    double *aColumns[4]={NULL, NULL, NULL, NULL};
+    int i, n, ncolumns=0, nrows=0, ipass;
+    bool bCorrupt=false;
+    
+    fp=fopen(cFileName, "r");
+    if (fp==NULL) {return false;}
+    delete [] aValues;
+    aValues=NULL; aQ=NULL; adQ=NULL; aR=NULL; adR=NULL; nQ=0;
+    for (ipass=0; (ipass<2) && (bCorrupt==false); ipass++) {
+        n=0;
+        while (fgets(cLine, sizeof(cLine), fp)!=NULL) {
+            if (strchr(cLine, '#')!=NULL) {continue;}
+            cPos=cLine;
+            for (i=0; i<5; i++) {
+                a[i]=strtod(cPos, &cEnd);
+                if (cEnd==cPos) {break;}
+                cPos=cEnd;
+            }
+            while (isspace((unsigned char) *cPos)) {cPos++;}
+            if ((i==0) && (*cPos==0)) {continue;}
+            if (ncolumns==0) {ncolumns=i;}
+            if ((i<3) || (i>4) || (i!=ncolumns) || (*cPos!=0)) {bCorrupt=true; break;}
+            if (ipass==1) {
+                for (i=0; i<ncolumns; i++) {aColumns[i][n]=a[i];}
+            }
+            n++;
+        }
+        if ((ipass==0) && (bCorrupt==false)) {
+            nrows=n;
+            aValues=new double[4*nrows+1];
+            for (i=0; i<4; i++) {aColumns[i]=aValues+i*nrows;}
+            rewind(fp);
+        }
+    }
+    fclose(fp);
+    if (bCorrupt) {
+        delete [] aValues;
+        aValues=NULL;
+        return false;
+    }
+    nQ=nrows;
+    aQ=aColumns[0];
+    if (ncolumns==4) {adQ=aColumns[1]; aR=aColumns[2]; adR=aColumns[3];}
+    else {adQ=NULL; aR=aColumns[1]; adR=aColumns[2];}
+    return (nrows>0);
+}
+
+//ten rounds of Philox4x32 on aCounter with the two 32 bit halves of iKey
+void fnPhilox(const unsigned int aCounter[4], unsigned long long iKey, unsigned int aOut[4])
+{
+    unsigned long long p0, p1;
+    unsigned int c0, c1, c2, c3, k0, k1;
+    int i;
     
-    fnAdjustParameters();
+    c0=aCounter[0]; c1=aCounter[1]; c2=aCounter[2]; c3=aCounter[3];
+    k0=(unsigned int) iKey; k1=(unsigned int) (iKey>>32);
+    for (i=0; i<10; i++) {
+        p0=0xD2511F53ULL*c0;
+        p1=0xCD9E8D57ULL*c2;
+        c0=((unsigned int) (p1>>32))^c1^k0;
+        c2=((unsigned int) (p0>>32))^c3^k1;
+        c1=(unsigned int) p1;
+        c3=(unsigned int) p0;
+        k0+=0x9E3779B9U; k1+=0xBB67AE85U;
+    }
+    aOut[0]=c0; aOut[1]=c1; aOut[2]=c2; aOut[3]=c3;
+}
+
+//one Philox block gives two uniforms of 53 bits, Box-Muller turns them into the deviates of two points.
+//The deviates are written to aR first and scaled in a second loop that has no dependencies
+void fnResample(const Dataset &data, unsigned long long iSeed, int iReplica, int iContrast, double aR[])
+{
+    unsigned int aCounter[4], aOut[4];
+    double u1, u2, r, phi;
+    int j, k;
+    
+    aCounter[1]=(unsigned int) iReplica;
+    aCounter[2]=(unsigned int) iContrast;
+    aCounter[3]=0;
+    for (j=0; 2*j<data.nQ; j++) {
+        aCounter[0]=(unsigned int) j;
+        fnPhilox(aCounter, iSeed, aOut);
+        u1=(double(((((unsigned long long) aOut[0])<<32)|aOut[1])>>11)+0.5)*(1.0/9007199254740992.0);
+        u2=(double(((((unsigned long long) aOut[2])<<32)|aOut[3])>>11)+0.5)*(1.0/9007199254740992.0);
+        r=sqrt(-2*log(u1));
+        phi=2*M_PI*u2;
+        aR[2*j]=r*cos(phi);
+        if (2*j+1<data.nQ) {aR[2*j+1]=r*sin(phi);}
+    }
+    for (k=0; k<data.nQ; k++) {aR[k]=data.aR[k]+data.adR[k]*aR[k];}
+}
+
+class ResampleJob
+{
+public:
+    const Dataset *data;
+    unsigned long long iSeed;
+    double *aR;
+    int iFirst, iContrast;
+};
+
+void fnResampleTask(int i, void *pData)
+{
+    ResampleJob *job;
     
+    job=(ResampleJob *) pData;
+    fnResample(*job->data, job->iSeed, job->iFirst+i, job->iContrast, job->aR+size_t(i)*job->data->nQ);
 }
 
-tBLM_HC18_POPC_POPE_KDO2_CHOL::tBLM_HC18_POPC_POPE_KDO2_CHOL()
+void fnResample(const Dataset &data, unsigned long long iSeed, int iFirst, int nreplicas, int iContrast, double aR[], ThreadPool *pool)
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+    ResampleJob job;
+    int i;
     
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    job.data=&data; job.iSeed=iSeed; job.aR=aR;
+    job.iFirst=iFirst; job.iContrast=iContrast;
+    if (pool!=NULL) {pool->fnParallelFor(0, nreplicas, fnResampleTask, &job);}
+    else {
+        for (i=0; i<nreplicas; i++) {fnResampleTask(i, &job);}
+    }
+}
+
+FitProblem::FitProblem()
+{
+    int i;
     
-    headgroup1_2->vol=262;                //PE volume and length are estimates
-    headgroup2_2->vol=262;
-    headgroup1_2->nSL=5.4558E-04;
-    headgroup2_2->nSL=5.4558E-04;
-    headgroup1_2->l=7.7;
-    headgroup2_2->l=7.7;
+    ncontrasts=0; nparameters=0;
+    for (i=0; i<MOLGROUPS_MAXCONTRASTS; i++) {aModels[i]=NULL;}
+    for (i=0; i<MOLGROUPS_MAXPARAMETERS; i++) {aLower[i]=0; aUpper[i]=0; aStart[i]=0; acNames[i]=NULL;}
+    nmaxevaluations=2000;
+    dTolerance=1e-8;
+}
+
+//sum of squared normalized residuals of n points, with aResiduals (may be NULL) also the residuals.
+//Four partial sums keep the additions independent, so the loop vectorizes without reassociating
+double fnChiSquareKernel(const double * MOLGROUPS_RESTRICT aModel, const double * MOLGROUPS_RESTRICT aR, const double * MOLGROUPS_RESTRICT adR, int n, double * MOLGROUPS_RESTRICT aResiduals)
+{
+    double s0=0, s1=0, s2=0, s3=0, d0, d1, d2, d3;
+    int k=0;
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    if (aResiduals==NULL) {
+        for (k=0; k+4<=n; k+=4) {
+            d0=(aModel[k]-aR[k])/adR[k];
+            d1=(aModel[k+1]-aR[k+1])/adR[k+1];
+            d2=(aModel[k+2]-aR[k+2])/adR[k+2];
+            d3=(aModel[k+3]-aR[k+3])/adR[k+3];
+            s0+=d0*d0; s1+=d1*d1; s2+=d2*d2; s3+=d3*d3;
+        }
+    }
+    else {
+        for (k=0; k+4<=n; k+=4) {
+            d0=(aModel[k]-aR[k])/adR[k];
+            d1=(aModel[k+1]-aR[k+1])/adR[k+1];
+            d2=(aModel[k+2]-aR[k+2])/adR[k+2];
+            d3=(aModel[k+3]-aR[k+3])/adR[k+3];
+            aResiduals[k]=d0; aResiduals[k+1]=d1; aResiduals[k+2]=d2; aResiduals[k+3]=d3;
+            s0+=d0*d0; s1+=d1*d1; s2+=d2*d2; s3+=d3*d3;
+        }
+    }
+    for (; k<n; k++) {
+        d0=(aModel[k]-aR[k])/adR[k];
+        if (aResiduals!=NULL) {aResiduals[k]=d0;}
+        s0+=d0*d0;
+    }
+    return (s0+s1)+(s2+s3);
+}
+
+//aModel holds the R(Q) of all contrasts one after the other, as do aResiduals. aChisq and aResiduals may
+//be NULL, returns the total
+double fnChiSquare(const double aModel[], const Dataset aData[], int ncontrasts, double aChisq[], double aResiduals[])
+{
+    double chisq=0, d;
+    size_t ioffset=0;
+    int i;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    for (i=0; i<ncontrasts; i++) {
+        d=fnChiSquareKernel(aModel+ioffset, aData[i].aR, aData[i].adR, aData[i].nQ, (aResiduals!=NULL) ? aResiduals+ioffset : NULL);
+        if (aChisq!=NULL) {aChisq[i]=d;}
+        chisq+=d;
+        ioffset+=aData[i].nQ;
+    }
+    return chisq;
+}
+
+//sum over all contrasts, aScratch holds the R(Q) of the largest data set. Every contrast is summed on its
+//own and then added in contrast order, as in ContrastEvaluator
+double fnChiSquare(PopulationModel *aModels[], const Dataset aData[], int ncontrasts, const double aParameters[], Canvas &canvas, double aScratch[], double aChisq[], double aResiduals[])
+{
+    PopulationModel *model;
+    double chisq=0, d;
+    size_t ioffset=0;
+    int i;
     
-    headgroup1_3->vol=200.00;                //KDO2
-    headgroup2_3->vol=1359.00;
-    headgroup1_3->fnSetnSL(3.1008E-03,3.45883E-03);
-    headgroup2_3->fnSetnSL(3.1008E-03,3.45883E-03);
-    headgroup1_3->l=12.0;
-    headgroup2_3->l=12.0;
+    for (i=0; i<ncontrasts; i++) {
+        model=aModels[i];
+        model->fnEvaluate(aParameters, canvas);
+        fnCanvasReflectivity(model->aTop, model->ntop, canvas, model->bulkrho, model->bulkmu, model->normarea, model->dTolerance, aData[i].aQ, aData[i].adQ, aData[i].nQ, model->nquadrature, aScratch);
+        d=fnChiSquareKernel(aScratch, aData[i].aR, aData[i].adR, aData[i].nQ, (aResiduals!=NULL) ? aResiduals+ioffset : NULL);
+        if (aChisq!=NULL) {aChisq[i]=d;}
+        chisq+=d;
+        ioffset+=aData[i].nQ;
+    }
+    return chisq;
+}
+
+ContrastEvaluator::ContrastEvaluator(const FitProblem &_problem)
+{
+    size_t ioffset=0;
+    int i;
     
-    volacyllipid_3=2066.40;
-    nslacyllipid_3=-7.9101E-04;
-    volmethyllipid_3=98.8*3;
-    nslmethyllipid_3=-9.15e-5*3;
+    problem=&_problem;
+    if ((problem->ncontrasts<0) || (problem->ncontrasts>MOLGROUPS_MAXCONTRASTS)) {
+        fprintf(stderr, "ContrastEvaluator: %i contrasts, at most MOLGROUPS_MAXCONTRASTS=%i \n", problem->ncontrasts, MOLGROUPS_MAXCONTRASTS);
+        abort();
+    }
+    nQ=1;
+    for (i=0; i<MOLGROUPS_MAXCONTRASTS; i++) {aModels[i]=NULL;}
+    for (i=0; i<problem->ncontrasts; i++) {
+        aModels[i]=problem->aModels[i]->fnClone();
+        aiOffset[i]=ioffset;
+        ioffset+=problem->aData[i].nQ;
+        if (problem->aData[i].nQ>nQ) {nQ=problem->aData[i].nQ;}
+    }
+    aScratch=new double[size_t(problem->ncontrasts)*nQ+1];
+    x=NULL; aResidualsOut=NULL;
+}
 
-    fnAdjustParameters();
+ContrastEvaluator::~ContrastEvaluator()
+{
+    int i;
     
+    for (i=0; i<MOLGROUPS_MAXCONTRASTS; i++) {delete aModels[i];}
+    delete [] aScratch;
 }
 
+void fnContrastTask(int iContrast, void *pData)
+{
+    ContrastEvaluator *evaluator;
+    PopulationModel *model;
+    const Dataset *data;
+    double *aR;
+    
+    evaluator=(ContrastEvaluator *) pData;
+    model=evaluator->aModels[iContrast];
+    data=&evaluator->problem->aData[iContrast];
+    aR=evaluator->aScratch+size_t(iContrast)*evaluator->nQ;
+    model->fnEvaluate(evaluator->x, evaluator->aCanvas[iContrast]);
+    fnCanvasReflectivity(model->aTop, model->ntop, evaluator->aCanvas[iContrast], model->bulkrho, model->bulkmu, model->normarea, model->dTolerance, data->aQ, data->adQ, data->nQ, model->nquadrature, aR);
+    evaluator->aContrastChisq[iContrast]=fnChiSquareKernel(aR, data->aR, data->adR, data->nQ, (evaluator->aResidualsOut!=NULL) ? evaluator->aResidualsOut+evaluator->aiOffset[iContrast] : NULL);
+}
 
+//as fnChiSquare on the models of the problem, aChisq and aResiduals may be NULL, returns the total
+double ContrastEvaluator::fnChiSquare(const double aParameters[], ThreadPool *pool, double aChisq[], double aResiduals[])
+{
+    double chisq=0;
+    int i;
+    
+    x=aParameters; aResidualsOut=aResiduals;
+    if (pool!=NULL) {pool->fnParallelFor(0, problem->ncontrasts, fnContrastTask, this);}
+    else {
+        for (i=0; i<problem->ncontrasts; i++) {fnContrastTask(i, this);}
+    }
+    for (i=0; i<problem->ncontrasts; i++) {
+        if (aChisq!=NULL) {aChisq[i]=aContrastChisq[i];}
+        chisq+=aContrastChisq[i];
+    }
+    return chisq;
+}
 
-tBLM_HC18_DOPC_POPG_Cardiolipin18T1_CHOL::tBLM_HC18_DOPC_POPG_Cardiolipin18T1_CHOL()
+//the simplex works on parameters scaled to 0..1 between their bounds, vertices are clamped to the box
+class SimplexState
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+public:
+    const FitProblem *problem;
+    PopulationModel **aModels;
+    const Dataset *aData;
+    Canvas canvas;
+    double *aScratch, *x;
+    int nevaluations;
     
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    double fnEvaluate(double u[]);
+};
+
+double SimplexState::fnEvaluate(double u[])
+{
+    int i;
     
-    headgroup1_2->vol=270;                //PG volume and length are estimates
-    headgroup2_2->vol=270;
-    headgroup1_2->nSL=7.1472e-4;
-    headgroup2_2->nSL=7.1472e-4;
-    headgroup1_2->l=7.8;
-    headgroup2_2->l=7.8;
+    for (i=0; i<problem->nparameters; i++) {
+        if (u[i]<0) {u[i]=0;}
+        if (u[i]>1) {u[i]=1;}
+        x[i]=problem->aLower[i]+u[i]*(problem->aUpper[i]-problem->aLower[i]);
+    }
+    nevaluations++;
+    return fnChiSquare(aModels, aData, problem->ncontrasts, x, canvas, aScratch);
+}
+
+//Nelder-Mead from aParameters, which returns the best vertex. Returns the number of evaluations
+int fnFitSimplex(const FitProblem &problem, PopulationModel *aModels[], const Dataset aData[], double aParameters[], double &chisq)
+{
+    SimplexState state;
+    double *u, *f, *c, *ur, *ue, *uc, *w;
+    double fr, fe, fc, dSpan;
+    int n, i, j, nQ=1, iBest, iWorst, iSecond;
     
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    n=problem.nparameters;
+    for (i=0; i<problem.ncontrasts; i++) {
+        if (aData[i].nQ>nQ) {nQ=aData[i].nQ;}
+    }
+    state.problem=&problem; state.aModels=aModels; state.aData=aData;
+    state.aScratch=new double[nQ];
+    state.x=new double[n+1];
+    state.nevaluations=0;
+    u=new double[(n+1)*n+1];
+    f=new double[n+1];
+    c=new double[4*n+1];
+    ur=c+n; ue=ur+n; uc=ue+n;
+    
+    for (i=0; i<n; i++) {
+        dSpan=problem.aUpper[i]-problem.aLower[i];
+        u[i]=(dSpan!=0) ? (aParameters[i]-problem.aLower[i])/dSpan : 0;
+    }
+    for (j=1; j<=n; j++) {
+        for (i=0; i<n; i++) {u[j*n+i]=u[i];}
+        u[j*n+j-1]+=(u[j-1]>0.9) ? -0.1 : 0.1;
+    }
+    for (j=0; j<=n; j++) {f[j]=state.fnEvaluate(u+j*n);}
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    while (state.nevaluations<problem.nmaxevaluations) {
+        iBest=0; iWorst=0;
+        for (j=1; j<=n; j++) {
+            if (f[j]<f[iBest]) {iBest=j;}
+            if (f[j]>f[iWorst]) {iWorst=j;}
+        }
+        iSecond=iBest;
+        for (j=0; j<=n; j++) {
+            if ((j!=iWorst) && (f[j]>f[iSecond])) {iSecond=j;}
+        }
+        if (fabs(f[iWorst]-f[iBest])<=problem.dTolerance*fabs(f[iBest])) {break;}
+        
+        w=u+iWorst*n;
+        for (i=0; i<n; i++) {
+            c[i]=0;
+            for (j=0; j<=n; j++) {
+                if (j!=iWorst) {c[i]+=u[j*n+i];}
+            }
+            c[i]/=double(n);
+            ur[i]=2*c[i]-w[i];
+        }
+        fr=state.fnEvaluate(ur);
+        if (fr<f[iBest]) {
+            for (i=0; i<n; i++) {ue[i]=3*c[i]-2*w[i];}
+            fe=state.fnEvaluate(ue);
+            if (fe<fr) {memcpy(w, ue, n*sizeof(double)); f[iWorst]=fe;}
+            else {memcpy(w, ur, n*sizeof(double)); f[iWorst]=fr;}
+        }
+        else if (fr<f[iSecond]) {
+            memcpy(w, ur, n*sizeof(double)); f[iWorst]=fr;
+        }
+        else {
+            for (i=0; i<n; i++) {uc[i]=(fr<f[iWorst]) ? 0.5*(c[i]+ur[i]) : 0.5*(c[i]+w[i]);}
+            fc=state.fnEvaluate(uc);
+            if (fc<fmin(fr, f[iWorst])) {
+                memcpy(w, uc, n*sizeof(double)); f[iWorst]=fc;
+            }
+            else {
+                for (j=0; j<=n; j++) {
+                    if (j==iBest) {continue;}
+                    for (i=0; i<n; i++) {u[j*n+i]=0.5*(u[iBest*n+i]+u[j*n+i]);}
+                    f[j]=state.fnEvaluate(u+j*n);
+                }
+            }
+        }
+    }
     
-    headgroup1_3->vol=684.40;                //cardiolipin
-    headgroup2_3->vol=684.40;
-    headgroup1_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup2_3->fnSetnSL(2.82E-06,2.97E-06);
-    headgroup1_3->l=9.56;
-    headgroup2_3->l=9.56;
+    iBest=0;
+    for (j=1; j<=n; j++) {
+        if (f[j]<f[iBest]) {iBest=j;}
+    }
+    for (i=0; i<n; i++) {aParameters[i]=problem.aLower[i]+u[iBest*n+i]*(problem.aUpper[i]-problem.aLower[i]);}
+    chisq=f[iBest];
     
-    volacyllipid_3=972*2;
-    nslacyllipid_3=-2.09e-4*2;
-    volmethyllipid_3=98.8*2;
-    nslmethyllipid_3=-9.15e-5*2;
+    delete [] state.aScratch;
+    delete [] state.x;
+    delete [] u;
+    delete [] f;
+    delete [] c;
+    return state.nevaluations;
+}
+
+class BootstrapJob
+{
+public:
+    const FitProblem *problem;
+    unsigned long long iSeed;
+    double *aResults;
+};
+
+//fits replica iReplica of the data into aRow (parameters, then chi-square)
+void fnBootstrapReplica(const FitProblem &problem, unsigned long long iSeed, int iReplica, double aRow[])
+{
+    PopulationModel *aModels[MOLGROUPS_MAXCONTRASTS];
+    Dataset aData[MOLGROUPS_MAXCONTRASTS];
+    double *aR[MOLGROUPS_MAXCONTRASTS];
+    int i;
+    
+    for (i=0; i<problem.ncontrasts; i++) {
+        aModels[i]=problem.aModels[i]->fnClone();
+        aData[i]=problem.aData[i];
+        aR[i]=new double[aData[i].nQ+1];
+        fnResample(problem.aData[i], iSeed, iReplica, i, aR[i]);
+        aData[i].aR=aR[i];
+    }
+    for (i=0; i<problem.nparameters; i++) {aRow[i]=problem.aStart[i];}
+    fnFitSimplex(problem, aModels, aData, aRow, aRow[problem.nparameters]);
+    
+    for (i=0; i<problem.ncontrasts; i++) {
+        delete aModels[i];
+        delete [] aR[i];
+    }
+}
+
+void fnBootstrapTask(int iReplica, void *pData)
+{
+    BootstrapJob *job;
     
-    fnAdjustParameters();
+    job=(BootstrapJob *) pData;
+    fnBootstrapReplica(*job->problem, job->iSeed, iReplica, job->aResults+iReplica*(job->problem->nparameters+1));
 }
 
+//aResults holds nreplicas rows of nparameters+1 values
+void fnBootstrap(const FitProblem &problem, int nreplicas, unsigned long long iSeed, double aResults[], ThreadPool *pool)
+{
+    BootstrapJob job;
+    int i;
+    
+    job.problem=&problem; job.iSeed=iSeed; job.aResults=aResults;
+    if (pool!=NULL) {pool->fnParallelFor(0, nreplicas, fnBootstrapTask, &job);}
+    else {
+        for (i=0; i<nreplicas; i++) {fnBootstrapTask(i, &job);}
+    }
+}
 
-tBLM_HC18_DOPC_CERNP_STEARIC_CHOL::tBLM_HC18_DOPC_CERNP_STEARIC_CHOL()
+bool fnWriteResults(const FitProblem &problem, const double aResults[], int nreplicas, const char *cFileName)
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+    FILE *fp;
+    int i, j;
     
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    fp=fopen(cFileName, "w");
+    if (fp==NULL) {return false;}
+    for (j=0; j<problem.nparameters; j++) {
+        if (problem.acNames[j]!=NULL) {fprintf(fp, "%s ", problem.acNames[j]);}
+        else {fprintf(fp, "p%i ", j);}
+    }
+    fprintf(fp, "Chisq \n");
+    for (i=0; i<nreplicas; i++) {
+        for (j=0; j<=problem.nparameters; j++) {fprintf(fp, "%.17g ", aResults[i*(problem.nparameters+1)+j]);}
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------
+//MCMC
+//------------------------------------------------------------------------------------------------------
+//the chains are split into one contiguous block per thread, every block evaluates with its own clones of
+//the contrast models
+
+class DreamJob
+{
+public:
+    const FitProblem *problem;
+    PopulationModel **aModels;
+    Canvas *aCanvas;
+    double *aScratch;
+    const double *aStates;
+    double *aChisq;                         //NULL when sampling
+    double *aProfiles, *aProperties;
+    const PropertyStatistics *pProperties;
+    ContourHistogram **aContours;
+    int nchains, nblocks, nQ, nenvelope;
+};
+
+void fnDreamTask(int iblock, void *pData)
+{
+    DreamJob *job;
+    PopulationModel **aModels;
+    Canvas *canvas;
+    const double *aState;
+    double *arho=NULL;
+    int i, j, istart, iend, ndimension=0, nparameters, nproperties;
+    
+    job=(DreamJob *) pData;
+    aModels=job->aModels+iblock*job->problem->ncontrasts;
+    canvas=&job->aCanvas[iblock];
+    nparameters=job->problem->nparameters;
+    istart=(job->nchains*iblock)/job->nblocks;
+    iend=(job->nchains*(iblock+1))/job->nblocks;
+    for (i=istart; i<iend; i++) {
+        aState=job->aStates+i*nparameters;
+        if (job->aChisq!=NULL) {
+            job->aChisq[i]=fnChiSquare(aModels, job->problem->aData, job->problem->ncontrasts, aState, *canvas, job->aScratch+iblock*job->nQ);
+            continue;
+        }
+        aModels[0]->fnEvaluate(aState, *canvas);
+        if (canvas->dimension!=ndimension) {
+            delete [] arho;
+            ndimension=canvas->dimension;
+            arho=new double[ndimension+1];
+            canvas->fnSetSlabKey(0);
+        }
+        fnWriteCanvas2Buffer(*canvas, &aModels[0]->bulkrho, &aModels[0]->bulkmu, 1, aModels[0]->normarea, arho, NULL);
+        if ((job->aProfiles!=NULL) && (ndimension>0)) {
+            for (j=0; j<job->nenvelope; j++) {job->aProfiles[i*job->nenvelope+j]=arho[(j<ndimension) ? j : ndimension-1];}
+        }
+        if (job->aContours!=NULL) {job->aContours[iblock]->fnAdd(arho, ndimension, canvas->stepsize);}
+        if (job->aProperties!=NULL) {
+            nproperties=job->pProperties->nproperties;
+            for (j=0; j<nproperties; j++) {job->aProperties[i*nproperties+j]=0;}
+            aModels[0]->fnGetProperties(*job->pProperties, job->aProperties+i*nproperties);
+        }
+    }
+    delete [] arho;
+}
+
+DreamSampler::DreamSampler(const FitProblem &_problem, int _nchains, unsigned long long _iSeed)
+{
+    int i;
     
-    headgroup1_2->vol=200;                //PG volume and length are estimates
-    headgroup2_2->vol=200;
-    headgroup1_2->fnSetnSL(1.60733E-06,3.68965E-06);
-    headgroup2_2->fnSetnSL(1.60733E-06,3.68965E-06);
-    headgroup1_2->l=7.8;
-    headgroup2_2->l=7.8;
+    problem=&_problem;
+    nchains=(_nchains<3) ? 3 : _nchains;
+    nparameters=problem->nparameters;
+    iSeed=_iSeed;
+    ngenerations=0; nsamples=0;
+    nburn=0; nthin=1; ndelta=3; ncr=3;
+    aChains=new double[nchains*nparameters+1];
+    aChisq=new double[nchains];
+    aProposals=new double[nchains*nparameters+1];
+    aProposalChisq=new double[nchains];
+    aRandom=new RandomStream[nchains];
+    for (i=0; i<nchains; i++) {
+        aRandom[i]=RandomStream(fnHashBytes(&i, sizeof(int), fnHashBytes(&iSeed, sizeof(unsigned long long))));
+        aChisq[i]=0;
+    }
+    for (i=0; i<nchains*nparameters; i++) {aChains[i]=0;}
+    pEnvelope=NULL; pProperties=NULL; pContour=NULL;
+    aProfiles=NULL; aProperties=NULL; nenvelope=0; nproperties=0;
+    fpSamples=NULL; iResumeOffset=-1;
+    aModels=NULL; aCanvas=NULL; aScratch=NULL; aContours=NULL;
+    nblocks=0; nQ=1;
+    for (i=0; i<problem->ncontrasts; i++) {
+        if (problem->aData[i].nQ>nQ) {nQ=problem->aData[i].nQ;}
+    }
+}
+
+DreamSampler::~DreamSampler()
+{
+    int i;
     
-    volacyllipid_2=1093.00;
-    nslacyllipid_2=-3.8310E-04;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    fnCloseSamples();
+    for (i=0; i<nblocks*problem->ncontrasts; i++) {delete aModels[i];}
+    if (aContours!=NULL) {
+        for (i=0; i<nblocks; i++) {delete aContours[i];}
+    }
+    delete [] aModels;
+    delete [] aCanvas;
+    delete [] aScratch;
+    delete [] aContours;
+    delete [] aChains;
+    delete [] aChisq;
+    delete [] aProposals;
+    delete [] aProposalChisq;
+    delete [] aRandom;
+    delete [] aProfiles;
+    delete [] aProperties;
+}
+
+//clones are kept between calls and only remade when the number of threads changes
+void DreamSampler::fnSetBlocks(ThreadPool *pool)
+{
+    int i, n;
+    
+    n=(pool!=NULL) ? pool->fnGetThreads() : 1;
+    if (n>nchains) {n=nchains;}
+    if (n==nblocks) {return;}
+    for (i=0; i<nblocks*problem->ncontrasts; i++) {delete aModels[i];}
+    if (aContours!=NULL) {
+        for (i=0; i<nblocks; i++) {delete aContours[i];}
+    }
+    delete [] aModels;
+    delete [] aCanvas;
+    delete [] aScratch;
+    delete [] aContours;
+    aContours=NULL;
+    nblocks=n;
+    aModels=new PopulationModel*[nblocks*problem->ncontrasts+1];
+    for (i=0; i<nblocks*problem->ncontrasts; i++) {aModels[i]=problem->aModels[i%problem->ncontrasts]->fnClone();}
+    aCanvas=new Canvas[nblocks];
+    aScratch=new double[nblocks*nQ];
+}
+
+void DreamSampler::fnEvaluate(const double aStates[], double aResults[], bool bSample, ThreadPool *pool)
+{
+    DreamJob job;
+    int i;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    fnSetBlocks(pool);
+    job.problem=problem; job.aModels=aModels; job.aCanvas=aCanvas; job.aScratch=aScratch;
+    job.aStates=aStates; job.aChisq=(bSample) ? NULL : aResults;
+    job.nchains=nchains; job.nblocks=nblocks; job.nQ=nQ;
+    job.aProfiles=NULL; job.aProperties=NULL; job.pProperties=pProperties; job.aContours=NULL; job.nenvelope=0;
+    if (bSample) {
+        if ((pEnvelope!=NULL) && (pEnvelope->dimension!=nenvelope)) {
+            delete [] aProfiles;
+            nenvelope=pEnvelope->dimension;
+            aProfiles=new double[size_t(nchains)*nenvelope+1];
+        }
+        if ((pProperties!=NULL) && (pProperties->nproperties!=nproperties)) {
+            delete [] aProperties;
+            nproperties=pProperties->nproperties;
+            aProperties=new double[size_t(nchains)*nproperties+1];
+        }
+        if ((pContour!=NULL) && (aContours==NULL)) {
+            aContours=new ContourHistogram*[nblocks];
+            for (i=0; i<nblocks; i++) {aContours[i]=new ContourHistogram(pContour->z0, pContour->dz, pContour->nz, pContour->y0, pContour->dy, pContour->ny, pContour->bRasterize);}
+        }
+        if (pEnvelope!=NULL) {job.aProfiles=aProfiles; job.nenvelope=nenvelope;}
+        if (pProperties!=NULL) {job.aProperties=aProperties;}
+        if (pContour!=NULL) {job.aContours=aContours;}
+    }
+    if (pool!=NULL) {pool->fnParallelFor(0, nblocks, fnDreamTask, &job);}
+    else {fnDreamTask(0, &job);}
+}
+
+void DreamSampler::fnInitialize(ThreadPool *pool)
+{
+    int i, j;
     
-    headgroup1_3->vol=55;                //cardiolipin
-    headgroup2_3->vol=55;
-    headgroup1_3->fnSetnSL(1.8254E-04,1.8254E-04);
-    headgroup2_3->fnSetnSL(1.8254E-04,1.8254E-04);
-    headgroup1_3->l=5.0;
-    headgroup2_3->l=5.0;
+    for (i=0; i<nchains; i++) {
+        for (j=0; j<nparameters; j++) {
+            if (i==0) {aChains[j]=problem->aStart[j];}
+            else {aChains[i*nparameters+j]=problem->aLower[j]+aRandom[i].fnUniform()*(problem->aUpper[j]-problem->aLower[j]);}
+        }
+    }
+    fnEvaluate(aChains, aChisq, false, pool);
+    ngenerations=0;
+}
+
+//difference of delta pairs of other chains, applied to a random subspace and folded back into the bounds
+void DreamSampler::fnPropose(int iChain, double aProposal[])
+{
+    RandomStream *random;
+    const double *aState;
+    int aiPick[2*MOLGROUPS_MAXDELTA];
+    bool abCross[MOLGROUPS_MAXPARAMETERS];
+    double dCrossover, dGamma, dSpan, dx;
+    int i, j, k, n, npick, ndelta_max, delta, nselected=0, nfree=0;
+    
+    random=&aRandom[iChain];
+    aState=aChains+iChain*nparameters;
+    memcpy(aProposal, aState, nparameters*sizeof(double));
+    
+    ndelta_max=(nchains-1)/2;
+    if (ndelta_max>ndelta) {ndelta_max=ndelta;}
+    if (ndelta_max>MOLGROUPS_MAXDELTA) {ndelta_max=MOLGROUPS_MAXDELTA;}
+    if (ndelta_max<1) {ndelta_max=1;}
+    delta=1+int(random->fnUniform()*ndelta_max);
+    npick=0;
+    while (npick<2*delta) {
+        k=int(random->fnUniform()*nchains);
+        if (k==iChain) {continue;}
+        for (i=0; i<npick; i++) {
+            if (aiPick[i]==k) {break;}
+        }
+        if (i==npick) {aiPick[npick++]=k;}
+    }
     
-    volacyllipid_3=504.20;
-    nslacyllipid_3=-1.7905E-04;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
+    n=(ncr<1) ? 1 : ncr;
+    dCrossover=double(1+int(random->fnUniform()*n))/double(n);
+    for (j=0; j<nparameters; j++) {
+        abCross[j]=false;
+        if (problem->aUpper[j]<=problem->aLower[j]) {continue;}
+        nfree++;
+        if (random->fnUniform()<dCrossover) {abCross[j]=true; nselected++;}
+    }
+    if (nfree==0) {return;}
+    if (nselected==0) {
+        k=int(random->fnUniform()*nfree);
+        for (j=0; j<nparameters; j++) {
+            if (problem->aUpper[j]<=problem->aLower[j]) {continue;}
+            if (k==0) {abCross[j]=true; break;}
+            k--;
+        }
+        nselected=1;
+    }
     
-    fnAdjustParameters();
+    dGamma=(ngenerations%5==4) ? 1 : 2.38/sqrt(2*delta*nselected);
+    for (j=0; j<nparameters; j++) {
+        if (abCross[j]==false) {continue;}
+        dSpan=problem->aUpper[j]-problem->aLower[j];
+        dx=0;
+        for (i=0; i<delta; i++) {dx+=aChains[aiPick[2*i]*nparameters+j]-aChains[aiPick[2*i+1]*nparameters+j];}
+        dx=(1+0.1*(random->fnUniform()-0.5))*dGamma*dx+1e-6*dSpan*random->fnGauss();
+        aProposal[j]+=dx;
+        if (aProposal[j]<problem->aLower[j]) {aProposal[j]=2*problem->aLower[j]-aProposal[j];}
+        if (aProposal[j]>problem->aUpper[j]) {aProposal[j]=2*problem->aUpper[j]-aProposal[j];}
+        if ((aProposal[j]<problem->aLower[j]) || (aProposal[j]>problem->aUpper[j])) {aProposal[j]=problem->aLower[j]+random->fnUniform()*dSpan;}
+    }
 }
 
-tBLM_HC18_DOPC_CERNP_LIGNOCERIC_CHOL::tBLM_HC18_DOPC_CERNP_LIGNOCERIC_CHOL()
+void DreamSampler::fnRemoveOutliers()
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
+    double *aSorted;
+    double q1, q3;
+    int i, iBest;
     
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
+    aSorted=new double[nchains];
+    for (i=0; i<nchains; i++) {aSorted[i]=(aChisq[i]==aChisq[i]) ? aChisq[i] : HUGE_VAL;}
+    std::sort(aSorted, aSorted+nchains);
+    q1=aSorted[nchains/4];
+    q3=aSorted[(3*nchains)/4];
+    delete [] aSorted;
+    iBest=fnGetBest(NULL);
+    for (i=0; i<nchains; i++) {
+        if ((aChisq[i]>q3+2*(q3-q1)) || (aChisq[i]!=aChisq[i])) {
+            memcpy(aChains+i*nparameters, aChains+iBest*nparameters, nparameters*sizeof(double));
+            aChisq[i]=aChisq[iBest];
+        }
+    }
+}
+
+int DreamSampler::fnGetBest(double aParameters[])
+{
+    int i, iBest=0;
     
-    headgroup1_2->vol=200;                //PG volume and length are estimates
-    headgroup2_2->vol=200;
-    headgroup1_2->fnSetnSL(1.60733E-06,3.68965E-06);
-    headgroup2_2->fnSetnSL(1.60733E-06,3.68965E-06);
-    headgroup1_2->l=7.8;
-    headgroup2_2->l=7.8;
+    for (i=1; i<nchains; i++) {
+        if ((aChisq[i]<aChisq[iBest]) || (aChisq[iBest]!=aChisq[iBest])) {iBest=i;}
+    }
+    if (aParameters!=NULL) {memcpy(aParameters, aChains+iBest*nparameters, nparameters*sizeof(double));}
+    return iBest;
+}
+
+void DreamSampler::fnSample(ThreadPool *pool)
+{
+    int i, j;
     
-    volacyllipid_2=1093.00;
-    nslacyllipid_2=-3.8310E-04;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
+    if ((pEnvelope!=NULL) || (pProperties!=NULL) || (pContour!=NULL)) {fnEvaluate(aChains, NULL, true, pool);}
+    for (i=0; i<nchains; i++) {
+        if (fpSamples!=NULL) {
+            for (j=0; j<nparameters; j++) {fprintf(fpSamples, "%.17g ", aChains[i*nparameters+j]);}
+            fprintf(fpSamples, "%.17g \n", aChisq[i]);
+        }
+        if (pEnvelope!=NULL) {pEnvelope->fnAdd(aProfiles+i*nenvelope, nenvelope);}
+        if (pProperties!=NULL) {pProperties->fnAdd(aProperties+i*nproperties);}
+    }
+    if (pContour!=NULL) {
+        for (i=0; i<nblocks; i++) {
+            pContour->fnMerge(*aContours[i]);
+            aContours[i]->fnClear();
+        }
+    }
+    nsamples+=nchains;
+}
+
+int DreamSampler::fnRun(int _ngenerations, ThreadPool *pool)
+{
+    double dLogRatio;
+    int i, n, naccepted=0;
     
-    volchol=630;
-    nslchol=1.3215e-4;
+    for (n=0; n<_ngenerations; n++) {
+        for (i=0; i<nchains; i++) {fnPropose(i, aProposals+i*nparameters);}
+        fnEvaluate(aProposals, aProposalChisq, false, pool);
+        for (i=0; i<nchains; i++) {
+            if (aProposalChisq[i]!=aProposalChisq[i]) {continue;}
+            dLogRatio=(aChisq[i]-aProposalChisq[i])/2;
+            if ((dLogRatio>=0) || (log(aRandom[i].fnUniform())<dLogRatio)) {
+                memcpy(aChains+i*nparameters, aProposals+i*nparameters, nparameters*sizeof(double));
+                aChisq[i]=aProposalChisq[i];
+                naccepted++;
+            }
+        }
+        ngenerations++;
+        if (ngenerations<=nburn) {fnRemoveOutliers();}
+        else if ((nthin<2) || ((ngenerations-nburn)%nthin==0)) {fnSample(pool);}
+    }
+    if (fpSamples!=NULL) {fflush(fpSamples);}
+    return naccepted;
+}
+
+//SErr.dat layout, parameter names from the FitProblem. The header is not repeated when appending.
+//After Checkpoint::fnGetSampler, appending first cuts off the rows written after the checkpoint, and
+//fails if the file is shorter than it was then
+bool DreamSampler::fnOpenSamples(const char *cFileName, bool bAppend)
+{
+    int j;
+    bool bOk=true;
+    
+    fnCloseSamples();
+    fpSamples=fopen(cFileName, (bAppend) ? "a" : "w");
+    if (fpSamples==NULL) {return false;}
+    fseek(fpSamples, 0, SEEK_END);
+    if (bAppend && (iResumeOffset>=0)) {
+        bOk=(ftell(fpSamples)>=iResumeOffset) && (ftruncate(fileno(fpSamples), off_t(iResumeOffset))==0);
+        iResumeOffset=-1;
+        if (bOk==false) {fnCloseSamples(); return false;}
+        fseek(fpSamples, 0, SEEK_END);
+    }
+    if (ftell(fpSamples)>0) {return true;}
+    for (j=0; j<nparameters; j++) {
+        if (problem->acNames[j]!=NULL) {fprintf(fpSamples, "%s ", problem->acNames[j]);}
+        else {fprintf(fpSamples, "p%i ", j);}
+    }
+    fprintf(fpSamples, "Chisq \n");
+    return true;
+}
+
+void DreamSampler::fnCloseSamples()
+{
+    if (fpSamples!=NULL) {fclose(fpSamples);}
+    fpSamples=NULL;
+}
+
+//bytes written to the samples file so far, -1 if none is open
+long long DreamSampler::fnSamplesOffset() const
+{
+    if (fpSamples==NULL) {return -1;}
+    fflush(fpSamples);
+    fseek(fpSamples, 0, SEEK_END);
+    return (long long) ftell(fpSamples);
+}
+
+//------------------------------------------------------------------------------------------------------
+//Checkpoints
+//------------------------------------------------------------------------------------------------------
+//section header: type and name as char[32], payload size as uint64. Integers in payloads are int32,
+//flags int32 0 or 1
+
+#define MOLGROUPS_SECTIONNAME 32
+
+Checkpoint::Checkpoint()
+{
+    aData=NULL;
+    nbytes=0; ncapacity=0; iSection=0;
+    iCursor=0; iEnd=0;
+}
+
+Checkpoint::~Checkpoint()
+{
+    free(aData);
+}
+
+void Checkpoint::fnClear()
+{
+    nbytes=0; iSection=0;
+    iCursor=0; iEnd=0;
+}
+
+void Checkpoint::fnPut(const void *p, size_t n)
+{
+    unsigned long long iSize;
+    size_t nnew, iHeader;
     
-    headgroup1_3->vol=55;                //cardiolipin
-    headgroup2_3->vol=55;
-    headgroup1_3->fnSetnSL(1.8254E-04,1.8254E-04);
-    headgroup2_3->fnSetnSL(1.8254E-04,1.8254E-04);
-    headgroup1_3->l=5.0;
-    headgroup2_3->l=5.0;
+    if (nbytes+n>ncapacity) {
+        nnew=(ncapacity>0) ? 2*ncapacity : 65536;
+        while (nnew<nbytes+n) {nnew*=2;}
+        aData=(char *) realloc(aData, nnew);
+        if (aData==NULL) {throw std::bad_alloc();}
+        ncapacity=nnew;
+    }
+    memcpy(aData+nbytes, p, n);
+    nbytes+=n;
+    //the payload size of the open section follows its type and name
+    iHeader=iSection+2*MOLGROUPS_SECTIONNAME+sizeof(unsigned long long);
+    if (nbytes>=iHeader) {
+        iSize=nbytes-iHeader;
+        memcpy(aData+iHeader-sizeof(unsigned long long), &iSize, sizeof(unsigned long long));
+    }
+}
+
+void Checkpoint::fnBeginSection(const char *cType, const char *cName)
+{
+    char cField[MOLGROUPS_SECTIONNAME];
+    unsigned long long iSize=0;
     
-    volacyllipid_3=673.40;
-    nslacyllipid_3=-2.2904E-04;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
+    iSection=nbytes;
+    memset(cField, 0, MOLGROUPS_SECTIONNAME);
+    strncpy(cField, cType, MOLGROUPS_SECTIONNAME-1);
+    fnPut(cField, MOLGROUPS_SECTIONNAME);
+    memset(cField, 0, MOLGROUPS_SECTIONNAME);
+    strncpy(cField, cName, MOLGROUPS_SECTIONNAME-1);
+    fnPut(cField, MOLGROUPS_SECTIONNAME);
+    fnPut(&iSize, sizeof(unsigned long long));
+}
+
+//positions the cursor on the payload of the last matching section
+bool Checkpoint::fnFindSection(const char *cType, const char *cName)
+{
+    unsigned long long iSize;
+    size_t i=0, iPayload;
+    bool bFound=false;
     
-    fnAdjustParameters();
+    while (i+2*MOLGROUPS_SECTIONNAME+sizeof(unsigned long long)<=nbytes) {
+        memcpy(&iSize, aData+i+2*MOLGROUPS_SECTIONNAME, sizeof(unsigned long long));
+        iPayload=i+2*MOLGROUPS_SECTIONNAME+sizeof(unsigned long long);
+        if (iSize>nbytes-iPayload) {break;}
+        if ((strncmp(aData+i, cType, MOLGROUPS_SECTIONNAME-1)==0) && (strncmp(aData+i+MOLGROUPS_SECTIONNAME, cName, MOLGROUPS_SECTIONNAME-1)==0)) {
+            iCursor=iPayload;
+            iEnd=iPayload+size_t(iSize);
+            bFound=true;
+        }
+        i=iPayload+size_t(iSize);
+    }
+    return bFound;
 }
 
+bool Checkpoint::fnTake(void *p, size_t n)
+{
+    if (n>iEnd-iCursor) {return false;}
+    memcpy(p, aData+iCursor, n);
+    iCursor+=n;
+    return true;
+}
 
-tBLM_HC18_DOPC_DOPS_PIP_CHOL_domain::tBLM_HC18_DOPC_DOPS_PIP_CHOL_domain()
+bool Checkpoint::fnSave(const char *cFileName)
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	tether_domain->vol=380;
-	tether_domain->nSL=2.1864e-4;
-	tetherg_domain->vol=110;
-	tetherg_domain->nSL=1.8654e-4;
-	
-    volacyllipid=972;
-    nslacyllipid=-2.09e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=999;
-    nslacyltether=-2.25e-4;
-    
-	headgroup1_2->vol=260;                //PS volume and length are estimates
-	headgroup2_2->vol=260;
-	headgroup1_2->nSL=8.4513e-4;
-	headgroup2_2->nSL=8.4513e-4;
-	headgroup1_2->l=7.5;
-	headgroup2_2->l=7.5;
-	headgroup1_2_domain->vol=260;                //PS volume and length are estimates
-	headgroup2_2_domain->vol=260;
-	headgroup1_2_domain->nSL=8.4513e-4;
-	headgroup2_2_domain->nSL=8.4513e-4;
-	headgroup1_2_domain->l=7.5;
-	headgroup2_2_domain->l=7.5;
-	
-    volacyllipid_2=972;
-    nslacyllipid_2=-2.09e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-	
-    volchol=630;
-    nslchol=1.3215e-4;
-	
-	headgroup1_3->vol=500;                //PIP volume and length are estimates
-	headgroup2_3->vol=500;
-	headgroup1_3->nSL=1.22e-3;
-	headgroup2_3->nSL=1.22e-3;
-	headgroup1_3->l=12.0;
-	headgroup2_3->l=12.0;
-	headgroup1_3_domain->vol=500;                //PIP volume and length are estimates
-	headgroup2_3_domain->vol=500;
-	headgroup1_3_domain->nSL=1.22e-3;
-	headgroup2_3_domain->nSL=1.22e-3;
-	headgroup1_3_domain->l=12.0;
-	headgroup2_3_domain->l=12.0;
-	
-    volacyllipid_3=1025;
-    nslacyllipid_3=-7.5785e-5;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
+    FILE *fp;
+    char cTemp[4096];
+    int iTest=1;
+    bool bOk;
     
-    fnAdjustParameters();
+    snprintf(cTemp, sizeof(cTemp), "%s.tmp", cFileName);
+    fp=fopen(cTemp, "wb");
+    if (fp==NULL) {return false;}
+    fprintf(fp, "MOLGROUPS-CHECKPOINT 2 %s\n", (*((char *) &iTest)==1) ? "little" : "big");
+    bOk=(fwrite(aData, 1, nbytes, fp)==nbytes);
+    bOk=(fflush(fp)==0) && bOk;
+    bOk=(fclose(fp)==0) && bOk;
+    if (bOk) {bOk=(rename(cTemp, cFileName)==0);}
+    if (bOk==false) {remove(cTemp);}
+    return bOk;
+}
+
+//replaces the sections held by the checkpoint
+bool Checkpoint::fnLoad(const char *cFileName)
+{
+    FILE *fp;
+    char cHeader[256];
+    long iSize, iStart;
+    int iTest=1;
+    bool bOk;
+    
+    fp=fopen(cFileName, "rb");
+    if (fp==NULL) {return false;}
+    snprintf(cHeader, sizeof(cHeader), "MOLGROUPS-CHECKPOINT 2 %s\n", (*((char *) &iTest)==1) ? "little" : "big");
+    bOk=(fgets(cHeader+128, 128, fp)!=NULL) && (strcmp(cHeader, cHeader+128)==0);
+    if (bOk==false) {
+        fprintf(stderr, "Checkpoint: %s is not a checkpoint of this version and byte order \n", cFileName);
+        fclose(fp);
+        return false;
+    }
+    iStart=ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    iSize=ftell(fp)-iStart;
+    fseek(fp, iStart, SEEK_SET);
+    fnClear();
+    if (size_t(iSize)>ncapacity) {
+        free(aData);
+        aData=(char *) malloc(size_t(iSize)+1);
+        if (aData==NULL) {throw std::bad_alloc();}
+        ncapacity=size_t(iSize);
+    }
+    bOk=(fread(aData, 1, size_t(iSize), fp)==size_t(iSize));
+    fclose(fp);
+    nbytes=(bOk) ? size_t(iSize) : 0;
+    return bOk;
+}
+
+void Checkpoint::fnAddValues(const char *cName, const double aValues[], int n)
+{
+    fnBeginSection("values", cName);
+    if (n>0) {fnPut(aValues, sizeof(double)*n);}
+}
+
+int Checkpoint::fnGetValues(const char *cName, double aValues[], int nmax)
+{
+    int n;
     
+    if (fnFindSection("values", cName)==false) {return -1;}
+    n=int((iEnd-iCursor)/sizeof(double));
+    if (n>nmax) {n=nmax;}
+    fnTake(aValues, sizeof(double)*n);
+    return n;
 }
 
-tBLM_WC14_POPC_POPS_POPA::tBLM_WC14_POPC_POPS_POPA()
+//the class name is the one the object's own fnRegisterParameters gives, registry selects the parameters
+void Checkpoint::fnAddObject(const char *cName, nSLDObj &object, const ParameterRegistry &registry)
 {
-	tether->vol=380;
-	tether->nSL=2.1864e-4;
-	tetherg->vol=110;
-	tetherg->nSL=1.8654e-4;
-	
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
-    
-	headgroup1_2->vol=280;                //PS volume and length are estimates
-	headgroup2_2->vol=280;
-	headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-	headgroup1_2->l=8.1;
-	headgroup2_2->l=8.1;
-	
-    volacyllipid_2=925;
-    nslacyllipid_2=-2.67e-4;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=-9.15e-5;
-    
-	headgroup1_3->vol=174;                //was 174
-	headgroup2_3->vol=174;                //was 174
-	headgroup1_3->nSL=6.2364e-4;          //was 6.2364e-4
-	headgroup2_3->nSL=6.2364e-4;          //was 6.2364e-4
-	headgroup1_3->l=5;
-	headgroup2_3->l=5;
-	
-    volacyllipid_3=925;
-    nslacyllipid_3=-2.67e-4;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
- 
-    fnAdjustParameters();
+    ParameterRegistry own;
+    char cField[MOLGROUPS_SECTIONNAME*2];
+    double dValue;
+    int i, n=0;
     
+    object.fnRegisterParameters(own);
+    fnBeginSection("object", cName);
+    memset(cField, 0, sizeof(cField));
+    strncpy(cField, own.cClass, sizeof(cField)-1);
+    fnPut(cField, sizeof(cField));
+    for (i=0; i<registry.nparameters; i++) {
+        if (registry.aParameters[i].bDerived==false) {n++;}
+    }
+    fnPut(&n, sizeof(int));
+    for (i=0; i<registry.nparameters; i++) {
+        if (registry.aParameters[i].bDerived) {continue;}
+        memset(cField, 0, sizeof(cField));
+        strncpy(cField, registry.aParameters[i].cName, MOLGROUPS_SECTIONNAME-1);
+        fnPut(cField, MOLGROUPS_SECTIONNAME);
+        dValue=fnValue(object.fnGetParameter(registry, registry.aParameters[i].cName));
+        fnPut(&dValue, sizeof(double));
+    }
 }
 
-tBLM_WC14_POPC_d31POPC_POPA::tBLM_WC14_POPC_d31POPC_POPA()
+//parameters the registry does not know are skipped. The registry must be one of the object's class
+bool Checkpoint::fnGetObject(const char *cName, nSLDObj &object, const ParameterRegistry &registry)
+{
+    ParameterRegistry own;
+    char cField[MOLGROUPS_SECTIONNAME*2];
+    double dValue;
+    int i, j, n;
+    
+    object.fnRegisterParameters(own);
+    if (strcmp(own.cClass, registry.cClass)!=0) {return false;}
+    if (fnFindSection("object", cName)==false) {return false;}
+    if (fnTake(cField, sizeof(cField))==false) {return false;}
+    cField[sizeof(cField)-1]=0;
+    if (strncmp(cField, own.cClass, sizeof(cField)-1)!=0) {return false;}
+    if (fnTake(&n, sizeof(int))==false) {return false;}
+    for (i=0; i<n; i++) {
+        if ((fnTake(cField, MOLGROUPS_SECTIONNAME)==false) || (fnTake(&dValue, sizeof(double))==false)) {return false;}
+        cField[MOLGROUPS_SECTIONNAME-1]=0;
+        j=registry.fnFind(cField);
+        if ((j<0) || registry.aParameters[j].bDerived) {continue;}
+        *(mgreal *)((char *)&object+registry.aParameters[j].iOffset)=dValue;
+    }
+    object.fnSetDirty();
+    object.fnAdjustParameters();
+    return true;
+}
+
+void Checkpoint::fnAddSampler(const char *cName, const DreamSampler &sampler)
+{
+    int aiHeader[8], i, iSpare;
+    long long iOffset=sampler.fnSamplesOffset();
+    
+    fnBeginSection("sampler", cName);
+    aiHeader[0]=sampler.nchains; aiHeader[1]=sampler.nparameters;
+    aiHeader[2]=sampler.ngenerations; aiHeader[3]=sampler.nsamples;
+    aiHeader[4]=sampler.nburn; aiHeader[5]=sampler.nthin;
+    aiHeader[6]=sampler.ndelta; aiHeader[7]=sampler.ncr;
+    fnPut(aiHeader, sizeof(aiHeader));
+    fnPut(&sampler.iSeed, sizeof(unsigned long long));
+    fnPut(&iOffset, sizeof(long long));
+    fnPut(sampler.aChains, sizeof(double)*sampler.nchains*sampler.nparameters);
+    fnPut(sampler.aChisq, sizeof(double)*sampler.nchains);
+    for (i=0; i<sampler.nchains; i++) {
+        iSpare=(sampler.aRandom[i].bSpare) ? 1 : 0;
+        fnPut(&sampler.aRandom[i].iState, sizeof(unsigned long long));
+        fnPut(&iSpare, sizeof(int));
+        fnPut(&sampler.aRandom[i].dSpare, sizeof(double));
+    }
+}
+
+bool Checkpoint::fnGetSampler(const char *cName, DreamSampler &sampler)
+{
+    int aiHeader[8], i, iSpare;
+    unsigned long long iSeed=0;
+    long long iOffset=-1;
+    size_t n;
+    bool bRead;
+    
+    if (fnFindSection("sampler", cName)==false) {return false;}
+    if (fnTake(aiHeader, sizeof(aiHeader))==false) {return false;}
+    if ((aiHeader[0]!=sampler.nchains) || (aiHeader[1]!=sampler.nparameters)) {return false;}
+    n=sizeof(unsigned long long)+sizeof(long long)+sizeof(double)*sampler.nchains*(sampler.nparameters+1)+(sizeof(unsigned long long)+sizeof(int)+sizeof(double))*sampler.nchains;
+    if (iEnd-iCursor<n) {return false;}
+    bRead=fnTake(&iSeed, sizeof(unsigned long long));
+    bRead=bRead && fnTake(&iOffset, sizeof(long long));
+    bRead=bRead && fnTake(sampler.aChains, sizeof(double)*sampler.nchains*sampler.nparameters);
+    bRead=bRead && fnTake(sampler.aChisq, sizeof(double)*sampler.nchains);
+    for (i=0; (i<sampler.nchains) && bRead; i++) {
+        iSpare=0;
+        bRead=fnTake(&sampler.aRandom[i].iState, sizeof(unsigned long long));
+        bRead=bRead && fnTake(&iSpare, sizeof(int));
+        bRead=bRead && fnTake(&sampler.aRandom[i].dSpare, sizeof(double));
+        sampler.aRandom[i].bSpare=(iSpare!=0);
+    }
+    if (bRead==false) {return false;}
+    sampler.iSeed=iSeed; sampler.iResumeOffset=iOffset;
+    sampler.ngenerations=aiHeader[2]; sampler.nsamples=aiHeader[3];
+    sampler.nburn=aiHeader[4]; sampler.nthin=aiHeader[5];
+    sampler.ndelta=aiHeader[6]; sampler.ncr=aiHeader[7];
+    return true;
+}
+
+//exact samples as nsamples values per bin, or the P2 markers
+void Checkpoint::fnPutEnvelope(const Envelope &envelope)
+{
+    int aiHeader[4], i;
+    
+    aiHeader[0]=envelope.dimension; aiHeader[1]=envelope.nmaxsamples;
+    aiHeader[2]=envelope.nsamples; aiHeader[3]=(envelope.bStreaming) ? 1 : 0;
+    fnPut(aiHeader, sizeof(aiHeader));
+    fnPut(&envelope.stepsize, sizeof(double));
+    if (envelope.bStreaming) {
+        fnPut(envelope.aHeights, sizeof(double)*envelope.dimension*MOLGROUPS_QUANTILES*5);
+        fnPut(envelope.aPositions, sizeof(double)*envelope.dimension*MOLGROUPS_QUANTILES*5);
+    }
+    else {
+        for (i=0; i<envelope.dimension; i++) {fnPut(envelope.aSamples+size_t(i)*envelope.nmaxsamples, sizeof(double)*envelope.nsamples);}
+    }
+}
+
+//the envelope must have the dimension and capacity it was saved with
+bool Checkpoint::fnTakeEnvelope(Envelope &envelope)
+{
+    int aiHeader[4], i;
+    double stepsize;
+    size_t n;
+    
+    if (fnTake(aiHeader, sizeof(aiHeader))==false) {return false;}
+    if ((aiHeader[0]!=envelope.dimension) || (aiHeader[1]!=envelope.nmaxsamples)) {return false;}
+    if ((aiHeader[2]<0) || ((aiHeader[3]==0) && (aiHeader[2]>envelope.nmaxsamples))) {return false;}
+    n=(aiHeader[3]!=0) ? 2*sizeof(double)*envelope.dimension*MOLGROUPS_QUANTILES*5 : sizeof(double)*envelope.dimension*aiHeader[2];
+    if (fnTake(&stepsize, sizeof(double))==false) {return false;}
+    if (iEnd-iCursor<n) {return false;}
+    if (aiHeader[3]!=0) {
+        if (envelope.bStreaming==false) {
+            delete [] envelope.aSamples;
+            envelope.aSamples=NULL;
+            envelope.aHeights=new double[size_t(envelope.dimension)*MOLGROUPS_QUANTILES*5];
+            envelope.aPositions=new double[size_t(envelope.dimension)*MOLGROUPS_QUANTILES*5];
+        }
+        fnTake(envelope.aHeights, sizeof(double)*envelope.dimension*MOLGROUPS_QUANTILES*5);
+        fnTake(envelope.aPositions, sizeof(double)*envelope.dimension*MOLGROUPS_QUANTILES*5);
+    }
+    else {
+        if (envelope.bStreaming) {
+            delete [] envelope.aHeights; envelope.aHeights=NULL;
+            delete [] envelope.aPositions; envelope.aPositions=NULL;
+            envelope.aSamples=new double[size_t(envelope.dimension)*envelope.nmaxsamples+1];
+        }
+        for (i=0; i<envelope.dimension; i++) {fnTake(envelope.aSamples+size_t(i)*envelope.nmaxsamples, sizeof(double)*aiHeader[2]);}
+    }
+    envelope.stepsize=stepsize;
+    envelope.nsamples=aiHeader[2];
+    envelope.bStreaming=(aiHeader[3]!=0);
+    return true;
+}
+
+void Checkpoint::fnAddEnvelope(const char *cName, const Envelope &envelope)
 {
-    tether->vol=380;
-    tether->nSL=2.1864e-4;
-    tetherg->vol=110;
-    tetherg->nSL=1.8654e-4;
-    
-    volacyllipid=925;
-    nslacyllipid=-2.67e-4;
-    volmethyllipid=98.8;
-    nslmethyllipid=-9.15e-5;
-    volmethyltether=98.8;
-    nslmethyltether=-9.15e-5;
-    volacyltether=850;
-    nslacyltether=-3.5834e-4;
-    
-    headgroup1_2->vol=280;                //PS volume and length are estimates
-    headgroup2_2->vol=280;
-    headgroup1_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup2_2->fnSetnSL(8.4513e-4,1.1576E-03);
-    headgroup1_2->l=8.1;
-    headgroup2_2->l=8.1;
+    fnBeginSection("envelope", cName);
+    fnPutEnvelope(envelope);
+}
+
+bool Checkpoint::fnGetEnvelope(const char *cName, Envelope &envelope)
+{
+    if (fnFindSection("envelope", cName)==false) {return false;}
+    return fnTakeEnvelope(envelope);
+}
+
+void Checkpoint::fnAddProperties(const char *cName, const PropertyStatistics &properties)
+{
+    int aiHeader[4];
     
-    volacyllipid_2=925;
-    nslacyllipid_2=2.9618E-03;
-    volmethyllipid_2=98.8;
-    nslmethyllipid_2=2.2087e-4;
+    fnBeginSection("properties", cName);
+    aiHeader[0]=properties.nproperties; aiHeader[1]=properties.nsamples;
+    aiHeader[2]=properties.nmaxsamples; aiHeader[3]=(properties.pEnvelope!=NULL) ? 1 : 0;
+    fnPut(aiHeader, sizeof(aiHeader));
+    fnPut(properties.acNames, MOLGROUPS_NAMELENGTH*properties.nproperties);
+    fnPut(properties.aMean, sizeof(double)*properties.nproperties);
+    fnPut(properties.aM2, sizeof(double)*properties.nproperties);
+    if (properties.pEnvelope!=NULL) {fnPutEnvelope(*properties.pEnvelope);}
+}
 
-    headgroup1_3->vol=174;                //was 174
-    headgroup2_3->vol=174;                //was 174
-    headgroup1_3->nSL=6.2364e-4;          //was 6.2364e-4
-    headgroup2_3->nSL=6.2364e-4;          //was 6.2364e-4
-    headgroup1_3->l=5;
-    headgroup2_3->l=5;
+//replaces the property table, the names need not be registered again
+bool Checkpoint::fnGetProperties(const char *cName, PropertyStatistics &properties)
+{
+    int aiHeader[4];
     
-    volacyllipid_3=925;
-    nslacyllipid_3=-2.67e-4;
-    volmethyllipid_3=98.8;
-    nslmethyllipid_3=-9.15e-5;
- 
-    fnAdjustParameters();
+    if (fnFindSection("properties", cName)==false) {return false;}
+    if (fnTake(aiHeader, sizeof(aiHeader))==false) {return false;}
+    if ((aiHeader[0]<0) || (aiHeader[0]>MOLGROUPS_MAXPROPERTIES)) {return false;}
+    if (iEnd-iCursor<(MOLGROUPS_NAMELENGTH+2*sizeof(double))*aiHeader[0]) {return false;}
+    fnTake(properties.acNames, MOLGROUPS_NAMELENGTH*aiHeader[0]);
+    fnTake(properties.aMean, sizeof(double)*aiHeader[0]);
+    fnTake(properties.aM2, sizeof(double)*aiHeader[0]);
+    properties.nproperties=aiHeader[0];
+    properties.nsamples=aiHeader[1];
+    properties.nmaxsamples=aiHeader[2];
+    delete properties.pEnvelope;
+    properties.pEnvelope=NULL;
+    if (aiHeader[3]!=0) {
+        properties.pEnvelope=new Envelope(properties.nproperties, 1, properties.nmaxsamples);
+        return fnTakeEnvelope(*properties.pEnvelope);
+    }
+    return true;
+}
+
+void Checkpoint::fnAddContour(const char *cName, const ContourHistogram &contour)
+{
+    int aiHeader[3];
+    double aGrid[4];
     
+    fnBeginSection("contour", cName);
+    aiHeader[0]=contour.nz; aiHeader[1]=contour.ny; aiHeader[2]=contour.nprofiles;
+    aGrid[0]=contour.z0; aGrid[1]=contour.dz; aGrid[2]=contour.y0; aGrid[3]=contour.dy;
+    fnPut(aiHeader, sizeof(aiHeader));
+    fnPut(aGrid, sizeof(aGrid));
+    fnPut(contour.aCounts, sizeof(unsigned int)*size_t(contour.nz)*contour.ny);
 }
 
+//the histogram must have the grid it was saved with
+bool Checkpoint::fnGetContour(const char *cName, ContourHistogram &contour)
+{
+    int aiHeader[3];
+    double aGrid[4];
+    
+    if (fnFindSection("contour", cName)==false) {return false;}
+    if ((fnTake(aiHeader, sizeof(aiHeader))==false) || (fnTake(aGrid, sizeof(aGrid))==false)) {return false;}
+    if ((aiHeader[0]!=contour.nz) || (aiHeader[1]!=contour.ny)) {return false;}
+    if ((aGrid[0]!=contour.z0) || (aGrid[1]!=contour.dz) || (aGrid[2]!=contour.y0) || (aGrid[3]!=contour.dy)) {return false;}
+    if (fnTake(contour.aCounts, sizeof(unsigned int)*size_t(contour.nz)*contour.ny)==false) {return false;}
+    contour.nprofiles=aiHeader[2];
+    return true;
+}
 
+#ifdef MOLGROUPS_DISTRIBUTED
+//------------------------------------------------------------------------------------------------------
+//Distributed work queue
 //------------------------------------------------------------------------------------------------------
-void fnWriteConstant(FILE *fp, const char *cName, double area, double nSLD, int dimension, double stepsize)
+//socket protocol: the coordinator sends an item index as 32 bit integer in network order, -1 ends the
+//worker; the worker answers with the index and nvalues doubles
+
+bool fnSendAll(int fd, const void *p, size_t n)
 {
-    int i;
-    double d;
+    const char *c=(const char *) p;
+    ssize_t i;
     
-    fprintf(fp, "Constant %s area %lf \n",cName, area);
-    fprintf(fp, "z%s a%s nsl%s \n",cName, cName, cName);
-	for (i=0; i<dimension; i++)
-	{
-        d=double(i)*stepsize;
-        fprintf(fp, "%lf %lf %e \n", d, area, nSLD*area*stepsize);
-	};
-	fprintf(fp,"\n");
+    while (n>0) {
+        i=send(fd, c, n, MSG_NOSIGNAL);
+        if (i<=0) {return false;}
+        c+=i; n-=size_t(i);
+    }
+    return true;
+}
+
+bool fnReceiveAll(int fd, void *p, size_t n)
+{
+    char *c=(char *) p;
+    ssize_t i;
     
+    while (n>0) {
+        i=recv(fd, c, n, 0);
+        if (i<=0) {return false;}
+        c+=i; n-=size_t(i);
+    }
+    return true;
 }
 
+bool fnSendItem(int fd, int iItem)
+{
+    unsigned int i=htonl((unsigned int) iItem);
+    
+    return fnSendAll(fd, &i, sizeof(i));
+}
 
-//------------------------------------------------------------------------------------------------------
-double fnClearCanvas(double aArea[], double anSL[], int dimension)
+WorkQueue::WorkQueue(int _nitems, int _nvalues)
 {
-	int j;
-	
-	for (j=0; j<dimension; j++) {
-		aArea[j]=0; anSL[j]=0;
-	};
-	
-	return 0;
+    int i;
+    
+    nitems=_nitems; nvalues=_nvalues; ndone=0;
+    aResults=new double[size_t(nitems)*nvalues+1];
+    aiState=new int[nitems+1];
+    for (i=0; i<nitems; i++) {aiState[i]=0;}
 }
-double fnClearCanvas(double aArea[], double anSL[], double aAbsorb[], int dimension)
+
+WorkQueue::~WorkQueue()
 {
-	int j;
-	
-	for (j=0; j<dimension; j++) {
-		aArea[j]=0; anSL[j]=0; aAbsorb[j]=0;
-	};
-	
-	return 0;
+    delete [] aResults;
+    delete [] aiState;
 }
-//------------------------------------------------------------------------------------------------------
-// Overlays one canvas onto another 
 
-void fnOverlayCanvasOnCanvas(double aArea[], double anSL[], double aArea2[], double anSL2[], int dimension, double dMaxArea)
+//returns the listening socket or -1, iPort 0 picks a free port
+int WorkQueue::fnListen(int iPort, bool bLoopback)
 {
-    double temparea;
-	int i;
-	
-	
-	for(i=0; i<dimension; i++)
-	{
-        temparea=aArea2[i]+aArea[i];
-        if (temparea>dMaxArea) 
-        {
-            anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-            anSL[i]=anSL[i]+anSL2[i];
-            aArea[i]=dMaxArea;
+    struct sockaddr_in address;
+    int fd, iOn=1;
+    
+    fd=socket(AF_INET, SOCK_STREAM, 0);
+    if (fd<0) {return -1;}
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+    memset(&address, 0, sizeof(address));
+    address.sin_family=AF_INET;
+    address.sin_addr.s_addr=htonl(bLoopback ? INADDR_LOOPBACK : INADDR_ANY);
+    address.sin_port=htons((unsigned short) iPort);
+    if ((bind(fd, (struct sockaddr *) &address, sizeof(address))<0) || (listen(fd, 64)<0)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//one pass of poll per event: new workers and finished items get the next pending item, items of
+//workers that disconnect become pending again. Gives up with items outstanding when no worker has been
+//connected for iIdle seconds (0 waits for ever) or, given the nprocesses local workers in aPid, when all
+//of them have exited; their pids are then cleared. Returns the number of items done
+int WorkQueue::fnServeSocket(int iListen, int iIdle, pid_t aPid[], int nprocesses)
+{
+    std::vector<struct pollfd> afd;
+    std::vector<int> aiItem, aiReceived;
+    std::vector<char *> aBuffer;
+    struct pollfd p;
+    size_t nmessage, i;
+    ssize_t n;
+    int fd, j, iNext=0, nalive=nprocesses;
+    time_t iLastWorker=time(NULL);
+    bool bDrop;
+    
+    nmessage=sizeof(unsigned int)+sizeof(double)*size_t(nvalues);
+    p.fd=iListen; p.events=POLLIN; p.revents=0;
+    afd.push_back(p); aiItem.push_back(-1); aiReceived.push_back(0); aBuffer.push_back(NULL);
+    
+    while (ndone<nitems) {
+        if (poll(&afd[0], afd.size(), 1000)<0) {continue;}       //the timeout hands requeued items to idle workers
+        if (afd[0].revents & POLLIN) {
+            fd=accept(iListen, NULL, NULL);
+            if (fd>=0) {
+                p.fd=fd;
+                afd.push_back(p); aiItem.push_back(-1); aiReceived.push_back(0); aBuffer.push_back(new char[nmessage]);
+            }
         }
-        else 
-        {
-            //printf("Bin %i Areainc %f area now %f nSLinc %g nSL now %g \n", i, aArea2[i], aArea[i], anSL2[1], anSL[i]);
-            aArea[i]=aArea[i]+aArea2[i];
-            anSL[i]=anSL[i]+anSL2[i];
+        for (i=1; i<afd.size(); i++) {
+            bDrop=false;
+            if (afd[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                n=recv(afd[i].fd, aBuffer[i]+aiReceived[i], nmessage-aiReceived[i], 0);
+                if (n<=0) {bDrop=true;}
+                else {
+                    aiReceived[i]+=int(n);
+                    if (size_t(aiReceived[i])==nmessage) {
+                        j=int(ntohl(*((unsigned int *) aBuffer[i])));
+                        if ((j>=0) && (j<nitems) && (aiState[j]!=2)) {
+                            memcpy(aResults+size_t(j)*nvalues, aBuffer[i]+sizeof(unsigned int), sizeof(double)*nvalues);
+                            aiState[j]=2;
+                            ndone++;
+                        }
+                        aiItem[i]=-1; aiReceived[i]=0;
+                    }
+                }
+            }
+            if ((bDrop==false) && (aiItem[i]<0)) {
+                while ((iNext<nitems) && (aiState[iNext]!=0)) {iNext++;}
+                if (iNext<nitems) {
+                    if (fnSendItem(afd[i].fd, iNext)) {aiItem[i]=iNext; aiState[iNext]=1;}
+                    else {bDrop=true;}
+                }
+            }
+            if (bDrop) {
+                if ((aiItem[i]>=0) && (aiState[aiItem[i]]==1)) {
+                    aiState[aiItem[i]]=0;
+                    if (aiItem[i]<iNext) {iNext=aiItem[i];}
+                }
+                close(afd[i].fd);
+                delete [] aBuffer[i];
+                afd.erase(afd.begin()+i); aiItem.erase(aiItem.begin()+i); aiReceived.erase(aiReceived.begin()+i); aBuffer.erase(aBuffer.begin()+i);
+                i--;
+            }
         }
-	};
-};
-void fnOverlayCanvasOnCanvas(double aArea[], double anSL[], double aAbsorb[], double aArea2[], double anSL2[], double aAbsorb2[], int dimension, double dMaxArea)
-{
-    double temparea;
-	int i;
-	
-	
-	for(i=0; i<dimension; i++)
-	{
-        temparea=aArea2[i]+aArea[i];
-        if (temparea>dMaxArea) 
-        {
-            anSL[i]=anSL[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-            anSL[i]=anSL[i]+anSL2[i];
-            aAbsorb[i]=aAbsorb[i]*(1-((temparea-dMaxArea)/aArea[i]));						//eliminate the overfilled portion using original content
-            aAbsorb[i]=aAbsorb[i]+aAbsorb2[i];
-            aArea[i]=dMaxArea;
+        if (afd.size()>1) {iLastWorker=time(NULL); continue;}
+        //no worker connected: a local worker that is still running has yet to connect
+        for (j=0; j<nprocesses; j++) {
+            if ((aPid[j]>0) && (waitpid(aPid[j], NULL, WNOHANG)==aPid[j])) {aPid[j]=0; nalive--;}
         }
-        else 
-        {
-            //printf("Bin %i Areainc %f area now %f nSLinc %g nSL now %g \n", i, aArea2[i], aArea[i], anSL2[1], anSL[i]);
-            aArea[i]=aArea[i]+aArea2[i];
-            anSL[i]=anSL[i]+anSL2[i];
-            aAbsorb[i]=aAbsorb[i]+aAbsorb2[i];
+        if ((nprocesses>0) && (nalive==0)) {break;}
+        if ((iIdle>0) && (time(NULL)-iLastWorker>=iIdle)) {break;}
+    }
+    
+    for (i=1; i<afd.size(); i++) {
+        fnSendItem(afd[i].fd, -1);
+        close(afd[i].fd);
+        delete [] aBuffer[i];
+    }
+    return ndone;
+}
+
+//serves until every item is done, returns the number of items or -1 if the port cannot be opened or no
+//worker was connected for iIdle seconds before the job was done. aiState tells which items were done
+int WorkQueue::fnServe(int iPort, int iIdle)
+{
+    int fd, n;
+    
+    fd=fnListen(iPort, false);
+    if (fd<0) {return -1;}
+    n=fnServeSocket(fd, iIdle, NULL, 0);
+    close(fd);
+    return (n==nitems) ? n : -1;
+}
+
+//returns the number of items or -1 if no worker could be started or all workers exited before the job
+//was done. Runs with fewer workers if fork fails after the first one
+int WorkQueue::fnRunLocal(int nprocesses, WorkTask fnTask, void *pData)
+{
+    struct sockaddr_in address;
+    socklen_t iLength=sizeof(address);
+    pid_t *aPid;
+    int fd, i, n;
+    
+    fd=fnListen(0, true);
+    if (fd<0) {return -1;}
+    getsockname(fd, (struct sockaddr *) &address, &iLength);
+    aPid=new pid_t[nprocesses+1];
+    for (i=0; i<nprocesses; i++) {
+        aPid[i]=fork();
+        if (aPid[i]<0) {break;}
+        if (aPid[i]==0) {
+            close(fd);
+            fnWork("127.0.0.1", ntohs(address.sin_port), fnTask, pData, nvalues);
+            _exit(0);
         }
-	};
-};
+    }
+    nprocesses=i;
+    n=(nprocesses>0) ? fnServeSocket(fd, 0, aPid, nprocesses) : 0;
+    close(fd);
+    for (i=0; i<nprocesses; i++) {
+        if (aPid[i]>0) {waitpid(aPid[i], NULL, 0);}
+    }
+    delete [] aPid;
+    return (n==nitems) ? n : -1;
+}
+
+//worker side, retries the connection for a while so that workers may start before the coordinator.
+//Returns the number of items computed or -1 if no connection could be made
+int fnWork(const char *cHost, int iPort, WorkTask fnTask, void *pData, int nvalues)
+{
+    struct addrinfo hints, *pAddress;
+    char cPort[16], *aMessage;
+    double *aValues;
+    unsigned int iItem;
+    int fd=-1, i, n=0, iOn=1;
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family=AF_INET;
+    hints.ai_socktype=SOCK_STREAM;
+    snprintf(cPort, sizeof(cPort), "%i", iPort);
+    for (i=0; i<100; i++) {
+        if (getaddrinfo(cHost, cPort, &hints, &pAddress)==0) {
+            fd=socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+            if ((fd>=0) && (connect(fd, pAddress->ai_addr, pAddress->ai_addrlen)==0)) {freeaddrinfo(pAddress); break;}
+            if (fd>=0) {close(fd);}
+            fd=-1;
+            freeaddrinfo(pAddress);
+        }
+        usleep(100000);
+    }
+    if (fd<0) {return -1;}
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+    
+    aMessage=new char[sizeof(unsigned int)+sizeof(double)*size_t(nvalues)];
+    aValues=new double[nvalues+1];
+    while (fnReceiveAll(fd, &iItem, sizeof(iItem))) {
+        i=int(ntohl(iItem));
+        if (i<0) {break;}
+        fnTask(i, aValues, pData);
+        memcpy(aMessage, &iItem, sizeof(unsigned int));
+        memcpy(aMessage+sizeof(unsigned int), aValues, sizeof(double)*size_t(nvalues));
+        if (fnSendAll(fd, aMessage, sizeof(unsigned int)+sizeof(double)*size_t(nvalues))==false) {break;}
+        n++;
+    }
+    delete [] aMessage;
+    delete [] aValues;
+    close(fd);
+    return n;
+}
 
-//------------------------------------------------------------------------------------------------------
-//writes out canvas to reflectivity model taking into account bulk nSLD
+//directory transport: "queue" holds the job id, nitems and nvalues. Item i is claimed by creating
+//<job>.i.claim and published as <job>.i.result, the job id keeps the files of different runs apart.
+//Files of earlier runs are removed at the start, only one coordinator may use a directory at a time.
+//A claim without result iLease seconds after the coordinator first saw it is removed, so that the item
+//of a worker that died is computed again; iLease must exceed the time an item takes.
+//Returns the number of items or -1 if the directory cannot be used
 
-void fnWriteCanvas2Model(double aArea[], double anSL[], fitinfo fit[], int gaussstart, int dimension, double stepsize, double dMaxArea, double normarea, int modelstart, int modelend)
+//the queue file and anything named <16 hex digits>.
+bool fnIsQueueFile(const char *cName)
 {
-    int i, j;
-    if (dMaxArea!=0)  {
-        for (i=modelstart; i<modelend+1; i++)
-            for (j=0; j<dimension; j++)  {
-                fit[i].m.rho[j+gaussstart]=(anSL[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.rho[fit[i].m.n-1];
+    int i;
+    
+    if ((strcmp(cName, "queue")==0) || (strcmp(cName, "queue.tmp")==0)) {return true;}
+    for (i=0; i<16; i++) {
+        if (isxdigit((unsigned char) cName[i])==0) {return false;}
+    }
+    return (cName[16]=='.');
+}
+
+int WorkQueue::fnServeDirectory(const char *cDirectory, int iLease)
+{
+    char cFile[4096], cTemp[4096], cJob[32], cHost[256];
+    unsigned long long iJob;
+    struct stat status;
+    struct dirent *entry;
+    DIR *directory;
+    FILE *fp;
+    time_t *aClaimed, iNow;
+    pid_t iPid;
+    int i;
+    
+    mkdir(cDirectory, 0777);
+    directory=opendir(cDirectory);
+    if (directory==NULL) {return -1;}
+    while ((entry=readdir(directory))!=NULL) {
+        if (fnIsQueueFile(entry->d_name)) {
+            snprintf(cFile, sizeof(cFile), "%s/%s", cDirectory, entry->d_name);
+            unlink(cFile);
+        }
+    }
+    closedir(directory);
+    
+    iPid=getpid(); iNow=time(NULL);
+    memset(cHost, 0, sizeof(cHost));
+    gethostname(cHost, sizeof(cHost)-1);
+    iJob=fnHashBytes(cHost, strlen(cHost), fnHashBytes(&iNow, sizeof(iNow), fnHashBytes(&iPid, sizeof(iPid))));
+    snprintf(cJob, sizeof(cJob), "%016llx", iJob);
+    
+    snprintf(cTemp, sizeof(cTemp), "%s/queue.tmp", cDirectory);
+    fp=fopen(cTemp, "w");
+    if (fp==NULL) {return -1;}
+    fprintf(fp, "%s %i %i\n", cJob, nitems, nvalues);
+    fclose(fp);
+    snprintf(cFile, sizeof(cFile), "%s/queue", cDirectory);
+    if (rename(cTemp, cFile)!=0) {return -1;}
+    
+    aClaimed=new time_t[nitems+1];
+    for (i=0; i<nitems; i++) {aClaimed[i]=0;}
+    while (ndone<nitems) {
+        iNow=time(NULL);
+        for (i=0; i<nitems; i++) {
+            if (aiState[i]==2) {continue;}
+            snprintf(cFile, sizeof(cFile), "%s/%s.%i.result", cDirectory, cJob, i);
+            fp=fopen(cFile, "rb");
+            if (fp!=NULL) {
+                if (fread(aResults+size_t(i)*nvalues, sizeof(double), nvalues, fp)==size_t(nvalues)) {aiState[i]=2; ndone++;}
+                fclose(fp);
+                if (aiState[i]==2) {continue;}
+            }
+            snprintf(cFile, sizeof(cFile), "%s/%s.%i.claim", cDirectory, cJob, i);
+            if (stat(cFile, &status)!=0) {aiState[i]=0; continue;}
+            if (aiState[i]==0) {aiState[i]=1; aClaimed[i]=iNow;}
+            else if (iNow-aClaimed[i]>iLease) {
+                unlink(cFile);
+                aiState[i]=0;
             }
+        }
+        if (ndone<nitems) {usleep(200000);}
     }
-    else  {
-        for (i=modelstart; i<modelend+1; i++)  
-            for (j=0; j<dimension; j++)  {fit[i].m.rho[j+gaussstart]=fit[i].m.rho[fit[i].m.n-1];}
+    delete [] aClaimed;
+    
+    snprintf(cFile, sizeof(cFile), "%s/queue", cDirectory);
+    unlink(cFile);
+    for (i=0; i<nitems; i++) {
+        snprintf(cFile, sizeof(cFile), "%s/%s.%i.result", cDirectory, cJob, i);
+        unlink(cFile);
+        snprintf(cFile, sizeof(cFile), "%s/%s.%i.claim", cDirectory, cJob, i);
+        unlink(cFile);
     }
+    return ndone;
 }
-void fnWriteCanvas2Model(double aArea[], double anSL[], double aAbsorb[], fitinfo fit[], int gaussstart, int dimension, double stepsize, double dMaxArea, double normarea, int modelstart, int modelend)
+
+//reads job id, nitems and nvalues from the queue file, false if there is none
+bool fnReadQueue(const char *cDirectory, char cJob[], int &nitems, int &nvalues)
 {
-    int i, j;
-    if (dMaxArea!=0)  {
-        for (i=modelstart; i<modelend+1; i++)
-            for (j=0; j<dimension; j++)  {
-                //printf("bin %i area %e normarea %e areafraction %e bulk mu %e absorption %e result %e \n",j, aArea[j], normarea, aArea[j]/normarea,fit[i].m.mu[fit[i].m.n-1], aAbsorb[j],(aAbsorb[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.mu[fit[i].m.n-1]);
-                fit[i].m.rho[j+gaussstart]=(anSL[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.rho[fit[i].m.n-1];
-                fit[i].m.mu[j+gaussstart]=(aAbsorb[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*fit[i].m.mu[fit[i].m.n-1];
-            }
+    char cFile[4096];
+    FILE *fp;
+    bool bRead;
+    
+    snprintf(cFile, sizeof(cFile), "%s/queue", cDirectory);
+    fp=fopen(cFile, "r");
+    if (fp==NULL) {return false;}
+    bRead=(fscanf(fp, "%31s %i %i", cJob, &nitems, &nvalues)==3);
+    fclose(fp);
+    return bRead;
+}
+
+//waits for the queue file, then claims items until the coordinator removes it or starts another job.
+//Items whose claim expired are picked up again. Returns the number of items computed
+int fnWorkDirectory(const char *cDirectory, WorkTask fnTask, void *pData)
+{
+    char cFile[4096], cTemp[4096], cJob[32], cCurrent[32], cHost[256];
+    double *aValues;
+    FILE *fp;
+    int i, fd, nitems=0, nvalues=0, ncurrent, mcurrent, n=0;
+    bool bClaimed;
+    
+    for (i=0; i<100; i++) {
+        if (fnReadQueue(cDirectory, cJob, nitems, nvalues)) {break;}
+        usleep(100000);
     }
-    else  {
-        for (i=modelstart; i<modelend+1; i++)  
-            for (j=0; j<dimension; j++)  {
-                fit[i].m.rho[j+gaussstart]=fit[i].m.rho[fit[i].m.n-1];
-                fit[i].m.mu[j+gaussstart]=fit[i].m.mu[fit[i].m.n-1];
-            }
+    if (i==100) {return -1;}
+    memset(cHost, 0, sizeof(cHost));
+    gethostname(cHost, sizeof(cHost)-1);
+    
+    aValues=new double[nvalues+1];
+    bClaimed=true;
+    while (true) {
+        if (bClaimed==false) {usleep(200000);}
+        if ((fnReadQueue(cDirectory, cCurrent, ncurrent, mcurrent)==false) || (strcmp(cCurrent, cJob)!=0)) {break;}
+        bClaimed=false;
+        for (i=0; i<nitems; i++) {
+            snprintf(cFile, sizeof(cFile), "%s/%s.%i.result", cDirectory, cJob, i);
+            if (access(cFile, F_OK)==0) {continue;}
+            snprintf(cFile, sizeof(cFile), "%s/%s.%i.claim", cDirectory, cJob, i);
+            fd=open(cFile, O_CREAT | O_EXCL | O_WRONLY, 0666);
+            if (fd<0) {continue;}
+            close(fd);
+            bClaimed=true;
+            fnTask(i, aValues, pData);
+            snprintf(cTemp, sizeof(cTemp), "%s/%s.%i.%s.%i.tmp", cDirectory, cJob, i, cHost, int(getpid()));
+            fp=fopen(cTemp, "wb");
+            if (fp==NULL) {continue;}
+            fwrite(aValues, sizeof(double), nvalues, fp);
+            fclose(fp);
+            snprintf(cFile, sizeof(cFile), "%s/%s.%i.result", cDirectory, cJob, i);
+            rename(cTemp, cFile);
+            n++;
+        }
+    }
+    delete [] aValues;
+    return n;
+}
+
+void fnBootstrapWork(int iReplica, double aRow[], void *pData)
+{
+    BootstrapWork *work;
+    
+    work=(BootstrapWork *) pData;
+    fnBootstrapReplica(*work->problem, work->iSeed, iReplica, aRow);
+}
+#endif
+
+#ifdef MOLGROUPS_DUAL
+//------------------------------------------------------------------------------------------------------
+//writes out the nSLD profile of a canvas together with its derivatives with respect to all seeded
+//parameters (see fnSeedDerivative). arho has dimension entries, adrho is laid out [parameter][bin].
+
+void fnWriteCanvas2Gradient(mgreal aArea[], mgreal anSL[], mgreal bulknsld, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int nparameters, double arho[], double adrho[])
+{
+    int j, k;
+    mgreal rho;
+    
+    if (nparameters>MOLGROUPS_NDERIV) {nparameters=MOLGROUPS_NDERIV;}
+    
+    for (j=0; j<dimension; j++) {
+        if (dMaxArea!=0) {
+            rho=(anSL[j]/(normarea*stepsize))+(1-(aArea[j]/normarea))*bulknsld;
+        }
+        else {
+            rho=bulknsld;
+        }
+        arho[j]=fnValue(rho);
+        for (k=0; k<nparameters; k++) {
+            adrho[k*dimension+j]=fnDerivative(rho,k);
+        }
     }
 }
+#endif
 
+#ifdef MOLGROUPS_NAMESPACE
+}
+#endif
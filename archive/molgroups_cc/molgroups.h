@@ -1,39 +1,811 @@
+//---------------scalar type-----------------------------------------------------------------------------
+//all model parameters and canvases use mgreal, selected at compile time from one source:
+//  default               double, used for the final refinement
+//  -DMOLGROUPS_SINGLE    float, fast path for population screening; erf/exp resolve to the float overloads
+//  -DMOLGROUPS_DUAL      forward-mode dual numbers (molgroups_dual.h), which propagate parameter derivatives
+//                        through fnAdjustParameters and the rasterization into every canvas bin
+//mgconst is the matching type for literals in the erf/exp kernels, it keeps float arithmetic from promoting
+//defining MOLGROUPS_NAMESPACE places the library in that namespace, so that molgroups.cc can be compiled
+//once per scalar type and linked into one program, e.g. -DMOLGROUPS_SINGLE -DMOLGROUPS_NAMESPACE=mgfloat
+#if defined(MOLGROUPS_DUAL)
+#include "molgroups_dual.h"
+#endif
+
+#ifdef MOLGROUPS_NAMESPACE
+namespace MOLGROUPS_NAMESPACE {
+#endif
+
+#if defined(MOLGROUPS_DUAL)
+typedef mgdual mgreal;
+typedef double mgconst;
+#elif defined(MOLGROUPS_SINGLE)
+typedef float mgreal;
+typedef float mgconst;
+inline double fnValue(float f) {return f;};
+inline double fnValue(double d) {return d;};
+#else
+typedef double mgreal;
+typedef double mgconst;
+inline double fnValue(double d) {return d;};
+#endif
+
+//---------------rasterization cache---------------------------------------------------------------------
+//grid point contributions of one object as stored by nSLDObj::fnRasterize, a composite keeps up to
+//MOLGROUPS_CACHESLOTS of them keyed by the hash of its fnSet parameters
+#ifndef MOLGROUPS_CACHESLOTS
+#define MOLGROUPS_CACHESLOTS 8
+#endif
+
+class Raster
+{
+public:
+    Raster();
+    ~Raster();
+    void   fnGrow(int iNewCapacity);
+    
+    int    iSize, iCapacity, iDimension;
+    int    iFirstBin, iLastBin;             //bin range covered by the raster
+    double dStepsize;
+    bool   bValid, bAbsorb, bBulk;
+    bool   bMonotonic;                      //bins strictly increasing, no bin receives two contributions
+    unsigned long long iKey;                //parameter hash, 0 if the state was not set by fnSet
+    unsigned long iLastUsed;
+    mgreal dBulk;                           //bulk nSLD at which anSLD was evaluated
+    int    *aBin;
+    mgreal *aArea, *anSLD, *aAbsorb, *anSLDBulk;   //anSLDBulk: change of nSLD per unit bulk nSLD
+    
+private:
+    Raster(const Raster &);
+    Raster& operator=(const Raster &);
+};
+
+//---------------canvas----------------------------------------------------------------------------------
+//owns the channels of a rasterized profile: area, nSL and optionally absorption and the bulk nSLD
+//dependence of the nSL (see nSLDObj::fnWriteContrastProfile). All channels live in one block, each starts
+//on a MOLGROUPS_ALIGNMENT byte boundary and is zero-padded to iPaddedDimension, so that vectorized
+//kernels can run over whole registers. The block is reused across evaluations and only grows
+#ifndef MOLGROUPS_ALIGNMENT
+#define MOLGROUPS_ALIGNMENT 64
+#endif
+//the channels of two canvases never overlap, which lets the compositing kernels vectorize without alias checks
+#ifndef MOLGROUPS_RESTRICT
+#if defined(__GNUC__) || defined(__clang__)
+#define MOLGROUPS_RESTRICT __restrict__
+#else
+#define MOLGROUPS_RESTRICT
+#endif
+#endif
+//bins per block of the slab writers, with bIncremental unchanged blocks are not written again
+#ifndef MOLGROUPS_SLABBLOCK
+#define MOLGROUPS_SLABBLOCK 64
+#endif
+
+class Canvas
+{
+public:
+    Canvas();
+    Canvas(int _dimension, double _stepsize, bool _bAbsorb=false, bool _bBulk=false);
+    ~Canvas();
+    void   fnResize(int _dimension, double _stepsize);
+    void   fnSetChannels(bool _bAbsorb, bool _bBulk);
+    mgreal fnClear();
+    bool   fnSetSlabKey(unsigned long long iKey);
+    bool   fnSlabBlock(int iStart, int iEnd, mgreal normarea, double anSLr[], double aAbsorbr[], double aVoid[], double aVoidBulk[]);
+    
+    int    dimension, iPaddedDimension;
+    double stepsize;
+    bool   bAbsorb, bBulk;
+    bool   bIncremental;                    //slab writers skip blocks that did not change since the last write
+    mgreal dMaxArea;
+    mgreal *aArea, *anSL, *aAbsorb, *anSLBulk;
+    
+private:
+    void   fnAllocate();
+    
+    char   *pBlock;
+    int    iAllocatedElements;
+    double *aWritten;                       //per-bin slab coefficients of the last write
+    unsigned long long iSlabKey;            //destinations and bulk values of the last incremental write, 0 forces a full write
+    
+    Canvas(const Canvas &);
+    Canvas& operator=(const Canvas &);
+};
+
+//---------------slab output-----------------------------------------------------------------------------
+//one contrast for fnWriteCanvas2Targets: the bulk values the canvas is embedded in and where its first bin
+//goes, e.g. fit[i].m.rho+gaussstart. mu is NULL if the model has no absorption
+class ModelTarget
+{
+public:
+    ModelTarget() {bulkrho=0; bulkmu=0; rho=NULL; mu=NULL;};
+    
+    double bulkrho, bulkmu;
+    Real   *rho, *mu;
+};
+
+//one layer of a merged profile (see fnMergeSlabs): thickness d, nSLD rho and absorption mu, all in A and A^-2
+//rough is the roughness of the interface to the next layer, used by fnReflectivity
+class Slab
+{
+public:
+    Slab() {d=0; rho=0; mu=0; rough=0;};
+    
+    double d, rho, mu, rough;
+};
+
+//Q points per vectorized chunk of the reflectivity kernel
+#ifndef MOLGROUPS_QCHUNK
+#define MOLGROUPS_QCHUNK 64
+#endif
+
+//---------------thread pool-----------------------------------------------------------------------------
+//persistent worker threads for independent work items, e.g. the contrasts of a fit or chunks of Q points
+//fnParallelFor calls fnTask(i, pData) for every i in istart..iend-1 and returns when all are done, the
+//calling thread takes part. Without -DMOLGROUPS_THREADS (which requires C++11 threads, link with
+//-pthread) everything runs serially in the calling thread. Tasks must not share nSLDObj instances,
+//every thread works on its own copy (see the nSLDObj copy constructor)
+class ThreadPoolState;
+
+class ThreadPool
+{
+public:
+    ThreadPool(int _nthreads=0);            //0: one thread per hardware thread
+    ~ThreadPool();
+    void   fnParallelFor(int istart, int iend, void (*fnTask)(int i, void *pData), void *pData);
+    int    fnGetThreads() {return nthreads;};
+    
+private:
+    int    nthreads;
+    ThreadPoolState *pState;
+    
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+};
+
+//one contrast for fnContrastReflectivity: the layers before the canvas (incident medium first), the bulk
+//that backs and fills it, and the Q points, resolution and R(Q) of the contrast. adQ is NULL for no smearing
+class ContrastJob
+{
+public:
+    ContrastJob() {aTop=NULL; ntop=0; bulkrho=0; bulkmu=0; aQ=NULL; adQ=NULL; nQ=0; aR=NULL;};
+    
+    const Slab *aTop;
+    int    ntop;
+    double bulkrho, bulkmu;
+    const double *aQ, *adQ;
+    int    nQ;
+    double *aR;
+};
+
+//---------------binary molgroups file------------------------------------------------------------------
+//a MolDump passed to fnWriteGroup2File (as MolSink) takes the place of mol.dat. The header lines of
+//the groups stay text, fnWriteData2File and fnWriteConstant write the z, area and nSL columns of a
+//group as one binary block instead of formatted rows:
+//  file     "MOLGROUPS-BINARY 1 little|big\n", then for every group
+//  group    its header line as in mol.dat, "#BLOCK name n codec nbytes\n" and nbytes of payload
+//  payload  z[n], area[n], nSL[n] as doubles. codec 0: raw, codec 1: zlib over the byte-shuffled
+//           doubles (requires -DMOLGROUPS_ZLIB, link with -lz)
+//fnOpen(FILE *) writes to an open stream, such as a tmpfile, and closes it in fnClose
+//molgroups/moldump.py reads the file into the dictionary layout of rs.py's fnLoadMolgroups
+class MolDump
+{
+public:
+    MolDump();
+    ~MolDump();
+    FILE*  fnOpen(const char *cFileName, bool _bCompress=false);
+    FILE*  fnOpen(FILE *_fp, bool _bCompress=false);
+    void   fnClose();
+    void   fnWriteBlock(const char *cName, int n, const double aZ[], const double aArea[], const double anSL[]);
+    void   fnWriteProfile(int n, const double aZ[], const double arho[], const double amu[]);
+    
+    FILE   *fp;
+    bool   bCompress;
+    
+private:
+    void   fnWriteColumns(const char *cTag, const char *cName, int n, const double a1[], const double a2[], const double a3[]);
+    
+    MolDump(const MolDump &);
+    MolDump& operator=(const MolDump &);
+};
+
+//where fnWriteGroup2File writes: a text stream such as mol.dat, or a MolDump, whose blocks are then
+//written by fnWriteData2File and fnWriteConstant. Converts to the FILE of either for the header lines.
+//MolSink converts implicitly from FILE*, so calls that pass mol.dat are unchanged. Groups defined
+//outside this file must change their fnWriteGroup2File override from FILE *fp to MolSink fp; the old
+//signature no longer overrides and leaves the class abstract, so this fails at compile time
+class MolSink
+{
+public:
+    MolSink(FILE *_fp) {fp=_fp; pDump=NULL;};
+    MolSink(MolDump &dump) {fp=dump.fp; pDump=&dump;};
+    operator FILE*() const {return fp;};
+    
+    FILE    *fp;
+    MolDump *pDump;                         //NULL for text
+};
+
+//---------------population evaluation-------------------------------------------------------------------
+//interface between a fit setup and fnEvaluatePopulation. A derived class owns the molgroups objects of
+//one model, fnEvaluate configures them from one parameter vector and writes the profile into canvas
+//(resizing it as needed). For R(Q), fnEvaluate also sets the layers above the canvas (incident medium
+//first), the bulk and normarea. fnClone returns an independent copy, one is made per thread. molgroups
+//objects copy deeply and share only read-only data, so fnClone can return new Derived(*this)
+#ifndef MOLGROUPS_MAXTOP
+#define MOLGROUPS_MAXTOP 16
+#endif
+
+class PropertyStatistics;
+class ContourHistogram;
+
+class PopulationModel
+{
+public:
+    PopulationModel() {ntop=0; bulkrho=0; bulkmu=0; normarea=0; dTolerance=0; nquadrature=0;};
+    virtual ~PopulationModel() {};
+    virtual PopulationModel* fnClone() const = 0;
+    virtual void fnEvaluate(const double aParameters[], Canvas &canvas) = 0;
+    virtual void fnWriteGroups(MolSink fp, int dimension, double stepsize) {};     //mol.dat of the last evaluation, fp is passed on to fnWriteGroup2File
+    virtual void fnGetProperties(const PropertyStatistics &properties, double aValues[]) {};  //ditto, see PropertyStatistics
+    
+    Slab   aTop[MOLGROUPS_MAXTOP];
+    int    ntop;
+    double bulkrho, bulkmu;
+    mgreal normarea;
+    double dTolerance;                      //slab merging tolerance for R(Q), 0 merges identical bins only
+    int    nquadrature;                     //resolution quadrature points for R(Q)
+};
+
+//---------------parameter registry----------------------------------------------------------------------
+//name, location, bounds and flags of the fit parameters of a molgroups object, filled by the object's
+//fnRegisterParameters. Locations are byte offsets from the nSLDObj base, so one registry serves all
+//copies of the object. The vector read by fnSetParameters holds the free parameters (neither fixed nor
+//derived) in the order of registration. Fixed parameters keep their value, derived ones are computed by
+//fnAdjustParameters and can only be read
+#ifndef MOLGROUPS_MAXPARAMETERS
+#define MOLGROUPS_MAXPARAMETERS 64
+#endif
+#ifndef MOLGROUPS_NAMELENGTH
+#define MOLGROUPS_NAMELENGTH 32
+#endif
+
+class nSLDObj;
+
+class Parameter
+{
+public:
+    char   cName[MOLGROUPS_NAMELENGTH];
+    size_t iOffset;
+    double dLower, dUpper;
+    bool   bFixed, bDerived;
+};
+
+class ParameterRegistry
+{
+public:
+    ParameterRegistry() {nparameters=0; nfree=0; cClass[0]=0;};
+    void   fnSetClass(const char *cName);
+    int    fnAdd(nSLDObj *object, const char *cName, mgreal *pMember, double dLower, double dUpper, bool bDerived=false);
+    int    fnFind(const char *cName) const;
+    int    fnSetFixed(const char *cName, bool bFixed);
+    int    fnSetBounds(const char *cName, double dLower, double dUpper);
+    
+    Parameter aParameters[MOLGROUPS_MAXPARAMETERS];
+    int    nparameters;
+    int    nfree;                           //length of the parameter vector
+    char   cClass[MOLGROUPS_NAMELENGTH];    //class whose fnRegisterParameters filled the registry last
+    
+private:
+    void   fnCount();
+};
+
+//---------------statistical re-evaluation---------------------------------------------------------------
+//StatReader streams the rows of an SErr.dat or iSErr.dat file (a line of column names, then one line per
+//sample) and returns the columns named in acNames in that order, plus Chisq if the file has it.
+//fnRecreateStatistical evaluates all samples of such a file with a PopulationModel, whose parameter
+//vector is given by acNames, and writes one binary store (see MolDump) with, per sample:
+//  "#SAMPLE i value ... [chisq]\n", "#PROFILE profile n codec nbytes\n" with z, rho and mu of the bulk
+//  set in the model, and, if bMolgroups is set, the groups written by the model's fnWriteGroups
+//preceded once by "#PARAMETERS name ... [Chisq]\n". Samples are read in batches of nbatch and evaluated
+//in parallel on clones of the model. pEnvelope, if given, receives the rho profiles in sample order,
+//pProperties the property values the model's fnGetProperties computes for every sample and pContour
+//the rho profiles.
+//molgroups/moldump.py reads the store
+class StatReader
+{
+public:
+    StatReader();
+    ~StatReader();
+    bool   fnOpen(const char *cFileName, const char *acNames[], int _nparameters);
+    int    fnRead(double aParameters[], double aChisq[], int nrows);
+    void   fnClose();
+    
+    int    nparameters, ncolumns;
+    bool   bChisq;
+    char   cMissing[MOLGROUPS_NAMELENGTH];  //first name fnOpen did not find
+    
+private:
+    bool   fnReadLine();
+    
+    FILE   *fp;
+    int    *aiColumn;                       //column of each parameter, Chisq last
+    double *aRow;
+    char   *cLine;
+    int    iLineLength;
+    
+    StatReader(const StatReader &);
+    StatReader& operator=(const StatReader &);
+};
+
+//---------------profile envelopes-----------------------------------------------------------------------
+//per-bin quantiles of a population of profiles, such as nSLD profiles or molgroup areas. Up to
+//nmaxsamples profiles are kept column-major and the quantiles are exact (linear interpolation between
+//order statistics, as scipy's scoreatpercentile). Beyond that, and from the start for nmaxsamples=0, every
+//bin tracks the quantiles of aEnvelopeQuantiles (-2 to +2 sigma) with the P2 algorithm of Jain and
+//Chlamtac in constant memory; fnGetQuantile then returns NaN for any other fraction. Not thread-safe,
+//feed it from one thread
+#define MOLGROUPS_QUANTILES 5
+extern const double aEnvelopeQuantiles[MOLGROUPS_QUANTILES];
+
+class Envelope
+{
+public:
+    Envelope(int _dimension, double _stepsize, int _nmaxsamples=0);
+    ~Envelope();
+    void   fnAdd(const double aValues[], int n);    //shorter profiles are padded with their last value
+    void   fnAddArea(Canvas &canvas);
+    void   fnAddProfile(Canvas &canvas, double bulkrho, mgreal normarea);
+    void   fnAddGroup(nSLDObj &group);
+    double fnGetQuantile(int iBin, double dFraction);   //NaN if bStreaming and dFraction is not tracked
+    void   fnGetBands(double aBands[]);             //aEnvelopeQuantiles, laid out [quantile][bin]
+    bool   fnWrite(const char *cFileName);
+    
+    int    dimension, nsamples, nmaxsamples;
+    double stepsize;
+    bool   bStreaming;
+    
+private:
+    void   fnStartStreaming();
+    void   fnStream(double q[], double pos[], double dFraction, double x);
+    
+    double *aSamples;                       //[bin][sample] until bStreaming
+    double *aHeights, *aPositions;          //P2 markers, [bin][quantile][5]
+    double *aRow, *aProfile;
+    int    iProfileLength;
+    Canvas *pScratch;
+    friend class Checkpoint;
+    
+    Envelope(const Envelope &);
+    Envelope& operator=(const Envelope &);
+};
+
+//---------------molgroup properties---------------------------------------------------------------------
+//moments of the area of a group on the grid of mol.dat, see nSLDObj::fnGetMoments
+class Moments
+{
+public:
+    double integral;                        //area integrated over z
+    double com;                             //center of mass of the area
+    double variance;                        //second central moment of the area
+    double nsl;                             //integrated nSL
+    double start;                           //first grid point with area in mol.dat, 1e5 if there is none
+};
+
+//distributions of scalar properties over the samples of a population: mean and sigma, and the quantiles
+//of an Envelope over the properties. fnAddGroup registers the properties of fnCalculateMolgroupProperty
+//in rs.py for one group, name_COM (relative to the start of the group), name_INT (per normarea), name_AVG
+//(mean area), and in addition name_WIDTH (sigma of the area) and name_NSL (per normarea).
+//fnGroupValues computes them into a row of property values, fnAdd adds such a row as one sample
+#ifndef MOLGROUPS_MAXPROPERTIES
+#define MOLGROUPS_MAXPROPERTIES 128
+#endif
+#define MOLGROUPS_GROUPPROPERTIES 5
+
+class PropertyStatistics
+{
+public:
+    PropertyStatistics(int _nmaxsamples=0);
+    ~PropertyStatistics();
+    int    fnAddProperty(const char *cName);
+    int    fnAddGroup(const char *cName);
+    int    fnFind(const char *cName) const;
+    void   fnGroupValues(int iFirst, nSLDObj &group, int dimension, double stepsize, mgreal normarea, double aValues[]) const;
+    void   fnAdd(const double aValues[]);
+    double fnGetMean(int i);
+    double fnGetSigma(int i);
+    double fnGetQuantile(int i, double dFraction);
+    bool   fnWrite(const char *cFileName);
+    
+    char   acNames[MOLGROUPS_MAXPROPERTIES][MOLGROUPS_NAMELENGTH];
+    int    nproperties, nsamples, nmaxsamples;
+    
+private:
+    double aMean[MOLGROUPS_MAXPROPERTIES], aM2[MOLGROUPS_MAXPROPERTIES];
+    Envelope *pEnvelope;                    //one bin per property, created with the first sample
+    friend class Checkpoint;
+    
+    PropertyStatistics(const PropertyStatistics &);
+    PropertyStatistics& operator=(const PropertyStatistics &);
+};
+
+//---------------contour histogram-----------------------------------------------------------------------
+//2D density of a population of profiles on a fixed (z, y) grid, y being rho or area, as fnContourData in
+//rs.py. With bRasterize, consecutive points of a profile are joined by a line and every cell it crosses
+//is counted once, otherwise only the points are counted. Points outside the grid are dropped. Histograms
+//of the same grid add up with fnMerge, so threads can fill their own. fnWrite stores the counts as
+//"MOLGROUPS-CONTOUR 1 little|big nz ny z0 dz y0 dy nprofiles\n" followed by ny*nz uint32 [y][z],
+//molgroups/moldump.py reads it
+class ContourHistogram
+{
+public:
+    ContourHistogram(double _z0, double _dz, int _nz, double _y0, double _dy, int _ny, bool _bRasterize=true);
+    ~ContourHistogram();
+    void   fnAdd(const double aZ[], const double aY[], int n);
+    void   fnAdd(const double aY[], int n, double stepsize);     //profile on the canvas grid z=i*stepsize
+    void   fnAddProfile(Canvas &canvas, double bulkrho, mgreal normarea);
+    void   fnClear();
+    void   fnMerge(const ContourHistogram &o);
+    bool   fnWrite(const char *cFileName);
+    
+    unsigned int *aCounts;                  //[y][z]
+    int    nz, ny, nprofiles;
+    double z0, dz, y0, dy;
+    bool   bRasterize;
+    
+private:
+    void   fnCount(int iz, int iy);
+    
+    double *aProfile;
+    int    iProfileLength;
+    
+    ContourHistogram(const ContourHistogram &);
+    ContourHistogram& operator=(const ContourHistogram &);
+};
+
+//---------------bootstrap-------------------------------------------------------------------------------
+//FitProblem describes a fit in memory: one PopulationModel per contrast, all taking the same parameter
+//vector, with the measured R(Q) of that contrast (adQ may be NULL), and the bounds and starting point of
+//the parameters. fnFitSimplex minimizes chi-square with a bounded Nelder-Mead simplex.
+//fnChiSquare returns the total chi-square of all contrasts, either from their model R(Q) or by evaluating
+//the models, and optionally the chi-square of every contrast and the normalized residuals (model-R)/dR
+//of all points, contrast after contrast, as a least-squares fit needs them.
+//fnResample makes Monte Carlo copies of a data set without files, R+dR*N(0,1) of replica iReplica and
+//contrast iContrast. The normal deviates come from Philox4x32-10 (Salmon et al. 2011), a counter based
+//generator keyed with iSeed: every pair of points is one counter value (pair, replica, contrast), so any
+//replica can be generated on its own, in any order and on any thread, always with the same numbers. The
+//batched form writes nreplicas rows starting at replica iFirst, [replica][Q].
+//fnBootstrap fits nreplicas such copies on the thread pool. Every replica works on its own clones of the
+//models and writes to its own row of aResults (parameters, then chi-square), so that no locks are needed
+//and the results do not depend on the number of threads. fnWriteResults stores them as SErr.dat for
+//fnRecreateStatistical
+//ContrastEvaluator evaluates the contrasts of one parameter vector in parallel, each on its own clone of
+//the contrast's model with its own canvas. The chi-square of every contrast is summed in contrast order,
+//so the total is bitwise identical to fnChiSquare. It pays off for single fits and evaluations with
+//several contrasts, fnBootstrap and DreamSampler already run replicas and chains in parallel
+#ifndef MOLGROUPS_MAXCONTRASTS
+#define MOLGROUPS_MAXCONTRASTS 16
+#endif
+
+class Dataset
+{
+public:
+    Dataset() {aQ=NULL; aR=NULL; adR=NULL; adQ=NULL; nQ=0;};
+    
+    const double *aQ, *aR, *adR, *adQ;
+    int    nQ;
+};
+
+//a Dataset that owns its columns, read from a .refl file: "#" lines are comments, the data lines hold
+//Q R dR (NIST) or Q dQ R dR (ISIS) as in rs.py's fnModifyAndCopyFiles. adQ stays NULL for NIST files, fnLoad
+//returns false for a file with any other data line
+class ReflData: public Dataset
+{
+public:
+    ReflData() {aValues=NULL;};
+    ~ReflData() {delete [] aValues;};
+    bool   fnLoad(const char *cFileName);
+    
+private:
+    double *aValues;
+    
+    ReflData(const ReflData &);
+    ReflData& operator=(const ReflData &);
+};
+
+//splitmix64, a small generator whose streams can be seeded independently
+class RandomStream
+{
+public:
+    RandomStream(unsigned long long _iState=0) {iState=_iState; bSpare=false; dSpare=0;};
+    unsigned long long fnNext();
+    double fnUniform();                     //in (0,1)
+    double fnGauss();                       //standard normal, Box-Muller
+    
+    unsigned long long iState;
+    
+private:
+    bool   bSpare;
+    double dSpare;
+    friend class Checkpoint;
+};
+
+class FitProblem
+{
+public:
+    FitProblem();
+    
+    PopulationModel *aModels[MOLGROUPS_MAXCONTRASTS];
+    Dataset aData[MOLGROUPS_MAXCONTRASTS];
+    int    ncontrasts, nparameters;
+    double aLower[MOLGROUPS_MAXPARAMETERS], aUpper[MOLGROUPS_MAXPARAMETERS], aStart[MOLGROUPS_MAXPARAMETERS];
+    const char *acNames[MOLGROUPS_MAXPARAMETERS];  //for fnWriteResults
+    int    nmaxevaluations;
+    double dTolerance;                      //relative change of chi-square at which the simplex stops
+};
+
+class ContrastEvaluator
+{
+public:
+    ContrastEvaluator(const FitProblem &_problem);    //aborts for more than MOLGROUPS_MAXCONTRASTS contrasts
+    ~ContrastEvaluator();
+    double fnChiSquare(const double aParameters[], ThreadPool *pool=NULL, double aChisq[]=NULL, double aResiduals[]=NULL);
+    
+    const FitProblem *problem;
+    PopulationModel *aModels[MOLGROUPS_MAXCONTRASTS];     //clones
+    
+private:
+    Canvas aCanvas[MOLGROUPS_MAXCONTRASTS];
+    double *aScratch;                       //[contrast][nQ]
+    double aContrastChisq[MOLGROUPS_MAXCONTRASTS];
+    size_t aiOffset[MOLGROUPS_MAXCONTRASTS];  //of the contrast in aResiduals
+    int    nQ;
+    const double *x;                        //of the evaluation in progress
+    double *aResidualsOut;
+    friend void fnContrastTask(int iContrast, void *pData);
+    
+    ContrastEvaluator(const ContrastEvaluator &);
+    ContrastEvaluator& operator=(const ContrastEvaluator &);
+};
+
+//---------------MCMC------------------------------------------------------------------------------------
+//differential evolution Markov chains after DREAM (Vrugt et al. 2009) on a FitProblem, with likelihood
+//exp(-chisq/2) and a uniform prior within the bounds. Proposals are built in the calling thread from the
+//chain states at the start of a generation, every chain draws from its own RandomStream, then all chains
+//are evaluated in parallel on the thread pool, so the chains do not depend on the number of threads.
+//Jumps use delta pairs of other chains (1..ndelta), randomized subspace sampling with crossover
+//probabilities 1/ncr..1 and a jump rate of 1 every fifth generation. During burn-in, chains whose
+//chi-square lies beyond 2 interquartile ranges above the upper quartile are moved to the best chain.
+//After nburn generations, every nthin-th generation is a sample: fnRun then writes the chain states to
+//the file of fnOpenSamples (SErr.dat layout, for fnRecreateStatistical) and feeds pEnvelope, pProperties
+//and pContour with the profile of the first contrast, in chain order as in fnRecreateStatistical
+#ifndef MOLGROUPS_MAXDELTA
+#define MOLGROUPS_MAXDELTA 8
+#endif
+
+class DreamSampler
+{
+public:
+    DreamSampler(const FitProblem &_problem, int _nchains, unsigned long long _iSeed);
+    ~DreamSampler();
+    void   fnInitialize(ThreadPool *pool=NULL);     //chains uniform within the bounds, chain 0 at aStart
+    int    fnRun(int ngenerations, ThreadPool *pool=NULL);  //returns the number of accepted proposals
+    bool   fnOpenSamples(const char *cFileName, bool bAppend=false);  //bAppend to resume from a Checkpoint
+    void   fnCloseSamples();
+    long long fnSamplesOffset() const;              //bytes in the samples file, -1 if none is open
+    int    fnGetBest(double aParameters[]);         //returns the chain with the lowest chi-square
+
+    const FitProblem *problem;
+    double *aChains;                        //[chain][parameter]
+    double *aChisq;
+    int    nchains, nparameters, ngenerations, nsamples;
+    int    nburn, nthin, ndelta, ncr;     //ndelta up to MOLGROUPS_MAXDELTA
+    unsigned long long iSeed;
+    long long iResumeOffset;                //samples file length to resume at, set by Checkpoint::fnGetSampler
+    RandomStream *aRandom;                  //one per chain
+    Envelope *pEnvelope;
+    PropertyStatistics *pProperties;
+    ContourHistogram *pContour;
+
+private:
+    void   fnSetBlocks(ThreadPool *pool);
+    void   fnEvaluate(const double aStates[], double aResults[], bool bSample, ThreadPool *pool);
+    void   fnPropose(int iChain, double aProposal[]);
+    void   fnRemoveOutliers();
+    void   fnSample(ThreadPool *pool);
+
+    double *aProposals, *aProposalChisq, *aProfiles, *aProperties;
+    int    nenvelope, nproperties;
+    FILE   *fpSamples;
+    PopulationModel **aModels;              //clones, [block][contrast]
+    Canvas *aCanvas;                        //one per block
+    double *aScratch;                       //R(Q) of one block, [block][nQ]
+    ContourHistogram **aContours;           //one per block while pContour is set
+    int    nblocks, nQ;
+
+    DreamSampler(const DreamSampler &);
+    DreamSampler& operator=(const DreamSampler &);
+};
+
+//---------------checkpoints-----------------------------------------------------------------------------
+//binary snapshot of the state of a long run, so that it can resume after the job is stopped. Sections
+//are collected in memory with the fnAdd functions, each under a name, and fnSave writes them at once
+//(to cFileName.tmp, then renamed, so an interrupted save leaves the last checkpoint intact):
+//  file     "MOLGROUPS-CHECKPOINT 2 little|big\n", then for every section
+//  section  type and name as zero-padded char[32] each, payload size as uint64, payload
+//fnLoad reads a file of the same version and byte order, the fnGet functions restore a section into an
+//existing object of the same configuration and return false if it is missing or does not match:
+//  values      any array of doubles, such as the rows of fnBootstrap done so far
+//  object      the registered parameters of a molgroups object with the class name of its registry,
+//              derived parameters are recomputed by fnAdjustParameters
+//  sampler     chains, chi-square, generation counters and random streams of a DreamSampler with the same
+//              number of chains and parameters, and the length of its samples file. fnOpenSamples with
+//              bAppend cuts the rows written after the checkpoint off that file before resuming
+//  envelope, properties, contour   the accumulators, with samples or P2 markers and running moments
+//fnAdd with a name already present adds a second section, fnGet finds the last one
+class Checkpoint
+{
+public:
+    Checkpoint();
+    ~Checkpoint();
+    void   fnClear();
+    bool   fnSave(const char *cFileName);
+    bool   fnLoad(const char *cFileName);
+    void   fnAddValues(const char *cName, const double aValues[], int n);
+    int    fnGetValues(const char *cName, double aValues[], int nmax);   //number of values, -1 if missing
+    void   fnAddObject(const char *cName, nSLDObj &object, const ParameterRegistry &registry);
+    bool   fnGetObject(const char *cName, nSLDObj &object, const ParameterRegistry &registry);
+    void   fnAddSampler(const char *cName, const DreamSampler &sampler);
+    bool   fnGetSampler(const char *cName, DreamSampler &sampler);
+    void   fnAddEnvelope(const char *cName, const Envelope &envelope);
+    bool   fnGetEnvelope(const char *cName, Envelope &envelope);
+    void   fnAddProperties(const char *cName, const PropertyStatistics &properties);
+    bool   fnGetProperties(const char *cName, PropertyStatistics &properties);
+    void   fnAddContour(const char *cName, const ContourHistogram &contour);
+    bool   fnGetContour(const char *cName, ContourHistogram &contour);
+    
+private:
+    void   fnBeginSection(const char *cType, const char *cName);
+    void   fnPut(const void *p, size_t n);
+    void   fnPutEnvelope(const Envelope &envelope);
+    bool   fnFindSection(const char *cType, const char *cName);
+    bool   fnTake(void *p, size_t n);
+    bool   fnTakeEnvelope(Envelope &envelope);
+    
+    char   *aData;                          //the sections
+    size_t nbytes, ncapacity, iSection;     //iSection: start of the section being added
+    size_t iCursor, iEnd;                   //payload of the section being read
+    
+    Checkpoint(const Checkpoint &);
+    Checkpoint& operator=(const Checkpoint &);
+};
+
+//---------------distributed work queue------------------------------------------------------------------
+//hands out the items 0..nitems-1 of a job, such as bootstrap replicas or MCMC chains, to worker processes
+//and gathers nvalues doubles per item into aResults. Coordinator and workers run the same program and
+//set up the same job, only item indices and results travel, so a task must depend on nothing else.
+//Transports:
+//  sockets    fnServe listens on a TCP port, fnWork connects to it. The items of a worker that
+//             disconnects are handed out again. fnServe gives up once no worker has been connected
+//             for iIdle seconds. Results are sent in native byte order, the nodes must share the
+//             architecture
+//  local      fnRunLocal forks nprocesses workers connected to the coordinator through the loopback
+//             interface, for one machine and for testing, and gives up once all of them have exited.
+//             Fork before creating a ThreadPool
+//  directory  fnServeDirectory and fnWorkDirectory go through a shared directory, for clusters without
+//             network access between nodes. Workers claim items by creating a file exclusively and
+//             publish results by renaming, the coordinator polls for results and hands out the items
+//             of claims older than a lease again
+//requires POSIX and -DMOLGROUPS_DISTRIBUTED
+#ifdef MOLGROUPS_DISTRIBUTED
+#include "sys/types.h"
+
+typedef void (*WorkTask)(int iItem, double aValues[], void *pData);
+
+class WorkQueue
+{
+public:
+    WorkQueue(int _nitems, int _nvalues);
+    ~WorkQueue();
+    int    fnServe(int iPort, int iIdle=600);
+    int    fnRunLocal(int nprocesses, WorkTask fnTask, void *pData);
+    int    fnServeDirectory(const char *cDirectory, int iLease=600);
+    
+    double *aResults;                       //[item][value]
+    int    *aiState;                        //0 pending, 1 handed out, 2 done
+    int    nitems, nvalues, ndone;
+    
+private:
+    int    fnListen(int iPort, bool bLoopback);
+    int    fnServeSocket(int iListen, int iIdle, pid_t aPid[], int nprocesses);
+    
+    WorkQueue(const WorkQueue &);
+    WorkQueue& operator=(const WorkQueue &);
+};
+
+int fnWork(const char *cHost, int iPort, WorkTask fnTask, void *pData, int nvalues);
+int fnWorkDirectory(const char *cDirectory, WorkTask fnTask, void *pData);
+
+//WorkTask for bootstrap replicas, pData points to a BootstrapWork
+class BootstrapWork
+{
+public:
+    const FitProblem *problem;
+    unsigned long long iSeed;
+};
+void fnBootstrapWork(int iReplica, double aRow[], void *pData);
+#endif
+
 //---------------abstract base class---------------------------------------------------------------------
 class nSLDObj
 {
 public:
     nSLDObj();
+    nSLDObj(const nSLDObj &o);
     virtual ~nSLDObj();
-    virtual double fnGetLowerLimit() = 0;
-    virtual double fnGetUpperLimit() = 0;
-    virtual double fnGetArea(double z) = 0;
-    virtual double fnGetConvolutedArea(double z);
-    virtual double fnGetnSLD(double z) = 0;
-    virtual void   fnSetConvolution(double sigma, int n);
-    virtual void   fnSetSigma(double sigma) = 0;
-    virtual void   fnSetZ(double dz) {z=dz;};
-    virtual void   fnSetnSL(double d) {nSL=d;};
-    virtual void   fnSetnSL(double d1, double d2) {};
-    virtual void   fnSetnSL(double d1, double d2, double d3) {};
-    virtual void   fnSetnSL(double d1, double d2, double d3, double d4) {};
-    virtual void   fnSetnSL(double d1, double d2, double d3, double d4, double d5) {};
-    virtual double fnGetZ(){return z;};
-    virtual double fnGetAbsorb(double z);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], double aAbsorb[], int dimension, double stepsize, double dMaxArea);
-    virtual void   fnOverlayProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
-    virtual void   fnOverlayProfile(double aArea[], double anSLD[], double aAbsorb[], int dimension, double stepsize, double dMaxArea);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize) = 0;
-    virtual void   fnWriteData2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    nSLDObj& operator=(const nSLDObj &o);
+    virtual mgreal fnGetLowerLimit() = 0;
+    virtual mgreal fnGetUpperLimit() = 0;
+    virtual mgreal fnGetArea(mgreal z) = 0;
+    virtual mgreal fnGetConvolutedArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z) = 0;
+    virtual void   fnSetConvolution(mgreal sigma, int n);
+    virtual void   fnSetSigma(mgreal sigma) = 0;
+    virtual void   fnSetZ(mgreal dz) {fnUpdate(z,dz);};
+    virtual void   fnSetnSL(mgreal d) {fnUpdate(nSL,d);};
+    virtual void   fnSetnSL(mgreal d1, mgreal d2) {};
+    virtual void   fnSetnSL(mgreal d1, mgreal d2, mgreal d3) {};
+    virtual void   fnSetnSL(mgreal d1, mgreal d2, mgreal d3, mgreal d4) {};
+    virtual void   fnSetnSL(mgreal d1, mgreal d2, mgreal d3, mgreal d4, mgreal d5) {};
+    virtual mgreal fnGetZ(){return z;};
+    virtual mgreal fnGetAbsorb(mgreal z);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual void   fnOverlayProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual void   fnOverlayProfile(mgreal aArea[], mgreal anSLD[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual void   fnOverlayContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual void   fnSetBulknSLD(mgreal _bulknsld) {};
+    virtual mgreal fnGetBulknSLD() {return 0;};
+    mgreal fnWriteCanvas(Canvas &canvas);
+    void   fnOverlayCanvas(Canvas &canvas, mgreal dMaxArea);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize) = 0;
+    virtual void   fnWriteData2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual void   fnGetMoments(int dimension, double stepsize, Moments &moments);
+    virtual void   fnSetCaching(bool _bCaching);
+    virtual void   fnSetDirty();
+    virtual void   fnAdjustParameters() {};
+    virtual void   fnRegisterParameters(ParameterRegistry &registry) {};
+    int    fnSetParameters(const ParameterRegistry &registry, const double aValues[], int iFirstDerivative=0);
+    int    fnGetParameters(const ParameterRegistry &registry, double aValues[]);
+    mgreal fnGetParameter(const ParameterRegistry &registry, const char *cName);
     
     int iNumberOfConvPoints;
     bool bWrapping, bConvolution, bProtonExchange;
-    double absorb, z, l, nf, nSL, nSL2, vol, dSigmaConvolution;
+    mgreal absorb, z, l, nf, nSL, nSL2, vol, dSigmaConvolution;
+    
+    //incremental rasterization: with bCaching set, fnWriteProfile and fnOverlayProfile replay the
+    //per-grid-point contributions stored by the last rasterization unless bDirty is set. Setters flag
+    //bDirty only if a value actually changes, direct assignments to members require fnSetDirty() unless
+    //they are hashed by fnHashMembers and followed by a call to fnSet
+    bool bDirty, bCaching;
     
 protected:
-    virtual double CatmullInterpolate(double t, double pm1, double p0, double p1, double p2);
-    virtual double fnTriCubicCatmullInterpolate(double p[4][4][4],double t[3]);
-    virtual double fnQuadCubicCatmullInterpolate(double p[4][4][4][4],double t[4]);
+    void   fnUpdate(mgreal &dMember, mgreal dValue) {if (dMember!=dValue) {dMember=dValue; bDirty=true;}};
+    void   fnGetBin(int i, double stepsize, mgreal dLowerLimit, mgreal &dArea, mgreal &dnSL);
+    unsigned long long fnHashParameters(const mgreal aParameters[], int iNumberOfParameters);
+    virtual unsigned long long fnHashMembers(unsigned long long iHash) {return iHash;};
+    void   fnApplyState(const mgreal aParameters[], int iNumberOfParameters);
+    virtual void   fnRasterize(int dimension, double stepsize, bool bAbsorb, bool bBulk=false);
+    void   fnFreeCache();
+    void   fnRaster2Scratch(int dimension, double stepsize, bool bBulk);
+    
+    Raster *aRaster, *pRaster;              //cache slots and the slot holding the current state
+    Canvas *pScratch;                       //the current raster binned onto a canvas for the overlay kernels
+    unsigned long iRasterClock;
+    unsigned long long iStateHash;          //key of the state the current members derive from, 0 if none
+    
+    virtual mgreal CatmullInterpolate(mgreal t, mgreal pm1, mgreal p0, mgreal p1, mgreal p2);
+    virtual mgreal fnTriCubicCatmullInterpolate(mgreal p[4][4][4],mgreal t[3]);
+    virtual mgreal fnQuadCubicCatmullInterpolate(mgreal p[4][4][4][4],mgreal t[4]);
 
 };
 
@@ -42,37 +814,39 @@ class BoxErr : public nSLDObj
 {
 public:
     BoxErr() {};
-    BoxErr(double z, double sigma, double length, double vol, double nSL, double numberfraction);
+    BoxErr(mgreal z, mgreal sigma, mgreal length, mgreal vol, mgreal nSL, mgreal numberfraction);
     virtual ~BoxErr();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSetSigma(double dsigma) {sigma=dsigma;};
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSetSigma(mgreal dsigma) {fnUpdate(sigma,dsigma);};
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
-    double sigma;
+    mgreal sigma;
 };
 //------------------------------------------------------------------------------------------------------
 class Box2Err : public nSLDObj
 {
 public:
-    Box2Err() {};
-    Box2Err(double z, double sigma1, double sigma2, double length, double vol, double nSL, double numberfraction);
+    Box2Err() {sigma1=0; sigma2=0; nsldbulk_store=0;};
+    Box2Err(mgreal z, mgreal sigma1, mgreal sigma2, mgreal length, mgreal vol, mgreal nSL, mgreal numberfraction);
     virtual ~Box2Err();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSL(double bulknsld);
-    virtual double fnGetnSLD(double z);
-    virtual double fnGetnSLD(double z, double bulknsld);
-    virtual void   fnSetnSL(double d1, double d2);
-    virtual void   fnSetSigma(double sigma);
-    virtual void   fnSetSigma(double sigma1, double sigma2);
-    virtual void   fnSetZ(double dz);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    
-    double sigma1, sigma2, nsldbulk_store;
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSL(mgreal bulknsld);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z, mgreal bulknsld);
+    virtual void   fnSetnSL(mgreal d1, mgreal d2);
+    virtual void   fnSetSigma(mgreal sigma);
+    virtual void   fnSetSigma(mgreal sigma1, mgreal sigma2);
+    virtual void   fnSetZ(mgreal dz);
+    virtual void   fnSetBulknSLD(mgreal _bulknsld) {fnUpdate(nsldbulk_store,_bulknsld);};
+    virtual mgreal fnGetBulknSLD() {return nsldbulk_store;};
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    
+    mgreal sigma1, sigma2, nsldbulk_store;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -80,21 +854,21 @@ class BoxErrLinearSLD : public nSLDObj
 {
 public:
     BoxErrLinearSLD() {};
-    BoxErrLinearSLD(double z, double sigma1, double sigma2, double length, double vol, double nSLD1, double nSLD2, double numberfraction);
+    BoxErrLinearSLD(mgreal z, mgreal sigma1, mgreal sigma2, mgreal length, mgreal vol, mgreal nSLD1, mgreal nSLD2, mgreal numberfraction);
     virtual ~BoxErrLinearSLD();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual double fnGetnSL(double z);
-    virtual void   fnSetSigma(double sigma);
-    virtual void   fnSetSigma(double sigma1, double sigma2);
-    virtual void   fnSetnSLD(double nSLD);
-    virtual void   fnSetnSLD(double nSLD1, double nSLD2);
-    virtual void   fnSetZ(double dz);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual mgreal fnGetnSL(mgreal z);
+    virtual void   fnSetSigma(mgreal sigma);
+    virtual void   fnSetSigma(mgreal sigma1, mgreal sigma2);
+    virtual void   fnSetnSLD(mgreal nSLD);
+    virtual void   fnSetnSLD(mgreal nSLD1, mgreal nSLD2);
+    virtual void   fnSetZ(mgreal dz);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
-    double sigma1, sigma2, nSLD1, nSLD2;
+    mgreal sigma1, sigma2, nSLD1, nSLD2;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -103,15 +877,15 @@ class Gaussian : public nSLDObj
 {
 public:
     
-    Gaussian(double C, double sigma, double vol, double nSL, double numberfraction);
+    Gaussian(mgreal C, mgreal sigma, mgreal vol, mgreal nSL, mgreal numberfraction);
     virtual ~Gaussian();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
-    double sigma;
+    mgreal sigma;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -119,29 +893,29 @@ public:
 class Parabolic: public nSLDObj
 {
 public:
-    Parabolic(double dC, double dH, double dn, double dnSLD, double dnumberfraction);
+    Parabolic(mgreal dC, mgreal dH, mgreal dn, mgreal dnSLD, mgreal dnumberfraction);
     virtual ~Parabolic();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
-    double C, H, n, nSLD;
+    mgreal C, H, n, nSLD;
 };
 //------------------------------------------------------------------------------------------------------
 class StretchGaussian : public nSLDObj
 {
 public:
-    StretchGaussian(double z, double sigma, double length, double vol, double nSL, double numberfraction);
+    StretchGaussian(mgreal z, mgreal sigma, mgreal length, mgreal vol, mgreal nSL, mgreal numberfraction);
     virtual ~StretchGaussian();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
-    double sigma;
+    mgreal sigma;
 };
 
 
@@ -153,27 +927,35 @@ public:
 	
     Discrete(double dstartposition, double dnormarea, const char *cFileName);
     virtual ~Discrete();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetVolume(double dz1, double dz2);
-    virtual void fnSet(double _startposition, double _protonexchange, double _nsldbulksolvent, double _nf, double _normarea);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetSigma(double _sigma);
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
-    
-    
-    double dStartPosition, dProtExchange, dnSLDBulkSolvent;
+    Discrete(const Discrete &o);
+    Discrete& operator=(const Discrete &o);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetVolume(mgreal dz1, mgreal dz2);
+    virtual void fnSet(mgreal _startposition, mgreal _protonexchange, mgreal _nsldbulksolvent, mgreal _nf, mgreal _normarea);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetSigma(mgreal _sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld) {fnUpdate(dnSLDBulkSolvent,_bulknsld);};
+    virtual mgreal fnGetBulknSLD() {return dnSLDBulkSolvent;};
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
+    
+    
+    mgreal dStartPosition, dProtExchange, dnSLDBulkSolvent;
     double * area;
     double * nSLProt;
     double * nSLDeut;
     double * zcoord;
-    double nf;                  //number of proteins per unit area (typically area per outer leaflet lipid)
+    mgreal nf;                  //number of proteins per unit area (typically area per outer leaflet lipid)
     
 private:
+    int *piTableReferences;                 //copies share the read-only tables loaded from file, the count
+                                            //is not atomic: copy and destroy outside of parallel sections
+    void fnReleaseTables();
     int iNumberOfPoints;
-    double dZSpacing, normarea;
+    double dZSpacing;
+    mgreal normarea;
     
 	
 };
@@ -188,30 +970,37 @@ public:
                   double dGammaStart, double dGammaEnd, double dGammaInc, const char* strFileNameRoot, 
                   const char* strFileNameBeta, const char* strFileNameGamma, const char* strFileNameEnding);
     virtual ~DiscreteEuler();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetVolume(double dz1, double dz2);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetSigma(double sigma) {dsigma=sigma;}
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
-    
-    
-    double dStartPosition, dProtExchange, dnSLDBulkSolvent;
-    double dBeta, dGamma;                                         //Euler angles
+    DiscreteEuler(const DiscreteEuler &o);
+    DiscreteEuler& operator=(const DiscreteEuler &o);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetVolume(mgreal dz1, mgreal dz2);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetSigma(mgreal sigma) {fnUpdate(dsigma,sigma);}
+    virtual void fnSetBulknSLD(mgreal _bulknsld) {fnUpdate(dnSLDBulkSolvent,_bulknsld);};
+    virtual mgreal fnGetBulknSLD() {return dnSLDBulkSolvent;};
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
+    
+    
+    mgreal dStartPosition, dProtExchange, dnSLDBulkSolvent;
+    mgreal dBeta, dGamma;                                         //Euler angles
     char* strFileNameRoot[30], strFileNameBeta[30], strFileNameGamma[30], strFileNameEnding[30];
     double * area;
     double * nSLProt;
     double * nSLDeut;
     double * zcoord;
-    double nf, dsigma;                                          //number of proteins per unit area 
+    mgreal nf, dsigma;                                          //number of proteins per unit area 
                                                                 //(typically area per outer leaflet lipid)
     
 private:
+    int *piTableReferences;
+    void fnReleaseTables();
     int iNumberOfBeta, iNumberOfGamma, iNumberOfPoints;
     double dBetaStart, dBetaEnd, dBetaInc, dGammaStart, dGammaEnd, dGammaInc;
-    double dZSpacing, normarea;
+    double dZSpacing;
+    mgreal normarea;
     
     int fn3Cto1C(int c1, int c2, int c3);
     
@@ -228,30 +1017,37 @@ public:
                   double dSigmaInc, const char* strFileNameRoot,
                   const char* strFileNameBeta, const char* strFileNameGamma, const char* strFileNameEnding);
     virtual ~DiscreteEulerSigma();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetVolume(double dz1, double dz2);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetSigma(double sigma) {dSigma=sigma;}
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
-    
-    
-    double dStartPosition, dProtExchange, dnSLDBulkSolvent;
-    double dBeta, dGamma;                                         //Euler angles
+    DiscreteEulerSigma(const DiscreteEulerSigma &o);
+    DiscreteEulerSigma& operator=(const DiscreteEulerSigma &o);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetVolume(mgreal dz1, mgreal dz2);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetSigma(mgreal sigma) {fnUpdate(dSigma,sigma);}
+    virtual void fnSetBulknSLD(mgreal _bulknsld) {fnUpdate(dnSLDBulkSolvent,_bulknsld);};
+    virtual mgreal fnGetBulknSLD() {return dnSLDBulkSolvent;};
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
+    
+    
+    mgreal dStartPosition, dProtExchange, dnSLDBulkSolvent;
+    mgreal dBeta, dGamma;                                         //Euler angles
     char* strFileNameRoot[30], strFileNameBeta[30], strFileNameGamma[30], strFileNameEnding[30];
     double * area;
     double * nSLProt;
     double * nSLDeut;
     double * zcoord;
-    double nf, dSigma;                                          //number of proteins per unit area
+    mgreal nf, dSigma;                                          //number of proteins per unit area
 
     
 private:
+    int *piTableReferences;
+    void fnReleaseTables();
     int iNumberOfBeta, iNumberOfGamma, iNumberOfPoints, iNumberOfSigma;
     double dBetaStart, dBetaEnd, dBetaInc, dGammaStart, dGammaEnd, dGammaInc;
-    double dZSpacing, normarea;
+    double dZSpacing;
+    mgreal normarea;
     double dSigmaStart, dSigmaEnd, dSigmaInc;
     
     long int fn4Cto1C(int c1, int c2, int c3, int c4);
@@ -267,15 +1063,19 @@ public:
 	
     Discrete3Euler(double dnormarea, double dstartposition1, double dBetaStart1, double dBetaEnd1, double dBetaInc1, double dGammaStart1, double dGammaEnd1, double dGammaInc1, const char* strFileNameRoot1, const char* strFileNameBeta1, const char* strFileNameGamma1, const char* strFileNameEnding1, double dstartposition2, double dBetaStart2, double dBetaEnd2, double dBetaInc2, double dGammaStart2, double dGammaEnd2, double dGammaInc2, const char* strFileNameRoot2, const char* strFileNameBeta2, const char* strFileNameGamma2, const char* strFileNameEnding2, double dstartposition3, double dBetaStart3, double dBetaEnd3, double dBetaInc3, double dGammaStart3, double dGammaEnd3, double dGammaInc3, const char* strFileNameRoot3, const char* strFileNameBeta3, const char* strFileNameGamma3, const char* strFileNameEnding3);
     virtual ~Discrete3Euler();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetVolume(double dz1, double dz2);
-    virtual void fnSet(double bulknsld, double protonexchangeratio, double dBeta1, double dGamma1, double dStartPosition1, double nf_protein1, double dBeta2, double dGamma2, double dStartPosition2, double nf_protein2, double dBeta3, double dGamma3, double dStartPosition3, double nf_protein3);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
+    Discrete3Euler(const Discrete3Euler &o);
+    Discrete3Euler& operator=(const Discrete3Euler &o);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetVolume(mgreal dz1, mgreal dz2);
+    virtual void fnSet(mgreal bulknsld, mgreal protonexchangeratio, mgreal dBeta1, mgreal dGamma1, mgreal dStartPosition1, mgreal nf_protein1, mgreal dBeta2, mgreal dGamma2, mgreal dStartPosition2, mgreal nf_protein2, mgreal dBeta3, mgreal dGamma3, mgreal dStartPosition3, mgreal nf_protein3);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld);
+    virtual mgreal fnGetBulknSLD() {return protein1->dnSLDBulkSolvent;};
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
     
     DiscreteEuler *protein1, *protein2, *protein3;
 };
@@ -291,86 +1091,99 @@ class FreeBox: public nSLDObj
     
 public:
 	
-    FreeBox(int n, double dstartposition, double dnSLD, double dnormarea);
+    FreeBox(int n, mgreal dstartposition, mgreal dnSLD, mgreal dnormarea);
     virtual ~FreeBox();
+    FreeBox(const FreeBox &o);
+    FreeBox& operator=(const FreeBox &o);
     virtual void fnAdjustParameters();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual void fnSetStartposition(double dz);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetnSLD(double dnSLD);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual void fnSetStartposition(mgreal dz);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetnSLD(mgreal dnSLD);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
     
     Box2Err *box1, *box2, *box3, *box4, *box5, *box6, *box7, *box8, *box9, *box10;
     
     int numberofboxes;
-    double vf1, vf2, vf3, vf4, vf5, vf6, vf7, vf8, vf9, vf10;
-    double normarea, startposition, nSLD;
+    mgreal vf1, vf2, vf3, vf4, vf5, vf6, vf7, vf8, vf9, vf10;
+    mgreal normarea, startposition, nSLD;
     
 	
 };
 
 //---------------------------------------------------------------------------------------------------------
+//control points up to which the damped spline is evaluated in a stack buffer
+#ifndef MOLGROUPS_SPLINEPOINTS
+#define MOLGROUPS_SPLINEPOINTS 32
+#endif
+
 class Hermite: public nSLDObj
 {
     
     
 public:
 	
-    Hermite(){};
-    Hermite(int n, double dstartposition, double dnSLD, double dnormarea);
+    Hermite();
+    Hermite(int n, mgreal dstartposition, mgreal dnSLD, mgreal dnormarea);
     virtual ~Hermite();
-    virtual double fnGetArea(double dz);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetVolume(double dz1, double dz2);
-    virtual void fnSetNormarea(double dnormarea);
-    virtual void fnSetnSLD(double dnSLD);
-    virtual void fnSetRelative(double dSpacing, double dStart, double dDp[], double dVf[], double dnf);
-    virtual void fnSetSigma(double sigma){};
-    virtual void fnWriteGroup2File(FILE *fp, const char *cName, int dimension, double stepsize);
+    Hermite(const Hermite &o);
+    Hermite& operator=(const Hermite &o);
+    virtual mgreal fnGetArea(mgreal dz);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetVolume(mgreal dz1, mgreal dz2);
+    virtual void fnSetNormarea(mgreal dnormarea);
+    virtual void fnSetnSLD(mgreal dnSLD);
+    virtual void fnSetRelative(mgreal dSpacing, mgreal dStart, mgreal dDp[], mgreal dVf[], mgreal dnf);
+    virtual void fnSetSigma(mgreal sigma){};
+    virtual void fnWriteGroup2File(MolSink fp, const char *cName, int dimension, double stepsize);
     
     
     int numberofcontrolpoints, monotonic, damping;
-    double dampthreshold, dampFWHM, damptrigger;
-    double * vf;
-    double * dp;
-    double * damp;
-    double normarea, nSLD;
+    mgreal dampthreshold, dampFWHM, damptrigger;
+    mgreal * vf;
+    mgreal * dp;
+    mgreal normarea, nSLD;
     
 protected:
     
-    virtual double fnGetSplineAntiDerivative(double dz, double dp[], double dh[]);
-    virtual double fnGetSplineArea(double dz, double dp[], double dh[], int damping);
-    virtual int    fnGetSplinePars(double d, double dp[], double dh[], double &m0, double &m1, double &p0, double &p1);
-    virtual double fnGetSplineIntegral(double dz1, double dz2, double dp[], double dh[], int damping);
-    virtual double fnGetSplineProductIntegral(double dz1, double dz2, double dp[], double dh1[], double dh2[], int damping1, int damping2);
+    virtual mgreal fnGetSplineAntiDerivative(mgreal dz, mgreal dp[], mgreal dh[]);
+    virtual mgreal fnGetSplineArea(mgreal dz, mgreal dp[], mgreal dh[], int damping);
+    virtual int    fnGetSplinePars(mgreal d, mgreal dp[], mgreal dh[], mgreal &m0, mgreal &m1, mgreal &p0, mgreal &p1);
+    virtual mgreal fnGetSplineIntegral(mgreal dz1, mgreal dz2, mgreal dp[], mgreal dh[], int damping);
+    virtual mgreal fnGetSplineProductIntegral(mgreal dz1, mgreal dz2, mgreal dp[], mgreal dh1[], mgreal dh2[], int damping1, int damping2);
     
 	
 };
 
 //------------------------------------------------------------------------------------------------------
+//the nSLD comes from the control points in sld alone and does not depend on the bulk, the contrast
+//path gives it no bulk term. Setups that change sld with the contrast write it per contrast with
+//fnWriteProfile, which rasterizes it once per contrast
 class SLDHermite: public Hermite
 {
 public:
 	
-    SLDHermite() {};
-    SLDHermite(int n, double dstartposition, double dnormarea);
+    SLDHermite() {sld=NULL;};
+    SLDHermite(int n, mgreal dstartposition, mgreal dnormarea);
     virtual ~SLDHermite();
-    virtual double fnGetnSL(double dz1, double dz2);
-    virtual double fnGetnSLD(double dz);
-    virtual double fnGetnSLDIntegral(double dz1, double dz2);
-    virtual void fnSetTotalnSLD(double _totalnSLD);
+    SLDHermite(const SLDHermite &o);
+    SLDHermite& operator=(const SLDHermite &o);
+    virtual mgreal fnGetnSL(mgreal dz1, mgreal dz2);
+    virtual mgreal fnGetnSLD(mgreal dz);
+    virtual mgreal fnGetnSLDIntegral(mgreal dz1, mgreal dz2);
+    virtual void fnSetTotalnSLD(mgreal _totalnSLD);
     
     using Hermite::fnSetRelative;
-    virtual void fnSetRelative(double dSpacing, double dStart, double _dp[], double _vf[], double _sld[], double dnf);
+    virtual void fnSetRelative(mgreal dSpacing, mgreal dStart, mgreal _dp[], mgreal _vf[], mgreal _sld[], mgreal dnf);
     
-    double * sld;
-    double totalnSLD;
+    mgreal * sld;
+    mgreal totalnSLD;
     int bTotalnSLD;
 };
 
@@ -379,20 +1192,22 @@ public:
 class PC: public nSLDObj
 {
 protected:
-    double z;
+    mgreal z;
 public:
     PC();
     virtual ~PC();
+    PC(const PC &o);
+    PC& operator=(const PC &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetTotalnSL();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual double fnGetZ() {return z;};
-    virtual void fnSetSigma(double sigma);
-    virtual void fnSetZ(double dz);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetTotalnSL();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual mgreal fnGetZ() {return z;};
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetZ(mgreal dz);
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
     Box2Err *cg;
     Box2Err *phosphate;
@@ -405,9 +1220,9 @@ public:
     PCm();
     virtual ~PCm();
     virtual void fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
 };
 //------------------------------------------------------------------------------------------------------
 
@@ -415,20 +1230,22 @@ public:
 class PS: public nSLDObj
 {
 protected:
-    double z;
+    mgreal z;
 public:
     PS();
     virtual ~PS();
+    PS(const PS &o);
+    PS& operator=(const PS &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual double fnGetZ() {return z;};
-    virtual void fnSetSigma(double sigma);
-    virtual void fnSetZ(double dz);
-    virtual void fnSetnSL(double nSL_cg, double nSL_phosphate, double nSL_serine);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual mgreal fnGetZ() {return z;};
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetZ(mgreal dz);
+    virtual void fnSetnSL(mgreal nSL_cg, mgreal nSL_phosphate, mgreal nSL_serine);
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
     
     Box2Err *cg;
     Box2Err *phosphate;
@@ -447,10 +1264,10 @@ class AminoAcid: public BoxErr
 public:
     AminoAcid();
     virtual ~AminoAcid() {};
-    virtual double fnGetnSLD(double z);
+    virtual mgreal fnGetnSLD(mgreal z);
     
     int nH, nExch, Deuterated;
-    double ExchangeRatio;
+    mgreal ExchangeRatio;
 };
 //-----------------------------------------------------------------------------------------------------------
 //Specific implementations
@@ -590,19 +1407,25 @@ public:
 class BLM_quaternary: public nSLDObj
 {
 protected:
-    double normarea;
+    mgreal normarea;
 public:
     BLM_quaternary();
     virtual ~BLM_quaternary();
+    BLM_quaternary(const BLM_quaternary &o);
+    BLM_quaternary& operator=(const BLM_quaternary &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet(double sigma, double bulknsld, double startz, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid3=0, double nf_chol=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet(mgreal sigma, mgreal bulknsld, mgreal startz, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid3=0, mgreal nf_chol=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld);
+    virtual mgreal fnGetBulknSLD() {return bulknsld;};
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     PCm       *headgroup1;                                                 //mirrored PC head group
     Box2Err   *lipid1;
@@ -619,15 +1442,15 @@ public:
     Box2Err   *defect_headgroup;
     
     //primary fit parameters
-    double sigma, l_lipid1, l_lipid2, vf_bilayer, startz;
-    double hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
-    double nf_lipid_2, nf_lipid_3, nf_chol;
+    mgreal sigma, l_lipid1, l_lipid2, vf_bilayer, startz;
+    mgreal hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
+    mgreal nf_lipid_2, nf_lipid_3, nf_chol;
     
     //other parameters
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
-    double volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
-    double volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
-    double volchol, nslchol;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
+    mgreal volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
+    mgreal volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
+    mgreal volchol, nslchol;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -636,20 +1459,24 @@ public:
 class Monolayer: public nSLDObj
 {
 protected:
-    double normarea;
+    mgreal normarea;
 public:
     Monolayer();
     virtual ~Monolayer();
+    Monolayer(const Monolayer &o);
+    Monolayer& operator=(const Monolayer &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSetSigma(double sigma);
-    virtual void   fnSetnSL(double nSL_methyl, double nSL_lipid, double nSL_headgroup1, double nSL_headgroup2, double nSL_headgroup3);
-    virtual void   fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], double aAbsorb[], int dimension, double stepsize, double dMaxArea);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSetSigma(mgreal sigma);
+    virtual void   fnSetnSL(mgreal nSL_methyl, mgreal nSL_lipid, mgreal nSL_headgroup1, mgreal nSL_headgroup2, mgreal nSL_headgroup3);
+    virtual void   fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], mgreal aAbsorb[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     Box2Err   *substrate;
     nSLDObj   *headgroup;                                               
@@ -657,11 +1484,11 @@ public:
     Box2Err   *methyl;
     
     //primary fit parameters
-    double global_rough, sigma, l_lipid, vf_bilayer, rho_substrate, absorb_substrate;
-    double hc_substitution;
+    mgreal global_rough, sigma, l_lipid, vf_bilayer, rho_substrate, absorb_substrate;
+    mgreal hc_substitution;
     
     //other parameters
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid, absorbacyllipid, absorbmethyllipid;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid, absorbacyllipid, absorbmethyllipid;
 };
 
 
@@ -671,19 +1498,23 @@ public:
 class ssBLM: public nSLDObj
 {
 protected:
-    double normarea;
+    mgreal normarea;
 public:
     ssBLM();
     virtual ~ssBLM();
+    ssBLM(const ssBLM &o);
+    ssBLM& operator=(const ssBLM &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet(double sigma, double global_rough, double rho_substrate, double rho_siox, double l_siox, double l_submembrane, double l_lipid1, double l_lipid2, double vf_bilayer, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal rho_siox, mgreal l_siox, mgreal l_submembrane, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     Box2Err   *substrate;
     Box2Err   *siox;
@@ -698,29 +1529,35 @@ public:
     Box2Err   *defect_headgroup;
     
     //primary fit parameters
-    double global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate, rho_siox, l_submembrane, l_siox;
-    double hc_substitution_1, hc_substitution_2, radius_defect;
+    mgreal global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate, rho_siox, l_submembrane, l_siox;
+    mgreal hc_substitution_1, hc_substitution_2, radius_defect;
     
     //other parameters
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
 };
 
 class ssBLM_quaternary: public nSLDObj
 {
 protected:
-    double normarea;
+    mgreal normarea;
 public:
     ssBLM_quaternary();
     virtual ~ssBLM_quaternary();
+    ssBLM_quaternary(const ssBLM_quaternary &o);
+    ssBLM_quaternary& operator=(const ssBLM_quaternary &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet(double sigma, double global_rough, double rho_substrate, double bulknsld, double rho_siox, double l_siox, double l_submembrane, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid3=0, double nf_chol=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal bulknsld, mgreal rho_siox, mgreal l_siox, mgreal l_submembrane, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid3=0, mgreal nf_chol=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld);
+    virtual mgreal fnGetBulknSLD() {return bulknsld;};
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     Box2Err   *substrate;
     Box2Err   *siox;
@@ -739,15 +1576,15 @@ public:
     Box2Err   *defect_headgroup;
     
     //primary fit parameters
-    double global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate, rho_siox, l_submembrane, l_siox;
-    double hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
-    double nf_lipid_2, nf_lipid_3, nf_chol;
+    mgreal global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate, rho_siox, l_submembrane, l_siox;
+    mgreal hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
+    mgreal nf_lipid_2, nf_lipid_3, nf_chol;
     
     //other parameters
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
-    double volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
-    double volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
-    double volchol, nslchol;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
+    mgreal volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
+    mgreal volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
+    mgreal volchol, nslchol;
 };
 //------------------------------------------------------------------------------------------------------
 //quaternary ssBLM with two substrate layers on the canvas, for example, SiOx and Cr
@@ -757,37 +1594,46 @@ class ssBLM_quaternary_2sub: public ssBLM_quaternary
 public:
     ssBLM_quaternary_2sub();
     virtual ~ssBLM_quaternary_2sub();
+    ssBLM_quaternary_2sub(const ssBLM_quaternary_2sub &o);
+    ssBLM_quaternary_2sub& operator=(const ssBLM_quaternary_2sub &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet_2sub(double sigma, double global_rough, double rho_substrate, double bulknsld, double rho_siox, double l_siox, double rho_cr, double l_cr, double l_submembrane, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid3=0, double nf_chol=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet_2sub(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal bulknsld, mgreal rho_siox, mgreal l_siox, mgreal rho_cr, mgreal l_cr, mgreal l_submembrane, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid3=0, mgreal nf_chol=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
 
     Box2Err   *cr;
     
     //primary fit parameters
-    double rho_cr, l_cr;
+    mgreal rho_cr, l_cr;
 };
 
 //------------------------------------------------------------------------------------------------------
 class hybridBLM_quaternary: public nSLDObj
 {
 protected:
-    double normarea;
+    mgreal normarea;
 public:
     hybridBLM_quaternary();
     virtual ~hybridBLM_quaternary();
+    hybridBLM_quaternary(const hybridBLM_quaternary &o);
+    hybridBLM_quaternary& operator=(const hybridBLM_quaternary &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetNormarea() {return normarea;};
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet(double sigma, double global_rough, double rho_substrate, double bulknsld, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid3=0, double nf_chol=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetNormarea() {return normarea;};
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal bulknsld, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid3=0, mgreal nf_chol=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld);
+    virtual mgreal fnGetBulknSLD() {return bulknsld;};
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     Box2Err   *substrate;
     Box2Err   *headgroup1;                                                 //mirrored PC head group
@@ -805,16 +1651,16 @@ public:
     Box2Err   *defect_headgroup;
     
     //primary fit parameters
-    double global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate;
-    double hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
-    double nf_lipid_2, nf_lipid_3, nf_chol;
+    mgreal global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, rho_substrate;
+    mgreal hc_substitution_1, hc_substitution_2, radius_defect, bulknsld;
+    mgreal nf_lipid_2, nf_lipid_3, nf_chol;
     
     //other parameters
-    double volacylsam, nslacylsam, volheadsam, nslheadsam, volmethylsam, nslmethylsam;
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
-    double volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
-    double volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
-    double volchol, nslchol;
+    mgreal volacylsam, nslacylsam, volheadsam, nslheadsam, volmethylsam, nslmethylsam;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid;
+    mgreal volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
+    mgreal volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
+    mgreal volchol, nslchol;
 };
 
 
@@ -826,16 +1672,22 @@ class tBLM_quaternary_chol: public nSLDObj
 public:
     tBLM_quaternary_chol();
     virtual ~tBLM_quaternary_chol();
+    tBLM_quaternary_chol(const tBLM_quaternary_chol &o);
+    tBLM_quaternary_chol& operator=(const tBLM_quaternary_chol &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetNormarea() {return normarea;};
-    virtual double fnGetnSLD(double z);
-    virtual void   fnSet(double sigma, double global_rough, double rho_substrate, double dbulknsld, double nf_tether, double mult_tether, double l_tether, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid_3=0, double nf_chol=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetNormarea() {return normarea;};
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void   fnSet(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal dbulknsld, mgreal nf_tether, mgreal mult_tether, mgreal l_tether, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid_3=0, mgreal nf_chol=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnSetBulknSLD(mgreal _bulknsld);
+    virtual mgreal fnGetBulknSLD() {return bulknsld;};
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
     Box2Err   *substrate;
     Box2Err   *bME;
@@ -856,19 +1708,19 @@ public:
     Box2Err   *defect_headgroup;
     
     //primary fit parameters
-    double global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, l_tether, nf_tether, mult_tether, rho_substrate, bulknsld;
-    double hc_substitution_1, hc_substitution_2, radius_defect;
-    double nf_lipid_2;
-    double nf_lipid_3;
-    double nf_chol;
-    double normarea;
+    mgreal global_rough, sigma, l_lipid1, l_lipid2, vf_bilayer, l_tether, nf_tether, mult_tether, rho_substrate, bulknsld;
+    mgreal hc_substitution_1, hc_substitution_2, radius_defect;
+    mgreal nf_lipid_2;
+    mgreal nf_lipid_3;
+    mgreal nf_chol;
+    mgreal normarea;
     
     //other parameters
-    double volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid, volmethyltether;
-    double nslmethyltether, volacyltether, nslacyltether;
-    double volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
-    double volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
-    double volchol, nslchol;
+    mgreal volacyllipid, nslacyllipid, volmethyllipid, nslmethyllipid, volmethyltether;
+    mgreal nslmethyltether, volacyltether, nslacyltether;
+    mgreal volacyllipid_2, nslacyllipid_2, volmethyllipid_2, nslmethyllipid_2;
+    mgreal volacyllipid_3, nslacyllipid_3, volmethyllipid_3, nslmethyllipid_3;
+    mgreal volchol, nslchol;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -881,12 +1733,13 @@ public:
     virtual ~tBLM_quaternary_chol_2leaflet() {};
     virtual void   fnAdjustParameters();
     using tBLM_quaternary_chol::fnSet;
-    virtual void   fnSet(double sigma, double global_rough, double rho_substrate, double dbulknsld, double nf_tether, double mult_tether, double l_tether, double l_lipid1, double l_lipid2, double vf_bilayer, double nf_lipid_2=0, double nf_lipid_3=0, double nf_chol=0, double nf_lipid_2_inner=0, double nf_lipid_3_inner=0, double nf_chol_inner=0, double hc_substitution_1=0, double hc_substitution_2=0, double radius_defect=100);
+    virtual void   fnSet(mgreal sigma, mgreal global_rough, mgreal rho_substrate, mgreal dbulknsld, mgreal nf_tether, mgreal mult_tether, mgreal l_tether, mgreal l_lipid1, mgreal l_lipid2, mgreal vf_bilayer, mgreal nf_lipid_2=0, mgreal nf_lipid_3=0, mgreal nf_chol=0, mgreal nf_lipid_2_inner=0, mgreal nf_lipid_3_inner=0, mgreal nf_chol_inner=0, mgreal hc_substitution_1=0, mgreal hc_substitution_2=0, mgreal radius_defect=100);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
         
     //primary fit parameters
-    double nf_lipid_2_inner;
-    double nf_lipid_3_inner;
-    double nf_chol_inner;
+    mgreal nf_lipid_2_inner;
+    mgreal nf_lipid_3_inner;
+    mgreal nf_chol_inner;
     
     //other parameters
 };
@@ -901,18 +1754,23 @@ public:
 class tBLM_quaternary_chol_domain: public tBLM_quaternary_chol
 {
 protected:
-    double normarea, normarea_domain;
+    mgreal normarea, normarea_domain;
+    virtual unsigned long long fnHashMembers(unsigned long long iHash);
 public:
     tBLM_quaternary_chol_domain();
     virtual ~tBLM_quaternary_chol_domain();
+    tBLM_quaternary_chol_domain(const tBLM_quaternary_chol_domain &o);
+    tBLM_quaternary_chol_domain& operator=(const tBLM_quaternary_chol_domain &o);
     virtual void   fnAdjustParameters();
-    virtual double fnGetLowerLimit();
-    virtual double fnGetUpperLimit();
-    virtual double fnGetArea(double z);
-    virtual double fnGetnSLD(double z);
-    virtual void fnSetSigma(double sigma);
-    virtual void fnWriteGroup2File (FILE *fp, const char *cName, int dimension, double stepsize);
-    virtual double fnWriteProfile(double aArea[], double anSLD[], int dimension, double stepsize, double dMaxArea);
+    virtual void   fnRegisterParameters(ParameterRegistry &registry);
+    virtual mgreal fnGetLowerLimit();
+    virtual mgreal fnGetUpperLimit();
+    virtual mgreal fnGetArea(mgreal z);
+    virtual mgreal fnGetnSLD(mgreal z);
+    virtual void fnSetSigma(mgreal sigma);
+    virtual void fnWriteGroup2File (MolSink fp, const char *cName, int dimension, double stepsize);
+    virtual mgreal fnWriteProfile(mgreal aArea[], mgreal anSLD[], int dimension, double stepsize, mgreal dMaxArea);
+    virtual mgreal fnWriteContrastProfile(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], int dimension, double stepsize, mgreal dMaxArea);
     
 
     PCm       *headgroup1_domain;
@@ -929,12 +1787,12 @@ public:
     Box2Err   *tether_domain;
 
     
-    double nf_lipid_2_domain;
-    double nf_lipid_3_domain;
-    double nf_chol_domain;
+    mgreal nf_lipid_2_domain;
+    mgreal nf_lipid_3_domain;
+    mgreal nf_chol_domain;
     
     //frac_domain is a molar fraction
-    double frac_domain, l_lipid1_domain, l_lipid2_domain, l_tether_domain;
+    mgreal frac_domain, l_lipid1_domain, l_lipid2_domain, l_tether_domain;
 };
 
 //------------------------------------------------------------------------------------------------------
@@ -972,6 +1830,8 @@ class Monolayer_DOPS: public Monolayer
 public:
     Monolayer_DOPS();
     virtual ~Monolayer_DOPS();
+    Monolayer_DOPS(const Monolayer_DOPS &o);
+    Monolayer_DOPS& operator=(const Monolayer_DOPS &o);
 };
 class Monolayer_DOPS_xray: public Monolayer_DOPS
 {
@@ -984,6 +1844,8 @@ class Monolayer_DPPS: public Monolayer
 public:
     Monolayer_DPPS();
     virtual ~Monolayer_DPPS();
+    Monolayer_DPPS(const Monolayer_DPPS &o);
+    Monolayer_DPPS& operator=(const Monolayer_DPPS &o);
 };
 class Monolayer_DPPS_xray: public Monolayer_DPPS
 {
@@ -1408,10 +2270,48 @@ public:
 //------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------
 
-void fnWriteConstant(FILE *fp, const char *cName, double area, double nSLD, int dimension, double stepsize);
-void fnOverlayCanvasOnCanvas(double aArea[], double anSL[], double aArea2[], double anSL2[], int dimension, double dMaxArea);
-void fnOverlayCanvasOnCanvas(double aArea[], double anSL[], double aAbsorb[], double aArea2[], double anSL2[], double aAbsorb2[], int dimension, double dMaxArea);
-double fnClearCanvas(double aArea[], double anSL[], int dimension);
-double fnClearCanvas(double aArea[], double anSL[], double aAbsorb[], int dimension);
-void fnWriteCanvas2Model(double aArea[], double anSL[], fitinfo fit[], int gaussstart, int dimension, double stepsize, double dMaxArea, double normarea, int modelstart, int modelend);
-void fnWriteCanvas2Model(double aArea[], double anSL[], double aAbsorb[], fitinfo fit[], int gaussstart, int dimension, double stepsize, double dMaxArea, double normarea, int modelstart, int modelend);
+unsigned long long fnHashBytes(const void *p, size_t n, unsigned long long iHash=14695981039346656037ULL);
+void fnWriteConstant(MolSink fp, const char *cName, mgreal area, mgreal nSLD, int dimension, double stepsize);
+void fnOverlayCanvasOnCanvas(mgreal aArea[], mgreal anSL[], mgreal aArea2[], mgreal anSL2[], int dimension, mgreal dMaxArea);
+void fnOverlayCanvasOnCanvas(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], mgreal aArea2[], mgreal anSL2[], mgreal aAbsorb2[], int dimension, mgreal dMaxArea);
+void fnOverlayCanvasOnCanvas(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT aAbsorb, mgreal * MOLGROUPS_RESTRICT anSLBulk, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT aAbsorb2, const mgreal * MOLGROUPS_RESTRICT anSLBulk2, int dimension, mgreal dMaxArea);
+mgreal fnClearCanvas(mgreal aArea[], mgreal anSL[], int dimension);
+mgreal fnClearCanvas(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], int dimension);
+void fnWriteCanvas2Model(mgreal aArea[], mgreal anSL[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend);
+void fnWriteCanvas2Model(mgreal aArea[], mgreal anSL[], mgreal aAbsorb[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend);
+void fnWriteContrastCanvas2Model(mgreal aArea[], mgreal anSL[], mgreal anSLBulk[], fitinfo fit[], int gaussstart, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int modelstart, int modelend);
+mgreal fnClearCanvas(Canvas &canvas);
+void fnOverlayCanvasOnCanvas(Canvas &canvas, Canvas &canvas2, mgreal dMaxArea);
+void fnCompositeProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, int dimension, mgreal dMaxArea);
+void fnCompositeProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT aAbsorb, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT aAbsorb2, int dimension, mgreal dMaxArea);
+void fnCompositeContrastProfile(mgreal * MOLGROUPS_RESTRICT aArea, mgreal * MOLGROUPS_RESTRICT anSL, mgreal * MOLGROUPS_RESTRICT anSLBulk, const mgreal * MOLGROUPS_RESTRICT aArea2, const mgreal * MOLGROUPS_RESTRICT anSL2, const mgreal * MOLGROUPS_RESTRICT anSLBulk2, int dimension, mgreal dMaxArea);
+void fnWriteCanvas2Model(Canvas &canvas, fitinfo fit[], int gaussstart, mgreal normarea, int modelstart, int modelend);
+void fnWriteCanvas2Targets(Canvas &canvas, ModelTarget targets[], int ntargets, mgreal normarea);
+void fnWriteCanvas2Buffer(Canvas &canvas, const double abulkrho[], const double abulkmu[], int ncontrasts, mgreal normarea, double arho[], double amu[]);
+int fnMergeSlabs(const double arho[], const double amu[], int dimension, double stepsize, double dTolerance, double dToleranceMu, Slab aSlabs[]);
+int fnWriteCanvas2Slabs(Canvas &canvas, double bulkrho, double bulkmu, mgreal normarea, double dTolerance, double dToleranceMu, Slab aSlabs[]);
+void fnReflectivity(const Slab aSlabs[], int nslabs, const double aQ[], int nQ, double aR[], ThreadPool *pool=NULL);
+void fnReflectivitySmeared(const Slab aSlabs[], int nslabs, const double aQ[], const double adQ[], int nQ, int nquadrature, double aR[], ThreadPool *pool=NULL);
+void fnCanvasReflectivity(const Slab aTop[], int ntop, Canvas &canvas, double bulkrho, double bulkmu, mgreal normarea, double dTolerance, const double aQ[], const double adQ[], int nQ, int nquadrature, double aR[], ThreadPool *pool=NULL);
+void fnContrastReflectivity(Canvas &canvas, mgreal normarea, double dTolerance, int nquadrature, ContrastJob aJobs[], int ncontrasts, ThreadPool *pool=NULL);
+void fnGaussHermite(int n, double x[], double w[]);
+void fnEvaluatePopulation(PopulationModel &model, const double aParameters[], int nmembers, int nparameters, Canvas aCanvas[], ThreadPool *pool=NULL);
+void fnEvaluatePopulation(PopulationModel &model, const double aParameters[], int nmembers, int nparameters, const double aQ[], const double adQ[], int nQ, double aR[], ThreadPool *pool=NULL);
+int fnRecreateStatistical(PopulationModel &model, const char *cStatFile, const char *acNames[], int nparameters, const char *cStoreFile, bool bMolgroups=true, bool bCompress=false, ThreadPool *pool=NULL, int nbatch=256, Envelope *pEnvelope=NULL, PropertyStatistics *pProperties=NULL, ContourHistogram *pContour=NULL);
+double fnChiSquareKernel(const double * MOLGROUPS_RESTRICT aModel, const double * MOLGROUPS_RESTRICT aR, const double * MOLGROUPS_RESTRICT adR, int n, double * MOLGROUPS_RESTRICT aResiduals);
+double fnChiSquare(const double aModel[], const Dataset aData[], int ncontrasts, double aChisq[]=NULL, double aResiduals[]=NULL);
+double fnChiSquare(PopulationModel *aModels[], const Dataset aData[], int ncontrasts, const double aParameters[], Canvas &canvas, double aScratch[], double aChisq[]=NULL, double aResiduals[]=NULL);
+void fnPhilox(const unsigned int aCounter[4], unsigned long long iKey, unsigned int aOut[4]);
+void fnResample(const Dataset &data, unsigned long long iSeed, int iReplica, int iContrast, double aR[]);
+void fnResample(const Dataset &data, unsigned long long iSeed, int iFirst, int nreplicas, int iContrast, double aR[], ThreadPool *pool=NULL);
+int fnFitSimplex(const FitProblem &problem, PopulationModel *aModels[], const Dataset aData[], double aParameters[], double &chisq);
+void fnBootstrapReplica(const FitProblem &problem, unsigned long long iSeed, int iReplica, double aRow[]);
+void fnBootstrap(const FitProblem &problem, int nreplicas, unsigned long long iSeed, double aResults[], ThreadPool *pool=NULL);
+bool fnWriteResults(const FitProblem &problem, const double aResults[], int nreplicas, const char *cFileName);
+#ifdef MOLGROUPS_DUAL
+void fnWriteCanvas2Gradient(mgreal aArea[], mgreal anSL[], mgreal bulknsld, int dimension, double stepsize, mgreal dMaxArea, mgreal normarea, int nparameters, double arho[], double adrho[]);
+#endif
+
+#ifdef MOLGROUPS_NAMESPACE
+}
+#endif
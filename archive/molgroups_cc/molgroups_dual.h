@@ -0,0 +1,147 @@
+/*
+ *  molgroups_dual.h
+ *  Gauss
+ *
+ *  Forward-mode dual numbers for molgroups. When molgroups.cc is compiled with
+ *  -DMOLGROUPS_DUAL every model parameter and every canvas bin carries, next to its
+ *  value, the partial derivatives with respect to up to MOLGROUPS_NDERIV seeded fit
+ *  parameters. A single fnAdjustParameters + fnWriteProfile pass then returns
+ *  d(area)/dp and d(nSL)/dp for all seeded parameters at once.
+ *
+ */
+
+#ifndef MOLGROUPS_DUAL_H
+#define MOLGROUPS_DUAL_H
+
+#include "math.h"
+
+#ifndef MOLGROUPS_NDERIV
+#define MOLGROUPS_NDERIV 64
+#endif
+
+class mgdual
+{
+public:
+    mgdual() {v=0; fnClearGradient();};
+    mgdual(double d) {v=d; fnClearGradient();};
+
+    void fnClearGradient() {for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]=0;}};
+
+    mgdual& operator+=(const mgdual &b) {v+=b.v; for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]+=b.g[i];} return *this;};
+    mgdual& operator-=(const mgdual &b) {v-=b.v; for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]-=b.g[i];} return *this;};
+    mgdual& operator*=(const mgdual &b) {for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]=g[i]*b.v+v*b.g[i];} v*=b.v; return *this;};
+    mgdual& operator/=(const mgdual &b) {for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]=(g[i]*b.v-v*b.g[i])/(b.v*b.v);} v/=b.v; return *this;};
+    mgdual& operator+=(double b) {v+=b; return *this;};
+    mgdual& operator-=(double b) {v-=b; return *this;};
+    mgdual& operator*=(double b) {v*=b; for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]*=b;} return *this;};
+    mgdual& operator/=(double b) {v/=b; for (int i=0; i<MOLGROUPS_NDERIV; i++) {g[i]/=b;} return *this;};
+
+    double v;                                   //value
+    double g[MOLGROUPS_NDERIV];                 //partial derivatives with respect to the seeded parameters
+};
+
+//------------------------------------------------------------------------------------------------------
+//value access and seeding
+
+inline double fnValue(const mgdual &a) {return a.v;};
+inline double fnValue(double d) {return d;};
+
+//marks d as independent fit parameter number iParameter (0..MOLGROUPS_NDERIV-1)
+inline void fnSeedDerivative(mgdual &d, int iParameter)
+{
+    d.fnClearGradient();
+    if ((iParameter>=0) && (iParameter<MOLGROUPS_NDERIV)) {d.g[iParameter]=1;}
+};
+
+inline double fnDerivative(const mgdual &a, int iParameter) {return a.g[iParameter];};
+
+//------------------------------------------------------------------------------------------------------
+//arithmetic
+
+inline mgdual operator+(const mgdual &a) {return a;};
+inline mgdual operator-(const mgdual &a) {mgdual r(a); r*=-1.; return r;};
+
+inline mgdual operator+(const mgdual &a, const mgdual &b) {mgdual r(a); r+=b; return r;};
+inline mgdual operator+(const mgdual &a, double b) {mgdual r(a); r+=b; return r;};
+inline mgdual operator+(double a, const mgdual &b) {mgdual r(b); r+=a; return r;};
+inline mgdual operator-(const mgdual &a, const mgdual &b) {mgdual r(a); r-=b; return r;};
+inline mgdual operator-(const mgdual &a, double b) {mgdual r(a); r-=b; return r;};
+inline mgdual operator-(double a, const mgdual &b) {mgdual r(-b); r+=a; return r;};
+inline mgdual operator*(const mgdual &a, const mgdual &b) {mgdual r(a); r*=b; return r;};
+inline mgdual operator*(const mgdual &a, double b) {mgdual r(a); r*=b; return r;};
+inline mgdual operator*(double a, const mgdual &b) {mgdual r(b); r*=a; return r;};
+inline mgdual operator/(const mgdual &a, const mgdual &b) {mgdual r(a); r/=b; return r;};
+inline mgdual operator/(const mgdual &a, double b) {mgdual r(a); r/=b; return r;};
+inline mgdual operator/(double a, const mgdual &b)
+{
+    mgdual r;
+    r.v=a/b.v;
+    for (int i=0; i<MOLGROUPS_NDERIV; i++) {r.g[i]=(-1)*a*b.g[i]/(b.v*b.v);}
+    return r;
+};
+
+//comparisons act on the value only, branches are taken as in the double code
+inline bool operator< (const mgdual &a, const mgdual &b) {return a.v< b.v;};
+inline bool operator<=(const mgdual &a, const mgdual &b) {return a.v<=b.v;};
+inline bool operator> (const mgdual &a, const mgdual &b) {return a.v> b.v;};
+inline bool operator>=(const mgdual &a, const mgdual &b) {return a.v>=b.v;};
+inline bool operator==(const mgdual &a, const mgdual &b) {return a.v==b.v;};
+inline bool operator!=(const mgdual &a, const mgdual &b) {return a.v!=b.v;};
+inline bool operator< (const mgdual &a, double b) {return a.v< b;};
+inline bool operator<=(const mgdual &a, double b) {return a.v<=b;};
+inline bool operator> (const mgdual &a, double b) {return a.v> b;};
+inline bool operator>=(const mgdual &a, double b) {return a.v>=b;};
+inline bool operator==(const mgdual &a, double b) {return a.v==b;};
+inline bool operator!=(const mgdual &a, double b) {return a.v!=b;};
+inline bool operator< (double a, const mgdual &b) {return a< b.v;};
+inline bool operator<=(double a, const mgdual &b) {return a<=b.v;};
+inline bool operator> (double a, const mgdual &b) {return a> b.v;};
+inline bool operator>=(double a, const mgdual &b) {return a>=b.v;};
+inline bool operator==(double a, const mgdual &b) {return a==b.v;};
+inline bool operator!=(double a, const mgdual &b) {return a!=b.v;};
+
+//------------------------------------------------------------------------------------------------------
+//elementary functions, chain rule applied to the gradient
+
+inline mgdual fnChain(const mgdual &a, double value, double derivative)
+{
+    mgdual r;
+    r.v=value;
+    for (int i=0; i<MOLGROUPS_NDERIV; i++) {r.g[i]=derivative*a.g[i];}
+    return r;
+};
+
+inline mgdual erf(const mgdual &a) {return fnChain(a, erf(a.v), 1.128379167095513*exp((-1)*a.v*a.v));};
+inline mgdual exp(const mgdual &a) {double e=exp(a.v); return fnChain(a, e, e);};
+inline mgdual log(const mgdual &a) {return fnChain(a, log(a.v), 1/a.v);};
+inline mgdual sqrt(const mgdual &a)
+{
+    double s=sqrt(a.v);
+    return fnChain(a, s, (s!=0) ? 0.5/s : 0);
+};
+inline mgdual fabs(const mgdual &a) {return fnChain(a, fabs(a.v), (a.v<0) ? -1 : 1);};
+inline mgdual floor(const mgdual &a) {return mgdual(floor(a.v));};
+inline mgdual ceil(const mgdual &a) {return mgdual(ceil(a.v));};
+inline mgdual pow(const mgdual &a, double b) {return fnChain(a, pow(a.v,b), (b!=0) ? b*pow(a.v,b-1) : 0);};
+inline mgdual pow(const mgdual &a, const mgdual &b)
+{
+    mgdual r;
+    r.v=pow(a.v,b.v);
+    for (int i=0; i<MOLGROUPS_NDERIV; i++) {
+        r.g[i]=(a.v!=0) ? r.v*(b.v*a.g[i]/a.v+log(fabs(a.v))*b.g[i]) : 0;
+    }
+    return r;
+};
+inline mgdual fmin(const mgdual &a, const mgdual &b) {return (a.v<=b.v) ? a : b;};
+inline mgdual fmax(const mgdual &a, const mgdual &b) {return (a.v>=b.v) ? a : b;};
+//the integral part carries no derivative, the fractional part all of it
+inline mgdual modf(const mgdual &a, mgdual *ip)
+{
+    double dip;
+    mgdual r(a);
+    r.v=modf(a.v,&dip);
+    *ip=mgdual(dip);
+    return r;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ *  bilayer_model.h
+ *
+ *  A small model for the programs in this directory, include after molgroups.cc: a tethered bilayer on a
+ *  silicon substrate whose l_lipid1, l_lipid2 and vf_bilayer are the parameters, in a bulk set at
+ *  construction.
+ *
+ */
+
+#ifndef MOLGROUPS_TEST_BILAYER_MODEL_H
+#define MOLGROUPS_TEST_BILAYER_MODEL_H
+
+#define TEST_NQ 120
+#define TEST_DIMENSION 300
+#define TEST_STEPSIZE 0.5
+
+class BilayerModel: public PopulationModel
+{
+public:
+    BilayerModel(double _bulk=6.3e-6) {bulk=_bulk;};
+    PopulationModel* fnClone() const {return new BilayerModel(*this);};
+    void fnEvaluate(const double aParameters[], Canvas &canvas)
+    {
+        bilayer.fnSet(2.5, 3.0, 4.5e-6, bulk, 0.8, 1.0, aParameters[0], aParameters[1], aParameters[1], aParameters[2], 0.3);
+        canvas.fnResize(TEST_DIMENSION, TEST_STEPSIZE);
+        fnClearCanvas(canvas);
+        normarea=bilayer.fnWriteCanvas(canvas);
+        ntop=1; aTop[0].rho=2.07e-6; aTop[0].mu=0;
+        bulkrho=bulk; bulkmu=0;
+    };
+    void fnWriteGroups(MolSink fp, int dimension, double stepsize)
+    {
+        bilayer.fnWriteGroup2File(fp, "bilayer", dimension, stepsize);
+        fnWriteConstant(fp, "normarea", normarea, 0, dimension, stepsize);
+    };
+
+    tBLM_HC18_POPC_POPS bilayer;
+    double bulk;
+};
+
+//number of doubles in which a and b differ bitwise
+int fnDiffer(const double a[], const double b[], int n)
+{
+    int i, ndiffer=0;
+
+    for (i=0; i<n; i++) {
+        if (memcmp(a+i, b+i, sizeof(double))!=0) {ndiffer++;}
+    }
+    return ndiffer;
+}
+
+#endif
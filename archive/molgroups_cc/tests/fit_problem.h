@@ -0,0 +1,46 @@
+/*
+ *  fit_problem.h
+ *
+ *  A small fit for the programs in this directory, include after molgroups.cc: the bilayer of
+ *  bilayer_model.h with l_lipid1, l_lipid2 and vf_bilayer fitted to R(Q) simulated at known values, in up
+ *  to three bulk contrasts on a silicon substrate, with 3% errors.
+ *
+ */
+
+#ifndef MOLGROUPS_TEST_FIT_PROBLEM_H
+#define MOLGROUPS_TEST_FIT_PROBLEM_H
+
+#include "bilayer_model.h"
+
+class TestProblem: public FitProblem
+{
+public:
+    TestProblem(int _ncontrasts)
+    {
+        const double aBulk[3]={6.3e-6, -0.5e-6, 2.0e-6};
+        const double aTruth[3]={12.5, 13.4, 0.92};
+        const double aLow[3]={10, 10, 0.7}, aHigh[3]={15, 15, 1.0}, aInitial[3]={11, 14, 0.85};
+        static const char *acParameters[3]={"l_lipid1", "l_lipid2", "vf_bilayer"};
+        Canvas canvas;
+        int i, j;
+
+        ncontrasts=_ncontrasts; nparameters=3;
+        for (i=0; i<TEST_NQ; i++) {aQ[i]=0.01+i*0.002;}
+        for (i=0; i<3; i++) {
+            aLower[i]=aLow[i]; aUpper[i]=aHigh[i]; aStart[i]=aInitial[i]; acNames[i]=acParameters[i];
+        }
+        for (j=0; j<ncontrasts; j++) {
+            aBilayers[j].bulk=aBulk[j];
+            aBilayers[j].fnEvaluate(aTruth, canvas);
+            fnCanvasReflectivity(aBilayers[j].aTop, aBilayers[j].ntop, canvas, aBulk[j], 0, aBilayers[j].normarea, 0, aQ, NULL, TEST_NQ, 0, aR[j]);
+            for (i=0; i<TEST_NQ; i++) {adR[j][i]=0.03*aR[j][i]+1e-9;}
+            aModels[j]=&aBilayers[j];
+            aData[j].aQ=aQ; aData[j].aR=aR[j]; aData[j].adR=adR[j]; aData[j].nQ=TEST_NQ-10*j;
+        }
+    };
+
+    BilayerModel aBilayers[3];
+    double aQ[TEST_NQ], aR[3][TEST_NQ], adR[3][TEST_NQ];
+};
+
+#endif
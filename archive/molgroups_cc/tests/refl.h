@@ -0,0 +1,16 @@
+/*
+ *  refl.h
+ *
+ *  Stand-in for the refl.h of garefl with the two types molgroups uses, so that the programs in this
+ *  directory build without garefl.
+ *
+ */
+
+#ifndef MOLGROUPS_TEST_REFL_H
+#define MOLGROUPS_TEST_REFL_H
+
+typedef double Real;
+typedef struct {int n; Real *d, *rho, *mu, *rough;} model;
+typedef struct {model m;} fitinfo;
+
+#endif
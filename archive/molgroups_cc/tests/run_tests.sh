@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+#  run_tests.sh
+#
+#  Builds and runs the check programs of this directory with the build lines in their headers, in a
+#  temporary directory. CXX and CXXFLAGS override the compiler and the optimization flags. Set ZLIB=1 to
+#  also check the compressed MolDump (needs zlib).
+#
+
+cd "$(dirname "$0")" || exit 1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+BUILD=$(mktemp -d) || exit 1
+trap 'rm -rf "$BUILD"' EXIT
+nfailed=0
+
+run() {
+    name=$1; shift
+    echo "--- $name"
+    if ! $CXX $CXXFLAGS -I.. "$name.cc" -o "$BUILD/$name" "$@"; then
+        echo "$name does not build"; nfailed=$((nfailed+1)); return
+    fi
+    if [ "$name" = test_moldump ]; then
+        python3 test_moldump.py "$BUILD/$name" || nfailed=$((nfailed+1))
+    else
+        "$BUILD/$name" || nfailed=$((nfailed+1))
+    fi
+}
+
+run test_raster_cache
+run test_slab_writer
+run test_abeles_parratt
+run test_envelope
+run test_philox
+run test_chisquare
+run test_threads -DMOLGROUPS_THREADS -pthread
+run test_checkpoint
+run test_work_queue -DMOLGROUPS_DISTRIBUTED
+if [ "${ZLIB:-0}" = 1 ]; then
+    run test_moldump -DMOLGROUPS_ZLIB -lz
+else
+    run test_moldump
+fi
+
+if [ $nfailed -eq 0 ]; then echo "all programs passed"; exit 0; fi
+echo "$nfailed program(s) FAILED"
+exit 1
@@ -0,0 +1,108 @@
+/*
+ *  test_abeles_parratt.cc
+ *
+ *  fnReflectivity (Abeles transfer matrices, chunked over Q) must agree with an independent Parratt
+ *  recursion in complex arithmetic, with the same conventions: the incident medium is aSlabs[0], k of a
+ *  layer is sqrt(kz^2-4pi(rho+i*mu-rho_0-i*mu_0)) with Im k<0 for absorption, so the phase of a layer is
+ *  exp(-2ikd), and the roughness of a slab applies to the interface below it as Nevot-Croce factor
+ *  exp(-2 k k_next sigma^2). Weak absorption at high Q tests the precision of Im k.
+ *
+ *  g++ -O2 -I.. test_abeles_parratt.cc -o test_abeles_parratt && ./test_abeles_parratt
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include <complex>
+
+#define NQ 300
+
+typedef std::complex<double> complex;
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//X_j=(r_j,j+1+X_j+1 p_j+1)/(1+r_j,j+1 X_j+1 p_j+1), p=exp(-2ikd), from the backing up, R=|X_0|^2
+double fnParratt(const Slab aSlabs[], int nslabs, double Q)
+{
+    complex k[16], X=0, r, p;
+    double kz=0.5*fabs(Q);
+    int j;
+
+    for (j=0; j<nslabs; j++) {
+        k[j]=sqrt(complex(kz*kz-4*M_PI*(aSlabs[j].rho-aSlabs[0].rho), (-4)*M_PI*(aSlabs[j].mu-aSlabs[0].mu)));
+    }
+    for (j=nslabs-2; j>=0; j--) {
+        r=(k[j]-k[j+1])/(k[j]+k[j+1])*exp((-2.)*k[j]*k[j+1]*aSlabs[j].rough*aSlabs[j].rough);
+        p=(j+1<nslabs-1) ? exp(complex(0,-2)*k[j+1]*aSlabs[j+1].d) : complex(1);
+        X=(r+X*p)/(1.+r*X*p);
+    }
+    return norm(X);
+}
+
+//largest relative difference between fnReflectivity and fnParratt
+double fnCompare(const Slab aSlabs[], int nslabs, ThreadPool *pool)
+{
+    double aQ[NQ], aR[NQ], dError=0, d;
+    int i;
+
+    for (i=0; i<NQ; i++) {aQ[i]=0.001+i*0.001;}
+    fnReflectivity(aSlabs, nslabs, aQ, NQ, aR, pool);
+    for (i=0; i<NQ; i++) {
+        d=fabs(aR[i]-fnParratt(aSlabs, nslabs, aQ[i]))/aR[i];
+        if (d>dError) {dError=d;}
+    }
+    return dError;
+}
+
+void fnSetSlab(Slab &s, double d, double rho, double mu, double rough)
+{
+    s.d=d; s.rho=rho; s.mu=mu; s.rough=rough;
+}
+
+//air / SiOx / tether / bilayer / D2O on Si, optionally rough and absorbing, from either side
+void fnSetStack(Slab aSlabs[], bool bRough, bool bAbsorbing, bool bReverse)
+{
+    double rough=(bRough) ? 4 : 0, mu=(bAbsorbing) ? 1 : 0;
+    Slab aStack[6];
+    int i;
+
+    fnSetSlab(aStack[0], 0,   0,       0,         rough);
+    fnSetSlab(aStack[1], 15,  3.4e-6,  1e-8*mu,   rough);
+    fnSetSlab(aStack[2], 60,  -0.4e-6, 2e-9*mu,   rough*0.5);
+    fnSetSlab(aStack[3], 25,  5.8e-6,  0,         rough*1.5);
+    fnSetSlab(aStack[4], 10,  1.2e-6,  5e-7*mu,   rough);
+    fnSetSlab(aStack[5], 0,   6.3e-6,  1e-7*mu,   0);
+    for (i=0; i<6; i++) {
+        aSlabs[i]=aStack[(bReverse) ? 5-i : i];
+        if (bReverse) {aSlabs[i].rough=(i<5) ? aStack[4-i].rough : 0;}
+    }
+}
+
+int main()
+{
+    Slab aSlabs[6];
+    ThreadPool pool(3);
+
+    fnSetStack(aSlabs, false, false, false);
+    fnCheck("bare substrate", fnCompare(aSlabs+4, 2, NULL), 1e-10);
+    fnCheck("sharp interfaces", fnCompare(aSlabs, 6, NULL), 1e-10);
+    fnSetStack(aSlabs, true, false, false);
+    fnCheck("rough interfaces", fnCompare(aSlabs, 6, NULL), 1e-10);
+    fnSetStack(aSlabs, false, true, false);
+    fnCheck("absorbing layers", fnCompare(aSlabs, 6, NULL), 1e-10);
+    fnSetStack(aSlabs, true, true, false);
+    fnCheck("rough and absorbing", fnCompare(aSlabs, 6, NULL), 1e-10);
+    fnSetStack(aSlabs, true, true, true);
+    fnCheck("rough and absorbing, from the backing side", fnCompare(aSlabs, 6, NULL), 1e-10);
+    fnCheck("rough and absorbing, on a thread pool", fnCompare(aSlabs, 6, &pool), 1e-10);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
@@ -0,0 +1,148 @@
+/*
+ *  test_checkpoint.cc
+ *
+ *  A DREAM run resumed from a Checkpoint must continue exactly as the uninterrupted run: bitwise the
+ *  same chains, chi-square, envelope and contour counts, and the same rows in the samples file, also when
+ *  the stopped run wrote rows past the checkpoint. Objects and values must come back unchanged, and
+ *  fnGetObject must refuse an object of another class.
+ *
+ *  g++ -O2 -I.. test_checkpoint.cc -o test_checkpoint && ./test_checkpoint
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include "fit_problem.h"
+
+#define NCHAINS 12
+#define NZ 150
+#define NY 80
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+void fnSetSampler(DreamSampler &sampler, Envelope &envelope, ContourHistogram &contour)
+{
+    sampler.nburn=30; sampler.nthin=2;
+    sampler.pEnvelope=&envelope; sampler.pContour=&contour;
+}
+
+//number of bytes in which two files differ, including the difference in length
+long fnCompareFiles(const char *cFile1, const char *cFile2)
+{
+    FILE *fp1, *fp2;
+    int c1, c2;
+    long ndiffer=0;
+
+    fp1=fopen(cFile1, "rb"); fp2=fopen(cFile2, "rb");
+    if ((fp1==NULL) || (fp2==NULL)) {
+        if (fp1) {fclose(fp1);}
+        if (fp2) {fclose(fp2);}
+        return -1;
+    }
+    do {
+        c1=fgetc(fp1); c2=fgetc(fp2);
+        if (c1!=c2) {ndiffer++;}
+    } while ((c1!=EOF) || (c2!=EOF));
+    fclose(fp1); fclose(fp2);
+    return ndiffer;
+}
+
+int fnDifferProfiles(nSLDObj &a, nSLDObj &b)
+{
+    Canvas canvas1(TEST_DIMENSION, TEST_STEPSIZE), canvas2(TEST_DIMENSION, TEST_STEPSIZE);
+    double aProfile[2][2*TEST_DIMENSION];
+    int i;
+
+    fnClearCanvas(canvas1); fnClearCanvas(canvas2);
+    a.fnWriteCanvas(canvas1); b.fnWriteCanvas(canvas2);
+    for (i=0; i<TEST_DIMENSION; i++) {
+        aProfile[0][i]=fnValue(canvas1.aArea[i]); aProfile[0][TEST_DIMENSION+i]=fnValue(canvas1.anSL[i]);
+        aProfile[1][i]=fnValue(canvas2.aArea[i]); aProfile[1][TEST_DIMENSION+i]=fnValue(canvas2.anSL[i]);
+    }
+    return fnDiffer(aProfile[0], aProfile[1], 2*TEST_DIMENSION);
+}
+
+int main()
+{
+    TestProblem problem(2);
+    char cDirectory[]="/tmp/test_checkpoint.XXXXXX", cCheckpoint[256], cSamplesA[256], cSamplesB[256], cCommand[300];
+    double aBands[2][MOLGROUPS_QUANTILES*TEST_DIMENSION], aValues[5]={1, 2, 3, 4, 5}, aRead[10];
+    int ndiffer;
+    tBLM_HC18_POPC_POPS bilayer, restored;
+    Box2Err other;
+    ParameterRegistry registry;
+    Checkpoint checkpoint, resumed;
+
+    if (mkdtemp(cDirectory)==NULL) {printf("no temporary directory\n"); return 1;}
+    snprintf(cCheckpoint, sizeof(cCheckpoint), "%s/run.ckpt", cDirectory);
+    snprintf(cSamplesA, sizeof(cSamplesA), "%s/A.dat", cDirectory);
+    snprintf(cSamplesB, sizeof(cSamplesB), "%s/B.dat", cDirectory);
+
+    //uninterrupted run A, and run C of the same seed into B.dat that is stopped some generations after
+    //the checkpoint it takes halfway
+    Envelope envelopeA(TEST_DIMENSION, TEST_STEPSIZE, 40), envelopeB(TEST_DIMENSION, TEST_STEPSIZE, 40);
+    Envelope envelopeC(TEST_DIMENSION, TEST_STEPSIZE, 40);
+    ContourHistogram contourA(0, 1, NZ, -1e-6, 1e-7, NY), contourB(0, 1, NZ, -1e-6, 1e-7, NY);
+    ContourHistogram contourC(0, 1, NZ, -1e-6, 1e-7, NY);
+    DreamSampler A(problem, NCHAINS, 7), B(problem, NCHAINS, 99), C(problem, NCHAINS, 7);
+    fnSetSampler(A, envelopeA, contourA);
+    fnSetSampler(B, envelopeB, contourB);
+    fnSetSampler(C, envelopeC, contourC);
+
+    bilayer.fnSet(2.5, 3.0, 4.5e-6, 6.3e-6, 0.8, 1.0, 10, 13, 13, 0.9, 0.3);
+    bilayer.fnRegisterParameters(registry);
+
+    A.fnOpenSamples(cSamplesA);
+    A.fnInitialize(NULL);
+    A.fnRun(40, NULL);
+    A.fnRun(40, NULL);
+    A.fnCloseSamples();
+
+    C.fnOpenSamples(cSamplesB);
+    C.fnInitialize(NULL);
+    C.fnRun(40, NULL);
+    checkpoint.fnAddSampler("dream", C);
+    checkpoint.fnAddEnvelope("rho", envelopeC);
+    checkpoint.fnAddContour("rho", contourC);
+    checkpoint.fnAddObject("bilayer", bilayer, registry);
+    checkpoint.fnAddValues("bootstrap", aValues, 5);
+    fnCheck("fnSave", (checkpoint.fnSave(cCheckpoint)) ? 0 : 1, 0);
+    C.fnRun(20, NULL);
+    C.fnCloseSamples();
+
+    //resumed from the checkpoint into a sampler, accumulators and object of other state
+    restored.fnSet(2, 2, 4e-6, 6e-6, 0.5, 1.0, 11, 11, 11, 0.5, 0.1);
+    fnCheck("fnLoad", (resumed.fnLoad(cCheckpoint)) ? 0 : 1, 0);
+    ndiffer=(resumed.fnGetSampler("dream", B) ? 0 : 1)+(resumed.fnGetEnvelope("rho", envelopeB) ? 0 : 1);
+    ndiffer+=(resumed.fnGetContour("rho", contourB) ? 0 : 1)+(resumed.fnGetObject("bilayer", restored, registry) ? 0 : 1);
+    fnCheck("sections not restored", ndiffer, 0);
+    fnCheck("values, count differing", fabs(resumed.fnGetValues("bootstrap", aRead, 10)-5.0), 0);
+    fnCheck("values, values differing", fnDiffer(aValues, aRead, 5), 0);
+    fnCheck("object, profile values differing", fnDifferProfiles(bilayer, restored), 0);
+    fnCheck("object of another class refused", (resumed.fnGetObject("bilayer", other, registry)) ? 1 : 0, 0);
+
+    B.fnOpenSamples(cSamplesB, true);
+    B.fnRun(40, NULL);
+    B.fnCloseSamples();
+    ndiffer=fnDiffer(A.aChains, B.aChains, NCHAINS*3)+fnDiffer(A.aChisq, B.aChisq, NCHAINS);
+    ndiffer+=abs(A.ngenerations-B.ngenerations)+abs(A.nsamples-B.nsamples);
+    fnCheck("resumed sampler, values differing", ndiffer, 0);
+    envelopeA.fnGetBands(aBands[0]); envelopeB.fnGetBands(aBands[1]);
+    fnCheck("resumed envelope, values differing", fnDiffer(aBands[0], aBands[1], MOLGROUPS_QUANTILES*TEST_DIMENSION), 0);
+    ndiffer=(memcmp(contourA.aCounts, contourB.aCounts, NZ*NY*sizeof(unsigned int))!=0)+abs(contourA.nprofiles-contourB.nprofiles);
+    fnCheck("resumed contour, counts differing", ndiffer, 0);
+    fnCheck("resumed samples file, bytes differing", fnCompareFiles(cSamplesA, cSamplesB), 0);
+
+    snprintf(cCommand, sizeof(cCommand), "rm -rf %s", cDirectory);
+    if (system(cCommand)!=0) {printf("could not remove %s\n", cDirectory);}
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
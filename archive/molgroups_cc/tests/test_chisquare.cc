@@ -0,0 +1,97 @@
+/*
+ *  test_chisquare.cc
+ *
+ *  fnChiSquareKernel must give the chi-square of a plain loop over the points up to rounding, and
+ *  bitwise the same residuals, for lengths that do and do not divide into its blocks of four. The form of
+ *  fnChiSquare that takes the R(Q) of all contrasts back to back must give the kernel's numbers per contrast.
+ *
+ *  g++ -O2 -I.. test_chisquare.cc -o test_chisquare && ./test_chisquare
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+
+#define NMAX 131
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//R(Q)-like data over several decades, with 3% errors and a model a few errors away
+void fnSetData(double aModel[], double aR[], double adR[], int n)
+{
+    int k;
+
+    for (k=0; k<n; k++) {
+        aR[k]=exp(-0.09*k)*(1+0.3*sin(0.7*k));
+        adR[k]=0.03*aR[k]+1e-9;
+        aModel[k]=aR[k]+adR[k]*2.5*sin(1.3*k+0.4);
+    }
+}
+
+double fnNaive(const double aModel[], const double aR[], const double adR[], int n, double aResiduals[])
+{
+    double chisq=0, d;
+    int k;
+
+    for (k=0; k<n; k++) {
+        d=(aModel[k]-aR[k])/adR[k];
+        if (aResiduals!=NULL) {aResiduals[k]=d;}
+        chisq+=d*d;
+    }
+    return chisq;
+}
+
+int main()
+{
+    const int an[9]={0, 1, 2, 3, 5, 7, 64, 121, NMAX};
+    double aModel[NMAX], aR[NMAX], adR[NMAX], aResiduals[2][NMAX];
+    double aChisq[2], dNoResiduals=0, dResiduals=0, dTotal, dContrast=0;
+    int i, ndiffer=0, noffset=0;
+    Dataset aData[3];
+    double aContrastChisq[3];
+
+    fnSetData(aModel, aR, adR, NMAX);
+    for (i=0; i<9; i++) {
+        aChisq[0]=fnNaive(aModel, aR, adR, an[i], NULL);
+        aChisq[1]=fnChiSquareKernel(aModel, aR, adR, an[i], NULL);
+        if (aChisq[0]>0) {dNoResiduals=fmax(dNoResiduals, fabs(aChisq[1]-aChisq[0])/aChisq[0]);}
+        else {dNoResiduals=fmax(dNoResiduals, fabs(aChisq[1]));}
+
+        memset(aResiduals, 0, sizeof(aResiduals));
+        aChisq[0]=fnNaive(aModel, aR, adR, an[i], aResiduals[0]);
+        aChisq[1]=fnChiSquareKernel(aModel, aR, adR, an[i], aResiduals[1]);
+        if (aChisq[0]>0) {dResiduals=fmax(dResiduals, fabs(aChisq[1]-aChisq[0])/aChisq[0]);}
+        else {dResiduals=fmax(dResiduals, fabs(aChisq[1]));}
+        ndiffer+=(memcmp(aResiduals[0], aResiduals[1], sizeof(double)*NMAX)!=0);
+    }
+    fnCheck("fnChiSquareKernel vs loop, relative", dNoResiduals, 1e-14);
+    fnCheck("fnChiSquareKernel vs loop with residuals, relative", dResiduals, 1e-14);
+    fnCheck("fnChiSquareKernel vs loop, residual arrays differing", ndiffer, 0);
+
+    //three contrasts of 7, 64 and 5 points back to back
+    for (i=0; i<3; i++) {
+        aData[i].aR=aR+noffset; aData[i].adR=adR+noffset; aData[i].nQ=an[(i==0) ? 5 : ((i==1) ? 6 : 4)];
+        noffset+=aData[i].nQ;
+    }
+    memset(aResiduals, 0, sizeof(aResiduals));
+    dTotal=fnChiSquare(aModel, aData, 3, aContrastChisq, aResiduals[0]);
+    fnNaive(aModel, aR, adR, noffset, aResiduals[1]);
+    noffset=0;
+    for (i=0; i<3; i++) {
+        dContrast=fmax(dContrast, fabs(aContrastChisq[i]-fnChiSquareKernel(aModel+noffset, aR+noffset, adR+noffset, aData[i].nQ, NULL)));
+        noffset+=aData[i].nQ;
+    }
+    fnCheck("fnChiSquare of contrasts, contrast chi-square vs kernel", dContrast, 0);
+    fnCheck("fnChiSquare of contrasts, total vs sum of contrasts", fabs(dTotal-((aContrastChisq[0]+aContrastChisq[1])+aContrastChisq[2])), 0);
+    fnCheck("fnChiSquare of contrasts, residuals differing", memcmp(aResiduals[0], aResiduals[1], sizeof(double)*NMAX)!=0, 0);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
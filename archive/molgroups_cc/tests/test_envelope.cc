@@ -0,0 +1,67 @@
+/*
+ *  test_envelope.cc
+ *
+ *  An Envelope that keeps its samples must give the quantiles of scoreatpercentile. Once it streams, it
+ *  must give the tracked quantiles close to the exact ones and NaN for fractions it does not track.
+ *
+ *  g++ -O2 -I.. test_envelope.cc -o test_envelope && ./test_envelope
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+
+#define NSAMPLES 2000
+#define NEXACT 51
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//scoreatpercentile of n values
+double fnScore(double aSorted[], int n, double dFraction)
+{
+    double dIndex=dFraction*(n-1);
+    int i=int(floor(dIndex));
+
+    if (i+1>=n) {return aSorted[n-1];}
+    return aSorted[i]+(aSorted[i+1]-aSorted[i])*(dIndex-i);
+}
+
+int main()
+{
+    const double aFractions[5]={0, 0.25, 0.5, 0.9, 1};
+    Envelope exact(2, 1, 100), streaming(2, 1, 50);
+    double aValues[2], aSorted[NEXACT], dError=0;
+    int i, j;
+
+    //0..NSAMPLES-1 in a scrambled order, the second bin twice the first
+    for (i=0; i<NSAMPLES; i++) {
+        aValues[0]=double((i*7919)%NSAMPLES); aValues[1]=2*aValues[0];
+        if (i<NEXACT) {exact.fnAdd(aValues, 2); aSorted[i]=aValues[0];}
+        streaming.fnAdd(aValues, 2);
+    }
+    std::sort(aSorted, aSorted+NEXACT);
+    for (j=0; j<5; j++) {
+        dError=fmax(dError, fabs(exact.fnGetQuantile(0, aFractions[j])-fnScore(aSorted, NEXACT, aFractions[j])));
+        dError=fmax(dError, fabs(exact.fnGetQuantile(1, aFractions[j])-2*fnScore(aSorted, NEXACT, aFractions[j])));
+    }
+    fnCheck("exact, quantiles vs scoreatpercentile", dError, 0);
+
+    dError=0;
+    fnCheck("streaming, switched", (streaming.bStreaming) ? 0 : 1, 0);
+    for (j=0; j<MOLGROUPS_QUANTILES; j++) {
+        dError=fmax(dError, fabs(streaming.fnGetQuantile(0, aEnvelopeQuantiles[j])-aEnvelopeQuantiles[j]*(NSAMPLES-1))/NSAMPLES);
+    }
+    fnCheck("streaming, tracked quantiles, relative to the range", dError, 0.02);
+    fnCheck("streaming, untracked fraction 0.25 not NaN", (isnan(streaming.fnGetQuantile(0, 0.25))) ? 0 : 1, 0);
+    fnCheck("streaming, untracked fraction 0.52 not NaN", (isnan(streaming.fnGetQuantile(1, 0.52))) ? 0 : 1, 0);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
@@ -0,0 +1,101 @@
+/*
+ *  test_moldump.cc
+ *
+ *  Writes the files that test_moldump.py reads back through molgroups/moldump.py into cDirectory: the
+ *  groups of one bilayer as text (mol.dat), as a raw MolDump (mol.bin) and, with MOLGROUPS_ZLIB, as a
+ *  compressed one (molz.bin), and the store of fnRecreateStatistical over a few samples (store.bin),
+ *  with a text mol.dat and the rho profile of every sample as reference (molN.dat, rhoN.txt).
+ *
+ *  g++ -O2 -I.. test_moldump.cc -o test_moldump && python3 test_moldump.py ./test_moldump
+ *  g++ -O2 -DMOLGROUPS_ZLIB -I.. test_moldump.cc -o test_moldump -lz && python3 test_moldump.py ./test_moldump
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include "bilayer_model.h"
+
+#define NSAMPLES 4
+
+bool fnWriteText(BilayerModel &model, const char *cFileName)
+{
+    FILE *fp;
+
+    fp=fopen(cFileName, "w");
+    if (fp==NULL) {return false;}
+    model.fnWriteGroups(fp, TEST_DIMENSION, TEST_STEPSIZE);
+    fclose(fp);
+    return true;
+}
+
+bool fnWriteBinary(BilayerModel &model, const char *cFileName, bool bCompress)
+{
+    MolDump dump;
+
+    if (dump.fnOpen(cFileName, bCompress)==NULL) {return false;}
+    model.fnWriteGroups(dump, TEST_DIMENSION, TEST_STEPSIZE);
+    dump.fnClose();
+    return true;
+}
+
+//z and rho of the canvas of the last evaluation at full precision
+bool fnWriteRho(BilayerModel &model, Canvas &canvas, const char *cFileName)
+{
+    double arho[TEST_DIMENSION];
+    FILE *fp;
+    int i;
+
+    fp=fopen(cFileName, "w");
+    if (fp==NULL) {return false;}
+    fnWriteCanvas2Buffer(canvas, &model.bulkrho, &model.bulkmu, 1, model.normarea, arho, NULL);
+    for (i=0; i<canvas.dimension; i++) {fprintf(fp, "%.17g %.17g\n", i*canvas.stepsize, arho[i]);}
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *acNames[3]={"l_lipid1", "l_lipid2", "vf_bilayer"};
+    double aParameters[3];
+    char cFile[4096], cStore[4096];
+    BilayerModel model;
+    Canvas canvas;
+    FILE *fp;
+    int i;
+    bool bOk=true;
+
+    if (argc<2) {printf("usage: test_moldump directory\n"); return 1;}
+
+    aParameters[0]=12.5; aParameters[1]=13.4; aParameters[2]=0.92;
+    model.fnEvaluate(aParameters, canvas);
+    snprintf(cFile, sizeof(cFile), "%s/mol.dat", argv[1]);
+    bOk&=fnWriteText(model, cFile);
+    snprintf(cFile, sizeof(cFile), "%s/mol.bin", argv[1]);
+    bOk&=fnWriteBinary(model, cFile, false);
+#ifdef MOLGROUPS_ZLIB
+    snprintf(cFile, sizeof(cFile), "%s/molz.bin", argv[1]);
+    bOk&=fnWriteBinary(model, cFile, true);
+#endif
+
+    snprintf(cFile, sizeof(cFile), "%s/SErr.dat", argv[1]);
+    fp=fopen(cFile, "w");
+    if (fp==NULL) {printf("cannot write %s\n", cFile); return 1;}
+    fprintf(fp, "Chisq l_lipid1 l_lipid2 vf_bilayer\n");
+    for (i=0; i<NSAMPLES; i++) {
+        aParameters[0]=11+0.75*i; aParameters[1]=14-0.5*i; aParameters[2]=0.8+0.05*i;
+        fprintf(fp, "%.17g %.17g %.17g %.17g\n", 100.0+i, aParameters[0], aParameters[1], aParameters[2]);
+        model.fnEvaluate(aParameters, canvas);
+        snprintf(cFile, sizeof(cFile), "%s/mol%i.dat", argv[1], i);
+        bOk&=fnWriteText(model, cFile);
+        snprintf(cFile, sizeof(cFile), "%s/rho%i.txt", argv[1], i);
+        bOk&=fnWriteRho(model, canvas, cFile);
+    }
+    fclose(fp);
+
+    snprintf(cFile, sizeof(cFile), "%s/SErr.dat", argv[1]);
+    snprintf(cStore, sizeof(cStore), "%s/store.bin", argv[1]);
+    bOk&=(fnRecreateStatistical(model, cFile, acNames, 3, cStore, true, false, NULL, 3)==NSAMPLES);
+
+    if (bOk==false) {printf("could not write all files to %s\n", argv[1]); return 1;}
+    return 0;
+}
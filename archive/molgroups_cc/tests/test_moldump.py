@@ -0,0 +1,138 @@
+"""
+test_moldump.py
+
+Runs test_moldump in a temporary directory and reads its files back through molgroups/moldump.py: the
+binary molgroups files must give the groups of the text mol.dat, and the store of fnRecreateStatistical
+the parameters, rho profiles and groups of every sample.
+
+python3 test_moldump.py ./test_moldump
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+
+import numpy
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..'))
+from molgroups import moldump
+
+nfailed = 0
+
+
+def fnCheck(test, error, tolerance):
+    global nfailed
+    print('%-60s max error %-12g %s' % (test, error, 'ok' if error <= tolerance else 'FAILED'))
+    if not error <= tolerance:
+        nfailed += 1
+
+
+def fnLoadMolgroupsText(filename):
+    # mol.dat as rs.py's fnLoadMolgroups reads it: a header line per group, a line of column names and
+    # the data lines up to an empty line
+    diMolgroups = {}
+    with open(filename) as f:
+        data = f.readlines()
+    i = 0
+    while i < len(data):
+        tdata = data[i].split()
+        if not tdata:
+            i += 1
+            continue
+        headerdata = {'Type': tdata[0], 'ID': tdata[1]}
+        for j in range(2, len(tdata) - 1, 2):
+            headerdata[tdata[j]] = tdata[j + 1]
+        i += 2
+        rows = []
+        while i < len(data) and data[i].split():
+            rows.append([float(x) for x in data[i].split()])
+            i += 1
+        columns = numpy.array(rows).reshape(-1, 3).T
+        diMolgroups[tdata[1]] = {'headerdata': headerdata, 'zaxis': columns[0], 'areaaxis': columns[1],
+                                 'nslaxis': columns[2]}
+    return diMolgroups
+
+
+def fnCompareMolgroups(diText, diBinary):
+    # largest difference in units of the last digit of mol.dat, %lf for z and area and %e for nSL, or
+    # infinity if the groups or their headers differ
+    if sorted(diText) != sorted(diBinary):
+        return numpy.inf
+    error = 0.0
+    for name in diText:
+        if diText[name]['headerdata'] != diBinary[name]['headerdata']:
+            return numpy.inf
+        for axis in ('zaxis', 'areaaxis', 'nslaxis'):
+            text, binary = diText[name][axis], diBinary[name][axis]
+            if len(text) != len(binary):
+                return numpy.inf
+            if len(text) == 0:
+                continue
+            if axis == 'nslaxis':
+                scale = 1e-6 * 10.0 ** numpy.floor(numpy.log10(numpy.maximum(numpy.abs(binary), 1e-300)))
+            else:
+                scale = 1e-6 * numpy.ones(len(binary))
+            error = max(error, numpy.max(numpy.abs(text - binary) / scale))
+    return error
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: python3 test_moldump.py ./test_moldump')
+        return 1
+    program = os.path.abspath(sys.argv[1])
+    with tempfile.TemporaryDirectory() as directory:
+        if subprocess.call([program, directory]) != 0:
+            print('%s failed' % program)
+            return 1
+
+        # mol.dat is rounded to half a last digit, the margin covers the decimal conversion
+        diText = fnLoadMolgroupsText(os.path.join(directory, 'mol.dat'))
+        diBinary = moldump.fnLoadMolgroupsBinary(os.path.join(directory, 'mol.bin'))
+        fnCheck('raw MolDump vs mol.dat, in last digits of mol.dat', fnCompareMolgroups(diText, diBinary), 0.51)
+        if os.path.exists(os.path.join(directory, 'molz.bin')):
+            diBinary = moldump.fnLoadMolgroupsBinary(os.path.join(directory, 'molz.bin'))
+            fnCheck('compressed MolDump vs mol.dat, in last digits of mol.dat', fnCompareMolgroups(diText, diBinary),
+                    0.51)
+
+        diStat = moldump.fnLoadStatStore(os.path.join(directory, 'store.bin'))
+        with open(os.path.join(directory, 'SErr.dat')) as f:
+            names = f.readline().split()
+            rows = numpy.array([[float(x) for x in line.split()] for line in f if line.split()])
+        fnCheck('store, samples missing', abs(diStat['NumberOfStatValues'] - len(rows)), 0)
+
+        error = 0.0
+        for j, name in enumerate(names):
+            if name == 'Chisq':
+                continue
+            values = numpy.array(diStat['Parameters'].get(name, {'Values': []})['Values'])
+            if len(values) != len(rows):
+                error = numpy.inf
+                continue
+            error = max(error, numpy.max(numpy.abs(values - rows[:, j])))
+        fnCheck('store, parameter values', error, 0.0)
+
+        rhoerror, grouperror = 0.0, 0.0
+        for i in range(min(diStat['NumberOfStatValues'], len(rows))):
+            reference = numpy.loadtxt(os.path.join(directory, 'rho%i.txt' % i))
+            profiles = diStat['nSLDProfiles'][i]
+            if len(profiles) != 1 or len(profiles[0][0]) != len(reference):
+                rhoerror = numpy.inf
+                continue
+            rhoerror = max(rhoerror, numpy.max(numpy.abs(profiles[0][0] - reference[:, 0])),
+                           numpy.max(numpy.abs(profiles[0][1] - reference[:, 1])))
+            diText = fnLoadMolgroupsText(os.path.join(directory, 'mol%i.dat' % i))
+            grouperror = max(grouperror, fnCompareMolgroups(diText, diStat['Molgroups'][i]))
+        fnCheck('store, z and rho of the samples', rhoerror, 0.0)
+        fnCheck('store, groups vs mol.dat, in last digits of mol.dat', grouperror, 0.51)
+
+    if nfailed == 0:
+        print('all tests passed')
+        return 0
+    print('%i test(s) FAILED' % nfailed)
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,102 @@
+/*
+ *  test_philox.cc
+ *
+ *  fnPhilox must reproduce the known-answer vectors of Philox4x32-10 published with Random123
+ *  (kat_vectors), and fnResample must give every replica the same numbers whether it is generated alone,
+ *  in a batch, in another order or on a thread pool. The deviates must be standard normal.
+ *
+ *  g++ -O2 -I.. test_philox.cc -o test_philox && ./test_philox
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+
+#define NQ 101
+#define NREPLICAS 400
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//number of output words of fnPhilox that differ from aExpected, the key is k1:k0
+int fnTestVector(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3, unsigned int k0, unsigned int k1, const unsigned int aExpected[4])
+{
+    unsigned int aCounter[4]={c0, c1, c2, c3}, aOut[4];
+    int i, ndiffer=0;
+
+    fnPhilox(aCounter, ((unsigned long long) k1<<32) | k0, aOut);
+    for (i=0; i<4; i++) {
+        if (aOut[i]!=aExpected[i]) {ndiffer++;}
+    }
+    return ndiffer;
+}
+
+int fnDiffer(const double a[], const double b[], int n)
+{
+    int i, ndiffer=0;
+
+    for (i=0; i<n; i++) {
+        if (memcmp(a+i, b+i, sizeof(double))!=0) {ndiffer++;}
+    }
+    return ndiffer;
+}
+
+int main()
+{
+    const unsigned int aZero[4]={0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    const unsigned int aOnes[4]={0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+    const unsigned int aPi[4]={0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+    double aQ[NQ], aR[NQ], adR[NQ], aBatch[NREPLICAS*NQ], aPool[NREPLICAS*NQ], aSingle[NQ];
+    double mean=0, var=0, z;
+    int i, j, ndiffer;
+    Dataset data;
+    ThreadPool pool(4);
+
+    fnCheck("philox4x32-10, zero counter and key", fnTestVector(0, 0, 0, 0, 0, 0, aZero), 0);
+    fnCheck("philox4x32-10, all-ones counter and key", fnTestVector(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, aOnes), 0);
+    fnCheck("philox4x32-10, digits of pi", fnTestVector(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0, aPi), 0);
+
+    //an odd number of points leaves half a pair in every row
+    for (i=0; i<NQ; i++) {aQ[i]=0.01+0.002*i; aR[i]=1.0/(1+i); adR[i]=0.1/(1+i);}
+    data.aQ=aQ; data.aR=aR; data.adR=adR; data.nQ=NQ;
+
+    fnResample(data, 5, 0, NREPLICAS, 1, aBatch, NULL);
+    fnResample(data, 5, 0, NREPLICAS, 1, aPool, &pool);
+    fnCheck("fnResample, batch on a thread pool, values differing", fnDiffer(aBatch, aPool, NREPLICAS*NQ), 0);
+
+    ndiffer=0;
+    for (j=NREPLICAS-1; j>=0; j-=7) {
+        fnResample(data, 5, j, 1, aSingle);
+        ndiffer+=fnDiffer(aSingle, aBatch+j*NQ, NQ);
+    }
+    fnCheck("fnResample, single replicas in reverse, values differing", ndiffer, 0);
+
+    fnResample(data, 5, 100, 50, 1, aPool, &pool);
+    fnCheck("fnResample, batch from replica 100, values differing", fnDiffer(aPool, aBatch+100*NQ, 50*NQ), 0);
+
+    fnResample(data, 5, 3, 2, aSingle);
+    ndiffer=NQ-fnDiffer(aSingle, aBatch+3*NQ, NQ);
+    fnCheck("fnResample, other contrast, values equal", ndiffer, 0);
+    fnResample(data, 6, 3, 1, aSingle);
+    ndiffer=NQ-fnDiffer(aSingle, aBatch+3*NQ, NQ);
+    fnCheck("fnResample, other seed, values equal", ndiffer, 0);
+
+    for (j=0; j<NREPLICAS; j++) {
+        for (i=0; i<NQ; i++) {
+            z=(aBatch[j*NQ+i]-aR[i])/adR[i];
+            mean+=z; var+=z*z;
+        }
+    }
+    mean/=NREPLICAS*NQ; var=var/(NREPLICAS*NQ)-mean*mean;
+    fnCheck("fnResample, mean of the deviates", fabs(mean), 0.02);
+    fnCheck("fnResample, variance of the deviates - 1", fabs(var-1), 0.02);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
@@ -0,0 +1,129 @@
+/*
+ *  test_raster_cache.cc
+ *
+ *  A molgroups object must write the profile of its current state, whether or not rasterization
+ *  caching is on and whichever way the state was changed.
+ *
+ *  g++ -O2 -I.. test_raster_cache.cc -o test_raster_cache && ./test_raster_cache
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+
+#define DIMENSION 400
+#define STEPSIZE 0.5
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+void fnSetDomain(tBLM_quaternary_chol_domain &o, double frac_domain)
+{
+    o.frac_domain=frac_domain;
+    o.l_lipid1_domain=14; o.l_lipid2_domain=14; o.l_tether_domain=10;
+    o.nf_lipid_2_domain=0.2; o.nf_lipid_3_domain=0; o.nf_chol_domain=0.3;
+    o.fnSet(2.5, 3, 4.5e-6, 6.3e-6, 0.8, 1, 10, 12, 12, 0.95, 0.3, 0, 0.1, 0, 0, 100);
+}
+
+void fnWrite(nSLDObj &o, bool bContrast, mgreal aArea[], mgreal anSL[], mgreal anSLBulk[])
+{
+    fnClearCanvas(aArea, anSL, anSLBulk, DIMENSION);
+    if (bContrast) {o.fnWriteContrastProfile(aArea, anSL, anSLBulk, DIMENSION, STEPSIZE, 0);}
+    else {o.fnWriteProfile(aArea, anSL, DIMENSION, STEPSIZE, 0);}
+}
+
+//largest difference of area, nSL (per 1e-6) and bulk dependence between the profiles of a and b
+double fnCompare(nSLDObj &a, nSLDObj &b, bool bContrast)
+{
+    mgreal aArea[2][DIMENSION], anSL[2][DIMENSION], anSLBulk[2][DIMENSION];
+    double dError=0, d;
+    int i;
+    
+    fnWrite(a, bContrast, aArea[0], anSL[0], anSLBulk[0]);
+    fnWrite(b, bContrast, aArea[1], anSL[1], anSLBulk[1]);
+    for (i=0; i<DIMENSION; i++) {
+        d=fabs(fnValue(aArea[0][i])-fnValue(aArea[1][i]));
+        if (d>dError) {dError=d;}
+        d=fabs(fnValue(anSL[0][i])-fnValue(anSL[1][i]))*1e6;
+        if (d>dError) {dError=d;}
+        d=fabs(fnValue(anSLBulk[0][i])-fnValue(anSLBulk[1][i]));
+        if (d>dError) {dError=d;}
+    }
+    return dError;
+}
+
+//frac_domain has no setter, it changes between two fnSet calls with identical arguments
+void fnTestDomain(bool bCaching, bool bContrast, const char *cTest)
+{
+    tBLM_quaternary_chol_domain a, b;
+    mgreal aArea[DIMENSION], anSL[DIMENSION], anSLBulk[DIMENSION];
+    
+    a.fnSetCaching(bCaching);
+    fnSetDomain(a, 0.1);
+    fnWrite(a, bContrast, aArea, anSL, anSLBulk);
+    fnSetDomain(a, 0.6);
+    fnSetDomain(b, 0.6);
+    fnCheck(cTest, fnCompare(a, b, bContrast), 1e-9);
+}
+
+//with caching, returning to an earlier state replays its slot
+void fnTestDomainRevisit(bool bContrast, const char *cTest)
+{
+    tBLM_quaternary_chol_domain a, b;
+    mgreal aArea[DIMENSION], anSL[DIMENSION], anSLBulk[DIMENSION];
+    
+    a.fnSetCaching(true);
+    fnSetDomain(a, 0.1);
+    fnWrite(a, bContrast, aArea, anSL, anSLBulk);
+    fnSetDomain(a, 0.6);
+    fnWrite(a, bContrast, aArea, anSL, anSLBulk);
+    fnSetDomain(a, 0.1);
+    fnSetDomain(b, 0.1);
+    fnCheck(cTest, fnCompare(a, b, bContrast), 1e-9);
+}
+
+//the contrast profile of an exchanging box, evaluated at another bulk nSLD, is the profile written
+//directly at that bulk nSLD
+void fnTestExchange(bool bCaching, const char *cTest)
+{
+    Box2Err box(20, 2, 3, 10, 300, 2e-4, 1);
+    mgreal aArea[2][DIMENSION], anSL[2][DIMENSION], anSLBulk[DIMENSION];
+    double dError=0, d;
+    int i;
+    
+    box.fnSetCaching(bCaching);
+    box.fnSetnSL(2e-4, 5e-4);
+    box.nsldbulk_store=4e-6;
+    box.fnSetDirty();
+    fnWrite(box, true, aArea[0], anSL[0], anSLBulk);
+    box.nsldbulk_store=-0.5e-6;
+    box.fnSetDirty();
+    fnClearCanvas(aArea[1], anSL[1], DIMENSION);
+    box.fnWriteProfile(aArea[1], anSL[1], DIMENSION, STEPSIZE, 0);
+    for (i=0; i<DIMENSION; i++) {
+        d=fabs(fnValue(anSL[0][i])-0.5e-6*fnValue(anSLBulk[i])-fnValue(anSL[1][i]))*1e6;
+        if (d>dError) {dError=d;}
+    }
+    fnCheck(cTest, dError, 1e-9);
+}
+
+int main()
+{
+    fnTestDomain(false, true, "domain, no caching, contrast profile");
+    fnTestDomain(false, false, "domain, no caching, profile");
+    fnTestDomain(true, true, "domain, caching, contrast profile");
+    fnTestDomain(true, false, "domain, caching, profile");
+    fnTestDomainRevisit(true, "domain, caching, earlier state, contrast profile");
+    fnTestDomainRevisit(false, "domain, caching, earlier state, profile");
+    fnTestExchange(false, "Box2Err, proton exchange, contrast profile");
+    fnTestExchange(true, "Box2Err, proton exchange, caching, contrast profile");
+    
+    if (nfailed>0) {printf("%i test(s) FAILED\n", nfailed); return 1;}
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ *  test_slab_writer.cc
+ *
+ *  An incremental slab write must leave the buffer as a full write would, also after the canvas was
+ *  written with bIncremental off in between and when bulk values or the buffer change.
+ *
+ *  g++ -O2 -I.. test_slab_writer.cc -o test_slab_writer && ./test_slab_writer
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include "bilayer_model.h"
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//rho of the bilayer with l_lipid1 in a fresh buffer, written in full
+void fnReference(BilayerModel &model, double l_lipid1, double bulkrho, double arho[])
+{
+    double aParameters[3]={l_lipid1, 13.4, 0.92};
+    Canvas canvas;
+
+    model.fnEvaluate(aParameters, canvas);
+    fnWriteCanvas2Buffer(canvas, &bulkrho, &bulkrho, 1, model.normarea, arho, NULL);
+}
+
+void fnWrite(BilayerModel &model, Canvas &canvas, double l_lipid1, double bulkrho, double arho[])
+{
+    double aParameters[3]={l_lipid1, 13.4, 0.92};
+
+    model.fnEvaluate(aParameters, canvas);
+    fnWriteCanvas2Buffer(canvas, &bulkrho, &bulkrho, 1, model.normarea, arho, NULL);
+}
+
+int main()
+{
+    BilayerModel model;
+    Canvas canvas;
+    double arho[2][TEST_DIMENSION], aReference[TEST_DIMENSION];
+
+    canvas.bIncremental=true;
+    fnWrite(model, canvas, 12.5, 6.3e-6, arho[0]);
+    canvas.bIncremental=false;
+    fnWrite(model, canvas, 11, 6.3e-6, arho[0]);
+    canvas.bIncremental=true;
+    fnWrite(model, canvas, 12.5, 6.3e-6, arho[0]);
+    fnReference(model, 12.5, 6.3e-6, aReference);
+    fnCheck("incremental after a non-incremental write, bins differing", fnDiffer(arho[0], aReference, TEST_DIMENSION), 0);
+
+    fnWrite(model, canvas, 12.5, -0.5e-6, arho[0]);
+    fnReference(model, 12.5, -0.5e-6, aReference);
+    fnCheck("incremental with another bulk, bins differing", fnDiffer(arho[0], aReference, TEST_DIMENSION), 0);
+
+    memset(arho[1], 0, sizeof(arho[1]));
+    fnWrite(model, canvas, 12.5, -0.5e-6, arho[1]);
+    fnCheck("incremental into another buffer, bins differing", fnDiffer(arho[1], aReference, TEST_DIMENSION), 0);
+
+    fnWrite(model, canvas, 14, -0.5e-6, arho[1]);
+    fnReference(model, 14, -0.5e-6, aReference);
+    fnCheck("incremental with another profile, bins differing", fnDiffer(arho[1], aReference, TEST_DIMENSION), 0);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
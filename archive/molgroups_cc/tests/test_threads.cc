@@ -0,0 +1,167 @@
+/*
+ *  test_threads.cc
+ *
+ *  Work spread over a ThreadPool must give bitwise the same results as the serial code, for any number of
+ *  threads: R(Q), the R(Q) of several contrasts of one canvas, population evaluation, bootstrap rows, DREAM
+ *  chains and their envelope, and the contrast-parallel chi-square against fnChiSquare. Without
+ *  MOLGROUPS_THREADS the pool runs serially and the program checks the chunking only.
+ *
+ *  g++ -O2 -DMOLGROUPS_THREADS -pthread -I.. test_threads.cc -o test_threads && ./test_threads
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include "fit_problem.h"
+
+#define NTHREADS 4
+#define NCONTRASTS 6
+#define NMEMBERS 16
+#define NREPLICAS 4
+#define NCHAINS 12
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//NMEMBERS parameter vectors of l_lipid1, l_lipid2 and vf_bilayer spread over 10..15, 10..15 and 0.7..1
+void fnSetMembers(double aParameters[])
+{
+    const double aLower[3]={10, 10, 0.7}, aUpper[3]={15, 15, 1.0};
+    int i, j;
+
+    for (i=0; i<NMEMBERS; i++) {
+        for (j=0; j<3; j++) {
+            aParameters[i*3+j]=aLower[j]+(aUpper[j]-aLower[j])*((i*7+j*3)%NMEMBERS+0.5)/NMEMBERS;
+        }
+    }
+}
+
+int fnTestReflectivity(ThreadPool *pool)
+{
+    double aQ[1000], aR[2][1000];
+    Slab aSlabs[4];
+    int i;
+
+    aSlabs[0].rough=3; aSlabs[1].d=40; aSlabs[1].rho=4e-6; aSlabs[1].mu=1e-8; aSlabs[1].rough=5;
+    aSlabs[2].d=15; aSlabs[2].rho=-0.5e-6; aSlabs[2].rough=2; aSlabs[3].rho=2.07e-6;
+    for (i=0; i<1000; i++) {aQ[i]=0.0003*(i+1);}
+    fnReflectivity(aSlabs, 4, aQ, 1000, aR[0], NULL);
+    fnReflectivity(aSlabs, 4, aQ, 1000, aR[1], pool);
+    return fnDiffer(aR[0], aR[1], 1000);
+}
+
+//a tethered bilayer on silicon in NCONTRASTS bulk contrasts, every second one smeared, each with its
+//own number of Q points, against fnCanvasReflectivity contrast by contrast
+int fnTestContrasts(ThreadPool *pool)
+{
+    double aQ[TEST_NQ], adQ[TEST_NQ], aR[2][NCONTRASTS*TEST_NQ];
+    Slab aTop[1];
+    ContrastJob aJobs[NCONTRASTS];
+    Canvas canvas(TEST_DIMENSION, TEST_STEPSIZE, false, true);
+    tBLM_HC18_POPC_POPS bilayer;
+    mgreal normarea;
+    int i, j;
+
+    for (i=0; i<TEST_NQ; i++) {aQ[i]=0.01+i*0.002; adQ[i]=0.02*aQ[i];}
+    memset(aR, 0, sizeof(aR));
+    aTop[0].rho=2.07e-6;
+    bilayer.fnSet(2.5, 3.0, 4.5e-6, 6.3e-6, 0.8, 1.0, 12.5, 13.4, 13.4, 0.92, 0.3);
+    fnClearCanvas(canvas);
+    normarea=bilayer.fnWriteCanvas(canvas);
+    for (j=0; j<NCONTRASTS; j++) {
+        aJobs[j].aTop=aTop; aJobs[j].ntop=1;
+        aJobs[j].bulkrho=-0.56e-6+j*1.4e-6; aJobs[j].bulkmu=(j%3)*1e-9;
+        aJobs[j].aQ=aQ; aJobs[j].adQ=(j%2) ? adQ : NULL; aJobs[j].nQ=TEST_NQ-10*j;
+        aJobs[j].aR=aR[0]+j*TEST_NQ;
+        fnCanvasReflectivity(aTop, 1, canvas, aJobs[j].bulkrho, aJobs[j].bulkmu, normarea, 0, aQ, aJobs[j].adQ, aJobs[j].nQ, 5, aR[1]+j*TEST_NQ);
+    }
+    fnContrastReflectivity(canvas, normarea, 0, 5, aJobs, NCONTRASTS, pool);
+    return fnDiffer(aR[0], aR[1], NCONTRASTS*TEST_NQ);
+}
+
+int fnTestPopulation(BilayerModel &model, const double aQ[], ThreadPool *pool)
+{
+    double aParameters[NMEMBERS*3], aR[2][NMEMBERS*TEST_NQ];
+
+    fnSetMembers(aParameters);
+    fnEvaluatePopulation(model, aParameters, NMEMBERS, 3, aQ, NULL, TEST_NQ, aR[0], NULL);
+    fnEvaluatePopulation(model, aParameters, NMEMBERS, 3, aQ, NULL, TEST_NQ, aR[1], pool);
+    return fnDiffer(aR[0], aR[1], NMEMBERS*TEST_NQ);
+}
+
+int fnTestBootstrap(TestProblem &problem, const double aSerial[], ThreadPool *pool)
+{
+    double aResults[NREPLICAS*4];
+
+    fnBootstrap(problem, NREPLICAS, 42, aResults, pool);
+    return fnDiffer(aSerial, aResults, NREPLICAS*4);
+}
+
+//chains, chi-square and the rho envelope of the samples after 60 generations
+void fnRunDream(TestProblem &problem, ThreadPool *pool, double aResults[])
+{
+    DreamSampler sampler(problem, NCHAINS, 7);
+    Envelope envelope(TEST_DIMENSION, TEST_STEPSIZE);
+
+    sampler.nburn=30; sampler.nthin=5; sampler.pEnvelope=&envelope;
+    sampler.fnInitialize(pool);
+    sampler.fnRun(60, pool);
+    memcpy(aResults, sampler.aChains, NCHAINS*3*sizeof(double));
+    memcpy(aResults+NCHAINS*3, sampler.aChisq, NCHAINS*sizeof(double));
+    envelope.fnGetBands(aResults+NCHAINS*4);
+}
+
+int fnTestContrastEvaluator(TestProblem &problem, ThreadPool *pool)
+{
+    double x[3]={12.1, 13.9, 0.88}, aScratch[TEST_NQ];
+    double aTotal[2], aChisq[2][3], aResiduals[2][3*TEST_NQ];
+    int n=problem.aData[0].nQ+problem.aData[1].nQ+problem.aData[2].nQ;
+    Canvas canvas;
+    ContrastEvaluator evaluator(problem);
+
+    aTotal[0]=fnChiSquare(problem.aModels, problem.aData, 3, x, canvas, aScratch, aChisq[0], aResiduals[0]);
+    aTotal[1]=evaluator.fnChiSquare(x, pool, aChisq[1], aResiduals[1]);
+    return fnDiffer(aTotal, aTotal+1, 1)+fnDiffer(aChisq[0], aChisq[1], 3)+fnDiffer(aResiduals[0], aResiduals[1], n);
+}
+
+int main()
+{
+    BilayerModel model;
+    TestProblem problem(3);
+    double aQ[TEST_NQ], aBootstrap[NREPLICAS*4];
+    double aDream[2][NCHAINS*4+MOLGROUPS_QUANTILES*TEST_DIMENSION];
+    int n=NCHAINS*4+MOLGROUPS_QUANTILES*TEST_DIMENSION;
+    int i, nthreads, aDiffer[6]={0, 0, 0, 0, 0, 0};
+
+    for (i=0; i<TEST_NQ; i++) {aQ[i]=0.01+i*0.002;}
+    fnBootstrap(problem, NREPLICAS, 42, aBootstrap, NULL);
+    fnRunDream(problem, NULL, aDream[0]);
+
+    for (nthreads=1; nthreads<=NTHREADS; nthreads++) {
+        ThreadPool pool(nthreads);
+        aDiffer[0]+=fnTestReflectivity(&pool);
+        aDiffer[1]+=fnTestContrasts(&pool);
+        aDiffer[2]+=fnTestPopulation(model, aQ, &pool);
+        aDiffer[3]+=fnTestBootstrap(problem, aBootstrap, &pool);
+        aDiffer[4]+=fnTestContrastEvaluator(problem, &pool);
+        fnRunDream(problem, &pool, aDream[1]);
+        aDiffer[5]+=fnDiffer(aDream[0], aDream[1], n);
+    }
+    aDiffer[1]+=fnTestContrasts(NULL);
+    aDiffer[4]+=fnTestContrastEvaluator(problem, NULL);
+    fnCheck("fnReflectivity, values differing on 1-4 threads", aDiffer[0], 0);
+    fnCheck("fnContrastReflectivity, values differing on 1-4 threads", aDiffer[1], 0);
+    fnCheck("fnEvaluatePopulation, values differing on 1-4 threads", aDiffer[2], 0);
+    fnCheck("fnBootstrap, values differing on 1-4 threads", aDiffer[3], 0);
+    fnCheck("ContrastEvaluator vs fnChiSquare, values differing", aDiffer[4], 0);
+    fnCheck("DreamSampler, values differing on 1-4 threads", aDiffer[5], 0);
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
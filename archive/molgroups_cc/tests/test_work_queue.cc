@@ -0,0 +1,122 @@
+/*
+ *  test_work_queue.cc
+ *
+ *  Bootstrap replicas handed out by a WorkQueue must come back as bitwise the same rows as fnBootstrap
+ *  computes in one process: over sockets with fnRunLocal, and through a directory, also when a worker
+ *  dies on an item it has claimed. The directory must be left without files of the job. fnRunLocal must
+ *  return -1 rather than wait for ever when all its workers die.
+ *
+ *  g++ -O2 -DMOLGROUPS_DISTRIBUTED -I.. test_work_queue.cc -o test_work_queue && ./test_work_queue
+ *
+ */
+
+#include "refl.h"
+#include "molgroups.cc"
+#include "fit_problem.h"
+#include <sys/wait.h>
+
+#define NREPLICAS 6
+
+int nfailed=0;
+
+void fnCheck(const char *cTest, double dError, double dTolerance)
+{
+    printf("%-60s max error %-12g %s\n", cTest, dError, (dError<=dTolerance) ? "ok" : "FAILED");
+    if (dError>dTolerance) {nfailed++;}
+}
+
+//a worker that dies on the first item it claims, leaving its claim behind
+void fnDyingWork(int iReplica, double aRow[], void *pData)
+{
+    _exit(1);
+}
+
+//rows of NREPLICAS replicas through cDirectory, with one worker that dies and one that stays. The one
+//that stays waits for the end of the pipe the first one holds, so the first one always finds an item
+//to claim. bDied tells whether it died
+int fnServeWithWorkers(const char *cDirectory, BootstrapWork &work, double aResults[], bool &bDied)
+{
+    WorkQueue queue(NREPLICAS, 4);
+    pid_t aPid[2];
+    int i, n, aStatus[2], aPipe[2];
+    char c;
+
+    if (pipe(aPipe)!=0) {bDied=false; return 0;}
+    for (i=0; i<2; i++) {
+        aPid[i]=fork();
+        if (aPid[i]==0) {
+            close(aPipe[(i==0) ? 0 : 1]);
+            if (i==1) {while (read(aPipe[0], &c, 1)>0) {}}
+            fnWorkDirectory(cDirectory, (i==0) ? fnDyingWork : fnBootstrapWork, &work);
+            _exit(0);
+        }
+    }
+    close(aPipe[0]); close(aPipe[1]);
+    n=queue.fnServeDirectory(cDirectory, 5);
+    for (i=0; i<2; i++) {waitpid(aPid[i], aStatus+i, 0);}
+    bDied=WIFEXITED(aStatus[0]) && (WEXITSTATUS(aStatus[0])==1);
+    memcpy(aResults, queue.aResults, NREPLICAS*4*sizeof(double));
+    return n;
+}
+
+//files in cDirectory other than keep.txt
+int fnCountFiles(const char *cDirectory)
+{
+    DIR *dir;
+    struct dirent *entry;
+    int n=0;
+
+    dir=opendir(cDirectory);
+    if (dir==NULL) {return -1;}
+    while ((entry=readdir(dir))!=NULL) {
+        if ((entry->d_name[0]!='.') && (strcmp(entry->d_name, "keep.txt")!=0)) {n++;}
+    }
+    closedir(dir);
+    return n;
+}
+
+int main()
+{
+    TestProblem problem(2);
+    BootstrapWork work;
+    double aSerial[NREPLICAS*4], aResults[NREPLICAS*4];
+    char cDirectory[]="/tmp/test_work_queue.XXXXXX", cFile[256];
+    FILE *fp;
+    int n;
+    bool bDied;
+
+    work.problem=&problem; work.iSeed=42;
+    fnBootstrap(problem, NREPLICAS, 42, aSerial, NULL);
+
+    {
+        WorkQueue queue(NREPLICAS, 4);
+        n=queue.fnRunLocal(2, fnBootstrapWork, &work);
+        fnCheck("fnRunLocal, values differing from fnBootstrap", fnDiffer(aSerial, queue.aResults, NREPLICAS*4)+NREPLICAS-n, 0);
+    }
+    {
+        WorkQueue queue(NREPLICAS, 4);
+        alarm(60);                                  //a hang ends the program
+        n=queue.fnRunLocal(2, fnDyingWork, &work);
+        alarm(0);
+        fnCheck("fnRunLocal with all workers dying, not -1", (n==-1) ? 0 : 1, 0);
+        fnCheck("fnRunLocal with all workers dying, items done", queue.ndone, 0);
+    }
+
+    if (mkdtemp(cDirectory)==NULL) {printf("no temporary directory\n"); return 1;}
+    snprintf(cFile, sizeof(cFile), "%s/keep.txt", cDirectory);
+    fp=fopen(cFile, "w"); fprintf(fp, "not part of any job\n"); fclose(fp);
+    snprintf(cFile, sizeof(cFile), "%s/0123456789abcdef.3.result", cDirectory);
+    fp=fopen(cFile, "w"); fprintf(fp, "left over from a stopped job\n"); fclose(fp);
+
+    n=fnServeWithWorkers(cDirectory, work, aResults, bDied);
+    fnCheck("directory, the dying worker died", (bDied) ? 0 : 1, 0);
+    fnCheck("directory with a dying worker, values differing", fnDiffer(aSerial, aResults, NREPLICAS*4)+NREPLICAS-n, 0);
+    fnCheck("directory, files left behind", fnCountFiles(cDirectory), 0);
+
+    snprintf(cFile, sizeof(cFile), "rm -rf %s", cDirectory);
+    if (system(cFile)!=0) {printf("could not remove %s\n", cDirectory);}
+
+    if (nfailed==0) {printf("all tests passed\n"); return 0;}
+    printf("%i test(s) FAILED\n", nfailed);
+    return 1;
+}
@@ -0,0 +1,124 @@
+import zlib
+
+import numpy
+
+
+def _fnReadColumns(data, pos, tdata, dtype):
+    # tdata: tag name n codec nbytes, returns the three columns and the position behind the payload
+    name, n, codec, nbytes = tdata[1], int(tdata[2]), int(tdata[3]), int(tdata[4])
+    payload = data[pos:pos + nbytes]
+    if codec == 1:
+        # undo the byte shuffle: the k-th bytes of all 3n doubles are stored contiguously
+        shuffled = numpy.frombuffer(zlib.decompress(payload), dtype=numpy.uint8)
+        payload = shuffled.reshape(dtype.itemsize, 3 * n).T.tobytes()
+    elif codec != 0:
+        raise ValueError('unknown codec %i in block %s' % (codec, name))
+    columns = numpy.frombuffer(payload, dtype=dtype, count=3 * n).astype(float).reshape(3, n)
+    return columns, pos + nbytes
+
+
+def _fnParse(filename):
+    # yields the records of a binary molgroups file as (tdata, columns), columns is None for text lines
+    with open(filename, 'rb') as f:
+        data = f.read()
+
+    def readline(pos):
+        end = data.index(b'\n', pos)
+        return data[pos:end].decode('ascii'), end + 1
+
+    line, pos = readline(0)
+    tdata = line.split()
+    if len(tdata) < 3 or tdata[0] != 'MOLGROUPS-BINARY':
+        raise ValueError(filename + ' is not a binary molgroups file')
+    if tdata[1] != '1':
+        raise ValueError('unsupported binary molgroups file version ' + tdata[1])
+    dtype = numpy.dtype('<f8') if tdata[2] == 'little' else numpy.dtype('>f8')
+
+    while pos < len(data):
+        line, pos = readline(pos)
+        tdata = line.split()
+        if not tdata:
+            continue
+        if tdata[0] in ('#BLOCK', '#PROFILE'):
+            columns, pos = _fnReadColumns(data, pos, tdata, dtype)
+            yield tdata, columns
+        else:
+            yield tdata, None
+
+
+def _fnAddRecord(diMolgroups, tdata, columns):
+    if columns is not None:
+        name = tdata[1]
+        group = diMolgroups.setdefault(name, {'headerdata': {'Type': '', 'ID': name}})
+        group.update({'zaxis': columns[0], 'areaaxis': columns[1], 'nslaxis': columns[2]})
+        return
+
+    # header line: Type ID key value key value ...
+    headerdata = {'Type': tdata[0], 'ID': tdata[1]}
+    for j in range(2, len(tdata) - 1, 2):
+        headerdata[tdata[j]] = tdata[j + 1]
+    diMolgroups[tdata[1]] = {'headerdata': headerdata, 'zaxis': numpy.zeros(0),
+                             'areaaxis': numpy.zeros(0), 'nslaxis': numpy.zeros(0)}
+
+
+def fnLoadMolgroupsBinary(filename):
+    """
+    Reads a binary molgroups file written through MolDump (molgroups_cc) and returns a dictionary in the
+    layout of the mol.dat reader: diMolgroups[name] = {'headerdata': {'Type': ..., 'ID': ..., key: value},
+    'zaxis': ..., 'areaaxis': ..., 'nslaxis': ...}. The axes are numpy arrays. Groups that only write a
+    header line (composites) have empty axes.
+    """
+    diMolgroups = {}
+    for tdata, columns in _fnParse(filename):
+        _fnAddRecord(diMolgroups, tdata, columns)
+    return diMolgroups
+
+
+def fnLoadStatStore(filename):
+    """
+    Reads the store written by fnRecreateStatistical (molgroups_cc) into the layout of rs.py's
+    diStatResults: 'Parameters': {name: {'Values': [...]}}, 'nSLDProfiles': one [(z, rho)] per sample,
+    'Molgroups': one molgroups dictionary per sample (see fnLoadMolgroupsBinary), and 'Absorption': one
+    [(z, mu)] per sample.
+    """
+    diStatResults = {'Parameters': {}, 'nSLDProfiles': [], 'Absorption': [], 'Molgroups': []}
+    liNames = []
+    for tdata, columns in _fnParse(filename):
+        if tdata[0] == '#PARAMETERS':
+            liNames = tdata[1:]
+            for name in liNames:
+                diStatResults['Parameters'][name] = {'Values': []}
+        elif tdata[0] == '#SAMPLE':
+            for name, value in zip(liNames, tdata[2:]):
+                diStatResults['Parameters'][name]['Values'].append(float(value))
+            diStatResults['nSLDProfiles'].append([])
+            diStatResults['Absorption'].append([])
+            diStatResults['Molgroups'].append({})
+        elif tdata[0] == '#PROFILE':
+            diStatResults['nSLDProfiles'][-1].append((columns[0], columns[1]))
+            diStatResults['Absorption'][-1].append((columns[0], columns[2]))
+        else:
+            _fnAddRecord(diStatResults['Molgroups'][-1], tdata, columns)
+    diStatResults['NumberOfStatValues'] = len(diStatResults['nSLDProfiles'])
+    return diStatResults
+
+
+def fnLoadContour(filename):
+    """
+    Reads a contour histogram written by ContourHistogram::fnWrite (molgroups_cc) and returns the counts
+    as a numpy array [y][z] together with the z and y coordinates of the lower cell edges and the number
+    of profiles.
+    """
+    with open(filename, 'rb') as f:
+        data = f.read()
+    end = data.index(b'\n')
+    tdata = data[:end].decode('ascii').split()
+    if len(tdata) < 10 or tdata[0] != 'MOLGROUPS-CONTOUR':
+        raise ValueError(filename + ' is not a molgroups contour file')
+    if tdata[1] != '1':
+        raise ValueError('unsupported molgroups contour file version ' + tdata[1])
+    dtype = numpy.dtype('<u4') if tdata[2] == 'little' else numpy.dtype('>u4')
+    nz, ny = int(tdata[3]), int(tdata[4])
+    z0, dz, y0, dy = (float(x) for x in tdata[5:9])
+    counts = numpy.frombuffer(data, dtype=dtype, count=nz * ny, offset=end + 1).reshape(ny, nz)
+    return counts, z0 + dz * numpy.arange(nz), y0 + dy * numpy.arange(ny), int(tdata[9])